@@ -0,0 +1,52 @@
+# Helpers to translate templates into C++ headers as part of the build
+# using the `yate-compile` tool.
+#
+#   yate_compile_template(<output> <template>
+#                         [NAME <name>]
+#                         [NAMESPACE <namespace>]
+#                         [MINIFY]
+#                         [DELIMITERS <open> <close>]
+#                         [PARTIALS <partial>...])
+#
+# Adds a custom command which generates the header <output> from
+# <template>. The header is regenerated whenever the template or the
+# tool change. Partials included by the template are read from
+# `<name>.yate` files next to it and inlined; list them in PARTIALS so
+# changes to them also regenerate the header. MINIFY collapses the
+# whitespace of the literals of HTML templates. DELIMITERS replaces
+# `{{` and `}}`, e.g. for templates of JavaScript code. Add <output>
+# to the sources of a target to trigger the generation, e.g.:
+#
+#   yate_compile_template(${CMAKE_CURRENT_BINARY_DIR}/page.hh
+#                         ${CMAKE_CURRENT_SOURCE_DIR}/page.yate
+#                         NAMESPACE site)
+#   add_executable(server main.cc ${CMAKE_CURRENT_BINARY_DIR}/page.hh)
+#   target_include_directories(server PRIVATE ${CMAKE_CURRENT_BINARY_DIR})
+function(yate_compile_template output template)
+  cmake_parse_arguments(
+    YATE_COMPILE "MINIFY" "NAME;NAMESPACE" "PARTIALS;DELIMITERS" ${ARGN})
+
+  set(arguments)
+  if (YATE_COMPILE_NAME)
+    list(APPEND arguments --name ${YATE_COMPILE_NAME})
+  endif()
+  if (YATE_COMPILE_NAMESPACE)
+    list(APPEND arguments --namespace ${YATE_COMPILE_NAMESPACE})
+  endif()
+  if (YATE_COMPILE_MINIFY)
+    list(APPEND arguments --minify)
+  endif()
+  if (YATE_COMPILE_DELIMITERS)
+    list(APPEND arguments --delimiters ${YATE_COMPILE_DELIMITERS})
+  endif()
+
+  get_filename_component(output_dir ${output} DIRECTORY)
+  add_custom_command(
+    OUTPUT ${output}
+    COMMAND ${CMAKE_COMMAND} -E make_directory ${output_dir}
+    COMMAND yate-compile ${arguments} ${template} ${output}
+    DEPENDS yate-compile ${template} ${YATE_COMPILE_PARTIALS}
+    COMMENT "Compiling template ${template}"
+    VERBATIM
+  )
+endfunction()
@@ -0,0 +1,325 @@
+#include <yate/allocation_counter.hh>
+#include <yate/compiler.hh>
+#include <yate/escape.hh>
+#include <yate/fd_sink.hh>
+#include <yate/generator.hh>
+#include <yate/gzip_sink.hh>
+#include <yate/hashing_sink.hh>
+#include <yate/renderer.hh>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+/// Runs `body` `iterations` times and prints the mean time of each
+/// run, the throughput given the number of bytes it produces and the
+/// heap allocations of each run.
+void Run(
+    const std::string &name,
+    int iterations,
+    std::size_t bytes,
+    const std::function<void()> &body) {
+  body();  // Warm up.
+  yate::AllocationCounter allocations;
+  auto begin = std::chrono::steady_clock::now();
+  for (int i = 0; i < iterations; ++i) {
+    body();
+  }
+  auto end = std::chrono::steady_clock::now();
+  auto allocations_per_run =
+      static_cast<double>(allocations.allocations()) / iterations;
+  auto seconds = std::chrono::duration<double>(end - begin).count();
+  auto mean_ms = 1000.0 * seconds / iterations;
+  auto mb_per_second = bytes * iterations / seconds / (1024.0 * 1024.0);
+  std::cout << std::left << std::setw(40) << name << std::right << std::fixed
+            << std::setprecision(3) << std::setw(10) << mean_ms << " ms"
+            << std::setprecision(1) << std::setw(10) << mb_per_second
+            << " MB/s" << std::setw(12) << allocations_per_run
+            << " allocs\n";
+}
+
+yate::Template CompileString(const std::string &text) {
+  std::stringstream input(text);
+  yate::Compiler compiler(input);
+  return compiler.Compile();
+}
+
+/// Compares rendering values verbatim with escaping them, for values
+/// which are mostly clean text, the common case for escaped output.
+void BenchmarkEscaping() {
+  std::vector<std::string> rows;
+  for (int i = 0; i < 100000; ++i) {
+    rows.push_back(
+        "Row number " + std::to_string(i) + " with a plain description " +
+        std::string(100, 'x') + " & a few <special> characters");
+  }
+  yate::Renderer renderer({}, {{"rows", rows}});
+
+  for (auto mode :
+       {yate::Escape::eNone, yate::Escape::eHtml, yate::Escape::eJson,
+        yate::Escape::eUrl}) {
+    auto tmpl = CompileString(
+        "{{#loop rows row}}<td>{{row | " + yate::to_string(mode) +
+        "}}</td>\n{{/loop}}");
+    std::string output;
+    yate::StringSink sink(output);
+    renderer.Render(tmpl, sink);
+    auto bytes = output.size();
+    Run("escape " + yate::to_string(mode), 10, bytes, [&]() {
+      output.clear();
+      renderer.Render(tmpl, sink);
+    });
+  }
+}
+
+/// A sink which only counts the bytes written to it.
+class CountingSink : public yate::Sink {
+ public:
+  void Write(const char *data, std::size_t size) override { bytes += size; }
+  void WriteStable(const char *data, std::size_t size) override {
+    bytes += size;
+  }
+  void Flush() override {}
+
+  std::size_t bytes = 0;
+};
+
+/// Compares exporting a large table from an array, which has to be
+/// built before rendering, with producing the rows from a generator.
+void BenchmarkGenerators() {
+  const std::size_t kRows = 1000000;
+  auto tmpl = CompileString(
+      "{{#loop rows row}}{{@number}},{{row}}\n{{/loop}}");
+  auto produce = [](std::size_t index, std::string &row) {
+    row = "customer " + std::to_string(index) + std::string(80, '.');
+  };
+
+  CountingSink sink;
+  Run("export from array", 3, kRows * 90, [&]() {
+    std::vector<std::string> rows(kRows);
+    for (std::size_t i = 0; i < kRows; ++i) {
+      produce(i, rows[i]);
+    }
+    yate::Renderer renderer({}, {{"rows", std::move(rows)}});
+    renderer.Render(tmpl, sink);
+  });
+  Run("export from generator", 3, kRows * 90, [&]() {
+    yate::Renderer renderer({}, {});
+    renderer.SetGenerator(
+        "rows",
+        std::make_shared<yate::FunctionGenerator>(
+            [&](std::size_t index, std::string &row) {
+              if (index >= kRows) {
+                return false;
+              }
+              produce(index, row);
+              return true;
+            }));
+    renderer.Render(tmpl, sink);
+  });
+}
+
+/// Renders a loop whose body mostly prints values of a large root
+/// context, which is dominated by symbol lookups.
+void BenchmarkLookups() {
+  std::unordered_map<std::string, std::string> values;
+  for (int i = 0; i < 1000; ++i) {
+    values["value" + std::to_string(i)] = std::to_string(i);
+  }
+  std::vector<std::string> rows(200000, "r");
+  yate::Renderer renderer(values, {{"rows", rows}});
+  auto tmpl = CompileString(
+      "{{#loop rows row}}{{value1}}{{value20}}{{value300}}{{value4000}}"
+      "{{value999}}{{row}}{{/loop}}");
+  renderer.SetValue("value4000", "x");
+  CountingSink sink;
+  renderer.Render(tmpl, sink);
+  Run("root lookups", 10, sink.bytes, [&]() { renderer.Render(tmpl, sink); });
+}
+
+/// Renders a small page over and over with the same renderer, the
+/// steady state of a server, which allocates nothing once warm.
+void BenchmarkSmallRenders() {
+  auto tmpl = CompileString(
+      "<h1>{{title | html}}</h1><ul>{{#loop items item}}<li>{{item | html}}"
+      "{{#if @last}}.{{/if}}</li>{{/loop}}</ul>{{#if footer}}{{footer}}"
+      "{{/if}}");
+  yate::Renderer renderer(
+      {{"title", "Small page"}, {"footer", "That's it"}},
+      {{"items", {"apple", "banana", "citrus & lime"}}});
+  std::string output;
+  yate::StringSink sink(output);
+  renderer.Render(tmpl, sink);
+  auto bytes = output.size();
+  Run("small page", 100000, bytes, [&]() {
+    output.clear();
+    renderer.Render(tmpl, sink);
+  });
+}
+
+/// Compares the generic rendering of loops with the kernels used for
+/// bodies which only print their element.
+void BenchmarkLoopKernels() {
+  std::vector<std::string> items;
+  for (int i = 0; i < 100000; ++i) {
+    items.push_back("item " + std::to_string(i));
+  }
+  yate::Renderer renderer({}, {{"items", items}});
+  std::vector<std::pair<std::string, std::string>> shapes = {
+      {"join", "{{#loop items item}}{{item}}{{/loop}}"},
+      {"surround", "{{#loop items item}}<li>{{item | html}}</li>{{/loop}}"},
+      {"separator",
+       "[{{#loop items item}}{{#if @index}}, {{/if}}\"{{item | json}}\""
+       "{{/loop}}]"}};
+  for (const auto &shape : shapes) {
+    auto tmpl = CompileString(shape.second);
+    std::string output;
+    yate::StringSink sink(output);
+    renderer.Render(tmpl, sink);
+    auto bytes = output.size();
+    for (auto kernels : {false, true}) {
+      renderer.set_loop_kernels(kernels);
+      auto name = "loop " + shape.first + (kernels ? " (kernel)" : "");
+      Run(name, 100, bytes, [&]() {
+        output.clear();
+        renderer.Render(tmpl, sink);
+      });
+    }
+  }
+}
+
+/// Compares computing the entity tag of a page by rendering it into a
+/// string and hashing the string with hashing it as it is rendered,
+/// without keeping the output.
+void BenchmarkHashing() {
+  auto tmpl = CompileString(
+      "<html><body>{{#loop rows row}}<tr><td>{{row | html}}</td>"
+      "<td>{{description}}</td></tr>\n{{/loop}}</body></html>\n");
+  std::vector<std::string> rows;
+  for (int i = 0; i < 1000; ++i) {
+    rows.push_back("row " + std::to_string(i) + std::string(50, '.'));
+  }
+  yate::Renderer renderer(
+      {{"description", std::string(100, 'd')}}, {{"rows", rows}});
+  CountingSink counter;
+  renderer.Render(tmpl, counter);
+  auto bytes = counter.bytes;
+
+  Run("render to string, then xxh64", 1000, bytes, [&]() {
+    std::string output;
+    yate::StringSink sink(output);
+    renderer.Render(tmpl, sink);
+    yate::HashingSink hashing;
+    hashing.Write(output.data(), output.size());
+  });
+  Run("hash-only sink (xxh64)", 1000, bytes, [&]() {
+    yate::HashingSink hashing;
+    renderer.Render(tmpl, hashing);
+  });
+  Run("hash-only sink (xxh64 + sha256)", 1000, bytes, [&]() {
+    yate::HashingSink hashing(true);
+    renderer.Render(tmpl, hashing);
+  });
+}
+
+#ifndef _WIN32
+/// Compares writing a large output through `std::ofstream` with the
+/// scatter-gather `FdSink`.
+void BenchmarkOutput(const std::string &path) {
+  auto tmpl = CompileString(
+      "<table>\n{{#loop rows row}}<tr class=\"row\"><td>{{row}}</td>"
+      "<td>{{description}}</td></tr>\n{{/loop}}</table>\n");
+  std::vector<std::string> rows;
+  for (int i = 0; i < 100000; ++i) {
+    rows.push_back("row " + std::to_string(i) + std::string(150, '.'));
+  }
+  yate::Renderer renderer(
+      {{"description", std::string(300, 'd')}}, {{"rows", rows}});
+
+  std::string output;
+  yate::StringSink sink(output);
+  renderer.Render(tmpl, sink);
+  auto bytes = output.size();
+
+  std::cout << "Rendering " << bytes / (1024 * 1024) << " MB into " << path
+            << '\n';
+  Run("ofstream", 10, bytes, [&]() {
+    std::ofstream stream(path, std::ios_base::binary | std::ios_base::trunc);
+    renderer.Render(tmpl, stream);
+  });
+  Run("FdSink (writev)", 10, bytes, [&]() {
+    int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    yate::FdSink fd_sink(fd);
+    renderer.Render(tmpl, fd_sink);
+    close(fd);
+  });
+  std::remove(path.c_str());
+}
+#endif
+
+#ifdef YATE_ZLIB
+/// Compresses responses of a page with long static markup around a
+/// small dynamic part, with and without caching the compressed form
+/// of the literals.
+void BenchmarkGzip() {
+  std::string markup;
+  for (int i = 0; markup.size() < 16 * 1024; ++i) {
+    markup += "<div class=\"nav-item item-" + std::to_string(i) +
+        "\"><a href=\"/section/" + std::to_string(i * 7) + "\">Section " +
+        std::to_string(i) + "</a></div>\n";
+  }
+  auto tmpl = CompileString(
+      "<html><head>" + markup + "</head><body><h1>{{title}}</h1>\n" +
+      "{{#loop items item}}<li>{{item}}</li>{{/loop}}\n" + markup +
+      "</body></html>\n");
+  yate::Renderer renderer(
+      {{"title", "Benchmark"}}, {{"items", {"one", "two", "three"}}});
+  CountingSink counter;
+  renderer.Render(tmpl, counter);
+  auto bytes = counter.bytes;
+
+  Run("gzip", 1000, bytes, [&]() {
+    yate::GzipSink sink(counter);
+    renderer.Render(tmpl, sink);
+  });
+  auto literals = std::make_shared<yate::CompressedLiterals>();
+  Run("gzip with compressed literals", 1000, bytes, [&]() {
+    yate::GzipSink sink(counter, Z_DEFAULT_COMPRESSION,
+                        yate::GzipSink::Format::eGzip, literals);
+    renderer.Render(tmpl, sink);
+  });
+}
+#endif
+
+} // namespace
+
+int main(int argc, char **argv) {
+  BenchmarkEscaping();
+  BenchmarkGenerators();
+  BenchmarkLookups();
+  BenchmarkSmallRenders();
+  BenchmarkLoopKernels();
+  BenchmarkHashing();
+#ifdef YATE_ZLIB
+  BenchmarkGzip();
+#endif
+#ifndef _WIN32
+  BenchmarkOutput(argc > 1 ? argv[1] : "yate-benchmark.out");
+#endif
+  return 0;
+}
@@ -0,0 +1,408 @@
+#include <yate/compiler.hh>
+#include <yate/fd_sink.hh>
+#include <yate/json_context.hh>
+#include <yate/renderer.hh>
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdlib>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace {
+
+void PrintUsage(const char *program) {
+  std::cerr << "Usage: " << program
+            << " [--jobs <n>] [--files <pattern>] [--batch <records>] "
+               "[--minify] [--delimiters <open> <close>] [--quiet] "
+               "<template> [<records.ndjson>]\n"
+            << "Renders a template once for every JSON object of an NDJSON "
+               "file, or of the\nstandard input when no file or '-' is "
+               "given. The outputs are written to the\nstandard output in "
+               "the order of the records or, with --files, one file per\n"
+               "record named after the pattern, where '%n' is replaced by "
+               "the line number of\nthe record.\n";
+}
+
+struct Options {
+  std::string template_path;
+  std::string input_path = "-";
+  std::string files;
+  unsigned jobs = std::max(1u, std::thread::hardware_concurrency());
+  std::size_t batch = 256;
+  bool minify = false;
+  std::string open = "{{";
+  std::string close = "}}";
+  bool quiet = false;
+};
+
+/// Records are handed to the workers in batches, which amortizes the
+/// locking over many small renders.
+struct Batch {
+  std::uint64_t sequence = 0;
+  /// The line numbers and text of the records.
+  std::vector<std::pair<std::uint64_t, std::string>> records;
+  /// The output of each record when they go to the standard output.
+  std::vector<std::string> outputs;
+  /// The error of each record, empty when it was rendered.
+  std::vector<std::string> errors;
+  std::uint64_t bytes = 0;
+};
+
+/// The batches moving between the reader, the workers and the writer.
+/// At most `max_batches` are read and not written yet, which bounds the
+/// memory taken whatever the size of the input.
+class BatchQueue {
+ public:
+  BatchQueue(std::size_t max_batches)
+      : max_batches_(max_batches),
+        in_flight_(0),
+        closed_(false),
+        pending_(),
+        finished_() {}
+  ~BatchQueue() {}
+
+  // Not copyable nor movable.
+  BatchQueue(const BatchQueue &) = delete;
+  BatchQueue &operator=(const BatchQueue &) = delete;
+
+  /// Called by the reader, waits until there is room for the batch.
+  void Push(std::unique_ptr<Batch> batch) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    room_.wait(lock, [this]() { return in_flight_ < max_batches_; });
+    ++in_flight_;
+    pending_.push_back(std::move(batch));
+    readable_.notify_one();
+  }
+
+  /// Called by the reader once the input is over.
+  void Close() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    closed_ = true;
+    readable_.notify_all();
+    writable_.notify_all();
+  }
+
+  /// Called by the workers.
+  /// @return The next batch to render or `nullptr` when the input is
+  ///         over.
+  std::unique_ptr<Batch> Pop() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    readable_.wait(lock, [this]() { return closed_ || !pending_.empty(); });
+    if (pending_.empty()) {
+      return nullptr;
+    }
+    auto batch = std::move(pending_.front());
+    pending_.pop_front();
+    return batch;
+  }
+
+  /// Called by the workers once a batch is rendered.
+  void Finish(std::unique_ptr<Batch> batch) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto sequence = batch->sequence;
+    finished_[sequence] = std::move(batch);
+    writable_.notify_one();
+  }
+
+  /// Called by the writer, releases the room of the previous batch.
+  /// @return The batch with the given sequence number or `nullptr` when
+  ///         the input is over and every batch was written.
+  std::unique_ptr<Batch> Next(std::uint64_t sequence, bool release) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (release) {
+      --in_flight_;
+      room_.notify_one();
+    }
+    writable_.wait(lock, [this, sequence]() {
+      return finished_.count(sequence) != 0 ||
+          (closed_ && in_flight_ == 0);
+    });
+    auto it = finished_.find(sequence);
+    if (it == finished_.end()) {
+      return nullptr;
+    }
+    auto batch = std::move(it->second);
+    finished_.erase(it);
+    return batch;
+  }
+
+ private:
+  std::size_t max_batches_;
+  std::size_t in_flight_;
+  bool closed_;
+  std::deque<std::unique_ptr<Batch>> pending_;
+  std::map<std::uint64_t, std::unique_ptr<Batch>> finished_;
+  std::mutex mutex_;
+  std::condition_variable room_;
+  std::condition_variable readable_;
+  std::condition_variable writable_;
+};
+
+/// Loads the partials included by a template from files named after
+/// them, e.g. `{{>header}}` reads `header.yate` next to the template.
+bool LoadPartial(
+    const std::string &directory,
+    const std::string &name,
+    std::string &source) {
+  std::ifstream input(
+      directory + name + ".yate", std::ios_base::in | std::ios_base::binary);
+  if (!input) {
+    return false;
+  }
+  std::stringstream content;
+  content << input.rdbuf();
+  source = content.str();
+  return true;
+}
+
+/// @return The name of the file of a record, replacing every `%n` of
+///         the pattern by its line number.
+std::string FileName(const std::string &pattern, std::uint64_t line) {
+  std::string name;
+  auto number = std::to_string(line);
+  for (std::size_t i = 0; i < pattern.size(); ++i) {
+    if (pattern[i] == '%' && i + 1 < pattern.size() && pattern[i + 1] == 'n') {
+      name += number;
+      ++i;
+    } else {
+      name += pattern[i];
+    }
+  }
+  return name;
+}
+
+/// Renders every record of a batch, keeping their outputs in the batch
+/// or writing them to their own files.
+void RenderBatch(
+    const yate::Template &tmpl,
+    const Options &options,
+    Batch &batch) {
+  batch.outputs.resize(options.files.empty() ? batch.records.size() : 0);
+  batch.errors.assign(batch.records.size(), std::string());
+  std::string output;
+  for (std::size_t i = 0; i < batch.records.size(); ++i) {
+    auto &target = options.files.empty() ? batch.outputs[i] : output;
+    target.clear();
+    try {
+      auto context = yate::ParseJsonContext(batch.records[i].second);
+      yate::Renderer renderer(
+          std::move(context.values), std::move(context.arrays));
+      yate::StringSink sink(target);
+      auto result = renderer.TryRender(tmpl, sink);
+      if (!result.ok()) {
+        batch.errors[i] = result.Message();
+        target.clear();
+        continue;
+      }
+    } catch (const std::runtime_error &e) {
+      batch.errors[i] = e.what();
+      target.clear();
+      continue;
+    }
+    batch.bytes += target.size();
+    if (!options.files.empty()) {
+      auto path = FileName(options.files, batch.records[i].first);
+      std::ofstream file(path, std::ios_base::out | std::ios_base::binary);
+      file.write(target.data(), static_cast<std::streamsize>(target.size()));
+      if (!file) {
+        batch.errors[i] = "Cannot write '" + path + "'";
+      }
+    }
+    // Records are released as soon as they are rendered.
+    std::string().swap(batch.records[i].second);
+  }
+}
+
+/// Splits the input in batches of records, skipping blank lines.
+void ReadBatches(
+    std::istream &input,
+    const Options &options,
+    BatchQueue &queue) {
+  std::uint64_t line_number = 0;
+  std::uint64_t sequence = 0;
+  auto batch = std::unique_ptr<Batch>(new Batch());
+  std::string line;
+  while (std::getline(input, line)) {
+    ++line_number;
+    if (line.find_first_not_of(" \t\r") == std::string::npos) {
+      continue;
+    }
+    batch->records.emplace_back(line_number, std::move(line));
+    line.clear();
+    if (batch->records.size() == options.batch) {
+      batch->sequence = sequence++;
+      queue.Push(std::move(batch));
+      batch.reset(new Batch());
+    }
+  }
+  if (!batch->records.empty()) {
+    batch->sequence = sequence;
+    queue.Push(std::move(batch));
+  }
+  queue.Close();
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  Options options;
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    if ((arg == "--jobs" || arg == "-j" || arg == "--batch") && i + 1 < argc) {
+      auto value = std::strtoul(argv[++i], nullptr, 10);
+      if (value == 0) {
+        PrintUsage(argv[0]);
+        return 1;
+      }
+      if (arg == "--batch") {
+        options.batch = value;
+      } else {
+        options.jobs = static_cast<unsigned>(value);
+      }
+    } else if (arg == "--files" && i + 1 < argc) {
+      options.files = argv[++i];
+    } else if (arg == "--minify") {
+      options.minify = true;
+    } else if (arg == "--delimiters" && i + 2 < argc) {
+      options.open = argv[++i];
+      options.close = argv[++i];
+    } else if (arg == "--quiet" || arg == "-q") {
+      options.quiet = true;
+    } else if (arg == "--help" || arg == "-h") {
+      PrintUsage(argv[0]);
+      return 0;
+    } else if (options.template_path.empty()) {
+      options.template_path = arg;
+    } else if (options.input_path == "-") {
+      options.input_path = arg;
+    } else {
+      PrintUsage(argv[0]);
+      return 1;
+    }
+  }
+  if (options.template_path.empty()) {
+    PrintUsage(argv[0]);
+    return 1;
+  }
+
+  // The template is compiled once and shared by every worker, compiled
+  // templates are immutable.
+  std::ifstream template_input(
+      options.template_path, std::ios_base::in | std::ios_base::binary);
+  if (!template_input) {
+    std::cerr << "Cannot open template '" << options.template_path << "'\n";
+    return 1;
+  }
+  yate::Template tmpl;
+  try {
+    auto separator = options.template_path.find_last_of("/\\");
+    auto directory = separator == std::string::npos
+        ? std::string()
+        : options.template_path.substr(0, separator + 1);
+    yate::Compiler compiler(template_input);
+    compiler.set_partials(std::make_shared<yate::PartialCache>(
+        [&directory](const std::string &name, std::string &source) {
+          return LoadPartial(directory, name, source);
+        }));
+    compiler.set_minify(options.minify);
+    compiler.set_delimiters(yate::Delimiters(options.open, options.close));
+    tmpl = compiler.Compile();
+  } catch (const std::runtime_error &e) {
+    std::cerr << options.template_path << ": " << e.what() << '\n';
+    return 1;
+  }
+
+  std::ifstream file;
+  std::istream *input = &std::cin;
+  std::string input_name = "<stdin>";
+  if (options.input_path != "-") {
+    file.open(options.input_path, std::ios_base::in | std::ios_base::binary);
+    if (!file) {
+      std::cerr << "Cannot open '" << options.input_path << "'\n";
+      return 1;
+    }
+    input = &file;
+    input_name = options.input_path;
+  } else {
+    std::ios_base::sync_with_stdio(false);
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  BatchQueue queue(4 * options.jobs);
+  std::thread reader([&]() { ReadBatches(*input, options, queue); });
+  std::vector<std::thread> workers;
+  for (unsigned i = 0; i < options.jobs; ++i) {
+    workers.emplace_back([&]() {
+      for (auto batch = queue.Pop(); batch != nullptr; batch = queue.Pop()) {
+        RenderBatch(tmpl, options, *batch);
+        queue.Finish(std::move(batch));
+      }
+    });
+  }
+
+  // The outputs stay in their batch until it is flushed, so they are
+  // written without being copied.
+  yate::FdSink output(STDOUT_FILENO);
+  std::uint64_t records = 0;
+  std::uint64_t failures = 0;
+  std::uint64_t bytes = 0;
+  auto broken = false;
+  std::uint64_t sequence = 0;
+  for (auto batch = queue.Next(sequence, false); batch != nullptr;
+       batch = queue.Next(++sequence, true)) {
+    for (std::size_t i = 0; i < batch->records.size(); ++i) {
+      if (!batch->errors[i].empty()) {
+        std::cerr << input_name << ':' << batch->records[i].first << ": "
+                  << batch->errors[i] << '\n';
+        ++failures;
+      }
+    }
+    records += batch->records.size();
+    bytes += batch->bytes;
+    if (broken || !options.files.empty()) {
+      continue;
+    }
+    try {
+      for (const auto &text : batch->outputs) {
+        output.WriteStable(text.data(), text.size());
+      }
+      output.Flush();
+    } catch (const std::runtime_error &e) {
+      // The remaining batches are still rendered and their errors
+      // reported, only their outputs are dropped.
+      std::cerr << e.what() << '\n';
+      broken = true;
+    }
+  }
+  reader.join();
+  for (auto &worker : workers) {
+    worker.join();
+  }
+
+  if (!options.quiet) {
+    auto seconds = std::chrono::duration<double>(
+                       std::chrono::steady_clock::now() - start)
+                       .count();
+    seconds = std::max(seconds, 1e-9);
+    std::cerr << records << " records (" << failures << " failed), "
+              << bytes << " bytes in " << seconds << " s: "
+              << static_cast<std::uint64_t>(records / seconds)
+              << " records/s, " << bytes / seconds / (1 << 20) << " MiB/s\n";
+  }
+  return broken || failures != 0 ? 1 : 0;
+}
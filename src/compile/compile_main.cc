@@ -0,0 +1,147 @@
+#include <yate/codegen.hh>
+#include <yate/compiler.hh>
+
+#include <cctype>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+namespace {
+
+void PrintUsage(const char *program) {
+  std::cerr << "Usage: " << program
+            << " [--name <Name>] [--namespace <a::b>] [--minify] "
+               "[--delimiters <open> <close>] <template> <output>\n"
+            << "Translates a template into a C++ header with a typed render "
+               "function.\n";
+}
+
+/// Derives a CamelCase name from the file name of the template, e.g.
+/// `path/to/page_header.yate` becomes `PageHeader`.
+std::string NameFromPath(const std::string &path) {
+  auto begin = path.find_last_of("/\\");
+  begin = begin == std::string::npos ? 0 : begin + 1;
+  auto end = path.find('.', begin);
+  if (end == std::string::npos) {
+    end = path.size();
+  }
+
+  std::string name;
+  bool upper = true;
+  for (auto i = begin; i < end; ++i) {
+    auto ch = static_cast<unsigned char>(path[i]);
+    if (!std::isalnum(ch)) {
+      upper = true;
+      continue;
+    }
+    name += upper ? static_cast<char>(std::toupper(ch)) : static_cast<char>(ch);
+    upper = false;
+  }
+  if (name.empty() || std::isdigit(static_cast<unsigned char>(name[0]))) {
+    name = "Template" + name;
+  }
+  return name;
+}
+
+/// Loads the partials included by a template from files named after
+/// them, e.g. `{{>header}}` reads `header.yate` next to the template.
+bool LoadPartial(
+    const std::string &directory,
+    const std::string &name,
+    std::string &source) {
+  std::ifstream input(
+      directory + name + ".yate", std::ios_base::in | std::ios_base::binary);
+  if (!input) {
+    return false;
+  }
+  std::stringstream content;
+  content << input.rdbuf();
+  source = content.str();
+  return true;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  std::string name;
+  std::string name_space;
+  std::string input_path;
+  std::string output_path;
+  auto minify = false;
+  std::string open = "{{";
+  std::string close = "}}";
+
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    if ((arg == "--name" || arg == "--namespace") && i + 1 < argc) {
+      (arg == "--name" ? name : name_space) = argv[++i];
+    } else if (arg == "--minify") {
+      minify = true;
+    } else if (arg == "--delimiters" && i + 2 < argc) {
+      open = argv[++i];
+      close = argv[++i];
+    } else if (arg == "--help" || arg == "-h") {
+      PrintUsage(argv[0]);
+      return 0;
+    } else if (input_path.empty()) {
+      input_path = arg;
+    } else if (output_path.empty()) {
+      output_path = arg;
+    } else {
+      PrintUsage(argv[0]);
+      return 1;
+    }
+  }
+  if (input_path.empty() || output_path.empty()) {
+    PrintUsage(argv[0]);
+    return 1;
+  }
+  if (name.empty()) {
+    name = NameFromPath(input_path);
+  }
+
+  std::ifstream input(input_path, std::ios_base::in | std::ios_base::binary);
+  if (!input) {
+    std::cerr << "Cannot open template '" << input_path << "'\n";
+    return 1;
+  }
+
+  // The code is generated in memory first, so a failure does not
+  // leave a truncated file behind which the build would consider up
+  // to date.
+  std::stringstream code;
+  try {
+    auto separator = input_path.find_last_of("/\\");
+    auto directory = separator == std::string::npos
+        ? std::string()
+        : input_path.substr(0, separator + 1);
+    yate::Compiler compiler(input);
+    // The generated code has no partials of its own, every include is
+    // inlined.
+    compiler.set_partials(std::make_shared<yate::PartialCache>(
+        [&directory](const std::string &name, std::string &source) {
+          return LoadPartial(directory, name, source);
+        }));
+    compiler.set_inline_limit(std::numeric_limits<std::size_t>::max());
+    compiler.set_minify(minify);
+    compiler.set_delimiters(yate::Delimiters(open, close));
+    auto tmpl = compiler.Compile();
+    yate::CodeGenerator generator(tmpl, name, name_space);
+    generator.Generate(code);
+  } catch (const std::runtime_error &e) {
+    std::cerr << input_path << ": " << e.what() << '\n';
+    return 1;
+  }
+
+  std::ofstream output(output_path, std::ios_base::out | std::ios_base::binary);
+  output << code.str();
+  if (!output) {
+    std::cerr << "Cannot write '" << output_path << "'\n";
+    return 1;
+  }
+  return 0;
+}
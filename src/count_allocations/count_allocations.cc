@@ -0,0 +1,85 @@
+// Replaces the global allocation functions with ones which count the
+// allocations of each thread for `yate::AllocationCounter`. Linked as
+// an object library, so the replacement applies to the whole
+// executable, including the standard library.
+
+#include <yate/allocation_counter.hh>
+
+#include <cstdlib>
+#include <new>
+
+namespace {
+
+struct EnableCounting {
+  EnableCounting() { yate::allocation_counting::Enable(); }
+};
+
+EnableCounting enable_counting;
+
+void *Allocate(std::size_t size) {
+  yate::allocation_counting::Count(size);
+  if (size == 0) {
+    size = 1;
+  }
+  while (true) {
+    auto *memory = std::malloc(size);
+    if (memory != nullptr) {
+      return memory;
+    }
+    auto handler = std::get_new_handler();
+    if (handler == nullptr) {
+      throw std::bad_alloc();
+    }
+    handler();
+  }
+}
+
+void *AllocateNoThrow(std::size_t size) noexcept {
+  try {
+    return Allocate(size);
+  } catch (...) {
+    return nullptr;
+  }
+}
+
+} // namespace
+
+void *operator new(std::size_t size) {
+  return Allocate(size);
+}
+
+void *operator new[](std::size_t size) {
+  return Allocate(size);
+}
+
+void *operator new(std::size_t size, const std::nothrow_t &) noexcept {
+  return AllocateNoThrow(size);
+}
+
+void *operator new[](std::size_t size, const std::nothrow_t &) noexcept {
+  return AllocateNoThrow(size);
+}
+
+void operator delete(void *memory) noexcept {
+  std::free(memory);
+}
+
+void operator delete[](void *memory) noexcept {
+  std::free(memory);
+}
+
+void operator delete(void *memory, std::size_t) noexcept {
+  std::free(memory);
+}
+
+void operator delete[](void *memory, std::size_t) noexcept {
+  std::free(memory);
+}
+
+void operator delete(void *memory, const std::nothrow_t &) noexcept {
+  std::free(memory);
+}
+
+void operator delete[](void *memory, const std::nothrow_t &) noexcept {
+  std::free(memory);
+}
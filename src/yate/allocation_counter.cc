@@ -0,0 +1,44 @@
+#include "allocation_counter.hh"
+
+#include <atomic>
+
+namespace yate {
+
+namespace allocation_counting {
+
+thread_local Counts counts = {0, 0};
+
+namespace {
+
+std::atomic<bool> enabled(false);
+
+} // namespace
+
+void Enable() {
+  enabled.store(true, std::memory_order_relaxed);
+}
+
+} // namespace allocation_counting
+
+AllocationCounter::AllocationCounter()
+    : allocations_(allocation_counting::counts.allocations),
+      bytes_(allocation_counting::counts.bytes) {}
+
+std::uint64_t AllocationCounter::allocations() const {
+  return allocation_counting::counts.allocations - allocations_;
+}
+
+std::uint64_t AllocationCounter::bytes() const {
+  return allocation_counting::counts.bytes - bytes_;
+}
+
+void AllocationCounter::Reset() {
+  allocations_ = allocation_counting::counts.allocations;
+  bytes_ = allocation_counting::counts.bytes;
+}
+
+bool AllocationCounter::enabled() {
+  return allocation_counting::enabled.load(std::memory_order_relaxed);
+}
+
+} // namespace yate
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace yate {
+
+/// Counts the heap allocations made by the current thread, so tests
+/// and benchmarks can tell how many a render makes. Allocations are
+/// only counted in executables which link the `yate-count-allocations`
+/// library, which replaces the global `operator new`; elsewhere
+/// `enabled()` is false and the counts stay at zero, at no cost.
+class AllocationCounter {
+ public:
+  /// Starts counting from the current totals of the thread.
+  AllocationCounter();
+  ~AllocationCounter() {}
+
+  /// @return The allocations made by the thread since the counter was
+  ///         constructed or reset.
+  std::uint64_t allocations() const;
+
+  /// @return The bytes requested by those allocations.
+  std::uint64_t bytes() const;
+
+  /// Starts counting again from the current totals of the thread.
+  void Reset();
+
+  /// @return Whether allocations are being counted.
+  static bool enabled();
+
+ private:
+  std::uint64_t allocations_;
+  std::uint64_t bytes_;
+};
+
+/// Hooks for the replacement `operator new`, not meant to be called by
+/// anything else.
+namespace allocation_counting {
+
+/// The totals of a thread.
+struct Counts {
+  std::uint64_t allocations;
+  std::uint64_t bytes;
+};
+
+extern thread_local Counts counts;
+
+/// Called once before any allocation is counted.
+void Enable();
+
+/// Counts an allocation of the current thread.
+inline void Count(std::size_t size) {
+  ++counts.allocations;
+  counts.bytes += size;
+}
+
+} // namespace allocation_counting
+
+} // namespace yate
@@ -0,0 +1,46 @@
+#ifdef YATE_COROUTINES
+
+#include "async.hh"
+
+#include <stdexcept>
+#include <utility>
+
+namespace yate {
+
+RenderTask &RenderTask::operator=(RenderTask &&other) noexcept {
+  if (this != &other) {
+    if (handle_ != nullptr) {
+      handle_.destroy();
+    }
+    handle_ = other.handle_;
+    other.handle_ = nullptr;
+  }
+  return *this;
+}
+
+RenderTask::~RenderTask() {
+  if (handle_ != nullptr) {
+    handle_.destroy();
+  }
+}
+
+void RenderTask::Start(std::function<void()> done) {
+  if (handle_ == nullptr || handle_.done()) {
+    throw std::runtime_error("Render task already finished");
+  }
+  handle_.promise().done = std::move(done);
+  handle_.resume();
+}
+
+void RenderTask::Get() const {
+  if (!done()) {
+    throw std::runtime_error("Render task has not finished");
+  }
+  if (handle_.promise().error != nullptr) {
+    std::rethrow_exception(handle_.promise().error);
+  }
+}
+
+} // namespace yate
+
+#endif // YATE_COROUTINES
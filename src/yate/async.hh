@@ -0,0 +1,128 @@
+#pragma once
+
+#ifndef YATE_COROUTINES
+#error "Asynchronous rendering requires configuring with -DYATE_COROUTINES=ON"
+#endif
+
+#include "sink.hh"
+
+#include <coroutine>
+#include <exception>
+#include <functional>
+#include <string>
+
+namespace yate {
+
+/// Sink of an asynchronous render, e.g. the send buffer of a socket.
+/// After every write the renderer asks whether the sink is full and,
+/// if it is, suspends the render until the sink calls it back.
+class AsyncSink : public Sink {
+ public:
+  ~AsyncSink() override {}
+
+  /// @return Whether the render should wait before writing more.
+  virtual bool Full() const = 0;
+
+  /// Called when `Full()` returns `true`. The sink calls `resume` once
+  /// it can accept more bytes, which continues the render on the
+  /// calling thread.
+  ///
+  /// @param resume The continuation of the render, called once.
+  virtual void WhenDrained(std::function<void()> resume) = 0;
+};
+
+/// Provides the values which the renderer does not define, e.g. by
+/// querying a remote service, without blocking the render.
+class AsyncValues {
+ public:
+  enum class Resolution {
+    eResolved = 0,  /// The value was stored.
+    ePending = 1,   /// The value will be available later.
+    eUndefined = 2  /// The symbol has no value.
+  };
+
+  virtual ~AsyncValues() {}
+
+  /// Looks a symbol up. When the value is not available yet, the
+  /// provider returns `ePending` and later calls `resume`, which makes
+  /// the renderer call `Resolve()` again for the same symbol.
+  ///
+  /// @param symbol The symbol looked up.
+  /// @param value Where the value is stored, only when `eResolved` is
+  ///        returned.
+  /// @param resume The continuation of the render, called once and
+  ///        only if `ePending` is returned.
+  /// @return Whether the value was stored, is pending or undefined.
+  virtual Resolution Resolve(
+      const std::string &symbol,
+      std::string &value,
+      std::function<void()> resume) = 0;
+};
+
+/// Handle of an asynchronous render returned by
+/// `Renderer::RenderAsync()`. Nothing is rendered until `Start()` is
+/// called; the render then runs until it has to wait for the sink or a
+/// value and continues when it is called back. The handle must outlive
+/// the render.
+class RenderTask {
+ public:
+  struct promise_type {
+    std::exception_ptr error;
+    std::function<void()> done;
+
+    RenderTask get_return_object() {
+      return RenderTask(
+          std::coroutine_handle<promise_type>::from_promise(*this));
+    }
+    std::suspend_always initial_suspend() noexcept { return {}; }
+    auto final_suspend() noexcept {
+      struct Finish {
+        bool await_ready() noexcept { return false; }
+        void await_suspend(
+            std::coroutine_handle<promise_type> handle) noexcept {
+          // Moved out, the callback may destroy the task.
+          auto done = std::move(handle.promise().done);
+          if (done) {
+            done();
+          }
+        }
+        void await_resume() noexcept {}
+      };
+      return Finish();
+    }
+    void return_void() {}
+    void unhandled_exception() { error = std::current_exception(); }
+  };
+
+  RenderTask(RenderTask &&other) noexcept : handle_(other.handle_) {
+    other.handle_ = nullptr;
+  }
+  RenderTask &operator=(RenderTask &&other) noexcept;
+  ~RenderTask();
+
+  // Not copyable.
+  RenderTask(const RenderTask &) = delete;
+  RenderTask &operator=(const RenderTask &) = delete;
+
+  /// Starts rendering. It returns when the render finishes or first
+  /// has to wait.
+  ///
+  /// @param done Called when the render finishes, successfully or not,
+  ///        on the thread which rendered its last part.
+  void Start(std::function<void()> done = nullptr);
+
+  /// @return Whether the render finished.
+  bool done() const { return handle_ != nullptr && handle_.done(); }
+
+  /// Throws the error which made the render fail, if any. Throws a
+  /// `std::runtime_error` if the render has not finished.
+  void Get() const;
+
+ private:
+  explicit RenderTask(std::coroutine_handle<promise_type> handle)
+      : handle_(handle) {}
+
+  std::coroutine_handle<promise_type> handle_;
+};
+
+} // namespace yate
@@ -0,0 +1,494 @@
+#include "codegen.hh"
+
+#include "utils.hh"
+
+#include <algorithm>
+#include <iterator>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+namespace yate {
+
+namespace {
+
+const std::unordered_set<std::string> kCppKeywords = {
+    "alignas",   "alignof",      "and",           "and_eq",
+    "asm",       "auto",         "bitand",        "bitor",
+    "bool",      "break",        "case",          "catch",
+    "char",      "char16_t",     "char32_t",      "char8_t",
+    "class",     "compl",        "concept",       "const",
+    "consteval", "constexpr",    "constinit",     "const_cast",
+    "continue",  "co_await",     "co_return",     "co_yield",
+    "decltype",  "default",      "delete",        "do",
+    "double",    "dynamic_cast", "else",          "enum",
+    "explicit",  "export",       "extern",        "false",
+    "float",     "for",          "friend",        "goto",
+    "if",        "inline",       "int",           "long",
+    "mutable",   "namespace",    "new",           "noexcept",
+    "not",       "not_eq",       "nullptr",       "operator",
+    "or",        "or_eq",        "private",       "protected",
+    "public",    "register",     "reinterpret_cast", "requires",
+    "return",    "short",        "signed",        "sizeof",
+    "static",    "static_assert", "static_cast",  "struct",
+    "switch",    "template",     "this",          "thread_local",
+    "throw",     "true",         "try",           "typedef",
+    "typeid",    "typename",     "union",         "unsigned",
+    "using",     "virtual",      "void",          "volatile",
+    "wchar_t",   "while",        "xor",           "xor_eq"};
+
+/// Splits a namespace of the form `a::b::c` into its components.
+std::vector<std::string> SplitNamespace(const std::string &name_space) {
+  std::vector<std::string> result;
+  std::string::size_type begin = 0;
+  while (begin < name_space.size()) {
+    auto end = name_space.find("::", begin);
+    if (end == std::string::npos) {
+      end = name_space.size();
+    }
+    result.push_back(name_space.substr(begin, end - begin));
+    begin = end + 2;
+  }
+  return result;
+}
+
+std::string Indent(std::size_t level) {
+  return std::string(2 * level, ' ');
+}
+
+/// Returns the C++ expression naming an escaping mode.
+std::string EscapeEnumerator(Escape escape) {
+  switch (escape) {
+    case Escape::eNone:
+      return "yate::Escape::eNone";
+    case Escape::eHtml:
+      return "yate::Escape::eHtml";
+    case Escape::eHtmlAttribute:
+      return "yate::Escape::eHtmlAttribute";
+    case Escape::eJson:
+      return "yate::Escape::eJson";
+    case Escape::eUrl:
+      return "yate::Escape::eUrl";
+  }
+  return "";
+}
+
+/// Whether any substitution of the template is escaped, in which case
+/// the generated code depends on the escaping kernels of yate.
+bool UsesEscaping(const Template &tmpl) {
+  for (const auto &node : tmpl.nodes()) {
+    if (node.kind == Template::Node::Kind::eValue &&
+        node.escape != Escape::eNone) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/// Whether the template has zipped loops.
+bool HasZippedLoops(const Template &tmpl) {
+  for (const auto &node : tmpl.nodes()) {
+    if (node.kind == Template::Node::Kind::eLoopBegin &&
+        !node.zipped.empty()) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/// Returns the C++ expression computing a loop metadata from the
+/// counter and the array of the innermost loop.
+std::string MetadataExpression(
+    LoopMetadata metadata,
+    const std::string &counter,
+    const std::string &array) {
+  switch (metadata) {
+    case LoopMetadata::eIndex:
+      return counter;
+    case LoopMetadata::eNumber:
+      return counter + " + 1";
+    case LoopMetadata::eFirst:
+      return counter + " == 0";
+    case LoopMetadata::eLast:
+      return counter + " + 1 == " + array + ".size()";
+    case LoopMetadata::eLength:
+      return array + ".size()";
+    case LoopMetadata::eNone:
+      break;
+  }
+  return "";
+}
+
+/// Returns the C++ condition testing a loop metadata, see
+/// `IsLoopMetadataTrue()`.
+std::string MetadataCondition(
+    LoopMetadata metadata,
+    const std::string &counter,
+    const std::string &array) {
+  switch (metadata) {
+    case LoopMetadata::eIndex:
+      return counter + " != 0";
+    case LoopMetadata::eNumber:
+    case LoopMetadata::eLength:
+      return "true";
+    case LoopMetadata::eFirst:
+    case LoopMetadata::eLast:
+    case LoopMetadata::eNone:
+      break;
+  }
+  return MetadataExpression(metadata, counter, array);
+}
+
+} // namespace
+
+CodeGenerator::CodeGenerator(
+    const Template &tmpl,
+    std::string name,
+    std::string name_space)
+    : template_(tmpl),
+      name_(std::move(name)),
+      name_space_(std::move(name_space)),
+      values_(),
+      arrays_() {}
+
+void CodeGenerator::Generate(std::ostream &output) {
+  CollectFields();
+  auto namespaces = SplitNamespace(name_space_);
+
+  output << "// Generated by yate-compile. Do not edit.\n"
+         << "#pragma once\n\n"
+         << "#include <string>\n"
+         << "#include <vector>\n";
+  if (HasZippedLoops(template_)) {
+    // Zipped loops check the lengths of their arrays.
+    output << "#include <stdexcept>\n";
+  }
+  output << '\n';
+  if (UsesEscaping(template_)) {
+    output << "#include <yate/escape.hh>\n\n";
+  }
+  for (const auto &name_space : namespaces) {
+    output << "namespace " << name_space << " {\n";
+  }
+  if (!namespaces.empty()) {
+    output << '\n';
+  }
+
+  output << "/// Symbols used by the " << name_ << " template.\n"
+         << "struct " << name_ << "Context {\n";
+  for (const auto &value : values_) {
+    output << "  std::string " << ToCppIdentifier(value) << ";\n";
+  }
+  for (const auto &array : arrays_) {
+    output << "  std::vector<std::string> " << ToCppIdentifier(array) << ";\n";
+  }
+  output << "};\n\n";
+
+  output << "/// Renders the " << name_ << " template into `output`, which\n"
+         << "/// can be any object with a `write(const char *, size)` method.\n"
+         << "template <typename Sink>\n"
+         << "void Render" << name_ << "(const " << name_
+         << "Context &context, Sink &output) {\n";
+  GenerateBody(output);
+  output << "}\n";
+
+  if (!namespaces.empty()) {
+    output << '\n';
+  }
+  for (auto it = namespaces.rbegin(); it != namespaces.rend(); ++it) {
+    output << "} // namespace " << *it << '\n';
+  }
+}
+
+void CodeGenerator::CollectFields() {
+  values_.clear();
+  arrays_.clear();
+  // The items bound by each open loop.
+  std::vector<std::vector<std::string>> scope;
+  auto bound = [&scope](const std::string &symbol) {
+    return std::any_of(
+        scope.begin(),
+        scope.end(),
+        [&symbol](const std::vector<std::string> &items) {
+          return std::find(items.begin(), items.end(), symbol) != items.end();
+        });
+  };
+  std::vector<std::string> conditions;
+  for (const auto &node : template_.nodes()) {
+    switch (node.kind) {
+      case Template::Node::Kind::eValue:
+        if (node.metadata == LoopMetadata::eNone && !bound(node.text)) {
+          append_unique(values_, node.text);
+        }
+        break;
+      case Template::Node::Kind::eLoopBegin:
+        // Arrays can only be defined in the root frame, so they are
+        // never shadowed by loops.
+        append_unique(arrays_, node.text);
+        scope.push_back({node.item});
+        for (const auto &zipped : node.zipped) {
+          append_unique(arrays_, zipped.array);
+          scope.back().push_back(zipped.item);
+        }
+        break;
+      case Template::Node::Kind::eLoopEnd:
+        scope.pop_back();
+        break;
+      case Template::Node::Kind::eIfBegin:
+        if (node.metadata == LoopMetadata::eNone && !bound(node.text)) {
+          append_unique(conditions, node.text);
+        }
+        break;
+      case Template::Node::Kind::eInclude:
+        throw std::runtime_error(
+            "Partial '" + node.text + "' must be inlined for yate-compile");
+      case Template::Node::Kind::eLiteral:
+      case Template::Node::Kind::eElse:
+      case Template::Node::Kind::eIfEnd:
+        break;
+    }
+  }
+  // Conditions test the array with that name if there is one, and a
+  // value otherwise.
+  for (const auto &condition : conditions) {
+    if (std::find(arrays_.begin(), arrays_.end(), condition) == arrays_.end()) {
+      append_unique(values_, condition);
+    }
+  }
+
+  for (const auto &value : values_) {
+    if (std::find(arrays_.begin(), arrays_.end(), value) != arrays_.end()) {
+      throw std::runtime_error(
+          "Symbol '" + value + "' is used both as a value and as an array");
+    }
+  }
+}
+
+void CodeGenerator::GenerateBody(std::ostream &output) {
+  const auto &nodes = template_.nodes();
+  // Loops whose body uses metadata iterate with a counter.
+  std::vector<bool> counted(nodes.size(), false);
+  std::vector<std::size_t> open_loops;
+  for (std::size_t i = 0; i < nodes.size(); ++i) {
+    const auto &node = nodes[i];
+    if (node.kind == Template::Node::Kind::eLoopBegin) {
+      open_loops.push_back(i);
+    } else if (node.kind == Template::Node::Kind::eLoopEnd) {
+      open_loops.pop_back();
+    } else if (node.metadata != LoopMetadata::eNone) {
+      if (open_loops.empty()) {
+        throw std::runtime_error(
+            "Loop metadata '" + node.text + "' used outside of a loop");
+      }
+      counted[open_loops.back()] = true;
+    }
+  }
+
+  // Loop variables are named after the symbol and the loop depth, so
+  // they can never clash with each other nor with the parameters.
+  // Counters end with an underscore, which symbols cannot.
+  std::vector<std::vector<std::string>> scope;
+  // The counter and the array of each enclosing loop.
+  std::vector<std::pair<std::string, std::string>> loops;
+  for (std::size_t i = 0; i < nodes.size(); ++i) {
+    const auto &node = nodes[i];
+    auto indent = Indent(scope.size() + 1);
+    switch (node.kind) {
+      case Template::Node::Kind::eLiteral:
+        output << indent << "output.write(" << ToCppStringLiteral(node.text)
+               << ", " << node.text.size() << ");\n";
+        break;
+
+      case Template::Node::Kind::eValue: {
+        if (!node.filters.empty()) {
+          throw std::runtime_error(
+              "Filter '" + node.filters.front().name +
+              "' is not supported by yate-compile");
+        }
+        if (node.metadata == LoopMetadata::eFirst ||
+            node.metadata == LoopMetadata::eLast) {
+          auto condition = MetadataExpression(
+              node.metadata, loops.back().first, loops.back().second);
+          output << indent << "output.write(" << condition
+                 << " ? \"true\" : \"false\", " << condition
+                 << " ? 4 : 5);\n";
+          break;
+        }
+        if (node.metadata != LoopMetadata::eNone) {
+          // Numbers never need escaping.
+          output << indent << "{\n"
+                 << indent << "  auto text = std::to_string("
+                 << MetadataExpression(
+                        node.metadata, loops.back().first, loops.back().second)
+                 << ");\n"
+                 << indent << "  output.write(text.data(), text.size());\n"
+                 << indent << "}\n";
+          break;
+        }
+        auto variable = Variable(node.text, scope);
+        if (node.escape == Escape::eNone) {
+          output << indent << "output.write(" << variable << ".data(), "
+                 << variable << ".size());\n";
+        } else {
+          output << indent << "yate::WriteEscapedTo("
+                 << EscapeEnumerator(node.escape) << ", " << variable
+                 << ".data(), " << variable << ".size(), output);\n";
+        }
+      } break;
+
+      case Template::Node::Kind::eLoopBegin: {
+        auto depth = std::to_string(scope.size());
+        auto item = node.item + "_" + depth;
+        auto array = "context." + ToCppIdentifier(node.text);
+        if (!node.zipped.empty()) {
+          // Zipped loops index every array with the same counter.
+          auto counter = "index" + depth + "_";
+          for (const auto &zipped : node.zipped) {
+            auto other = "context." + ToCppIdentifier(zipped.array);
+            output << indent << "if (" << other << ".size() != " << array
+                   << ".size()) {\n"
+                   << indent << "  throw std::length_error(\"Array '"
+                   << zipped.array << "' does not have the length of '"
+                   << node.text << "'\");\n"
+                   << indent << "}\n";
+          }
+          output << indent << "for (std::size_t " << counter << " = 0; "
+                 << counter << " < " << array << ".size(); ++" << counter
+                 << ") {\n"
+                 << indent << "  const std::string &" << item << " = "
+                 << array << "[" << counter << "];\n";
+          scope.push_back({node.item});
+          for (const auto &zipped : node.zipped) {
+            output << indent << "  const std::string &" << zipped.item << "_"
+                   << depth << " = context." << ToCppIdentifier(zipped.array)
+                   << "[" << counter << "];\n";
+            scope.back().push_back(zipped.item);
+          }
+          loops.emplace_back(counter, array);
+          break;
+        }
+        if (counted[i]) {
+          auto counter = "index" + std::to_string(scope.size()) + "_";
+          output << indent << "for (std::size_t " << counter << " = 0; "
+                 << counter << " < " << array << ".size(); ++" << counter
+                 << ") {\n"
+                 << indent << "  const std::string &" << item << " = "
+                 << array << "[" << counter << "];\n";
+          loops.emplace_back(counter, array);
+        } else {
+          output << indent << "for (const std::string &" << item << " : "
+                 << array << ") {\n";
+          loops.emplace_back("", array);
+        }
+        scope.push_back({node.item});
+      } break;
+
+      case Template::Node::Kind::eLoopEnd:
+        scope.pop_back();
+        loops.pop_back();
+        output << Indent(scope.size() + 1) << "}\n";
+        break;
+
+      case Template::Node::Kind::eIfBegin:
+        if (node.metadata != LoopMetadata::eNone) {
+          output << indent << "if ("
+                 << MetadataCondition(
+                        node.metadata, loops.back().first, loops.back().second)
+                 << ") {\n";
+        } else {
+          output << indent << "if (!" << Variable(node.text, scope)
+                 << ".empty()) {\n";
+        }
+        // Conditionals are indented like loops and bind nothing.
+        scope.emplace_back();
+        break;
+
+      case Template::Node::Kind::eElse:
+        output << Indent(scope.size()) << "} else {\n";
+        break;
+
+      case Template::Node::Kind::eIfEnd:
+        scope.pop_back();
+        output << Indent(scope.size() + 1) << "}\n";
+        break;
+
+      case Template::Node::Kind::eInclude:
+        // UNREACHABLE, rejected by CollectFields().
+        break;
+    }
+  }
+}
+
+std::string CodeGenerator::Variable(
+    const std::string &symbol,
+    const std::vector<std::vector<std::string>> &scope) {
+  auto it = std::find_if(
+      scope.rbegin(),
+      scope.rend(),
+      [&symbol](const std::vector<std::string> &items) {
+        return std::find(items.begin(), items.end(), symbol) != items.end();
+      });
+  if (it != scope.rend()) {
+    auto depth = std::distance(it, scope.rend()) - 1;
+    return symbol + "_" + std::to_string(depth);
+  }
+  return "context." + ToCppIdentifier(symbol);
+}
+
+std::string ToCppIdentifier(const std::string &identifier) {
+  if (contains(kCppKeywords, identifier)) {
+    return identifier + "_";
+  }
+  return identifier;
+}
+
+std::string ToCppStringLiteral(const std::string &text) {
+  static const char kDigits[] = "01234567";
+  std::string result = "\"";
+  for (std::size_t i = 0; i < text.size(); ++i) {
+    auto ch = static_cast<unsigned char>(text[i]);
+    switch (ch) {
+      case '"':
+        result += "\\\"";
+        break;
+      case '\\':
+        result += "\\\\";
+        break;
+      case '?':
+        // Prevents trigraphs from being formed.
+        result += "\\?";
+        break;
+      case '\t':
+        result += "\\t";
+        break;
+      case '\r':
+        result += "\\r";
+        break;
+      case '\n':
+        result += "\\n";
+        // Breaks the literal on new lines so the generated code
+        // resembles the template.
+        if (i + 1 < text.size()) {
+          result += "\"\n    \"";
+        }
+        break;
+      default:
+        if (ch < 0x20 || ch >= 0x7f) {
+          result += '\\';
+          result += kDigits[(ch >> 6) & 7];
+          result += kDigits[(ch >> 3) & 7];
+          result += kDigits[ch & 7];
+        } else {
+          result += static_cast<char>(ch);
+        }
+        break;
+    }
+  }
+  result += '"';
+  return result;
+}
+
+} // namespace yate
@@ -0,0 +1,90 @@
+#pragma once
+
+#include "template.hh"
+
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+namespace yate {
+
+/// Translates a parsed `Template` into C++ source code. The generated
+/// header contains a struct with one field per symbol used by the
+/// template (`std::string` for values and `std::vector<std::string>`
+/// for arrays) and a render function which writes the template
+/// directly, without any lookup at run time. Misspelled symbols in
+/// the calling code become compile errors.
+///
+/// For a template called `Page` the generated code looks like:
+///
+/// ```c++
+/// struct PageContext {
+///   std::string header;
+///   std::vector<std::string> items;
+/// };
+///
+/// template <typename Sink>
+/// void RenderPage(const PageContext &context, Sink &output);
+/// ```
+///
+/// Where `Sink` is any type with a `write(const char *, size)` method,
+/// such as `std::ostream`. Escaped substitutions call the kernels in
+/// `yate/escape.hh`, so code generated from templates which escape
+/// values has to be linked against the yate library.
+class CodeGenerator {
+ public:
+  /// @param tmpl The template to be translated.
+  /// @param name The name used for the generated struct and function,
+  ///        it must be a valid C++ identifier.
+  /// @param name_space The namespace where the generated code is
+  ///        placed, nested namespaces can be given with `::`. If
+  ///        empty, the code is put in the global namespace.
+  CodeGenerator(const Template &tmpl, std::string name, std::string name_space);
+  ~CodeGenerator() {}
+
+  /// Writes the generated header to the given stream. Throws a
+  /// `std::runtime_error` if the template cannot be represented, for
+  /// example when the same symbol is used as a value and as an array.
+  ///
+  /// @param output The stream where the code is written.
+  void Generate(std::ostream &output);
+
+ private:
+  /// Collects the symbols which are resolved in the context struct,
+  /// i.e. all the ones not bound by a loop.
+  void CollectFields();
+
+  /// Writes the body of the render function.
+  void GenerateBody(std::ostream &output);
+
+  /// Returns the C++ expression holding a symbol: the variable of the
+  /// innermost loop which binds it or the field of the context.
+  ///
+  /// @param symbol The template symbol.
+  /// @param scope The items bound by each enclosing section, several
+  ///        for zipped loops and none for conditionals.
+  static std::string Variable(
+      const std::string &symbol,
+      const std::vector<std::vector<std::string>> &scope);
+
+  const Template &template_;
+  std::string name_;
+  std::string name_space_;
+  std::vector<std::string> values_;
+  std::vector<std::string> arrays_;
+};
+
+/// Converts a symbol of the template language into a valid C++
+/// identifier, i.e. it appends an underscore to C++ keywords.
+///
+/// @param identifier A template symbol.
+/// @return An identifier which can be used as a C++ field name.
+std::string ToCppIdentifier(const std::string &identifier);
+
+/// Converts a string into a C++ string literal, including the quotes.
+///
+/// @param text Any text.
+/// @return A quoted and escaped C++ string literal.
+std::string ToCppStringLiteral(const std::string &text);
+
+} // namespace yate
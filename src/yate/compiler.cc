@@ -0,0 +1,417 @@
+#include "compiler.hh"
+
+#include <algorithm>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+namespace yate {
+
+Compiler::Compiler(std::istream &input)
+    : lexer_(input),
+      default_escape_(Escape::eNone),
+      filters_(&FilterRegistry::Builtin()),
+      array_check_(),
+      partials_(),
+      inline_limit_(0),
+      minify_(false),
+      minifier_(),
+      including_(),
+      error_() {}
+
+Template Compiler::Compile() {
+  Template result;
+  auto error = TryCompile(result);
+  if (!error.ok()) {
+    error.Throw();
+  }
+  return result;
+}
+
+Result Compiler::TryCompile(Template &result) noexcept {
+  try {
+    if (!Parse(result)) {
+      return std::move(error_);
+    }
+  } catch (...) {
+    // Only what the library calls may still throw, e.g. the loader of
+    // the partials or the array check.
+    return CurrentException();
+  }
+  return Result();
+}
+
+bool Compiler::Parse(Template &result) {
+  Token current;
+  if (!Scan(current)) {
+    return false;
+  }
+  while (current.tag() != Token::Tag::eEOF) {
+    switch (current.tag()) {
+      case Token::Tag::eNoOp: {
+        result.AppendLiteral(
+            minify_ ? minifier_.Minify(current.value()) : current.value(),
+            current.line(),
+            current.column());
+      } break;
+
+      case Token::Tag::eScriptBegin: {
+        if (!Scan(current)) {
+          return false;
+        }
+
+        switch (current.tag()) {
+          case Token::Tag::eIdentifier: {
+            std::vector<FilterCall> filters;
+            Escape escape;
+            if (!ParseModifiers(filters, escape)) {
+              return false;
+            }
+            result.AppendValue(
+                current.value(),
+                current.line(),
+                current.column(),
+                escape,
+                std::move(filters));
+          } break;
+
+          case Token::Tag::eLoopMetadata: {
+            LoopMetadata metadata;
+            std::vector<FilterCall> filters;
+            Escape escape;
+            if (!ResolveLoopMetadata(current, result, metadata) ||
+                !ParseModifiers(filters, escape)) {
+              return false;
+            }
+            result.AppendValue(
+                current.value(),
+                current.line(),
+                current.column(),
+                escape,
+                std::move(filters),
+                metadata);
+          } break;
+
+          case Token::Tag::eLoopBegin: {
+            std::vector<Template::Node::Zipped> zipped;
+            if (!ParseLoop(current, zipped)) {
+              return false;
+            }
+            auto first = std::move(zipped.front());
+            zipped.erase(zipped.begin());
+            result.BeginLoop(
+                std::move(first.array),
+                std::move(first.item),
+                current.line(),
+                current.column(),
+                std::move(zipped));
+          } break;
+
+          case Token::Tag::eLoopEnd: {
+            if (result.open_sections() == 0) {
+              return Fail(Status::eUnmatchedSection, std::move(current));
+            }
+            Token end;
+            if (!Expect(Token::Tag::eScriptEnd, end)) {
+              return false;
+            }
+            if (!result.CanClose(Template::Node::Kind::eLoopEnd)) {
+              return Fail(Status::eUnmatchedSection, std::move(current));
+            }
+            result.EndLoop(current.line(), current.column());
+          } break;
+
+          case Token::Tag::eIfBegin: {
+            Token symbol;
+            if (!Scan(symbol)) {
+              return false;
+            }
+            auto metadata = LoopMetadata::eNone;
+            if (symbol.tag() == Token::Tag::eLoopMetadata) {
+              if (!ResolveLoopMetadata(symbol, result, metadata)) {
+                return false;
+              }
+            } else if (symbol.tag() != Token::Tag::eIdentifier) {
+              Fail(Status::eUnexpectedToken, std::move(symbol));
+              error_.set_expected(Token::Tag::eIdentifier);
+              return false;
+            }
+            Token end;
+            if (!Expect(Token::Tag::eScriptEnd, end)) {
+              return false;
+            }
+            result.BeginIf(
+                symbol.value(), current.line(), current.column(), metadata);
+          } break;
+
+          case Token::Tag::eElse: {
+            Token end;
+            if (!Expect(Token::Tag::eScriptEnd, end)) {
+              return false;
+            }
+            if (!result.CanClose(Template::Node::Kind::eElse)) {
+              return Fail(Status::eUnmatchedSection, std::move(current));
+            }
+            result.Else(current.line(), current.column());
+          } break;
+
+          case Token::Tag::eIfEnd: {
+            Token end;
+            if (!Expect(Token::Tag::eScriptEnd, end)) {
+              return false;
+            }
+            if (!result.CanClose(Template::Node::Kind::eIfEnd)) {
+              return Fail(Status::eUnmatchedSection, std::move(current));
+            }
+            result.EndIf(current.line(), current.column());
+          } break;
+
+          case Token::Tag::ePartial: {
+            Token name;
+            Token end;
+            std::shared_ptr<const Template> partial;
+            if (!Expect(Token::Tag::eIdentifier, name) ||
+                !Expect(Token::Tag::eScriptEnd, end) ||
+                !LoadPartial(name, partial)) {
+              return false;
+            }
+            if (partial->nodes().size() <= inline_limit_) {
+              result.AppendTemplate(*partial);
+            } else {
+              result.AppendInclude(
+                  name.value(),
+                  std::move(partial),
+                  current.line(),
+                  current.column());
+            }
+          } break;
+
+          default:
+            return Fail(Status::eUnexpectedToken, std::move(current));
+        }
+      } break;
+
+      default:
+        // UNREACHABLE
+        return Fail(Status::eUnexpectedToken, std::move(current));
+    }
+    if (!Scan(current)) {
+      return false;
+    }
+  }
+
+  result.CloseSections(current.line(), current.column());
+  return true;
+}
+
+bool Compiler::ParseLoop(
+    const Token &loop,
+    std::vector<Template::Node::Zipped> &columns) {
+  // The arrays, separated by commas.
+  Token token;
+  do {
+    Token array;
+    if (!Expect(Token::Tag::eIdentifier, array)) {
+      return false;
+    }
+    if (array_check_ && !array_check_(array.value())) {
+      return Fail(Status::eUndefinedArray, std::move(array));
+    }
+    columns.push_back({array.value(), ""});
+    if (!Scan(token)) {
+      return false;
+    }
+  } while (token.tag() == Token::Tag::eComma);
+
+  // The symbols, optionally preceded by `as`.
+  if (token.tag() == Token::Tag::eIdentifier && token.value() == "as" &&
+      !Scan(token)) {
+    return false;
+  }
+  std::size_t items = 0;
+  while (true) {
+    if (token.tag() != Token::Tag::eIdentifier) {
+      Fail(Status::eUnexpectedToken, std::move(token));
+      error_.set_expected(Token::Tag::eIdentifier);
+      return false;
+    }
+    for (std::size_t i = 0; i < items && i < columns.size(); ++i) {
+      if (columns[i].item == token.value()) {
+        auto detail = "Symbol '" + token.value() + "' is bound twice";
+        return Fail(
+            Status::eInvalidZippedLoop, std::move(token), std::move(detail));
+      }
+    }
+    if (items < columns.size()) {
+      columns[items].item = token.value();
+    }
+    ++items;
+    if (!Scan(token)) {
+      return false;
+    }
+    if (token.tag() != Token::Tag::eComma) {
+      break;
+    }
+    if (!Scan(token)) {
+      return false;
+    }
+  }
+  if (token.tag() != Token::Tag::eScriptEnd) {
+    Fail(Status::eUnexpectedToken, std::move(token));
+    error_.set_expected(Token::Tag::eScriptEnd);
+    return false;
+  }
+  if (items != columns.size()) {
+    return Fail(
+        Status::eInvalidZippedLoop,
+        loop,
+        "Loop over " + std::to_string(columns.size()) + " arrays binds " +
+            std::to_string(items) + " symbols");
+  }
+  return true;
+}
+
+bool Compiler::LoadPartial(
+    const Token &name,
+    std::shared_ptr<const Template> &partial) {
+  if (std::find(including_.begin(), including_.end(), name.value()) !=
+      including_.end()) {
+    return Fail(Status::eRecursivePartial, name);
+  }
+  auto settings = partial_settings();
+  if (partials_ != nullptr) {
+    partial = partials_->Find(name.value(), settings);
+  }
+  if (partial != nullptr) {
+    return true;
+  }
+  std::string source;
+  if (partials_ == nullptr || !partials_->Load(name.value(), source)) {
+    return Fail(Status::ePartialNotFound, name);
+  }
+
+  std::istringstream input(source);
+  Compiler compiler(input);
+  compiler.default_escape_ = default_escape_;
+  compiler.filters_ = filters_;
+  compiler.array_check_ = array_check_;
+  compiler.partials_ = partials_;
+  compiler.inline_limit_ = inline_limit_;
+  compiler.minify_ = minify_;
+  compiler.lexer_.set_delimiters(lexer_.delimiters());
+  compiler.including_ = including_;
+  compiler.including_.push_back(name.value());
+  Template tmpl;
+  try {
+    if (!compiler.Parse(tmpl)) {
+      error_ = std::move(compiler.error_);
+      error_.AddPartial(name.value());
+      return false;
+    }
+  } catch (...) {
+    error_ = CurrentException();
+    error_.AddPartial(name.value());
+    return false;
+  }
+  partial = partials_->Insert(name.value(), settings, std::move(tmpl));
+  return true;
+}
+
+PartialSettings Compiler::partial_settings() const {
+  PartialSettings settings;
+  settings.delimiters = lexer_.delimiters();
+  settings.default_escape = default_escape_;
+  settings.filters = filters_;
+  settings.inline_limit = inline_limit_;
+  settings.minify = minify_;
+  return settings;
+}
+
+bool Compiler::ResolveLoopMetadata(
+    const Token &token,
+    const Template &result,
+    LoopMetadata &metadata) {
+  if (!ParseLoopMetadata(token.value(), metadata)) {
+    return Fail(Status::eUnknownLoopMetadata, token);
+  }
+  // Partials may be included inside loops, so they are not checked.
+  if (including_.empty() && !result.InLoop()) {
+    return Fail(Status::eLoopMetadataOutsideLoop, token);
+  }
+  return true;
+}
+
+bool Compiler::ParseModifiers(
+    std::vector<FilterCall> &filters,
+    Escape &escape) {
+  Token current;
+  if (!Scan(current)) {
+    return false;
+  }
+  while (current.tag() == Token::Tag::ePipe) {
+    Token name;
+    if (!Expect(Token::Tag::eIdentifier, name)) {
+      return false;
+    }
+    if (ParseEscape(name.value(), escape)) {
+      // Escaping applies to the final value, so it closes the chain.
+      Token end;
+      return Expect(Token::Tag::eScriptEnd, end);
+    }
+
+    std::vector<std::string> arguments;
+    if (!Scan(current)) {
+      return false;
+    }
+    while (current.tag() == Token::Tag::eNumber ||
+           current.tag() == Token::Tag::eString) {
+      arguments.push_back(current.value());
+      if (!Scan(current)) {
+        return false;
+      }
+    }
+    // The last stage without arguments may as well be a misspelled
+    // escaping mode.
+    if (arguments.empty() && current.tag() == Token::Tag::eScriptEnd &&
+        !filters_->Contains(name.value())) {
+      auto detail = "Unknown filter or escaping mode '" + name.value() + "'";
+      return Fail(Status::eInvalidFilter, std::move(name), std::move(detail));
+    }
+    try {
+      filters.push_back(filters_->Resolve(name.value(), std::move(arguments)));
+    } catch (const std::runtime_error &e) {
+      return Fail(Status::eInvalidFilter, std::move(name), e.what());
+    }
+  }
+  if (current.tag() != Token::Tag::eScriptEnd) {
+    Fail(Status::eUnexpectedToken, std::move(current));
+    error_.set_expected(Token::Tag::eScriptEnd);
+    return false;
+  }
+  escape = default_escape_;
+  return true;
+}
+
+bool Compiler::Scan(Token &token) {
+  token = lexer_.Scan(error_);
+  return error_.ok();
+}
+
+bool Compiler::Expect(Token::Tag expected, Token &token) {
+  if (!Scan(token)) {
+    return false;
+  }
+  if (token.tag() != expected) {
+    Fail(Status::eUnexpectedToken, token);
+    error_.set_expected(expected);
+    return false;
+  }
+  return true;
+}
+
+bool Compiler::Fail(Status status, Token token, std::string detail) {
+  error_ = Result(status, std::move(token), std::move(detail));
+  return false;
+}
+
+} // namespace yate
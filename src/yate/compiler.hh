@@ -0,0 +1,201 @@
+#pragma once
+
+#include "delimiters.hh"
+#include "escape.hh"
+#include "filter.hh"
+#include "lexer.hh"
+#include "minify.hh"
+#include "partial_cache.hh"
+#include "result.hh"
+#include "template.hh"
+#include "token.hh"
+
+#include <cstddef>
+#include <functional>
+#include <iosfwd>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace yate {
+
+/// Parses the whole input stream into a `Template`. It accepts the
+/// same language as the `Renderer` and reports syntax errors with the
+/// same messages, but it does not need any symbol to be defined since
+/// nothing is rendered.
+class Compiler {
+ public:
+  /// Creates a compiler which will read the template from the given
+  /// stream.
+  ///
+  /// @param input The stream from which the template will be read.
+  Compiler(std::istream &input);
+  ~Compiler() {}
+
+  /// Consumes the whole input and returns the parsed template. Any
+  /// syntax error results in a `std::runtime_error`. Loops and
+  /// conditionals which are still open at the end of the input are
+  /// closed.
+  Template Compile();
+
+  /// Like `Compile()`, but errors are returned instead of thrown.
+  /// Syntax errors are reported by the lexer and the parser as they
+  /// are found, without raising exceptions, and the message is only
+  /// formatted if the caller asks for it.
+  ///
+  /// @param result Where the template is stored, it is incomplete if
+  ///        compiling fails.
+  /// @return The outcome, `Compile()` throws `Result::Throw()`.
+  Result TryCompile(Template &result) noexcept;
+
+  /// Sets how substitutions are escaped when they do not name a mode
+  /// explicitly, e.g. `{{name | raw}}`. By default nothing is escaped.
+  ///
+  /// @param escape The default escaping mode of the template.
+  void set_default_escape(Escape escape) { default_escape_ = escape; }
+
+  /// Sets the registry used to resolve the filters of the template,
+  /// by default `FilterRegistry::Builtin()`. Only the function
+  /// pointers are kept, the registry may be destroyed after compiling.
+  ///
+  /// @param filters The registry, it must outlive `Compile()`.
+  void set_filters(const FilterRegistry &filters) { filters_ = &filters; }
+
+  /// Sets a check for the arrays iterated by loops, run as soon as
+  /// each loop is parsed. Arrays for which it returns `false` fail with
+  /// the same error the `Renderer` raises for undefined arrays, before
+  /// the rest of the input is read.
+  ///
+  /// @param check Returns whether an array is defined.
+  void set_array_check(std::function<bool(const std::string &)> check) {
+    array_check_ = std::move(check);
+  }
+
+  /// Sets the cache through which the partials included with
+  /// `{{>name}}` are loaded and compiled. Without a cache every include
+  /// is an error. Partials are cached per `PartialSettings`, so
+  /// compilers with different settings can share the cache.
+  ///
+  /// @param partials The cache, it may be shared among compilers.
+  void set_partials(std::shared_ptr<PartialCache> partials) {
+    partials_ = std::move(partials);
+  }
+
+  /// Partials with at most this number of nodes are copied into the
+  /// including template instead of being referenced, so rendering them
+  /// costs nothing and their literals merge with the surrounding ones.
+  /// By default partials are never inlined.
+  ///
+  /// @param max_nodes The size of the largest partial to inline.
+  void set_inline_limit(std::size_t max_nodes) { inline_limit_ = max_nodes; }
+
+  /// Collapses the insignificant whitespace of the literals of HTML
+  /// templates once, while compiling, so rendering them writes less
+  /// and costs the same, see `Minifier`. Partials compiled by this
+  /// compiler are minified too, and cached apart from the ones
+  /// compiled without minifying. By default literals are kept as they
+  /// are.
+  ///
+  /// @param minify Whether to minify the literals.
+  void set_minify(bool minify) { minify_ = minify; }
+
+  /// Sets the strings which open and close the tags of the template,
+  /// e.g. `<%` and `%>` for templates whose text contains `{{`.
+  /// Partials compiled by this compiler use them too, and are cached
+  /// apart from the ones compiled with other delimiters. It must be
+  /// called before compiling.
+  ///
+  /// @param delimiters The delimiters, `{{` and `}}` by default.
+  void set_delimiters(Delimiters delimiters) {
+    lexer_.set_delimiters(std::move(delimiters));
+  }
+
+ private:
+  /// Parses the input into `result`. Errors are stored in `error_`.
+  ///
+  /// @return `false` on errors.
+  bool Parse(Template &result);
+
+  /// Parses the arrays and symbols of a loop after `#loop` up to the
+  /// closing `}}`: `rows row`, or for zipped loops, which iterate
+  /// several arrays in step, `names, prices as name, price`.
+  ///
+  /// @param loop The `LOOP_BEGIN` token.
+  /// @param columns Where each array and the symbol bound to its
+  ///        elements are stored, at least one.
+  /// @return `false` on errors.
+  bool ParseLoop(
+      const Token &loop,
+      std::vector<Template::Node::Zipped> &columns);
+
+  /// Finds the compiled partial named by an include, compiling it
+  /// with the settings of this compiler if it is not cached yet.
+  ///
+  /// @param name The identifier following `>`.
+  /// @param partial Where the compiled partial is stored.
+  /// @return `false` on errors.
+  bool LoadPartial(
+      const Token &name,
+      std::shared_ptr<const Template> &partial);
+
+  /// @return The settings the partials of this compiler are compiled
+  ///         and cached with.
+  PartialSettings partial_settings() const;
+
+  /// Resolves the loop metadata named by a token, which must be used
+  /// inside a loop unless a partial is being compiled.
+  ///
+  /// @param token The `LOOP_METADATA` token.
+  /// @param result The template being compiled.
+  /// @param metadata Where the metadata is stored.
+  /// @return `false` on errors.
+  bool ResolveLoopMetadata(
+      const Token &token,
+      const Template &result,
+      LoopMetadata &metadata);
+
+  /// Scans the next token.
+  ///
+  /// @param token Where the token is stored.
+  /// @return `false` if the input does not form a token.
+  bool Scan(Token &token);
+
+  /// Scans the next token and verifies it is of the given kind.
+  ///
+  /// @param expected The kind of token which must come next.
+  /// @param token Where the scanned token is stored.
+  /// @return `false` on errors.
+  bool Expect(Token::Tag expected, Token &token);
+
+  /// Parses the modifiers of a substitution after its identifier, up
+  /// to the closing `}}`: a chain of filters, each of them preceded by
+  /// `|` and followed by its arguments, optionally ending with the
+  /// escaping mode, e.g. `| truncate 20 | upper | html`.
+  ///
+  /// @param filters Where the resolved filters are appended.
+  /// @param escape Where the escaping mode of the substitution is
+  ///        stored.
+  /// @return `false` on errors.
+  bool ParseModifiers(std::vector<FilterCall> &filters, Escape &escape);
+
+  /// Stores an error in `error_`.
+  ///
+  /// @return `false`, so parsing functions can return it.
+  bool Fail(Status status, Token token, std::string detail = std::string());
+
+  Lexer lexer_;
+  Escape default_escape_;
+  const FilterRegistry *filters_;
+  std::function<bool(const std::string &)> array_check_;
+  std::shared_ptr<PartialCache> partials_;
+  std::size_t inline_limit_;
+  bool minify_;
+  /// Keeps the elements opened by the literals minified so far.
+  Minifier minifier_;
+  /// The partials being compiled, used to detect recursive includes.
+  std::vector<std::string> including_;
+  /// The first error found.
+  Result error_;
+};
+
+} // namespace yate
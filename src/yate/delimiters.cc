@@ -0,0 +1,71 @@
+#include "delimiters.hh"
+
+#include <cctype>
+#include <stdexcept>
+#include <utility>
+
+namespace yate {
+
+namespace {
+
+const std::size_t kMaxDelimiterSize = 16;
+
+/// Built once and shared by the lexers which use the defaults.
+const Delimiters &DefaultDelimiters() {
+  static const Delimiters delimiters("{{", "}}");
+  return delimiters;
+}
+
+/// Returns why `delimiter` cannot be used, or an empty string.
+std::string CheckDelimiter(const std::string &delimiter) {
+  if (delimiter.size() < 2 || delimiter.size() > kMaxDelimiterSize) {
+    return "delimiters must have between 2 and " +
+        std::to_string(kMaxDelimiterSize) + " characters";
+  }
+  for (auto ch : delimiter) {
+    auto uch = static_cast<unsigned char>(ch);
+    if (std::isspace(uch) || std::isalnum(uch) || ch == '\\' || ch == '\0') {
+      return "delimiters cannot contain whitespace, letters, digits or '\\'";
+    }
+  }
+  return "";
+}
+
+} // namespace
+
+Delimiters::Delimiters() : Delimiters(DefaultDelimiters()) {}
+
+Delimiters::Delimiters(std::string open, std::string close)
+    : open_(std::move(open)), close_(std::move(close)), transitions_() {
+  auto reason = CheckDelimiter(open_);
+  if (reason.empty()) {
+    reason = CheckDelimiter(close_);
+  }
+  if (reason.empty() && close_.find_first_of("#/@>|-\",") == 0) {
+    reason = "the closing delimiter cannot begin with any of '#/@>|-\",'";
+  }
+  if (!reason.empty()) {
+    throw std::runtime_error(
+        "Invalid delimiters '" + open_ + "' and '" + close_ + "': " + reason);
+  }
+
+  // The automaton of Knuth, Morris and Pratt: on a mismatch the search
+  // continues from the longest prefix of the delimiter which is also a
+  // suffix of the characters matched so far.
+  auto size = open_.size();
+  std::vector<std::uint8_t> transitions(size * 256, 0);
+  transitions[static_cast<unsigned char>(open_[0])] = 1;
+  std::size_t fallback = 0;
+  for (std::size_t state = 1; state < size; ++state) {
+    auto ch = static_cast<unsigned char>(open_[state]);
+    for (std::size_t i = 0; i < 256; ++i) {
+      transitions[state * 256 + i] = transitions[fallback * 256 + i];
+    }
+    transitions[state * 256 + ch] = static_cast<std::uint8_t>(state + 1);
+    fallback = transitions[fallback * 256 + ch];
+  }
+  transitions_ =
+      std::make_shared<const std::vector<std::uint8_t>>(std::move(transitions));
+}
+
+} // namespace yate
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace yate {
+
+/// The strings which open and close the tags of a template, `{{` and
+/// `}}` by default. Templates which contain the default delimiters as
+/// text, e.g. JavaScript or templates of other languages, can use
+/// different ones such as `<%` and `%>`.
+///
+/// The lexer finds the opening delimiter in the literals with a
+/// transition table built once, when the delimiters are created: each
+/// character read moves it from the number of characters of the
+/// delimiter matched so far to the next, so it looks at every
+/// character once whatever the delimiter.
+///
+/// Delimiters are between 2 and 16 characters and cannot contain
+/// whitespace, letters, digits or `\`. The closing one cannot begin
+/// with a character which begins a token inside a tag, one of
+/// `#/@>|-",`.
+class Delimiters {
+ public:
+  /// Creates the default delimiters, `{{` and `}}`.
+  Delimiters();
+
+  /// Throws a `std::runtime_error` if the delimiters are invalid.
+  ///
+  /// @param open The string which opens tags.
+  /// @param close The string which closes tags.
+  Delimiters(std::string open, std::string close);
+  ~Delimiters() {}
+
+  const std::string &open() const { return open_; }
+  const std::string &close() const { return close_; }
+
+  /// Advances the search for the opening delimiter.
+  ///
+  /// @param state The number of characters of the opening delimiter
+  ///        matched before `ch`, 0 at the beginning of a literal.
+  /// @param ch The character read.
+  /// @return The number of characters matched including `ch`, the
+  ///         size of the opening delimiter once it is found.
+  std::size_t Next(std::size_t state, char ch) const {
+    return (*transitions_)[state * 256 + static_cast<unsigned char>(ch)];
+  }
+
+ private:
+  std::string open_;
+  std::string close_;
+  /// 256 entries per character of the opening delimiter, shared by the
+  /// copies.
+  std::shared_ptr<const std::vector<std::uint8_t>> transitions_;
+};
+
+} // namespace yate
@@ -0,0 +1,328 @@
+#include "escape.hh"
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
+
+#include <cstdint>
+#include <cstdio>
+#include <stdexcept>
+
+namespace yate {
+
+namespace {
+
+/// Table with the characters which need escaping in each mode, used by
+/// the scalar loops and to look up replacements.
+struct EscapeTable {
+  EscapeTable() : special(), replacement(), size() {
+    auto set = [this](Escape mode, unsigned char ch, const char *text) {
+      auto index = static_cast<int>(mode);
+      special[index][ch] = true;
+      replacement[index][ch] = text;
+      size[index][ch] = std::char_traits<char>::length(text);
+    };
+    for (auto mode : {Escape::eHtml, Escape::eHtmlAttribute}) {
+      set(mode, '&', "&amp;");
+      set(mode, '<', "&lt;");
+      set(mode, '>', "&gt;");
+    }
+    set(Escape::eHtmlAttribute, '"', "&quot;");
+    set(Escape::eHtmlAttribute, '\'', "&#39;");
+    set(Escape::eHtmlAttribute, '`', "&#96;");
+
+    static const char kHex[] = "0123456789ABCDEF";
+    for (int ch = 0; ch < 0x20; ++ch) {
+      auto &text = json_controls[ch];
+      std::snprintf(
+          text, sizeof(text), "\\u00%c%c", kHex[ch >> 4], kHex[ch & 0xf]);
+      set(Escape::eJson, static_cast<unsigned char>(ch), text);
+    }
+    set(Escape::eJson, '"', "\\\"");
+    set(Escape::eJson, '\\', "\\\\");
+    set(Escape::eJson, '\b', "\\b");
+    set(Escape::eJson, '\f', "\\f");
+    set(Escape::eJson, '\n', "\\n");
+    set(Escape::eJson, '\r', "\\r");
+    set(Escape::eJson, '\t', "\\t");
+
+    for (int ch = 0; ch < 256; ++ch) {
+      auto &text = percent_encoded[ch];
+      text[0] = '%';
+      text[1] = kHex[ch >> 4];
+      text[2] = kHex[ch & 0xf];
+      text[3] = '\0';
+      bool unreserved = (ch >= 'a' && ch <= 'z') || (ch >= 'A' && ch <= 'Z') ||
+                        (ch >= '0' && ch <= '9') || ch == '-' || ch == '.' ||
+                        ch == '_' || ch == '~';
+      if (!unreserved) {
+        set(Escape::eUrl, static_cast<unsigned char>(ch), text);
+      }
+    }
+  }
+
+  static const int kModes = 5;
+
+  bool special[kModes][256];
+  const char *replacement[kModes][256];
+  std::size_t size[kModes][256];
+  char json_controls[0x20][7];
+  char percent_encoded[256][4];
+};
+
+const EscapeTable &Table() {
+  static const EscapeTable table;
+  return table;
+}
+
+std::size_t FindScalar(
+    const bool *special,
+    const char *data,
+    std::size_t begin,
+    std::size_t size) {
+  for (; begin < size; ++begin) {
+    if (special[static_cast<unsigned char>(data[begin])]) {
+      break;
+    }
+  }
+  return begin;
+}
+
+#if defined(__AVX2__)
+
+typedef __m256i Vector;
+const std::size_t kVectorSize = 32;
+
+inline Vector Load(const char *data) {
+  return _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data));
+}
+inline Vector Splat(char ch) { return _mm256_set1_epi8(ch); }
+inline Vector Equal(Vector a, Vector b) { return _mm256_cmpeq_epi8(a, b); }
+inline Vector Or(Vector a, Vector b) { return _mm256_or_si256(a, b); }
+inline Vector Sub(Vector a, Vector b) { return _mm256_sub_epi8(a, b); }
+inline Vector Min(Vector a, Vector b) { return _mm256_min_epu8(a, b); }
+inline std::uint32_t MoveMask(Vector a) {
+  return static_cast<std::uint32_t>(_mm256_movemask_epi8(a));
+}
+const std::uint32_t kFullMask = 0xffffffffu;
+
+#define YATE_SIMD_ESCAPE 1
+
+#elif defined(__SSE2__) || defined(_M_X64)
+
+typedef __m128i Vector;
+const std::size_t kVectorSize = 16;
+
+inline Vector Load(const char *data) {
+  return _mm_loadu_si128(reinterpret_cast<const __m128i *>(data));
+}
+inline Vector Splat(char ch) { return _mm_set1_epi8(ch); }
+inline Vector Equal(Vector a, Vector b) { return _mm_cmpeq_epi8(a, b); }
+inline Vector Or(Vector a, Vector b) { return _mm_or_si128(a, b); }
+inline Vector Sub(Vector a, Vector b) { return _mm_sub_epi8(a, b); }
+inline Vector Min(Vector a, Vector b) { return _mm_min_epu8(a, b); }
+inline std::uint32_t MoveMask(Vector a) {
+  return static_cast<std::uint32_t>(_mm_movemask_epi8(a));
+}
+const std::uint32_t kFullMask = 0xffffu;
+
+#define YATE_SIMD_ESCAPE 1
+
+#endif
+
+#ifdef YATE_SIMD_ESCAPE
+
+inline std::size_t CountTrailingZeros(std::uint32_t mask) {
+#if defined(_MSC_VER)
+  unsigned long index;
+  _BitScanForward(&index, mask);
+  return index;
+#else
+  return static_cast<std::size_t>(__builtin_ctz(mask));
+#endif
+}
+
+/// Whether each byte is at most `limit`, compared as unsigned.
+inline Vector AtMost(Vector bytes, char limit) {
+  return Equal(Min(bytes, Splat(limit)), bytes);
+}
+
+/// Returns a bit mask with the bytes of the block which need escaping.
+template <Escape mode>
+inline std::uint32_t SpecialMask(const char *data);
+
+template <>
+inline std::uint32_t SpecialMask<Escape::eHtml>(const char *data) {
+  auto bytes = Load(data);
+  auto result = Or(
+      Equal(bytes, Splat('&')),
+      Or(Equal(bytes, Splat('<')), Equal(bytes, Splat('>'))));
+  return MoveMask(result);
+}
+
+template <>
+inline std::uint32_t SpecialMask<Escape::eHtmlAttribute>(const char *data) {
+  auto bytes = Load(data);
+  auto result = Or(
+      Or(Equal(bytes, Splat('&')),
+         Or(Equal(bytes, Splat('<')), Equal(bytes, Splat('>')))),
+      Or(Equal(bytes, Splat('"')),
+         Or(Equal(bytes, Splat('\'')), Equal(bytes, Splat('`')))));
+  return MoveMask(result);
+}
+
+template <>
+inline std::uint32_t SpecialMask<Escape::eJson>(const char *data) {
+  auto bytes = Load(data);
+  auto result = Or(
+      AtMost(bytes, 0x1f),
+      Or(Equal(bytes, Splat('"')), Equal(bytes, Splat('\\'))));
+  return MoveMask(result);
+}
+
+template <>
+inline std::uint32_t SpecialMask<Escape::eUrl>(const char *data) {
+  auto bytes = Load(data);
+  // Letters are folded to lower case, then a subtraction turns each
+  // range check into a single unsigned comparison.
+  auto letter = AtMost(Sub(Or(bytes, Splat(0x20)), Splat('a')), 'z' - 'a');
+  auto digit = AtMost(Sub(bytes, Splat('0')), '9' - '0');
+  auto marks = Or(
+      Or(Equal(bytes, Splat('-')), Equal(bytes, Splat('.'))),
+      Or(Equal(bytes, Splat('_')), Equal(bytes, Splat('~'))));
+  return MoveMask(Or(Or(letter, digit), marks)) ^ kFullMask;
+}
+
+#endif // YATE_SIMD_ESCAPE
+
+template <Escape mode>
+std::size_t Find(const char *data, std::size_t begin, std::size_t size) {
+#ifdef YATE_SIMD_ESCAPE
+  for (; begin + kVectorSize <= size; begin += kVectorSize) {
+    auto mask = SpecialMask<mode>(data + begin);
+    if (mask != 0) {
+      return begin + CountTrailingZeros(mask);
+    }
+  }
+#endif
+  return FindScalar(
+      Table().special[static_cast<int>(mode)], data, begin, size);
+}
+
+} // namespace
+
+std::string to_string(Escape mode) {
+  switch (mode) {
+    case Escape::eNone:
+      return "raw";
+    case Escape::eHtml:
+      return "html";
+    case Escape::eHtmlAttribute:
+      return "attr";
+    case Escape::eJson:
+      return "json";
+    case Escape::eUrl:
+      return "url";
+  }
+  return "";
+}
+
+bool ParseEscape(const std::string &name, Escape &mode) {
+  for (auto candidate :
+       {Escape::eNone, Escape::eHtml, Escape::eHtmlAttribute, Escape::eJson,
+        Escape::eUrl}) {
+    if (name == to_string(candidate)) {
+      mode = candidate;
+      return true;
+    }
+  }
+  return false;
+}
+
+std::size_t FindEscapable(
+    Escape mode,
+    const char *data,
+    std::size_t begin,
+    std::size_t size) {
+  switch (mode) {
+    case Escape::eNone:
+      return size;
+    case Escape::eHtml:
+      return Find<Escape::eHtml>(data, begin, size);
+    case Escape::eHtmlAttribute:
+      return Find<Escape::eHtmlAttribute>(data, begin, size);
+    case Escape::eJson:
+      return Find<Escape::eJson>(data, begin, size);
+    case Escape::eUrl:
+      return Find<Escape::eUrl>(data, begin, size);
+  }
+  return size;
+}
+
+const char *GetReplacement(Escape mode, char ch, std::size_t &size) {
+  const auto &table = Table();
+  auto index = static_cast<int>(mode);
+  auto byte = static_cast<unsigned char>(ch);
+  if (!table.special[index][byte]) {
+    throw std::logic_error("Character does not need escaping");
+  }
+  size = table.size[index][byte];
+  return table.replacement[index][byte];
+}
+
+void WriteEscaped(
+    Escape mode,
+    const char *data,
+    std::size_t size,
+    Sink &output,
+    bool stable) {
+  std::size_t begin = 0;
+  while (begin < size) {
+    auto special = FindEscapable(mode, data, begin, size);
+    if (special > begin) {
+      if (stable) {
+        output.WriteStable(data + begin, special - begin);
+      } else {
+        output.Write(data + begin, special - begin);
+      }
+    }
+    if (special == size) {
+      break;
+    }
+    std::size_t length;
+    auto replacement = GetReplacement(mode, data[special], length);
+    output.WriteStable(replacement, length);
+    begin = special + 1;
+  }
+}
+
+std::string Escaped(Escape mode, const std::string &text) {
+  std::string result;
+  result.reserve(text.size());
+  StringSink output(result);
+  WriteEscaped(mode, text.data(), text.size(), output, false);
+  return result;
+}
+
+EscapingSink::EscapingSink(Escape mode, Sink &target)
+    : mode_(mode), target_(target) {}
+
+void EscapingSink::Write(const char *data, std::size_t size) {
+  WriteEscaped(mode_, data, size, target_, false);
+}
+
+void EscapingSink::WriteStable(const char *data, std::size_t size) {
+  WriteEscaped(mode_, data, size, target_, true);
+}
+
+void EscapingSink::Flush() {
+  target_.Flush();
+}
+
+} // namespace yate
@@ -0,0 +1,129 @@
+#pragma once
+
+#include "sink.hh"
+
+#include <cstddef>
+#include <string>
+
+namespace yate {
+
+/// How the values of the symbols are escaped when written.
+enum class Escape {
+  eNone = 0,           /// Values are written verbatim.
+  eHtml = 1,           /// Text inside HTML elements: `&`, `<` and `>`.
+  eHtmlAttribute = 2,  /// HTML attribute values: also `"`, `'` and `` ` ``.
+  eJson = 3,           /// The content of a JSON string: `"`, `\` and
+                       /// control characters.
+  eUrl = 4             /// A URL component: everything but the unreserved
+                       /// characters of RFC 3986 is percent-encoded.
+};
+
+/// The size of the longest replacement of any mode, e.g. `&quot;` or
+/// `\u001f`, so escaped text is at most this many times longer.
+const std::size_t kMaxReplacementSize = 6;
+
+/// Helper function to get the name of an escaping mode as used in
+/// templates, i.e. `raw`, `html`, `attr`, `json` and `url`.
+///
+/// @param mode An element of the `Escape` enum.
+/// @return The name of the mode.
+std::string to_string(Escape mode);
+
+/// Parses the name of an escaping mode, see `to_string(Escape)`.
+///
+/// @param name The name of the mode.
+/// @param mode Where the parsed mode is stored.
+/// @return `false` if the name is not a known mode.
+bool ParseEscape(const std::string &name, Escape &mode);
+
+/// Finds the first character which needs escaping. Clean runs are
+/// skipped 16 or 32 bytes at a time with SIMD instructions when they
+/// are available.
+///
+/// @param mode The escaping mode.
+/// @param data The text to be escaped.
+/// @param begin The index where the search begins.
+/// @param size The size of the text.
+/// @return The index of the character or `size` if there is none.
+std::size_t FindEscapable(
+    Escape mode,
+    const char *data,
+    std::size_t begin,
+    std::size_t size);
+
+/// Returns the replacement for a character which needs escaping. The
+/// replacement is statically allocated.
+///
+/// @param mode The escaping mode.
+/// @param ch A character for which `FindEscapable()` stopped.
+/// @param size Where the size of the replacement is stored.
+/// @return The replacement text.
+const char *GetReplacement(Escape mode, char ch, std::size_t &size);
+
+/// Writes the escaped text to the sink. Clean runs are written
+/// without copying and replacements are written as stable bytes.
+///
+/// @param mode The escaping mode.
+/// @param data The text to be escaped.
+/// @param size The size of the text.
+/// @param output The sink where the escaped text is written.
+/// @param stable Whether `data` stays valid until the sink is
+///        flushed, see `Sink::WriteStable()`.
+void WriteEscaped(
+    Escape mode,
+    const char *data,
+    std::size_t size,
+    Sink &output,
+    bool stable);
+
+/// Returns the escaped copy of a text.
+///
+/// @param mode The escaping mode.
+/// @param text The text to be escaped.
+/// @return The escaped text.
+std::string Escaped(Escape mode, const std::string &text);
+
+/// Sink adapter which escapes every byte written to it before passing
+/// it on to another sink, e.g. to escape the output of a filter.
+class EscapingSink : public Sink {
+ public:
+  /// @param mode The escaping mode.
+  /// @param target The sink where the escaped output is written.
+  EscapingSink(Escape mode, Sink &target);
+  ~EscapingSink() {}
+
+  void Write(const char *data, std::size_t size) override;
+  void WriteStable(const char *data, std::size_t size) override;
+  void Flush() override;
+
+ private:
+  Escape mode_;
+  Sink &target_;
+};
+
+/// Same as `WriteEscaped()` but for any object with a
+/// `write(const char *, size)` method, e.g. `std::ostream`. It is used
+/// by the code generated by `yate-compile`.
+template <typename Writer>
+void WriteEscapedTo(
+    Escape mode,
+    const char *data,
+    std::size_t size,
+    Writer &output) {
+  std::size_t begin = 0;
+  while (begin < size) {
+    auto special = FindEscapable(mode, data, begin, size);
+    if (special > begin) {
+      output.write(data + begin, special - begin);
+    }
+    if (special == size) {
+      break;
+    }
+    std::size_t length;
+    auto replacement = GetReplacement(mode, data[special], length);
+    output.write(replacement, length);
+    begin = special + 1;
+  }
+}
+
+} // namespace yate
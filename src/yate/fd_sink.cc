@@ -0,0 +1,197 @@
+#ifndef _WIN32
+
+#include "fd_sink.hh"
+
+#include <poll.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+namespace yate {
+
+namespace {
+
+/// Size of each of the buffers used to hold copied bytes.
+const std::size_t kBufferSize = 16 * 1024;
+
+/// Stable writes smaller than this are copied: an `iovec` has a fixed
+/// cost in the kernel which is higher than copying a few bytes.
+const std::size_t kCopyThreshold = 128;
+
+/// Transient writes bigger than this are written directly instead of
+/// being copied to the buffers.
+const std::size_t kDirectThreshold = kBufferSize / 2;
+
+std::string ErrorMessage(const char *call) {
+  return std::string(call) + " failed: " + std::strerror(errno);
+}
+
+} // namespace
+
+FdSink::FdSink(int fd, std::size_t max_pending)
+    : fd_(fd),
+      max_pending_(max_pending),
+      iov_max_(16),
+      iovecs_(),
+      pending_(0),
+      buffers_(),
+      buffer_(0),
+      buffer_used_(0),
+      bytes_written_(0),
+      system_calls_(0) {
+  auto iov_max = sysconf(_SC_IOV_MAX);
+  if (iov_max > 0) {
+    iov_max_ = static_cast<std::size_t>(iov_max);
+  }
+  iovecs_.reserve(iov_max_);
+}
+
+FdSink::~FdSink() {
+  try {
+    Flush();
+  } catch (...) {
+  }
+}
+
+void FdSink::Write(const char *data, std::size_t size) {
+  if (size > kDirectThreshold) {
+    WriteDirect(data, size);
+  } else {
+    Copy(data, size);
+  }
+}
+
+void FdSink::WriteStable(const char *data, std::size_t size) {
+  if (size < kCopyThreshold) {
+    Copy(data, size);
+  } else {
+    Enqueue(data, size);
+  }
+}
+
+void FdSink::Flush() {
+  std::size_t first = 0;
+  while (first < iovecs_.size()) {
+    auto count = std::min(iov_max_, iovecs_.size() - first);
+    auto written = writev(fd_, &iovecs_[first], static_cast<int>(count));
+    if (written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        WaitWritable();
+        continue;
+      }
+      throw std::runtime_error(ErrorMessage("writev"));
+    }
+    ++system_calls_;
+    bytes_written_ += static_cast<std::uint64_t>(written);
+
+    // Skips the vectors written completely and adjusts the one which
+    // was written partially.
+    auto left = static_cast<std::size_t>(written);
+    while (first < iovecs_.size() && left >= iovecs_[first].iov_len) {
+      left -= iovecs_[first].iov_len;
+      ++first;
+    }
+    if (left > 0) {
+      auto &partial = iovecs_[first];
+      partial.iov_base = static_cast<char *>(partial.iov_base) + left;
+      partial.iov_len -= left;
+    }
+  }
+  iovecs_.clear();
+  pending_ = 0;
+  buffer_ = 0;
+  buffer_used_ = 0;
+}
+
+void FdSink::Enqueue(const char *data, std::size_t size) {
+  if (size == 0) {
+    return;
+  }
+  if (!iovecs_.empty()) {
+    auto &last = iovecs_.back();
+    if (static_cast<const char *>(last.iov_base) + last.iov_len == data) {
+      last.iov_len += size;
+      pending_ += size;
+      if (pending_ >= max_pending_) {
+        Flush();
+      }
+      return;
+    }
+  }
+  if (iovecs_.size() == iov_max_) {
+    Flush();
+  }
+  iovec vector;
+  vector.iov_base = const_cast<char *>(data);
+  vector.iov_len = size;
+  iovecs_.push_back(vector);
+  pending_ += size;
+  if (pending_ >= max_pending_) {
+    Flush();
+  }
+}
+
+void FdSink::Copy(const char *data, std::size_t size) {
+  while (size > 0) {
+    if (buffer_ == buffers_.size()) {
+      buffers_.emplace_back(new char[kBufferSize]);
+    }
+    auto chunk = std::min(size, kBufferSize - buffer_used_);
+    auto target = buffers_[buffer_].get() + buffer_used_;
+    std::memcpy(target, data, chunk);
+    buffer_used_ += chunk;
+    data += chunk;
+    size -= chunk;
+    if (buffer_used_ == kBufferSize) {
+      ++buffer_;
+      buffer_used_ = 0;
+    }
+    // Enqueuing may flush and reset the buffers, which is fine since
+    // the bytes were already handed to the kernel.
+    Enqueue(target, chunk);
+  }
+}
+
+void FdSink::WriteDirect(const char *data, std::size_t size) {
+  Flush();
+  while (size > 0) {
+    auto written = write(fd_, data, size);
+    if (written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        WaitWritable();
+        continue;
+      }
+      throw std::runtime_error(ErrorMessage("write"));
+    }
+    ++system_calls_;
+    bytes_written_ += static_cast<std::uint64_t>(written);
+    data += written;
+    size -= static_cast<std::size_t>(written);
+  }
+}
+
+void FdSink::WaitWritable() {
+  pollfd descriptor;
+  descriptor.fd = fd_;
+  descriptor.events = POLLOUT;
+  descriptor.revents = 0;
+  while (poll(&descriptor, 1, -1) < 0) {
+    if (errno != EINTR) {
+      throw std::runtime_error(ErrorMessage("poll"));
+    }
+  }
+}
+
+} // namespace yate
+
+#endif // _WIN32
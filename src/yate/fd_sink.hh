@@ -0,0 +1,80 @@
+#pragma once
+
+#ifndef _WIN32
+
+#include "sink.hh"
+
+#include <sys/uio.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace yate {
+
+/// Sink which writes to a file descriptor using scatter-gather I/O.
+/// Instead of copying the output into a stream buffer, it collects
+/// `iovec`s which point straight at the bytes given to `WriteStable()`
+/// (the literals of the template and the symbols of the renderer) and
+/// hands them to `writev()` in batches of at most `IOV_MAX` entries,
+/// so those bytes are copied exactly once, by the kernel.
+///
+/// Bytes given to `Write()` and very small stable writes, for which an
+/// `iovec` costs more than a copy, are copied into internal buffers
+/// which are reused after every flush. Partial writes and non-blocking
+/// descriptors are handled; any other error throws a
+/// `std::runtime_error`.
+class FdSink : public Sink {
+ public:
+  /// @param fd An open file descriptor, it is not closed by the sink.
+  /// @param max_pending The number of bytes after which pending data
+  ///        is written without waiting for an explicit `Flush()`.
+  FdSink(int fd, std::size_t max_pending = 1 << 20);
+
+  /// Flushes the pending data, ignoring any error. Call `Flush()`
+  /// explicitly to get errors reported.
+  ~FdSink();
+
+  // Not copyable nor movable.
+  FdSink(const FdSink &) = delete;
+  FdSink &operator=(const FdSink &) = delete;
+
+  void Write(const char *data, std::size_t size) override;
+  void WriteStable(const char *data, std::size_t size) override;
+  void Flush() override;
+
+  // Metrics.
+  std::uint64_t bytes_written() const { return bytes_written_; }
+  std::uint64_t system_calls() const { return system_calls_; }
+
+ private:
+  /// Queues an `iovec` for the given bytes, merging it with the last
+  /// one when they are contiguous in memory.
+  void Enqueue(const char *data, std::size_t size);
+
+  /// Copies the given bytes to the internal buffers and queues them.
+  void Copy(const char *data, std::size_t size);
+
+  /// Writes the given bytes immediately, after the pending ones.
+  void WriteDirect(const char *data, std::size_t size);
+
+  /// Blocks until the descriptor can be written, used when it is in
+  /// non-blocking mode.
+  void WaitWritable();
+
+  int fd_;
+  std::size_t max_pending_;
+  std::size_t iov_max_;
+  std::vector<iovec> iovecs_;
+  std::size_t pending_;
+  std::vector<std::unique_ptr<char[]>> buffers_;
+  std::size_t buffer_;
+  std::size_t buffer_used_;
+  std::uint64_t bytes_written_;
+  std::uint64_t system_calls_;
+};
+
+} // namespace yate
+
+#endif // _WIN32
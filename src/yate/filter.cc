@@ -0,0 +1,292 @@
+#include "filter.hh"
+
+#include "utils.hh"
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <limits>
+#include <stdexcept>
+#include <utility>
+
+namespace yate {
+
+namespace {
+
+/// Size of the stack buffers used by the built-in filters.
+const std::size_t kBufferSize = 256;
+
+/// Copies a value into a null terminated stack buffer so it can be
+/// given to the C conversion functions.
+void Terminate(
+    const char *data,
+    std::size_t size,
+    char (&buffer)[kBufferSize],
+    const char *kind) {
+  if (size == 0 || size >= kBufferSize) {
+    throw std::runtime_error(
+        "Value '" + std::string(data, size) + "' is not " + kind);
+  }
+  std::memcpy(buffer, data, size);
+  buffer[size] = '\0';
+}
+
+template <int (*convert)(int)>
+void ChangeCase(
+    const char *data,
+    std::size_t size,
+    const std::vector<FilterArgument> &arguments,
+    Sink &output) {
+  char buffer[kBufferSize];
+  while (size > 0) {
+    auto chunk = std::min(size, kBufferSize);
+    for (std::size_t i = 0; i < chunk; ++i) {
+      auto ch = static_cast<unsigned char>(data[i]);
+      buffer[i] = static_cast<char>(convert(ch));
+    }
+    output.Write(buffer, chunk);
+    data += chunk;
+    size -= chunk;
+  }
+}
+
+void Truncate(
+    const char *data,
+    std::size_t size,
+    const std::vector<FilterArgument> &arguments,
+    Sink &output) {
+  auto length = static_cast<std::size_t>(
+      std::min<std::uint64_t>(arguments[0].count, size));
+  if (size <= length) {
+    output.Write(data, size);
+    return;
+  }
+  // Backs off to the first byte of the UTF-8 character which does not
+  // fit, so it is not split.
+  while (length > 0 &&
+         (static_cast<unsigned char>(data[length]) & 0xc0) == 0x80) {
+    --length;
+  }
+  output.Write(data, length);
+  if (arguments.size() > 1) {
+    output.Write(arguments[1].text.data(), arguments[1].text.size());
+  } else {
+    output.Write("...", 3);
+  }
+}
+
+void Number(
+    const char *data,
+    std::size_t size,
+    const std::vector<FilterArgument> &arguments,
+    Sink &output) {
+  char value[kBufferSize];
+  Terminate(data, size, value, "a number");
+  char *end;
+  errno = 0;
+  auto number = std::strtod(value, &end);
+  if (*end != '\0' || errno == ERANGE) {
+    throw std::runtime_error(
+        "Value '" + std::string(value) + "' is not a number");
+  }
+  auto decimals = static_cast<int>(
+      std::min<std::uint64_t>(arguments.empty() ? 0 : arguments[0].count, 20));
+
+  char plain[kBufferSize];
+  auto length = std::snprintf(plain, sizeof(plain), "%.*f", decimals, number);
+  if (length < 0 || static_cast<std::size_t>(length) >= sizeof(plain)) {
+    throw std::runtime_error("Value '" + std::string(value) + "' is too large");
+  }
+
+  // Inserts a separator every three digits of the integer part.
+  char formatted[kBufferSize * 2];
+  std::size_t written = 0;
+  const char *digits = plain;
+  if (*digits == '-') {
+    formatted[written++] = *digits++;
+  }
+  auto integer = std::strcspn(digits, ".");
+  for (std::size_t i = 0; i < integer; ++i) {
+    if (i > 0 && (integer - i) % 3 == 0) {
+      formatted[written++] = ',';
+    }
+    formatted[written++] = digits[i];
+  }
+  auto rest = std::strlen(digits + integer);
+  std::memcpy(formatted + written, digits + integer, rest);
+  output.Write(formatted, written + rest);
+}
+
+void Date(
+    const char *data,
+    std::size_t size,
+    const std::vector<FilterArgument> &arguments,
+    Sink &output) {
+  char value[kBufferSize];
+  Terminate(data, size, value, "a timestamp");
+  char *end;
+  errno = 0;
+  auto seconds = std::strtoll(value, &end, 10);
+  if (*end != '\0' || errno == ERANGE) {
+    throw std::runtime_error(
+        "Value '" + std::string(value) + "' is not a timestamp");
+  }
+  auto time = static_cast<std::time_t>(seconds);
+  std::tm calendar;
+#ifdef _WIN32
+  gmtime_s(&calendar, &time);
+#else
+  gmtime_r(&time, &calendar);
+#endif
+  const char *format =
+      arguments.empty() ? "%Y-%m-%d" : arguments[0].text.c_str();
+  char formatted[kBufferSize];
+  auto length = std::strftime(formatted, sizeof(formatted), format, &calendar);
+  output.Write(formatted, length);
+}
+
+void Default(
+    const char *data,
+    std::size_t size,
+    const std::vector<FilterArgument> &arguments,
+    Sink &output) {
+  if (size == 0) {
+    output.Write(arguments[0].text.data(), arguments[0].text.size());
+  } else {
+    output.Write(data, size);
+  }
+}
+
+/// Parses the decimal digits of an `eCount` argument, rejecting signs,
+/// other characters and values which do not fit.
+bool ParseCount(const std::string &text, std::uint64_t &count) {
+  if (text.empty()) {
+    return false;
+  }
+  count = 0;
+  for (auto ch : text) {
+    if (ch < '0' || ch > '9') {
+      return false;
+    }
+    auto digit = static_cast<std::uint64_t>(ch - '0');
+    if (count > (std::numeric_limits<std::uint64_t>::max() - digit) / 10) {
+      return false;
+    }
+    count = count * 10 + digit;
+  }
+  return true;
+}
+
+} // namespace
+
+FilterRegistry::FilterRegistry() : filters_() {}
+
+const FilterRegistry &FilterRegistry::Builtin() {
+  static const FilterRegistry registry = []() {
+    FilterRegistry result;
+    result.Register("upper", ChangeCase<std::toupper>);
+    result.Register("lower", ChangeCase<std::tolower>);
+    result.Register(
+        "truncate", Truncate, 1, 2, {FilterArgumentKind::eCount});
+    result.Register("number", Number, 0, 1, {FilterArgumentKind::eCount});
+    result.Register("date", Date, 0, 1);
+    result.Register("default", Default, 1, 1);
+    return result;
+  }();
+  return registry;
+}
+
+void FilterRegistry::Register(
+    const std::string &name,
+    Filter filter,
+    std::size_t min_arguments,
+    std::size_t max_arguments,
+    std::vector<FilterArgumentKind> kinds) {
+  filters_[name] = {filter, min_arguments, max_arguments, std::move(kinds)};
+}
+
+FilterCall FilterRegistry::Resolve(
+    const std::string &name,
+    std::vector<std::string> arguments) const {
+  auto it = filters_.find(name);
+  if (it == filters_.end()) {
+    throw std::runtime_error("Unknown filter '" + name + "'");
+  }
+  const auto &entry = it->second;
+  if (arguments.size() < entry.min_arguments ||
+      arguments.size() > entry.max_arguments) {
+    auto expected = entry.min_arguments == entry.max_arguments
+        ? std::to_string(entry.min_arguments)
+        : std::to_string(entry.min_arguments) + " to " +
+              std::to_string(entry.max_arguments);
+    throw std::runtime_error(
+        "Filter '" + name + "' takes " + expected + " arguments but got " +
+        std::to_string(arguments.size()));
+  }
+  FilterCall call{name, entry.filter, {}};
+  for (std::size_t i = 0; i < arguments.size(); ++i) {
+    FilterArgument argument{std::move(arguments[i]), 0};
+    if (i < entry.kinds.size() &&
+        entry.kinds[i] == FilterArgumentKind::eCount &&
+        !ParseCount(argument.text, argument.count)) {
+      throw std::runtime_error(
+          "Argument " + std::to_string(i + 1) + " of filter '" + name +
+          "' is not a non-negative integer: '" + argument.text + "'");
+    }
+    call.arguments.push_back(std::move(argument));
+  }
+  return call;
+}
+
+bool FilterRegistry::Contains(const std::string &name) const {
+  return contains(filters_, name);
+}
+
+void WriteFiltered(
+    const std::vector<FilterCall> &filters,
+    Escape escape,
+    const char *data,
+    std::size_t size,
+    Sink &output,
+    std::vector<std::string> &scratch,
+    bool stable) {
+  if (filters.empty()) {
+    if (escape != Escape::eNone) {
+      WriteEscaped(escape, data, size, output, stable);
+    } else if (stable) {
+      output.WriteStable(data, size);
+    } else {
+      output.Write(data, size);
+    }
+    return;
+  }
+
+  // Intermediate results alternate between two buffers, the input of
+  // a filter is always the buffer it is not writing to.
+  if (scratch.size() < 2) {
+    scratch.resize(2);
+  }
+  for (std::size_t i = 0; i + 1 < filters.size(); ++i) {
+    auto &buffer = scratch[i % 2];
+    buffer.clear();
+    StringSink intermediate(buffer);
+    filters[i].function(data, size, filters[i].arguments, intermediate);
+    data = buffer.data();
+    size = buffer.size();
+  }
+
+  const auto &last = filters.back();
+  if (escape == Escape::eNone) {
+    last.function(data, size, last.arguments, output);
+  } else {
+    EscapingSink escaping(escape, output);
+    last.function(data, size, last.arguments, escaping);
+  }
+}
+
+} // namespace yate
@@ -0,0 +1,140 @@
+#pragma once
+
+#include "escape.hh"
+#include "sink.hh"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace yate {
+
+/// How a filter reads one of its arguments, checked when the template
+/// is compiled.
+enum class FilterArgumentKind {
+  eText = 0,   /// Any string or number, used as text.
+  eCount = 1   /// A non-negative integer, e.g. a length.
+};
+
+/// An argument given to a filter in a template.
+struct FilterArgument {
+  /// The argument as written, already unquoted.
+  std::string text;
+  /// The value of `eCount` arguments, parsed once when the template
+  /// is compiled. 0 for text arguments.
+  std::uint64_t count = 0;
+};
+
+/// A filter transforms the value of a symbol while it is written,
+/// e.g. `{{price | number 2}}`. Filters write their result straight
+/// into the sink, so values are only formatted when they are printed.
+///
+/// @param data The value to be transformed.
+/// @param size The size of the value.
+/// @param arguments The arguments given in the template, checked
+///        against the kinds the filter was registered with.
+/// @param output The sink where the result is written.
+using Filter = void (*)(
+    const char *data,
+    std::size_t size,
+    const std::vector<FilterArgument> &arguments,
+    Sink &output);
+
+/// A filter applied by a substitution, resolved when the template is
+/// compiled.
+struct FilterCall {
+  std::string name;
+  Filter function;
+  std::vector<FilterArgument> arguments;
+};
+
+/// Maps the names used in templates to filters. The `Compiler`
+/// resolves every filter of a template through a registry, so unknown
+/// filters and wrong arguments are reported at parse time and
+/// rendering calls the function pointers directly.
+class FilterRegistry {
+ public:
+  /// Creates an empty registry. Use `Builtin()` as a starting point
+  /// to extend the built-in filters.
+  FilterRegistry();
+  ~FilterRegistry() {}
+
+  /// The registry with the built-in filters:
+  ///
+  /// - `upper` and `lower` change the case of ASCII letters.
+  /// - `truncate N ["suffix"]` keeps the first `N` bytes, without
+  ///   splitting UTF-8 characters, and appends `suffix` (by default
+  ///   `...`) when something was cut.
+  /// - `number [decimals]` formats a number with thousands separators
+  ///   and the given number of decimals, 0 by default.
+  /// - `date ["format"]` formats a number of seconds since the epoch,
+  ///   in UTC, with `strftime()`. The default format is `%Y-%m-%d`.
+  /// - `default "text"` prints `text` instead of empty values.
+  static const FilterRegistry &Builtin();
+
+  /// Registers or replaces a filter.
+  ///
+  /// @param name The name used in templates.
+  /// @param filter The function implementing the filter.
+  /// @param min_arguments The minimum number of arguments it takes.
+  /// @param max_arguments The maximum number of arguments it takes.
+  /// @param kinds The kind of each argument, by position. Arguments
+  ///        past the end are text.
+  void Register(
+      const std::string &name,
+      Filter filter,
+      std::size_t min_arguments = 0,
+      std::size_t max_arguments = 0,
+      std::vector<FilterArgumentKind> kinds = {});
+
+  /// Resolves a filter used in a template, parsing the arguments which
+  /// are counts. A `std::runtime_error` is thrown if the filter is
+  /// unknown, the number of arguments is not accepted by it or an
+  /// argument is not of its kind.
+  ///
+  /// @param name The name of the filter.
+  /// @param arguments The arguments given in the template.
+  /// @return The call to be stored in the template.
+  FilterCall Resolve(
+      const std::string &name,
+      std::vector<std::string> arguments) const;
+
+  /// @return Whether a filter with the given name is registered.
+  bool Contains(const std::string &name) const;
+
+ private:
+  struct Entry {
+    Filter filter;
+    std::size_t min_arguments;
+    std::size_t max_arguments;
+    std::vector<FilterArgumentKind> kinds;
+  };
+
+  std::unordered_map<std::string, Entry> filters_;
+};
+
+/// Writes a value through its filters and escaping mode. A filter
+/// writes straight into the sink when it is the last one of the
+/// chain; the others write into `scratch`, whose buffers are reused
+/// between calls.
+///
+/// @param filters The filters to apply, in order.
+/// @param escape How the result of the last filter is escaped.
+/// @param data The value to be written.
+/// @param size The size of the value.
+/// @param output The sink where the result is written.
+/// @param scratch Buffers for the intermediate results of the chain.
+/// @param stable Whether `data` stays valid until the sink is
+///        flushed, see `Sink::WriteStable()`.
+void WriteFiltered(
+    const std::vector<FilterCall> &filters,
+    Escape escape,
+    const char *data,
+    std::size_t size,
+    Sink &output,
+    std::vector<std::string> &scratch,
+    bool stable);
+
+} // namespace yate
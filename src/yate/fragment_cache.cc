@@ -0,0 +1,105 @@
+#include "fragment_cache.hh"
+
+#include <string>
+
+namespace yate {
+
+FragmentCache::FragmentCache(std::size_t capacity)
+    : capacity_(capacity),
+      mutex_(),
+      entries_(),
+      index_(),
+      size_(0),
+      hits_(0),
+      misses_(0),
+      evictions_(0) {}
+
+std::shared_ptr<const std::string> FragmentCache::Find(
+    const FragmentKey &key) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = index_.find(key.hash());
+  if (it == index_.end() || !(it->second->first == key)) {
+    ++misses_;
+    return nullptr;
+  }
+  ++hits_;
+  entries_.splice(entries_.begin(), entries_, it->second);
+  return it->second->second;
+}
+
+void FragmentCache::Insert(
+    FragmentKey key,
+    std::shared_ptr<const std::string> fragment) {
+  Entry entry(std::move(key), std::move(fragment));
+  auto entry_size = EntrySize(entry);
+  if (entry_size > capacity_) {
+    return;
+  }
+  auto hash = entry.first.hash();
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = index_.find(hash);
+  if (it != index_.end()) {
+    size_ -= EntrySize(*it->second);
+    entries_.erase(it->second);
+    index_.erase(it);
+  }
+  size_ += entry_size;
+  entries_.push_front(std::move(entry));
+  index_[hash] = entries_.begin();
+  Evict();
+}
+
+void FragmentCache::Clear() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  entries_.clear();
+  index_.clear();
+  size_ = 0;
+}
+
+std::size_t FragmentCache::size() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return size_;
+}
+
+void FragmentCache::Evict() {
+  while (size_ > capacity_ && !entries_.empty()) {
+    const auto &last = entries_.back();
+    size_ -= EntrySize(last);
+    index_.erase(last.first.hash());
+    entries_.pop_back();
+    ++evictions_;
+  }
+}
+
+FragmentKey::FragmentKey() : hash_(14695981039346656037ull), bytes_() {}
+
+void FragmentKey::Add(std::uint64_t number) {
+  unsigned char bytes[sizeof(number)];
+  for (std::size_t i = 0; i < sizeof(number); ++i) {
+    bytes[i] = static_cast<unsigned char>(number >> (8 * i));
+  }
+  Add(reinterpret_cast<const char *>(bytes), sizeof(bytes));
+}
+
+void FragmentKey::Add(const std::string &text) {
+  Add(static_cast<std::uint64_t>(text.size()));
+  Add(text.data(), text.size());
+}
+
+void FragmentKey::Add(const std::vector<std::string> &array) {
+  Add(static_cast<std::uint64_t>(array.size()));
+  for (const auto &item : array) {
+    Add(item);
+  }
+}
+
+void FragmentKey::Add(const char *data, std::size_t size) {
+  bytes_.append(data, size);
+  for (std::size_t i = 0; i < size; ++i) {
+    hash_ ^= static_cast<unsigned char>(data[i]);
+    hash_ *= 1099511628211ull;
+  }
+}
+
+} // namespace yate
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace yate {
+
+/// Identifies a fragment: the template, the section and every input
+/// the section reads. Every string added is prefixed by its length, so
+/// different sequences of inputs do not produce the same bytes. The
+/// bytes are kept whole, a hash of them only picks the bucket of the
+/// cache, so inputs whose hashes collide never share a fragment.
+class FragmentKey {
+ public:
+  FragmentKey();
+  ~FragmentKey() {}
+
+  void Add(std::uint64_t number);
+  void Add(const std::string &text);
+  void Add(const std::vector<std::string> &array);
+
+  /// @return The 64 bits FNV-1a hash of the bytes.
+  std::uint64_t hash() const { return hash_; }
+  const std::string &bytes() const { return bytes_; }
+
+  bool operator==(const FragmentKey &other) const {
+    return hash_ == other.hash_ && bytes_ == other.bytes_;
+  }
+
+ private:
+  void Add(const char *data, std::size_t size);
+
+  std::uint64_t hash_;
+  std::string bytes_;
+};
+
+/// A bounded cache of rendered sections of templates. Each fragment
+/// is keyed by the template, the section and every input the section
+/// reads (see `Template::section_dependencies()`), so a section whose
+/// inputs did not change can be copied to the output instead of being
+/// rendered again.
+///
+/// The cache can be shared by several `Renderer`s in different
+/// threads. When the total size of the fragments and their keys
+/// exceeds the capacity the least recently used ones are evicted.
+class FragmentCache {
+ public:
+  /// @param capacity The maximum number of bytes of rendered output
+  ///        and keys kept in the cache.
+  FragmentCache(std::size_t capacity);
+  ~FragmentCache() {}
+
+  // Not copyable nor movable.
+  FragmentCache(const FragmentCache &) = delete;
+  FragmentCache &operator=(const FragmentCache &) = delete;
+
+  /// Looks up a fragment, counting a hit or a miss. Only a fragment
+  /// stored with the same key bytes is a hit.
+  ///
+  /// @param key The key of the fragment.
+  /// @return The rendered fragment or `nullptr` if it is not cached.
+  std::shared_ptr<const std::string> Find(const FragmentKey &key);
+
+  /// Stores a rendered fragment, replacing any previous one with the
+  /// same key or the same hash. Fragments which do not fit in the
+  /// capacity with their key are not stored.
+  ///
+  /// @param key The key of the fragment.
+  /// @param fragment The rendered output of the section, shared with
+  ///        the caller.
+  void Insert(FragmentKey key, std::shared_ptr<const std::string> fragment);
+
+  /// Removes all the fragments, the metrics are not reset.
+  void Clear();
+
+  // Metrics.
+  std::uint64_t hits() const { return hits_; }
+  std::uint64_t misses() const { return misses_; }
+  std::uint64_t evictions() const { return evictions_; }
+  std::size_t size() const;
+  std::size_t capacity() const { return capacity_; }
+
+ private:
+  using Entry = std::pair<FragmentKey, std::shared_ptr<const std::string>>;
+
+  /// The bytes an entry counts against the capacity.
+  static std::size_t EntrySize(const Entry &entry) {
+    return entry.first.bytes().size() + entry.second->size();
+  }
+
+  /// Evicts least recently used fragments until `size_` fits in the
+  /// capacity. Must be called with `mutex_` held.
+  void Evict();
+
+  const std::size_t capacity_;
+  mutable std::mutex mutex_;
+  /// Most recently used fragments first.
+  std::list<Entry> entries_;
+  /// The entries by the hash of their key.
+  std::unordered_map<std::uint64_t, std::list<Entry>::iterator> index_;
+  std::size_t size_;
+  std::atomic<std::uint64_t> hits_;
+  std::atomic<std::uint64_t> misses_;
+  std::atomic<std::uint64_t> evictions_;
+};
+
+} // namespace yate
@@ -10,8 +10,13 @@ namespace yate {
 Frame::Frame(std::shared_ptr<Frame> parent, std::string id)
     : parent_(parent),
       printable_values_(),
+      bound_values_(),
       iterable_values_(),
-      id_(std::move(id)) {
+      generators_(),
+      id_(std::move(id)),
+      loop_index_(0),
+      loop_length_(0),
+      loop_length_known_(true) {
   if (parent == nullptr) {
     throw std::runtime_error("Initializing environment with no parent");
   }
@@ -22,50 +27,120 @@ Frame::Frame(
     std::unordered_map<std::string, std::vector<std::string>> iterable_values)
     : parent_(),
       printable_values_(std::move(printable_values)),
+      bound_values_(),
       iterable_values_(std::move(iterable_values)),
-      id_("root") {
+      generators_(),
+      id_("root"),
+      loop_index_(0),
+      loop_length_(0),
+      loop_length_known_(true) {}
+
+void Frame::Reset(std::string id) {
+  printable_values_.clear();
+  bound_values_.clear();
+  iterable_values_.clear();
+  generators_.clear();
+  id_ = std::move(id);
+  loop_index_ = 0;
+  loop_length_ = 0;
+  loop_length_known_ = true;
 }
 
-std::string Frame::GetValue(const std::string& identifier) const {
-  if (contains(printable_values_, identifier)) {
-    return printable_values_.at(identifier);
-  }
-  if (parent_ == nullptr) {
+const std::string &Frame::GetValue(const std::string& identifier) const {
+  auto value = FindValue(identifier);
+  if (value == nullptr) {
     throw std::runtime_error("Unknown identifier '" + identifier + "'");
   }
-  return parent_->GetValue(identifier);
+  return *value;
 }
 
-bool Frame::ContainsValue(const std::string& identifier) const {
-  if (contains(printable_values_, identifier)) {
-    return true;
+const std::string *Frame::FindValue(const std::string &identifier) const {
+  for (auto frame = this; frame != nullptr; frame = frame->parent_.get()) {
+    for (const auto &bound : frame->bound_values_) {
+      if (*bound.first == identifier) {
+        return bound.second;
+      }
+    }
+    auto printable = frame->printable_values_.find(identifier);
+    if (printable != frame->printable_values_.end()) {
+      return &printable->second;
+    }
   }
-  return parent_ != nullptr && parent_->ContainsValue(identifier);
+  return nullptr;
 }
 
-void Frame::PutValue(
-    const std::string &identifier,
-    const std::string &value) {
-  printable_values_[identifier] = value;
+bool Frame::ContainsValue(const std::string& identifier) const {
+  return FindValue(identifier) != nullptr;
+}
+
+void Frame::PutValue(const std::string &identifier, std::string value) {
+  printable_values_[identifier] = std::move(value);
 }
 
 const std::vector<std::string> &Frame::GetIterable(
     const std::string &identifier) const {
-  if (contains(iterable_values_, identifier)) {
-    return iterable_values_.at(identifier);
-  }
-  if (parent_ == nullptr) {
+  auto iterable = FindIterable(identifier);
+  if (iterable == nullptr) {
     throw std::runtime_error("Unknown identifier '" + identifier + "'");
   }
-  return parent_->GetIterable(identifier);
+  return *iterable;
+}
+
+const std::vector<std::string> *Frame::FindIterable(
+    const std::string &identifier) const {
+  for (auto frame = this; frame != nullptr; frame = frame->parent_.get()) {
+    auto iterable = frame->iterable_values_.find(identifier);
+    if (iterable != frame->iterable_values_.end()) {
+      return &iterable->second;
+    }
+  }
+  return nullptr;
 }
 
 bool Frame::ContainsIterable(const std::string &identifier) const {
-  if (contains(iterable_values_, identifier)) {
+  return FindIterable(identifier) != nullptr;
+}
+
+void Frame::BindValue(
+    const std::string &identifier,
+    const std::string &value) {
+  for (auto &bound : bound_values_) {
+    if (*bound.first == identifier) {
+      bound.second = &value;
+      return;
+    }
+  }
+  bound_values_.emplace_back(&identifier, &value);
+}
+
+void Frame::PutIterable(
+    const std::string &identifier,
+    std::vector<std::string> values) {
+  iterable_values_[identifier] = std::move(values);
+}
+
+void Frame::PutGenerator(
+    const std::string &identifier,
+    std::shared_ptr<Generator> generator) {
+  generators_[identifier] = std::move(generator);
+}
+
+bool Frame::ContainsGenerator(const std::string &identifier) const {
+  if (contains(generators_, identifier)) {
     return true;
   }
+  return parent_ != nullptr && parent_->ContainsGenerator(identifier);
+}
 
-  return parent_ != nullptr && parent_->ContainsIterable(identifier);
+Generator &Frame::GetGenerator(const std::string &identifier) const {
+  auto it = generators_.find(identifier);
+  if (it != generators_.end()) {
+    return *it->second;
+  }
+  if (parent_ == nullptr) {
+    throw std::runtime_error("Unknown identifier '" + identifier + "'");
+  }
+  return parent_->GetGenerator(identifier);
 }
 
 } // namespace yate
@@ -1,10 +1,13 @@
 #pragma once
 
+#include "generator.hh"
 #include "token.hh"
 
+#include <cstddef>
 #include <memory>
 #include <string>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 
 namespace yate {
@@ -50,6 +53,41 @@ class Frame : public std::enable_shared_from_this<Frame> {
   // Getters.
   std::shared_ptr<Frame> parent() const { return parent_; }
   std::string id() const { return id_; }
+  std::size_t loop_index() const { return loop_index_; }
+  std::size_t loop_length() const { return loop_length_; }
+  bool loop_length_known() const { return loop_length_known_; }
+  const std::unordered_map<std::string, std::string> &printable_values()
+      const {
+    return printable_values_;
+  }
+  const std::unordered_map<std::string, std::vector<std::string>> &
+  iterable_values() const {
+    return iterable_values_;
+  }
+
+  /// Removes the symbols of the frame, so it can be reused by another
+  /// loop with the same parent. The memory of the bound values is
+  /// kept, so reused frames bind their symbols without allocating.
+  ///
+  /// @param id The new frame id.
+  void Reset(std::string id);
+
+  /// Sets the position of the element bound by the loop which owns
+  /// the frame, from which the loop metadata is computed.
+  ///
+  /// @param index The 0-based index of the element.
+  /// @param length The number of elements of the array. Loops over
+  ///        generators whose size is unknown give a length which only
+  ///        tells whether the element is the last one.
+  /// @param length_known Whether `length` is the actual length.
+  void SetLoopPosition(
+      std::size_t index,
+      std::size_t length,
+      bool length_known = true) {
+    loop_index_ = index;
+    loop_length_ = length;
+    loop_length_known_ = length_known;
+  }
 
   /// Search and returns the value associated with the given
   /// symbol. If not found in the current `Frame` it will perform the
@@ -58,7 +96,14 @@ class Frame : public std::enable_shared_from_this<Frame> {
   ///
   /// @param identifier The symbol name to be look for.
   /// @return The value associated with the given symbol.
-  std::string GetValue(const std::string& identifier) const;
+  const std::string &GetValue(const std::string& identifier) const;
+
+  /// Looks a value up like `GetValue()` with a single walk up the
+  /// frames, returning `nullptr` instead of throwing.
+  ///
+  /// @param identifier The symbol name to be look for.
+  /// @return The value associated with the symbol or `nullptr`.
+  const std::string *FindValue(const std::string &identifier) const;
 
   /// Search if a value is stored for the given symbol in either the
   /// current frame; or, if not found there, on the parent frame.
@@ -78,7 +123,20 @@ class Frame : public std::enable_shared_from_this<Frame> {
   ///        value.
   /// @param value The value associated with the given symbol
   ///        identifier.
-  void PutValue(const std::string &identifier, const std::string &value);
+  void PutValue(const std::string &identifier, std::string value);
+
+  /// Associates an identifier with a value owned by someone else,
+  /// e.g. the element of an array being iterated. Neither the
+  /// identifier nor the value are copied, so they must outlive the
+  /// frame or be bound again. Bound values are kept in a short list
+  /// rather than a map, since loops bind one symbol, or a few when
+  /// zipped, and binding them again must not allocate.
+  ///
+  /// @param identifier The symbol to be associated with the given
+  ///        value.
+  /// @param value The value associated with the given symbol
+  ///        identifier.
+  void BindValue(const std::string &identifier, const std::string &value);
 
   /// Search and returns the vector associated with the given
   /// symbol. If not found in the current `Frame` it will perform the
@@ -90,6 +148,14 @@ class Frame : public std::enable_shared_from_this<Frame> {
   const std::vector<std::string> &GetIterable(
       const std::string &identifier) const;
 
+  /// Looks an array up like `GetIterable()` with a single walk up the
+  /// frames, returning `nullptr` instead of throwing.
+  ///
+  /// @param identifier The symbol name to be look for.
+  /// @return The array associated with the symbol or `nullptr`.
+  const std::vector<std::string> *FindIterable(
+      const std::string &identifier) const;
+
   /// Search if an array is stored for the given symbol in either the
   /// current frame; or, if not found there, on the parent frame.
   /// If not found in any frame up to the top-most one, false is
@@ -100,11 +166,50 @@ class Frame : public std::enable_shared_from_this<Frame> {
   ///        or in any frame up the stack.
   bool ContainsIterable(const std::string &identifier) const;
 
+  /// Associates an identifier with a vector in the current frame,
+  /// replacing the previous one if there was any.
+  ///
+  /// @param identifier The symbol to be associated with the array.
+  /// @param values The elements of the array.
+  void PutIterable(
+      const std::string &identifier,
+      std::vector<std::string> values);
+
+  /// Associates an identifier with a generator in the current frame,
+  /// replacing the previous one if there was any. Loops over the
+  /// identifier consume the generator instead of an array.
+  ///
+  /// @param identifier The symbol to be associated with the generator.
+  /// @param generator The generator, shared with the caller.
+  void PutGenerator(
+      const std::string &identifier,
+      std::shared_ptr<Generator> generator);
+
+  /// Search if a generator is stored for the given symbol in this
+  /// frame or any frame up the stack.
+  ///
+  /// @param identifier The symbol name to be look for.
+  /// @return true if a generator is found.
+  bool ContainsGenerator(const std::string &identifier) const;
+
+  /// Search and returns the generator associated with the given
+  /// symbol, throwing a `std::runtime_error` if there is none.
+  ///
+  /// @param identifier The symbol name to be look for.
+  /// @return The generator associated with the given symbol.
+  Generator &GetGenerator(const std::string &identifier) const;
+
  private:
   std::shared_ptr<Frame> parent_;
   std::unordered_map<std::string, std::string> printable_values_;
+  std::vector<std::pair<const std::string *, const std::string *>>
+      bound_values_;
   std::unordered_map<std::string, std::vector<std::string>> iterable_values_;
+  std::unordered_map<std::string, std::shared_ptr<Generator>> generators_;
   std::string id_;
+  std::size_t loop_index_;
+  std::size_t loop_length_;
+  bool loop_length_known_;
 };
 
 } // namespace yate
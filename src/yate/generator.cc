@@ -0,0 +1,22 @@
+#include "generator.hh"
+
+#include <utility>
+
+namespace yate {
+
+FunctionGenerator::FunctionGenerator(Producer producer)
+    : producer_(std::move(producer)), index_(0) {}
+
+void FunctionGenerator::Reset() {
+  index_ = 0;
+}
+
+bool FunctionGenerator::Next(std::string &element) {
+  if (!producer_(index_, element)) {
+    return false;
+  }
+  ++index_;
+  return true;
+}
+
+} // namespace yate
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <string>
+
+namespace yate {
+
+/// An array whose elements are produced while the loop over it is
+/// rendered, e.g. the rows of a database cursor. Unlike the arrays
+/// given to the `Renderer`, the elements are never stored together:
+/// the renderer keeps the element being rendered and the next one,
+/// so memory is bounded by two elements whatever the length is.
+class Generator {
+ public:
+  virtual ~Generator() {}
+
+  /// Starts producing the elements from the first one. It is called
+  /// every time a loop over the generator begins, so generators which
+  /// cannot start again should throw a `std::runtime_error`.
+  virtual void Reset() = 0;
+
+  /// Produces the next element.
+  ///
+  /// @param element Where the element is stored. The renderer reuses
+  ///        the same strings, so their capacity is kept between calls.
+  /// @return `false` if there are no more elements.
+  virtual bool Next(std::string &element) = 0;
+
+  /// Returns the number of elements if it is known in advance, which
+  /// is required to print `@length` inside loops over the generator.
+  ///
+  /// @param size Where the number of elements is stored.
+  /// @return Whether the number of elements is known.
+  virtual bool Size(std::size_t &size) const { return false; }
+};
+
+/// A generator backed by a callback which produces the element with a
+/// given index, e.g. by formatting the row of a table.
+class FunctionGenerator : public Generator {
+ public:
+  /// Produces the element at `index` into `element`, returning `false`
+  /// when `index` is past the last element.
+  using Producer = std::function<bool(std::size_t index, std::string &element)>;
+
+  /// @param producer The callback, called with increasing indices from
+  ///        0 every time a loop begins.
+  FunctionGenerator(Producer producer);
+  ~FunctionGenerator() override {}
+
+  void Reset() override;
+  bool Next(std::string &element) override;
+
+ private:
+  Producer producer_;
+  std::size_t index_;
+};
+
+} // namespace yate
@@ -0,0 +1,279 @@
+#ifdef YATE_ZLIB
+
+#include "gzip_sink.hh"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <utility>
+
+namespace yate {
+
+namespace {
+
+/// Size of the buffer of compressed bytes of a sink.
+const std::size_t kBufferSize = 16 * 1024;
+
+/// The largest number of bytes zlib takes in one call.
+const std::size_t kMaxChunk = std::numeric_limits<uInt>::max();
+
+/// The window of raw deflate streams, the most their back references
+/// can reach.
+const std::size_t kWindowSize = 32 * 1024;
+
+/// Initializes a stream which produces raw deflate blocks, without
+/// any header or trailer.
+void InitRawDeflate(z_stream &stream, int level) {
+  std::memset(&stream, 0, sizeof(stream));
+  if (deflateInit2(&stream, level, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) !=
+      Z_OK) {
+    throw std::runtime_error("Cannot initialize the compression");
+  }
+}
+
+} // namespace
+
+CompressedLiterals::CompressedLiterals(
+    std::size_t min_size,
+    std::size_t max_bytes,
+    int level)
+    : min_size_(min_size),
+      max_bytes_(max_bytes),
+      level_(level),
+      mutex_(),
+      entries_(),
+      bytes_(0) {}
+
+std::shared_ptr<const CompressedLiterals::Entry> CompressedLiterals::Get(
+    const char *data,
+    std::size_t size) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  auto it = entries_.find(data);
+  if (it != entries_.end() && it->second->text.size() == size &&
+      std::memcmp(it->second->text.data(), data, size) == 0) {
+    return it->second;
+  }
+  if (size > kMaxChunk || bytes_ + size > max_bytes_) {
+    return nullptr;
+  }
+  lock.unlock();
+
+  // Compressed without holding the lock, if several threads compress
+  // the same literal the last one is kept.
+  auto entry = std::make_shared<Entry>();
+  entry->text.assign(data, size);
+  auto input = reinterpret_cast<const Bytef *>(data);
+  entry->crc32 = static_cast<std::uint32_t>(crc32_z(0, input, size));
+  entry->adler32 = static_cast<std::uint32_t>(adler32_z(1, input, size));
+  z_stream stream;
+  InitRawDeflate(stream, level_);
+  // The sync flush ends the blocks on a byte boundary without marking
+  // the last one as final.
+  entry->compressed.resize(deflateBound(&stream, size) + 16);
+  stream.next_in = const_cast<Bytef *>(input);
+  stream.avail_in = static_cast<uInt>(size);
+  stream.next_out = reinterpret_cast<Bytef *>(&entry->compressed[0]);
+  stream.avail_out = static_cast<uInt>(entry->compressed.size());
+  auto status = deflate(&stream, Z_SYNC_FLUSH);
+  auto produced = stream.total_out;
+  auto complete = stream.avail_in == 0 && stream.avail_out != 0;
+  deflateEnd(&stream);
+  if (status != Z_OK || !complete) {
+    throw std::runtime_error("Compression failed");
+  }
+  entry->compressed.resize(produced);
+  entry->compressed.shrink_to_fit();
+
+  lock.lock();
+  auto &slot = entries_[data];
+  if (slot != nullptr) {
+    bytes_ -= slot->text.size() + slot->compressed.size();
+  }
+  bytes_ += entry->text.size() + entry->compressed.size();
+  slot = entry;
+  return entry;
+}
+
+std::size_t CompressedLiterals::size() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return entries_.size();
+}
+
+GzipSink::GzipSink(
+    Sink &target,
+    int level,
+    Format format,
+    std::shared_ptr<CompressedLiterals> literals)
+    : target_(target),
+      format_(format),
+      literals_(std::move(literals)),
+      stream_(),
+      started_(false),
+      checksum_(0),
+      size_(0),
+      buffer_(new unsigned char[kBufferSize]),
+      pinned_(),
+      bytes_in_(0),
+      bytes_out_(0),
+      spliced_bytes_(0) {
+  InitRawDeflate(stream_, level);
+  stream_.next_out = buffer_.get();
+  stream_.avail_out = kBufferSize;
+}
+
+GzipSink::~GzipSink() {
+  deflateEnd(&stream_);
+}
+
+void GzipSink::Write(const char *data, std::size_t size) {
+  if (size == 0) {
+    return;
+  }
+  Begin();
+  auto input = reinterpret_cast<const Bytef *>(data);
+  checksum_ = static_cast<std::uint32_t>(
+      format_ == Format::eGzip ? crc32_z(checksum_, input, size)
+                               : adler32_z(checksum_, input, size));
+  size_ += size;
+  bytes_in_ += size;
+  Deflate(data, size, Z_NO_FLUSH);
+}
+
+void GzipSink::WriteStable(const char *data, std::size_t size) {
+  if (literals_ != nullptr && size >= literals_->min_size()) {
+    auto entry = literals_->Get(data, size);
+    if (entry != nullptr) {
+      Begin();
+      Splice(std::move(entry));
+      return;
+    }
+  }
+  Write(data, size);
+}
+
+void GzipSink::Flush() {
+  if (started_) {
+    Deflate(nullptr, 0, Z_FINISH);
+    unsigned char trailer[8];
+    std::size_t length = 0;
+    if (format_ == Format::eGzip) {
+      // Both little endian, the size modulo 2^32.
+      for (int i = 0; i < 4; ++i) {
+        trailer[length++] = static_cast<unsigned char>(checksum_ >> (8 * i));
+      }
+      for (int i = 0; i < 4; ++i) {
+        trailer[length++] = static_cast<unsigned char>(size_ >> (8 * i));
+      }
+    } else {
+      // Big endian.
+      for (int i = 3; i >= 0; --i) {
+        trailer[length++] = static_cast<unsigned char>(checksum_ >> (8 * i));
+      }
+    }
+    WriteRaw(trailer, length);
+    Drain();
+    deflateReset(&stream_);
+    started_ = false;
+  }
+  target_.Flush();
+  pinned_.clear();
+}
+
+void GzipSink::Begin() {
+  if (started_) {
+    return;
+  }
+  started_ = true;
+  size_ = 0;
+  if (format_ == Format::eGzip) {
+    // Deflate, no flags, no modification time, no extra flags, Unix.
+    const unsigned char header[] = {
+        0x1f, 0x8b, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x03};
+    checksum_ = static_cast<std::uint32_t>(crc32_z(0, Z_NULL, 0));
+    WriteRaw(header, sizeof(header));
+  } else {
+    // Deflate with a 32K window, default level.
+    const unsigned char header[] = {0x78, 0x9c};
+    checksum_ = static_cast<std::uint32_t>(adler32_z(0, Z_NULL, 0));
+    WriteRaw(header, sizeof(header));
+  }
+}
+
+void GzipSink::Deflate(const char *data, std::size_t size, int flush) {
+  stream_.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(data));
+  while (true) {
+    auto chunk = std::min(size, kMaxChunk);
+    stream_.avail_in = static_cast<uInt>(chunk);
+    size -= chunk;
+    // Once deflate leaves room in the buffer it has consumed the input
+    // and completed the flush.
+    do {
+      if (stream_.avail_out == 0) {
+        Drain();
+      }
+      if (deflate(&stream_, size == 0 ? flush : Z_NO_FLUSH) ==
+          Z_STREAM_ERROR) {
+        throw std::runtime_error("Compression failed");
+      }
+    } while (stream_.avail_out == 0);
+    if (size == 0) {
+      return;
+    }
+  }
+}
+
+void GzipSink::Drain() {
+  auto size = kBufferSize - stream_.avail_out;
+  if (size != 0) {
+    target_.Write(reinterpret_cast<const char *>(buffer_.get()), size);
+    bytes_out_ += size;
+  }
+  stream_.next_out = buffer_.get();
+  stream_.avail_out = kBufferSize;
+}
+
+void GzipSink::Splice(std::shared_ptr<const CompressedLiterals::Entry> entry) {
+  // Aligns the stream to a byte boundary after the pending data, which
+  // is written before the cached blocks.
+  Deflate(nullptr, 0, Z_SYNC_FLUSH);
+  Drain();
+  const auto &text = entry->text;
+  const auto &compressed = entry->compressed;
+  target_.WriteStable(compressed.data(), compressed.size());
+  bytes_out_ += compressed.size();
+  bytes_in_ += text.size();
+  spliced_bytes_ += text.size();
+  size_ += text.size();
+  auto length = static_cast<z_off_t>(text.size());
+  checksum_ = static_cast<std::uint32_t>(
+      format_ == Format::eGzip
+          ? crc32_combine(checksum_, entry->crc32, length)
+          : adler32_combine(checksum_, entry->adler32, length));
+  // The decompressor sees the literal before the following data, so
+  // it becomes their history.
+  auto window = std::min(text.size(), kWindowSize);
+  deflateSetDictionary(
+      &stream_,
+      reinterpret_cast<const Bytef *>(text.data() + text.size() - window),
+      static_cast<uInt>(window));
+  pinned_.push_back(std::move(entry));
+}
+
+void GzipSink::WriteRaw(const unsigned char *data, std::size_t size) {
+  while (size > 0) {
+    if (stream_.avail_out == 0) {
+      Drain();
+    }
+    auto chunk = std::min<std::size_t>(size, stream_.avail_out);
+    std::memcpy(stream_.next_out, data, chunk);
+    stream_.next_out += chunk;
+    stream_.avail_out -= static_cast<uInt>(chunk);
+    data += chunk;
+    size -= chunk;
+  }
+}
+
+} // namespace yate
+
+#endif // YATE_ZLIB
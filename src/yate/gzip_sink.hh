@@ -0,0 +1,164 @@
+#pragma once
+
+#ifdef YATE_ZLIB
+
+#include "sink.hh"
+
+#include <zlib.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace yate {
+
+/// The compressed form of the long literals of templates, shared by
+/// the `GzipSink`s which compress their output. Each literal is
+/// compressed once, on its own, and spliced into every response which
+/// contains it, so the per-response work is a copy instead of running
+/// deflate over the same bytes again. It is safe to use from several
+/// threads.
+class CompressedLiterals {
+ public:
+  /// A literal and its compressed form.
+  struct Entry {
+    std::string text;
+    /// Raw deflate blocks which are not final and end on a byte
+    /// boundary, so they can be spliced into any deflate stream.
+    std::string compressed;
+    /// The checksums of `text` for the gzip and zlib trailers.
+    std::uint32_t crc32;
+    std::uint32_t adler32;
+  };
+
+  /// @param min_size Shorter writes are compressed with the rest of
+  ///        the output, since splicing costs a few bytes.
+  /// @param max_bytes Literals are no longer added once the text and
+  ///        compressed form of the cached ones take this many bytes,
+  ///        which bounds the memory taken by long values which are
+  ///        written only once.
+  /// @param level The zlib compression level of the literals.
+  CompressedLiterals(
+      std::size_t min_size = 1024,
+      std::size_t max_bytes = 64 << 20,
+      int level = Z_DEFAULT_COMPRESSION);
+  ~CompressedLiterals() {}
+
+  // Not copyable nor movable.
+  CompressedLiterals(const CompressedLiterals &) = delete;
+  CompressedLiterals &operator=(const CompressedLiterals &) = delete;
+
+  /// Finds the compressed form of the bytes given to
+  /// `Sink::WriteStable()`, compressing them if they are not cached
+  /// yet. Literals are found by address and checked byte by byte, so
+  /// a template freed and replaced at the same address never gets the
+  /// output of the previous one.
+  ///
+  /// @param data The bytes written.
+  /// @param size The number of bytes, at least `min_size()`.
+  /// @return The entry or `nullptr` if the cache is full.
+  std::shared_ptr<const Entry> Get(const char *data, std::size_t size);
+
+  std::size_t min_size() const { return min_size_; }
+
+  /// @return The number of literals cached.
+  std::size_t size() const;
+
+ private:
+  std::size_t min_size_;
+  std::size_t max_bytes_;
+  int level_;
+  mutable std::mutex mutex_;
+  std::unordered_map<const char *, std::shared_ptr<const Entry>> entries_;
+  std::size_t bytes_;
+};
+
+/// Sink which compresses the output as it is rendered and writes the
+/// compressed bytes to another sink, in the gzip or zlib format used
+/// by the `gzip` and `deflate` HTTP content codings.
+///
+/// With `CompressedLiterals`, long stable writes (the literals of the
+/// template) are not compressed again: the stream is flushed to a byte
+/// boundary with `Z_SYNC_FLUSH`, the cached blocks are written as they
+/// are and the literal becomes the dictionary of the following data,
+/// so later back references still reach it. The checksums are
+/// combined from the cached ones.
+///
+/// `Flush()` ends the compressed stream and flushes the target. The
+/// following writes start a new stream, which for gzip is a valid
+/// continuation of the same file.
+class GzipSink : public Sink {
+ public:
+  enum class Format {
+    eGzip = 0,    /// RFC 1952, the `gzip` content coding.
+    eDeflate = 1  /// RFC 1950, the `deflate` content coding.
+  };
+
+  /// @param target The sink where the compressed output is written.
+  /// @param level The zlib compression level.
+  /// @param format The container of the compressed data.
+  /// @param literals The cache of compressed literals, may be
+  ///        `nullptr`.
+  GzipSink(
+      Sink &target,
+      int level = Z_DEFAULT_COMPRESSION,
+      Format format = Format::eGzip,
+      std::shared_ptr<CompressedLiterals> literals = nullptr);
+  ~GzipSink();
+
+  // Not copyable nor movable.
+  GzipSink(const GzipSink &) = delete;
+  GzipSink &operator=(const GzipSink &) = delete;
+
+  void Write(const char *data, std::size_t size) override;
+  void WriteStable(const char *data, std::size_t size) override;
+  void Flush() override;
+
+  // Metrics.
+  std::uint64_t bytes_in() const { return bytes_in_; }
+  std::uint64_t bytes_out() const { return bytes_out_; }
+  std::uint64_t spliced_bytes() const { return spliced_bytes_; }
+
+ private:
+  /// Writes the header of the stream if nothing was written since the
+  /// last flush.
+  void Begin();
+
+  /// Runs deflate over the given bytes, which may be empty.
+  ///
+  /// @param flush The zlib flush mode.
+  void Deflate(const char *data, std::size_t size, int flush);
+
+  /// Writes the compressed bytes of the buffer to the target.
+  void Drain();
+
+  /// Writes a cached literal in place of compressing it.
+  void Splice(std::shared_ptr<const CompressedLiterals::Entry> entry);
+
+  /// Writes bytes which are not compressed, e.g. headers, through the
+  /// buffer.
+  void WriteRaw(const unsigned char *data, std::size_t size);
+
+  Sink &target_;
+  Format format_;
+  std::shared_ptr<CompressedLiterals> literals_;
+  z_stream stream_;
+  bool started_;
+  std::uint32_t checksum_;
+  /// The uncompressed bytes of the current stream.
+  std::uint64_t size_;
+  std::unique_ptr<unsigned char[]> buffer_;
+  /// Spliced literals, kept alive until the target is flushed.
+  std::vector<std::shared_ptr<const CompressedLiterals::Entry>> pinned_;
+  std::uint64_t bytes_in_;
+  std::uint64_t bytes_out_;
+  std::uint64_t spliced_bytes_;
+};
+
+} // namespace yate
+
+#endif // YATE_ZLIB
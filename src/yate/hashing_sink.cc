@@ -0,0 +1,309 @@
+#include "hashing_sink.hh"
+
+#include <algorithm>
+#include <cstring>
+
+namespace yate {
+
+namespace {
+
+const std::uint64_t kPrime1 = 0x9e3779b185ebca87ull;
+const std::uint64_t kPrime2 = 0xc2b2ae3d27d4eb4full;
+const std::uint64_t kPrime3 = 0x165667b19e3779f9ull;
+const std::uint64_t kPrime4 = 0x85ebca77c2b2ae63ull;
+const std::uint64_t kPrime5 = 0x27d4eb2f165667c5ull;
+
+const std::uint32_t kSha256Initial[8] = {
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+    0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
+
+const std::uint32_t kSha256Rounds[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1,
+    0x923f82a4, 0xab1c5ed5, 0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+    0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174, 0xe49b69c1, 0xefbe4786,
+    0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147,
+    0x06ca6351, 0x14292967, 0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+    0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85, 0xa2bfe8a1, 0xa81a664b,
+    0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a,
+    0x5b9cca4f, 0x682e6ff3, 0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+    0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2};
+
+std::uint64_t RotateLeft(std::uint64_t value, int bits) {
+  return (value << bits) | (value >> (64 - bits));
+}
+
+std::uint32_t RotateRight(std::uint32_t value, int bits) {
+  return (value >> bits) | (value << (32 - bits));
+}
+
+/// Reads little endian words, which compilers turn into plain loads
+/// on little endian hosts.
+std::uint64_t Read64(const unsigned char *data) {
+  std::uint64_t value = 0;
+  for (int i = 7; i >= 0; --i) {
+    value = (value << 8) | data[i];
+  }
+  return value;
+}
+
+std::uint32_t Read32(const unsigned char *data) {
+  std::uint32_t value = 0;
+  for (int i = 3; i >= 0; --i) {
+    value = (value << 8) | data[i];
+  }
+  return value;
+}
+
+std::uint64_t Round(std::uint64_t lane, std::uint64_t input) {
+  lane += input * kPrime2;
+  return RotateLeft(lane, 31) * kPrime1;
+}
+
+std::uint64_t MergeRound(std::uint64_t hash, std::uint64_t lane) {
+  hash ^= Round(0, lane);
+  return hash * kPrime1 + kPrime4;
+}
+
+/// Runs XXH64 over whole 32 byte stripes.
+void HashStripes(
+    std::uint64_t lanes[4],
+    const unsigned char *data,
+    std::size_t stripes) {
+  auto lane0 = lanes[0];
+  auto lane1 = lanes[1];
+  auto lane2 = lanes[2];
+  auto lane3 = lanes[3];
+  for (std::size_t i = 0; i < stripes; ++i, data += 32) {
+    lane0 = Round(lane0, Read64(data));
+    lane1 = Round(lane1, Read64(data + 8));
+    lane2 = Round(lane2, Read64(data + 16));
+    lane3 = Round(lane3, Read64(data + 24));
+  }
+  lanes[0] = lane0;
+  lanes[1] = lane1;
+  lanes[2] = lane2;
+  lanes[3] = lane3;
+}
+
+} // namespace
+
+HashingSink::HashingSink(bool sha256)
+    : target_(nullptr), sha256_(sha256), size_(0) {
+  Reset();
+}
+
+HashingSink::HashingSink(Sink &target, bool sha256)
+    : target_(&target), sha256_(sha256), size_(0) {
+  Reset();
+}
+
+void HashingSink::Write(const char *data, std::size_t size) {
+  Hash(data, size);
+  if (target_ != nullptr) {
+    target_->Write(data, size);
+  }
+}
+
+void HashingSink::WriteStable(const char *data, std::size_t size) {
+  Hash(data, size);
+  if (target_ != nullptr) {
+    target_->WriteStable(data, size);
+  }
+}
+
+void HashingSink::Flush() {
+  if (target_ != nullptr) {
+    target_->Flush();
+  }
+}
+
+void HashingSink::Reset() {
+  size_ = 0;
+  // The seed is zero.
+  lanes_[0] = kPrime1 + kPrime2;
+  lanes_[1] = kPrime2;
+  lanes_[2] = 0;
+  lanes_[3] = 0 - kPrime1;
+  std::memcpy(state_, kSha256Initial, sizeof(state_));
+}
+
+void HashingSink::Hash(const char *data, std::size_t size) {
+  auto input = reinterpret_cast<const unsigned char *>(data);
+  auto pending = static_cast<std::size_t>(size_ % 32);
+  auto sha256_pending = static_cast<std::size_t>(size_ % 64);
+  size_ += size;
+
+  // XXH64 works on stripes of 32 bytes, the partial ones are completed
+  // with the following writes.
+  auto remaining = size;
+  auto next = input;
+  if (pending != 0) {
+    auto fill = std::min<std::size_t>(32 - pending, remaining);
+    std::memcpy(stripe_ + pending, next, fill);
+    next += fill;
+    remaining -= fill;
+    if (pending + fill == 32) {
+      HashStripes(lanes_, stripe_, 1);
+    }
+  }
+  if (pending == 0 || pending + size >= 32) {
+    HashStripes(lanes_, next, remaining / 32);
+    std::memcpy(stripe_, next + remaining / 32 * 32, remaining % 32);
+  }
+
+  if (!sha256_) {
+    return;
+  }
+  remaining = size;
+  next = input;
+  if (sha256_pending != 0) {
+    auto fill = std::min<std::size_t>(64 - sha256_pending, remaining);
+    std::memcpy(block_ + sha256_pending, next, fill);
+    next += fill;
+    remaining -= fill;
+    if (sha256_pending + fill < 64) {
+      return;
+    }
+    Sha256Blocks(block_, 1);
+  }
+  Sha256Blocks(next, remaining / 64);
+  std::memcpy(block_, next + remaining / 64 * 64, remaining % 64);
+}
+
+std::uint64_t HashingSink::hash() const {
+  std::uint64_t hash = 0;
+  if (size_ >= 32) {
+    hash = RotateLeft(lanes_[0], 1) + RotateLeft(lanes_[1], 7) +
+        RotateLeft(lanes_[2], 12) + RotateLeft(lanes_[3], 18);
+    for (auto lane : lanes_) {
+      hash = MergeRound(hash, lane);
+    }
+  } else {
+    hash = kPrime5;
+  }
+  hash += size_;
+
+  auto data = stripe_;
+  auto end = stripe_ + size_ % 32;
+  for (; data + 8 <= end; data += 8) {
+    hash ^= Round(0, Read64(data));
+    hash = RotateLeft(hash, 27) * kPrime1 + kPrime4;
+  }
+  if (data + 4 <= end) {
+    hash ^= static_cast<std::uint64_t>(Read32(data)) * kPrime1;
+    hash = RotateLeft(hash, 23) * kPrime2 + kPrime3;
+    data += 4;
+  }
+  for (; data < end; ++data) {
+    hash ^= *data * kPrime5;
+    hash = RotateLeft(hash, 11) * kPrime1;
+  }
+
+  hash ^= hash >> 33;
+  hash *= kPrime2;
+  hash ^= hash >> 29;
+  hash *= kPrime3;
+  hash ^= hash >> 32;
+  return hash;
+}
+
+std::string HashingSink::sha256() const {
+  if (!sha256_) {
+    return "";
+  }
+  // The padding is hashed by a copy, so more bytes can be written
+  // afterwards.
+  HashingSink copy(true);
+  std::memcpy(copy.state_, state_, sizeof(state_));
+  auto pending = static_cast<std::size_t>(size_ % 64);
+  unsigned char padding[128] = {0};
+  std::memcpy(padding, block_, pending);
+  padding[pending] = 0x80;
+  auto length = pending < 56 ? 64 : 128;
+  auto bits = size_ * 8;
+  for (int i = 0; i < 8; ++i) {
+    padding[length - 1 - i] = static_cast<unsigned char>(bits >> (8 * i));
+  }
+  copy.Sha256Blocks(padding, length / 64);
+
+  static const char kDigits[] = "0123456789abcdef";
+  std::string digest;
+  digest.reserve(64);
+  for (auto word : copy.state_) {
+    for (int shift = 28; shift >= 0; shift -= 4) {
+      digest += kDigits[(word >> shift) & 0xf];
+    }
+  }
+  return digest;
+}
+
+std::string HashingSink::ETag() const {
+  if (sha256_) {
+    return '"' + sha256() + '"';
+  }
+  static const char kDigits[] = "0123456789abcdef";
+  auto value = hash();
+  std::string tag(18, '"');
+  for (int i = 16; i >= 1; --i, value >>= 4) {
+    tag[i] = kDigits[value & 0xf];
+  }
+  return tag;
+}
+
+void HashingSink::Sha256Blocks(
+    const unsigned char *data,
+    std::size_t blocks) {
+  for (std::size_t block = 0; block < blocks; ++block, data += 64) {
+    std::uint32_t words[64];
+    for (int i = 0; i < 16; ++i) {
+      words[i] = static_cast<std::uint32_t>(data[4 * i]) << 24 |
+          static_cast<std::uint32_t>(data[4 * i + 1]) << 16 |
+          static_cast<std::uint32_t>(data[4 * i + 2]) << 8 |
+          static_cast<std::uint32_t>(data[4 * i + 3]);
+    }
+    for (int i = 16; i < 64; ++i) {
+      auto s0 = RotateRight(words[i - 15], 7) ^
+          RotateRight(words[i - 15], 18) ^ (words[i - 15] >> 3);
+      auto s1 = RotateRight(words[i - 2], 17) ^
+          RotateRight(words[i - 2], 19) ^ (words[i - 2] >> 10);
+      words[i] = words[i - 16] + s0 + words[i - 7] + s1;
+    }
+
+    auto a = state_[0];
+    auto b = state_[1];
+    auto c = state_[2];
+    auto d = state_[3];
+    auto e = state_[4];
+    auto f = state_[5];
+    auto g = state_[6];
+    auto h = state_[7];
+    for (int i = 0; i < 64; ++i) {
+      auto s1 = RotateRight(e, 6) ^ RotateRight(e, 11) ^ RotateRight(e, 25);
+      auto choice = (e & f) ^ (~e & g);
+      auto t1 = h + s1 + choice + kSha256Rounds[i] + words[i];
+      auto s0 = RotateRight(a, 2) ^ RotateRight(a, 13) ^ RotateRight(a, 22);
+      auto majority = (a & b) ^ (a & c) ^ (b & c);
+      auto t2 = s0 + majority;
+      h = g;
+      g = f;
+      f = e;
+      e = d + t1;
+      d = c;
+      c = b;
+      b = a;
+      a = t1 + t2;
+    }
+    state_[0] += a;
+    state_[1] += b;
+    state_[2] += c;
+    state_[3] += d;
+    state_[4] += e;
+    state_[5] += f;
+    state_[6] += g;
+    state_[7] += h;
+  }
+}
+
+} // namespace yate
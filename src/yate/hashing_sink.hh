@@ -0,0 +1,83 @@
+#pragma once
+
+#include "sink.hh"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace yate {
+
+/// Sink which hashes the output as it is rendered, e.g. to compute the
+/// entity tag of a response. It either passes the bytes on to another
+/// sink, so the output is hashed while it is sent, or drops them, so
+/// the hash of a page is known without holding its body, enough to
+/// answer a conditional request with `304 Not Modified`. Hashing
+/// allocates nothing.
+///
+/// The output is always hashed with XXH64, a fast non-cryptographic
+/// hash, and optionally with SHA-256. Both only depend on the bytes
+/// written, not on how they are split among the calls.
+class HashingSink : public Sink {
+ public:
+  /// Hashes the output without writing it anywhere.
+  ///
+  /// @param sha256 Whether to compute the SHA-256 digest too.
+  HashingSink(bool sha256 = false);
+
+  /// Hashes the output while writing it to `target`.
+  ///
+  /// @param target The sink where the output is written. Stable
+  ///        writes stay stable and flushes are passed on.
+  /// @param sha256 Whether to compute the SHA-256 digest too.
+  HashingSink(Sink &target, bool sha256 = false);
+  ~HashingSink() {}
+
+  // Not copyable nor movable.
+  HashingSink(const HashingSink &) = delete;
+  HashingSink &operator=(const HashingSink &) = delete;
+
+  void Write(const char *data, std::size_t size) override;
+  void WriteStable(const char *data, std::size_t size) override;
+  void Flush() override;
+
+  /// Forgets the bytes hashed so far, e.g. between responses.
+  void Reset();
+
+  /// @return The XXH64 hash of the bytes written since the sink was
+  ///         constructed or reset. It can be read at any time.
+  std::uint64_t hash() const;
+
+  /// @return The SHA-256 digest of the same bytes as 64 lowercase
+  ///         hexadecimal digits, or an empty string if it is not
+  ///         computed.
+  std::string sha256() const;
+
+  /// @return A strong entity tag for the output, quoted as required
+  ///         by the `ETag` header: the SHA-256 digest if it is
+  ///         computed, otherwise the XXH64 hash.
+  std::string ETag() const;
+
+  /// @return The number of bytes written.
+  std::uint64_t size() const { return size_; }
+
+ private:
+  /// Adds bytes to both hashes.
+  void Hash(const char *data, std::size_t size);
+
+  /// Processes the 64 byte blocks of SHA-256.
+  void Sha256Blocks(const unsigned char *data, std::size_t blocks);
+
+  Sink *target_;
+  bool sha256_;
+  std::uint64_t size_;
+  /// The state of XXH64, its four lanes and the bytes which do not
+  /// fill a 32 byte stripe yet.
+  std::uint64_t lanes_[4];
+  unsigned char stripe_[32];
+  /// The state of SHA-256 and the bytes which do not fill a block yet.
+  std::uint32_t state_[8];
+  unsigned char block_[64];
+};
+
+} // namespace yate
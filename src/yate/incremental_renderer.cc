@@ -0,0 +1,145 @@
+#include "incremental_renderer.hh"
+
+#include <algorithm>
+#include <string>
+
+namespace yate {
+
+IncrementalRenderer::IncrementalRenderer(
+    const Template &tmpl,
+    std::unordered_map<std::string, std::string> printable_values,
+    std::unordered_map<std::string, std::vector<std::string>> iterable_values)
+    : template_(tmpl),
+      renderer_(std::move(printable_values), std::move(iterable_values)),
+      segments_(),
+      value_readers_(),
+      array_readers_() {
+  const auto &nodes = template_.nodes();
+  for (std::size_t i = 0; i < nodes.size(); ++i) {
+    const auto &node = nodes[i];
+    auto segment = segments_.size();
+    segments_.push_back({i, ""});
+    switch (node.kind) {
+      case Template::Node::Kind::eLiteral:
+        break;
+      case Template::Node::Kind::eValue:
+        value_readers_[node.text].push_back(segment);
+        break;
+      case Template::Node::Kind::eLoopBegin:
+      case Template::Node::Kind::eIfBegin:
+        AddReaders(*template_.section_dependencies(i), segment);
+        i = template_.SectionEnd(i);
+        break;
+      case Template::Node::Kind::eInclude:
+        AddReaders(template_.CollectDependencies(i, i + 1), segment);
+        break;
+      case Template::Node::Kind::eLoopEnd:
+      case Template::Node::Kind::eElse:
+      case Template::Node::Kind::eIfEnd:
+        // UNREACHABLE, sections are skipped as a whole.
+        break;
+    }
+    RenderSegment(segments_.back());
+  }
+}
+
+std::string IncrementalRenderer::output() const {
+  std::size_t size = 0;
+  for (const auto &segment : segments_) {
+    size += Text(segment).size();
+  }
+  std::string result;
+  result.reserve(size);
+  for (const auto &segment : segments_) {
+    result += Text(segment);
+  }
+  return result;
+}
+
+std::vector<IncrementalRenderer::Patch> IncrementalRenderer::Update(
+    std::unordered_map<std::string, std::string> printable_values,
+    std::unordered_map<std::string, std::vector<std::string>>
+        iterable_values) {
+  std::vector<std::size_t> affected;
+  for (auto &value : printable_values) {
+    auto readers = value_readers_.find(value.first);
+    if (readers != value_readers_.end()) {
+      affected.insert(
+          affected.end(), readers->second.begin(), readers->second.end());
+    }
+    renderer_.SetValue(value.first, std::move(value.second));
+  }
+  for (auto &array : iterable_values) {
+    auto readers = array_readers_.find(array.first);
+    if (readers != array_readers_.end()) {
+      affected.insert(
+          affected.end(), readers->second.begin(), readers->second.end());
+    }
+    renderer_.SetIterable(array.first, std::move(array.second));
+  }
+  std::sort(affected.begin(), affected.end());
+  affected.erase(std::unique(affected.begin(), affected.end()), affected.end());
+
+  // Offsets are computed walking the segments once, only the affected
+  // ones are rendered.
+  std::vector<Patch> patches;
+  std::size_t offset = 0;
+  std::size_t segment = 0;
+  for (auto index : affected) {
+    for (; segment < index; ++segment) {
+      offset += Text(segments_[segment]).size();
+    }
+    auto &current = segments_[index];
+    auto previous = std::move(current.text);
+    RenderSegment(current);
+    if (current.text != previous) {
+      patches.push_back({offset, previous.size(), current.text});
+    }
+    offset += previous.size();
+    ++segment;
+  }
+  return patches;
+}
+
+void IncrementalRenderer::Apply(
+    const std::vector<Patch> &patches,
+    std::string &output) {
+  for (auto it = patches.rbegin(); it != patches.rend(); ++it) {
+    output.replace(it->offset, it->length, it->text);
+  }
+}
+
+void IncrementalRenderer::AddReaders(
+    const Template::Dependencies &dependencies,
+    std::size_t segment) {
+  for (const auto &value : dependencies.values) {
+    value_readers_[value].push_back(segment);
+  }
+  for (const auto &array : dependencies.arrays) {
+    array_readers_[array].push_back(segment);
+  }
+  // A condition may test either a value or an array.
+  for (const auto &condition : dependencies.conditions) {
+    value_readers_[condition].push_back(segment);
+    array_readers_[condition].push_back(segment);
+  }
+}
+
+const std::string &IncrementalRenderer::Text(const Segment &segment) const {
+  const auto &node = template_.nodes()[segment.node];
+  if (node.kind == Template::Node::Kind::eLiteral) {
+    return node.text;
+  }
+  return segment.text;
+}
+
+void IncrementalRenderer::RenderSegment(Segment &segment) {
+  if (template_.nodes()[segment.node].kind == Template::Node::Kind::eLiteral) {
+    return;
+  }
+  segment.text.clear();
+  StringSink output(segment.text);
+  renderer_.RenderNode(template_, segment.node, output);
+}
+
+} // namespace yate
@@ -0,0 +1,95 @@
+#pragma once
+
+#include "renderer.hh"
+#include "template.hh"
+
+#include <cstddef>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace yate {
+
+/// Keeps the rendered output of a compiled template as a list of
+/// segments, one per top-level construct of the template, and the
+/// symbols each segment depends on. When some symbols change, only
+/// the segments which read them are rendered again, so the cost of an
+/// update is proportional to what changed instead of to the whole
+/// output.
+class IncrementalRenderer {
+ public:
+  /// A change to the output. The bytes in the range
+  /// [offset, offset + length) of the previous output are replaced by
+  /// `text`.
+  struct Patch {
+    std::size_t offset;
+    std::size_t length;
+    std::string text;
+  };
+
+  /// Renders the whole template for the first time.
+  ///
+  /// @param tmpl The compiled template, it must outlive this object.
+  /// @param printable_values The initial printable symbols.
+  /// @param iterable_values The initial arrays.
+  IncrementalRenderer(
+      const Template &tmpl,
+      std::unordered_map<std::string, std::string> printable_values,
+      std::unordered_map<std::string, std::vector<std::string>>
+          iterable_values);
+  ~IncrementalRenderer() {}
+
+  /// @return The current output, built by concatenating the segments.
+  std::string output() const;
+
+  /// Replaces the given symbols and renders again the segments which
+  /// depend on any of them.
+  ///
+  /// @param printable_values The printable symbols which changed.
+  /// @param iterable_values The arrays which changed.
+  /// @return The patches which turn the previous output into the new
+  ///        one. They are sorted by offset, do not overlap and their
+  ///        offsets refer to the previous output, so they can be
+  ///        applied from the last one to the first one.
+  std::vector<Patch> Update(
+      std::unordered_map<std::string, std::string> printable_values,
+      std::unordered_map<std::string, std::vector<std::string>>
+          iterable_values);
+
+  /// Applies the patches returned by `Update()` to a copy of the
+  /// previous output.
+  ///
+  /// @param patches The patches, sorted by offset.
+  /// @param output The previous output, updated in place.
+  static void Apply(const std::vector<Patch> &patches, std::string &output);
+
+ private:
+  struct Segment {
+    /// The index of the top-level node which produced the segment.
+    std::size_t node;
+    /// The rendered output, empty for literals which are taken from
+    /// the template directly.
+    std::string text;
+  };
+
+  /// Registers a segment as a reader of the given symbols.
+  void AddReaders(
+      const Template::Dependencies &dependencies,
+      std::size_t segment);
+
+  /// @return The current text of the given segment.
+  const std::string &Text(const Segment &segment) const;
+
+  /// Renders the segment again and stores its output.
+  void RenderSegment(Segment &segment);
+
+  const Template &template_;
+  Renderer renderer_;
+  std::vector<Segment> segments_;
+  /// For every symbol, the segments which depend on it. Values and
+  /// arrays are kept apart since they can share names.
+  std::unordered_map<std::string, std::vector<std::size_t>> value_readers_;
+  std::unordered_map<std::string, std::vector<std::size_t>> array_readers_;
+};
+
+} // namespace yate
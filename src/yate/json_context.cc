@@ -0,0 +1,285 @@
+#include "json_context.hh"
+
+#include <cstdint>
+#include <stdexcept>
+#include <utility>
+
+namespace yate {
+
+namespace {
+
+/// Recursive descent parser of the subset of JSON which maps onto the
+/// symbols of a render.
+class JsonParser {
+ public:
+  JsonParser(const std::string &text) : text_(text), position_(0) {}
+  ~JsonParser() {}
+
+  JsonContext Parse() {
+    JsonContext context;
+    SkipWhitespace();
+    Expect('{');
+    SkipWhitespace();
+    if (!Accept('}')) {
+      do {
+        SkipWhitespace();
+        auto key = ParseString();
+        SkipWhitespace();
+        Expect(':');
+        SkipWhitespace();
+        if (Accept('[')) {
+          context.values.erase(key);
+          context.arrays[key] = ParseArray();
+        } else {
+          context.arrays.erase(key);
+          context.values[key] = ParseScalar();
+        }
+        SkipWhitespace();
+      } while (Accept(','));
+      Expect('}');
+    }
+    SkipWhitespace();
+    if (position_ != text_.size()) {
+      Fail("Unexpected text after the object");
+    }
+    return context;
+  }
+
+ private:
+  /// Parses the elements of an array, after its opening bracket.
+  std::vector<std::string> ParseArray() {
+    std::vector<std::string> elements;
+    SkipWhitespace();
+    if (Accept(']')) {
+      return elements;
+    }
+    do {
+      SkipWhitespace();
+      elements.push_back(ParseScalar());
+      SkipWhitespace();
+    } while (Accept(','));
+    Expect(']');
+    return elements;
+  }
+
+  /// Parses a string, number, boolean or null as the text of a value.
+  std::string ParseScalar() {
+    if (position_ == text_.size()) {
+      Fail("Expected a value");
+    }
+    switch (text_[position_]) {
+      case '"':
+        return ParseString();
+      case '{':
+        Fail("Nested objects are not supported");
+      case '[':
+        Fail("Nested arrays are not supported");
+      case 't':
+        ExpectWord("true");
+        return "true";
+      case 'f':
+        ExpectWord("false");
+        return "";
+      case 'n':
+        ExpectWord("null");
+        return "";
+      default:
+        return ParseNumber();
+    }
+  }
+
+  /// Parses a number, which keeps the text it is written with.
+  std::string ParseNumber() {
+    auto begin = position_;
+    Accept('-');
+    // Leading zeros are not allowed.
+    if (!Accept('0') && !AcceptDigits()) {
+      Fail("Expected a value");
+    }
+    if (Accept('.') && !AcceptDigits()) {
+      Fail("Expected digits after the decimal point");
+    }
+    if (Accept('e') || Accept('E')) {
+      if (!Accept('+')) {
+        Accept('-');
+      }
+      if (!AcceptDigits()) {
+        Fail("Expected digits in the exponent");
+      }
+    }
+    return text_.substr(begin, position_ - begin);
+  }
+
+  /// Parses a string, decoding its escape sequences into UTF-8.
+  std::string ParseString() {
+    Expect('"');
+    std::string result;
+    while (true) {
+      if (position_ == text_.size()) {
+        Fail("Unterminated string");
+      }
+      auto ch = text_[position_++];
+      if (ch == '"') {
+        return result;
+      }
+      if (static_cast<unsigned char>(ch) < 0x20) {
+        Fail("Control character in string");
+      }
+      if (ch != '\\') {
+        result += ch;
+        continue;
+      }
+      if (position_ == text_.size()) {
+        Fail("Unterminated string");
+      }
+      switch (text_[position_++]) {
+        case '"':
+          result += '"';
+          break;
+        case '\\':
+          result += '\\';
+          break;
+        case '/':
+          result += '/';
+          break;
+        case 'b':
+          result += '\b';
+          break;
+        case 'f':
+          result += '\f';
+          break;
+        case 'n':
+          result += '\n';
+          break;
+        case 'r':
+          result += '\r';
+          break;
+        case 't':
+          result += '\t';
+          break;
+        case 'u':
+          AppendCodePoint(ParseCodePoint(), result);
+          break;
+        default:
+          --position_;
+          Fail("Invalid escape sequence");
+      }
+    }
+  }
+
+  /// Parses the digits of a `\u` escape, joining surrogate pairs.
+  std::uint32_t ParseCodePoint() {
+    auto code_point = ParseHex();
+    if (code_point >= 0xdc00 && code_point <= 0xdfff) {
+      Fail("Unpaired surrogate");
+    }
+    if (code_point >= 0xd800 && code_point <= 0xdbff) {
+      if (text_.compare(position_, 2, "\\u") != 0) {
+        Fail("Unpaired surrogate");
+      }
+      position_ += 2;
+      auto low = ParseHex();
+      if (low < 0xdc00 || low > 0xdfff) {
+        Fail("Unpaired surrogate");
+      }
+      code_point = 0x10000 + ((code_point - 0xd800) << 10) + (low - 0xdc00);
+    }
+    return code_point;
+  }
+
+  std::uint32_t ParseHex() {
+    std::uint32_t value = 0;
+    for (int i = 0; i < 4; ++i) {
+      if (position_ == text_.size()) {
+        Fail("Unterminated string");
+      }
+      auto ch = text_[position_];
+      value <<= 4;
+      if (ch >= '0' && ch <= '9') {
+        value |= static_cast<std::uint32_t>(ch - '0');
+      } else if (ch >= 'a' && ch <= 'f') {
+        value |= static_cast<std::uint32_t>(ch - 'a' + 10);
+      } else if (ch >= 'A' && ch <= 'F') {
+        value |= static_cast<std::uint32_t>(ch - 'A' + 10);
+      } else {
+        Fail("Invalid escape sequence");
+      }
+      ++position_;
+    }
+    return value;
+  }
+
+  static void AppendCodePoint(std::uint32_t code_point, std::string &output) {
+    if (code_point < 0x80) {
+      output += static_cast<char>(code_point);
+    } else if (code_point < 0x800) {
+      output += static_cast<char>(0xc0 | (code_point >> 6));
+      output += static_cast<char>(0x80 | (code_point & 0x3f));
+    } else if (code_point < 0x10000) {
+      output += static_cast<char>(0xe0 | (code_point >> 12));
+      output += static_cast<char>(0x80 | ((code_point >> 6) & 0x3f));
+      output += static_cast<char>(0x80 | (code_point & 0x3f));
+    } else {
+      output += static_cast<char>(0xf0 | (code_point >> 18));
+      output += static_cast<char>(0x80 | ((code_point >> 12) & 0x3f));
+      output += static_cast<char>(0x80 | ((code_point >> 6) & 0x3f));
+      output += static_cast<char>(0x80 | (code_point & 0x3f));
+    }
+  }
+
+  void SkipWhitespace() {
+    while (position_ < text_.size() &&
+           (text_[position_] == ' ' || text_[position_] == '\t' ||
+            text_[position_] == '\n' || text_[position_] == '\r')) {
+      ++position_;
+    }
+  }
+
+  bool Accept(char ch) {
+    if (position_ < text_.size() && text_[position_] == ch) {
+      ++position_;
+      return true;
+    }
+    return false;
+  }
+
+  bool AcceptDigits() {
+    auto begin = position_;
+    while (position_ < text_.size() && text_[position_] >= '0' &&
+           text_[position_] <= '9') {
+      ++position_;
+    }
+    return position_ != begin;
+  }
+
+  void Expect(char ch) {
+    if (!Accept(ch)) {
+      Fail(std::string("Expected '") + ch + "'");
+    }
+  }
+
+  void ExpectWord(const char *word) {
+    std::string expected(word);
+    if (text_.compare(position_, expected.size(), expected) != 0) {
+      Fail("Expected a value");
+    }
+    position_ += expected.size();
+  }
+
+  [[noreturn]] void Fail(const std::string &message) const {
+    throw std::runtime_error(
+        "Invalid JSON at column " + std::to_string(position_ + 1) + ": " +
+        message);
+  }
+
+  const std::string &text_;
+  std::size_t position_;
+};
+
+} // namespace
+
+JsonContext ParseJsonContext(const std::string &text) {
+  return JsonParser(text).Parse();
+}
+
+} // namespace yate
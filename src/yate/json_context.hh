@@ -0,0 +1,29 @@
+#pragma once
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace yate {
+
+/// The symbols of a render, in the form taken by `Renderer`.
+struct JsonContext {
+  std::unordered_map<std::string, std::string> values;
+  std::unordered_map<std::string, std::vector<std::string>> arrays;
+};
+
+/// Reads the symbols of a render from a JSON object, e.g. a line of an
+/// NDJSON file. Strings and numbers become values, numbers keeping
+/// their text, `true` becomes `"true"` and `false` and `null` become
+/// empty strings, so they are false in conditionals. Arrays of those
+/// become arrays. Nested objects and arrays of arrays or objects are
+/// rejected, since templates have no way to address them.
+///
+/// @param text The JSON object, surrounding whitespace is ignored.
+/// @return The symbols of the object, the last one wins when a key is
+///         repeated.
+/// @throw std::runtime_error if the text is not a valid JSON object or
+///        has nested values.
+JsonContext ParseJsonContext(const std::string &text);
+
+} // namespace yate
@@ -1,5 +1,8 @@
 #include "lexer.hh"
 
+#include "utils.hh"
+
+#include <algorithm>
 #include <cctype>
 #include <iostream>
 
@@ -7,11 +10,15 @@ namespace yate {
 
 Lexer::Lexer(std::istream &istream)
     : istream_(istream),
+      delimiters_(),
       current_(),
       script_mode_(false),
       initialized_(false),
       id_generator_(0),
       must_return_script_begin_(false),
+      filter_arguments_(false),
+      trim_literal_(false),
+      script_column_(0),
       line_(1),
       column_(0) {}
 
@@ -37,19 +44,28 @@ bool Lexer::ReadCompare(std::istream::char_type ch) {
 }
 
 Token Lexer::Scan() {
+  Result error;
+  auto token = Scan(error);
+  if (!error.ok()) {
+    error.Throw();
+  }
+  return token;
+}
+
+Token Lexer::Scan(Result &error) {
   // Small workaround which prevents issuing EOF as the first token.
   if (initialized_ && current_ == '\0') {
     return Token(Token::Tag::eEOF, "", line_, column_);
   }
   initialized_ = true;
   if (script_mode_) {
-    return ScanScript();
+    return ScanScript(error);
   } else {
     return ScanLiterate();
   }
 }
 
-Token Lexer::ScanScript() {
+Token Lexer::ScanScript(Result &error) {
   // In literate mode when the lexer encounters the `{{` it returns
   // `NOOP` since `{{` where consumed it sets a flag so the next token
   // emitted is SCRIPT_BEGIN. Alternatively those two characters could
@@ -57,7 +73,11 @@ Token Lexer::ScanScript() {
   // include code to parse that input too.
   if (must_return_script_begin_) {
     must_return_script_begin_ = false;
-    return Token(Token::Tag::eScriptBegin, "{{", line_, column_-2);
+    return Token(
+        Token::Tag::eScriptBegin,
+        delimiters_.open(),
+        line_,
+        script_column_);
   }
 
   // In script mode we discard all spaces
@@ -68,33 +88,33 @@ Token Lexer::ScanScript() {
   auto column = column_;
   // Handles keywords begin which should start with '#'
   if (current_ == '#') {
-    if (ReadCompare('l') && ReadCompare('o') && ReadCompare('o') &&
-        ReadCompare('p')) {
-      ReadChar();
-      if (std::isalnum(current_)) {
-        throw std::runtime_error(GenerateError("Invalid keyword found"));
-      }
+    auto keyword =
+        ReadKeyword({"loop", "if", "else"}, "Invalid keyword found", error);
+    if (!error.ok()) {
+      return Token(Token::Tag::eEOF, "", line_, column_);
+    }
+    if (keyword == "loop") {
       return Token(
           Token::Tag::eLoopBegin,
           "#loop" + std::to_string(id_generator_++),
           line,
           column);
-    } else {
-      throw std::runtime_error(GenerateError("Invalid keyword found."));
+    } else if (keyword == "if") {
+      return Token(Token::Tag::eIfBegin, "#if", line, column);
     }
+    return Token(Token::Tag::eElse, "#else", line, column);
   }
   // Handles keywords ends, which should start with '/'
   if (current_ == '/') {
-    if (ReadCompare('l') && ReadCompare('o') && ReadCompare('o') &&
-        ReadCompare('p')) {
-      ReadChar();
-      if (std::isalnum(current_)) {
-        throw std::runtime_error(GenerateError("Invalid keyword found."));
-      }
+    auto keyword =
+        ReadKeyword({"loop", "if"}, "Invalid keyword found.", error);
+    if (!error.ok()) {
+      return Token(Token::Tag::eEOF, "", line_, column_);
+    }
+    if (keyword == "loop") {
       return Token(Token::Tag::eLoopEnd, "/loop", line, column);
-    } else {
-      throw std::runtime_error(GenerateError("Invalid keyword found."));
     }
+    return Token(Token::Tag::eIfEnd, "/if", line, column);
   }
   // Handles Identifiers.
   if (std::isalpha(current_)) {
@@ -105,50 +125,209 @@ Token Lexer::ScanScript() {
     } while (std::isalnum(current_));
     return Token(Token::Tag::eIdentifier, value, line, column);
   }
+  // Handles loop metadata, an identifier preceded by `@`.
+  if (current_ == '@') {
+    std::string value;
+    do {
+      value += current_;
+      ReadChar();
+    } while (std::isalnum(current_));
+    if (value.size() == 1) {
+      return GenerateError("Invalid loop metadata found.", error);
+    }
+    return Token(Token::Tag::eLoopMetadata, value, line, column);
+  }
+  // Handles includes of partials.
+  if (current_ == '>') {
+    ReadChar();
+    return Token(Token::Tag::ePartial, ">", line, column);
+  }
+  // Handles the separators of the arrays of zipped loops.
+  if (current_ == ',') {
+    ReadChar();
+    return Token(Token::Tag::eComma, ",", line, column);
+  }
+  // Handles modifiers of values.
+  if (current_ == '|') {
+    filter_arguments_ = true;
+    ReadChar();
+    return Token(Token::Tag::ePipe, "|", line, column);
+  }
+  const auto &close = delimiters_.close();
+  // Handles `-}}`, which ends script mode like `}}` and removes the
+  // whitespace which follows.
+  if (current_ == '-' && istream_.peek() == close[0]) {
+    ReadChar();
+    if (!ReadClose()) {
+      return GenerateError("Invalid trim marker found.", error);
+    }
+    script_mode_ = false;
+    filter_arguments_ = false;
+    trim_literal_ = true;
+    return Token(Token::Tag::eScriptEnd, "-" + close, line, column);
+  }
+  // Handles numeric arguments of filters, which are only accepted
+  // after a `|`.
+  if (filter_arguments_ && (std::isdigit(current_) || current_ == '-')) {
+    std::string value;
+    do {
+      value += current_;
+      ReadChar();
+    } while (std::isdigit(current_) || current_ == '.');
+    if (value == "-" || std::isalpha(current_)) {
+      return GenerateError("Invalid number found.", error);
+    }
+    return Token(Token::Tag::eNumber, value, line, column);
+  }
+  // Handles quoted arguments of filters, where `\"` and `\\` stand
+  // for `"` and `\`.
+  if (filter_arguments_ && current_ == '"') {
+    std::string value;
+    while (!ReadCompare('"')) {
+      if (current_ == '\0') {
+        return GenerateError("EOF found inside string.", error);
+      }
+      if (current_ == '\\') {
+        ReadChar();
+        if (current_ != '"' && current_ != '\\') {
+          return GenerateError("Invalid escape sequence in string.", error);
+        }
+      }
+      value += current_;
+    }
+    ReadChar();
+    return Token(Token::Tag::eString, value, line, column);
+  }
   // Handles end of script mode.
-  if (current_ == '}' && ReadCompare('}')) {
+  if (current_ == close[0] && ReadClose()) {
     script_mode_ = false;
-    return Token(Token::Tag::eScriptEnd, "}}", line, column);
+    filter_arguments_ = false;
+    return Token(Token::Tag::eScriptEnd, close, line, column);
   }
   if (current_ == '\0') {
-    throw std::runtime_error(GenerateError("EOF found inside script mode."));
+    return GenerateError("EOF found inside script mode.", error);
   }
   std::string message = "Cannot recognize character '";
   message += current_;
   message += "'.";
-  throw std::runtime_error(GenerateError(message));
+  return GenerateError(std::move(message), error);
+}
+
+std::string Lexer::ReadKeyword(
+    std::initializer_list<const char *> keywords,
+    const char *suffix_error,
+    Result &error) {
+  // Characters are consumed while they can still form one of the
+  // keywords, so errors point at the first one which cannot.
+  std::string word;
+  ReadChar();
+  while (true) {
+    auto candidate = word + current_;
+    auto extends = std::any_of(
+        keywords.begin(), keywords.end(), [&candidate](const char *keyword) {
+          return begins_with(std::string(keyword), candidate);
+        });
+    if (!extends || current_ == '\0') {
+      break;
+    }
+    word = std::move(candidate);
+    ReadChar();
+  }
+  if (std::none_of(
+          keywords.begin(), keywords.end(), [&word](const char *keyword) {
+            return word == keyword;
+          })) {
+    GenerateError("Invalid keyword found.", error);
+    return "";
+  }
+  if (std::isalnum(current_)) {
+    GenerateError(suffix_error, error);
+    return "";
+  }
+  return word;
+}
+
+bool Lexer::ReadClose() {
+  const auto &close = delimiters_.close();
+  for (std::size_t i = 1; i < close.size(); ++i) {
+    if (!ReadCompare(close[i])) {
+      return false;
+    }
+  }
+  return true;
+}
+
+std::size_t Lexer::ReadEscape(std::string &value) {
+  const auto &open = delimiters_.open();
+  std::size_t backslashes = 0;
+  while (current_ == '\\') {
+    ++backslashes;
+    ReadChar();
+  }
+  std::size_t matched = 1;
+  while (matched < open.size() && current_ == open[matched]) {
+    ++matched;
+    ReadChar();
+  }
+  if (matched == open.size()) {
+    value.append(backslashes - 1, '\\');
+    value.append(open, 1, std::string::npos);
+    return 0;
+  }
+  value.append(backslashes, '\\');
+  value.append(open, 1, matched - 1);
+  // The characters matched after the backslashes may begin the
+  // delimiter again.
+  std::size_t state = 0;
+  for (std::size_t i = 1; i < matched; ++i) {
+    state = delimiters_.Next(state, open[i]);
+  }
+  return state;
 }
 
 Token Lexer::ScanLiterate() {
   ReadChar();
+  if (trim_literal_) {
+    trim_literal_ = false;
+    while (std::isspace(current_)) {
+      ReadChar();
+    }
+  }
   auto line = line_;
   auto column = column_;
+  const auto &open = delimiters_.open();
   std::string value;
-  // Consume all input until we come to a `{{` which indicates the
-  // begin of script mode.
-  while (!script_mode_ && current_ != '\0') {
-    if (current_ == '{') {
-      if (ReadCompare('{')) {
-        script_mode_ = true;
-        current_ = ' '; // This will cause script mode to ignore this value.
-        if (!value.empty()) {
-          must_return_script_begin_ = true;
-          return Token(Token::Tag::eNoOp, value, line, column);
-        } else {
-          must_return_script_begin_ = false;
-          return Token(Token::Tag::eScriptBegin, "{{", line, column);
-        }
-      } else if (current_ == '\\') {
-        if (ReadCompare('{')) {
-          value += '{';
-        } else {
-          value += "{\\";
+  std::size_t state = 0;
+  // Consume all input until we come to the opening delimiter which
+  // indicates the begin of script mode.
+  while (current_ != '\0') {
+    if (state == 1 && current_ == '\\') {
+      state = ReadEscape(value);
+      continue;
+    }
+    state = delimiters_.Next(state, current_);
+    value += current_;
+    if (state == open.size()) {
+      value.resize(value.size() - open.size());
+      script_mode_ = true;
+      script_column_ = column_ - static_cast<std::uint32_t>(open.size());
+      // `{{-` removes the whitespace which precedes it.
+      if (istream_.peek() == '-') {
+        ReadChar();
+        while (!value.empty() &&
+               std::isspace(static_cast<unsigned char>(value.back()))) {
+          value.pop_back();
         }
+      }
+      current_ = ' '; // This will cause script mode to ignore this value.
+      if (!value.empty()) {
+        must_return_script_begin_ = true;
+        return Token(Token::Tag::eNoOp, value, line, column);
       } else {
-        value += '{';
+        must_return_script_begin_ = false;
+        return Token(Token::Tag::eScriptBegin, open, line, column);
       }
     }
-    value += current_;
     ReadChar();
   }
   // Investigate the case of the string containing only '\0'
@@ -169,10 +348,19 @@ void Lexer::SetStreamPos(StreamPos pos) {
   column_ = pos.column_;
 }
 
-std::string Lexer::GenerateError(const std::string &message)
-{
-  return "Error found in line " + std::to_string(line_) + " column " +
-      std::to_string(column_) + ": " + message;
+Token Lexer::GenerateError(std::string message, Result &error) {
+  std::string offending;
+  if (current_ != '\0') {
+    offending += current_;
+  }
+  error = Result(
+      Status::eLexicalError,
+      Token(Token::Tag::eNoOp, std::move(offending), line_, column_),
+      std::move(message));
+  // The following scans return `EOF`.
+  initialized_ = true;
+  current_ = '\0';
+  return Token(Token::Tag::eEOF, "", line_, column_);
 }
 
 StreamPos::StreamPos() : StreamPos(0, 0, 0) {}
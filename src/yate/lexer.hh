@@ -1,9 +1,14 @@
 #pragma once
 
 #include <cstdint>
+#include <initializer_list>
 #include <iosfwd>
 #include <istream>
+#include <string>
+#include <utility>
 
+#include "delimiters.hh"
+#include "result.hh"
 #include "token.hh"
 
 namespace yate {
@@ -11,7 +16,14 @@ namespace yate {
 class StreamPos;
 
 /// This class is on charge of going through every character in the
-/// stream and generate tokens out of it.
+/// stream and generate tokens out of it. Tags opened with `{{-` drop
+/// the whitespace before them from the preceding literal and tags
+/// closed with `-}}` drop the whitespace after them, so the trimmed
+/// whitespace never reaches the template.
+///
+/// Inside literals a `\` following the first character of the opening
+/// delimiter escapes it: `{\{` is read as `{{`, and every extra `\`
+/// is kept, so `{\\{` is read as `{\{`.
 class Lexer {
  public:
   /// Creates a new lexer with the associated stream to it.
@@ -20,11 +32,29 @@ class Lexer {
   Lexer(std::istream &istream);
   ~Lexer() {}
 
+  /// Sets the strings which open and close tags, `{{` and `}}` by
+  /// default. It must be called before the first token is scanned.
+  ///
+  /// @param delimiters The delimiters of the template.
+  void set_delimiters(Delimiters delimiters) {
+    delimiters_ = std::move(delimiters);
+  }
+  const Delimiters &delimiters() const { return delimiters_; }
+
   /// Consumes input from the associated stream until it matches any
   /// type of token and returns it. If the input does not match any
   /// token, it throws a `std::runtime_error`.
   Token Scan();
 
+  /// Like `Scan()`, but input which does not match any token is
+  /// stored in `error` instead of thrown, and scanning stops: this
+  /// and the following calls return `EOF`.
+  ///
+  /// @param error Where the error is stored, it is left untouched if
+  ///        a token is found.
+  /// @return The token found.
+  Token Scan(Result &error);
+
   /// Returns the current stream position, by doing `istream.tellg()`.
   /// It also keeps track of the number of lines read up to that
   /// position and the column within that line in which the stream is
@@ -57,30 +87,71 @@ class Lexer {
   ///         ch.
   bool ReadCompare(std::istream::char_type ch);
 
-  /// Helper method to generate error messages including the line and
-  /// column in the stream for easier debugging.
+  /// Helper method to record errors at the current line and column in
+  /// the stream, whose message is only formatted if it is asked for.
+  /// It stops the scanning.
   ///
   /// @param message The core error message.
-  /// @return A formated error including the given message as well as
-  ///        the location in the input where the error was generated.
-  std::string GenerateError(const std::string &message);
+  /// @param error Where the error is stored.
+  /// @return The `EOF` token returned in place of the invalid one.
+  Token GenerateError(std::string message, Result &error);
+
+  /// Reads the keyword which follows a `#` or a `/`. If the input
+  /// does not match any of the given keywords, or the keyword is
+  /// followed by more alphanumeric characters, the error is stored in
+  /// `error`.
+  ///
+  /// @param keywords The keywords accepted at this point.
+  /// @param suffix_error The message used when a keyword is followed
+  ///        by alphanumeric characters.
+  /// @param error Where the error is stored.
+  /// @return The keyword found, empty on errors.
+  std::string ReadKeyword(
+      std::initializer_list<const char *> keywords,
+      const char *suffix_error,
+      Result &error);
+
+  /// Consumes the rest of the closing delimiter, whose first
+  /// character is `current_`.
+  ///
+  /// @return `false` if the input does not match it.
+  bool ReadClose();
+
+  /// Reads the backslashes which follow the first character of the
+  /// opening delimiter in a literal, and the rest of the delimiter if
+  /// it is there, in which case the first backslash is dropped.
+  ///
+  /// @param value The literal read so far, where the characters are
+  ///        appended.
+  /// @return The number of characters of the opening delimiter the end
+  ///         of `value` matches.
+  std::size_t ReadEscape(std::string &value);
 
   /// Helper method called by `Scan()` when in literate mode. It
-  /// consumes all input until it finds the token `{{` it which point
-  /// it changes to script mode and returns.
+  /// consumes all input until it finds the opening delimiter at which
+  /// point it changes to script mode and returns.
   Token ScanLiterate();
 
   /// Helper method called by `Scan()` when in script mode. It
   /// tokenizes most of the input that actually needs specific
   /// processing.
-  Token ScanScript();
+  Token ScanScript(Result &error);
 
   std::istream &istream_;
+  Delimiters delimiters_;
   std::istream::char_type current_;
   bool script_mode_;
   bool initialized_; // TODO: Find a more elegant solution to this.
   std::uint64_t id_generator_;
   bool must_return_script_begin_;
+  /// Set after a `|`, numbers and strings are only scanned as the
+  /// arguments of filters.
+  bool filter_arguments_;
+  /// Set by `-}}`, the whitespace which begins the next literal is
+  /// skipped.
+  bool trim_literal_;
+  /// The column of the `{{` returned after the literal before it.
+  std::uint32_t script_column_;
   std::uint32_t line_;
   std::uint32_t column_;
 };
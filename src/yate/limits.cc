@@ -0,0 +1,33 @@
+#include "limits.hh"
+
+#include <string>
+
+namespace yate {
+
+LimitedSink::LimitedSink(Sink &target, std::size_t max_bytes)
+    : target_(target), max_bytes_(max_bytes), written_(0) {}
+
+void LimitedSink::Write(const char *data, std::size_t size) {
+  Count(size);
+  target_.Write(data, size);
+}
+
+void LimitedSink::WriteStable(const char *data, std::size_t size) {
+  Count(size);
+  target_.WriteStable(data, size);
+}
+
+void LimitedSink::Flush() {
+  target_.Flush();
+}
+
+void LimitedSink::Count(std::size_t size) {
+  if (size > max_bytes_ - written_) {
+    throw RenderLimitExceeded(
+        RenderLimitExceeded::Reason::eOutputSize,
+        "Render output exceeded " + std::to_string(max_bytes_) + " bytes");
+  }
+  written_ += size;
+}
+
+} // namespace yate
@@ -0,0 +1,102 @@
+#pragma once
+
+#include "sink.hh"
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+namespace yate {
+
+/// Lets another thread stop a render in progress. The renderer checks
+/// the token while it iterates loops, so cancelling it makes the
+/// render fail with `RenderLimitExceeded` shortly after.
+class CancellationToken {
+ public:
+  CancellationToken() : cancelled_(false) {}
+  ~CancellationToken() {}
+
+  // Not copyable nor movable.
+  CancellationToken(const CancellationToken &) = delete;
+  CancellationToken &operator=(const CancellationToken &) = delete;
+
+  /// Requests the renders which use the token to stop.
+  void Cancel() { cancelled_.store(true, std::memory_order_relaxed); }
+
+  /// @return Whether `Cancel()` was called.
+  bool cancelled() const { return cancelled_.load(std::memory_order_relaxed); }
+
+ private:
+  std::atomic<bool> cancelled_;
+};
+
+/// Bounds on the work done by a single render, see
+/// `Renderer::set_limits()`. By default nothing is limited.
+struct RenderLimits {
+  /// The render fails if it is still running at this point.
+  std::chrono::steady_clock::time_point deadline =
+      std::chrono::steady_clock::time_point::max();
+  /// The maximum number of bytes written to the sink.
+  std::size_t max_output_bytes = std::numeric_limits<std::size_t>::max();
+  /// The maximum number of loop iterations, adding up every loop.
+  std::size_t max_iterations = std::numeric_limits<std::size_t>::max();
+  /// Checked together with the deadline, may be `nullptr`.
+  std::shared_ptr<const CancellationToken> cancellation;
+};
+
+/// Error raised when a render exceeds one of its `RenderLimits` or is
+/// cancelled. It derives from `std::runtime_error`, like every other
+/// error of the library, but can be caught on its own to tell aborted
+/// renders apart from broken templates.
+class RenderLimitExceeded : public std::runtime_error {
+ public:
+  enum class Reason {
+    eDeadline = 0,    /// The deadline passed.
+    eOutputSize = 1,  /// Too many bytes were written.
+    eIterations = 2,  /// Too many loop iterations were rendered.
+    eCancelled = 3    /// The cancellation token was cancelled.
+  };
+
+  /// @param reason The limit which was exceeded.
+  /// @param message The description of the error.
+  RenderLimitExceeded(Reason reason, const std::string &message)
+      : std::runtime_error(message), reason_(reason) {}
+
+  Reason reason() const { return reason_; }
+
+ private:
+  Reason reason_;
+};
+
+/// Sink which forwards to another one and fails with
+/// `RenderLimitExceeded` when more than a given number of bytes are
+/// written, before passing the offending bytes on.
+class LimitedSink : public Sink {
+ public:
+  /// @param target The sink where the output is written.
+  /// @param max_bytes The maximum number of bytes accepted.
+  LimitedSink(Sink &target, std::size_t max_bytes);
+  ~LimitedSink() {}
+
+  void Write(const char *data, std::size_t size) override;
+  void WriteStable(const char *data, std::size_t size) override;
+  void Flush() override;
+
+  /// @return The number of bytes written so far.
+  std::size_t written() const { return written_; }
+
+ private:
+  /// Adds `size` to the bytes written, throwing if it exceeds the
+  /// maximum.
+  void Count(std::size_t size);
+
+  Sink &target_;
+  std::size_t max_bytes_;
+  std::size_t written_;
+};
+
+} // namespace yate
@@ -0,0 +1,78 @@
+#include "minify.hh"
+
+#include <cctype>
+
+namespace yate {
+
+namespace {
+
+const char *const kVerbatimElements[] = {"pre", "textarea", "script", "style"};
+
+/// Tells whether `literal` holds the element name `name` at
+/// `position`, ignoring case, followed by a character which ends it.
+bool MatchName(
+    const std::string &literal,
+    std::size_t position,
+    const std::string &name) {
+  if (literal.size() - position < name.size()) {
+    return false;
+  }
+  for (std::size_t i = 0; i < name.size(); ++i) {
+    auto ch = static_cast<unsigned char>(literal[position + i]);
+    if (std::tolower(ch) != name[i]) {
+      return false;
+    }
+  }
+  // The attributes may come from a value, so the literal can end
+  // right after the name.
+  auto end = position + name.size();
+  return end == literal.size() || literal[end] == '>' || literal[end] == '/' ||
+      std::isspace(static_cast<unsigned char>(literal[end]));
+}
+
+} // namespace
+
+Minifier::Minifier() : verbatim_() {}
+
+std::string Minifier::Minify(const std::string &literal) {
+  std::string result;
+  result.reserve(literal.size());
+  std::size_t i = 0;
+  while (i < literal.size()) {
+    auto ch = literal[i];
+    if (ch == '<') {
+      MatchElement(literal, i);
+    }
+    if (!verbatim_.empty() ||
+        !std::isspace(static_cast<unsigned char>(ch))) {
+      result += ch;
+      ++i;
+      continue;
+    }
+    auto newline = false;
+    while (i < literal.size() &&
+           std::isspace(static_cast<unsigned char>(literal[i]))) {
+      newline = newline || literal[i] == '\n';
+      ++i;
+    }
+    result += newline ? '\n' : ' ';
+  }
+  return result;
+}
+
+void Minifier::MatchElement(const std::string &literal, std::size_t position) {
+  if (verbatim_.empty()) {
+    for (const auto *name : kVerbatimElements) {
+      if (MatchName(literal, position + 1, name)) {
+        verbatim_ = name;
+        return;
+      }
+    }
+  } else if (
+      position + 1 < literal.size() && literal[position + 1] == '/' &&
+      MatchName(literal, position + 2, verbatim_)) {
+    verbatim_.clear();
+  }
+}
+
+} // namespace yate
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <string>
+
+namespace yate {
+
+/// Collapses the whitespace of the literals of HTML templates, which
+/// browsers render the same whatever its length. Each run of
+/// whitespace becomes a single space, or a single newline if it
+/// contains one, so scripts which rely on line breaks keep working.
+/// The content of `<pre>`, `<textarea>`, `<script>` and `<style>`
+/// elements is kept as it is. Only literals are minified, values are
+/// written unchanged.
+class Minifier {
+ public:
+  Minifier();
+  ~Minifier() {}
+
+  /// Minifies a literal of a template. Literals must be given in the
+  /// order of the template, since an element opened by one literal is
+  /// still open in the following ones.
+  ///
+  /// @param literal The text of the literal.
+  /// @return The minified text.
+  std::string Minify(const std::string &literal);
+
+ private:
+  /// Tells whether an element whose content is kept as it is opens or
+  /// closes at `position`, which holds a `<`, updating `verbatim_`.
+  void MatchElement(const std::string &literal, std::size_t position);
+
+  /// The name of the element whose content is being kept, e.g. `pre`,
+  /// or empty.
+  std::string verbatim_;
+};
+
+} // namespace yate
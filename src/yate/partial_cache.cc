@@ -0,0 +1,67 @@
+#include "partial_cache.hh"
+
+#include <utility>
+
+namespace yate {
+
+bool PartialSettings::operator==(const PartialSettings &other) const {
+  return delimiters.open() == other.delimiters.open() &&
+      delimiters.close() == other.delimiters.close() &&
+      default_escape == other.default_escape && filters == other.filters &&
+      inline_limit == other.inline_limit && minify == other.minify;
+}
+
+PartialCache::PartialCache(Loader loader)
+    : loader_(std::move(loader)), mutex_(), partials_() {}
+
+std::shared_ptr<const Template> PartialCache::Find(
+    const std::string &name,
+    const PartialSettings &settings) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = partials_.find(name);
+  if (it == partials_.end()) {
+    return nullptr;
+  }
+  for (const auto &entry : it->second) {
+    if (entry.first == settings) {
+      return entry.second;
+    }
+  }
+  return nullptr;
+}
+
+bool PartialCache::Load(const std::string &name, std::string &source) const {
+  return loader_ && loader_(name, source);
+}
+
+std::shared_ptr<const Template> PartialCache::Insert(
+    const std::string &name,
+    const PartialSettings &settings,
+    Template partial) {
+  auto value = std::make_shared<const Template>(std::move(partial));
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto &entries = partials_[name];
+  for (const auto &entry : entries) {
+    if (entry.first == settings) {
+      return entry.second;
+    }
+  }
+  entries.emplace_back(settings, std::move(value));
+  return entries.back().second;
+}
+
+void PartialCache::Clear() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  partials_.clear();
+}
+
+std::size_t PartialCache::size() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::size_t size = 0;
+  for (const auto &partial : partials_) {
+    size += partial.second.size();
+  }
+  return size;
+}
+
+} // namespace yate
@@ -0,0 +1,109 @@
+#pragma once
+
+#include "delimiters.hh"
+#include "escape.hh"
+#include "filter.hh"
+#include "template.hh"
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace yate {
+
+/// The settings of a `Compiler` which change the partials it compiles.
+/// The defaults are those of a new `Compiler`.
+struct PartialSettings {
+  Delimiters delimiters;
+  Escape default_escape = Escape::eNone;
+  /// Compared by address, like the registry a `Compiler` points to.
+  const FilterRegistry *filters = &FilterRegistry::Builtin();
+  std::size_t inline_limit = 0;
+  bool minify = false;
+
+  bool operator==(const PartialSettings &other) const;
+};
+
+/// Holds the compiled partials included by templates, e.g. with
+/// `{{>header}}`. The sources are obtained through a loader callback
+/// the first time a partial is included and every template which
+/// includes it afterwards shares the same compiled `Template`, so each
+/// partial is read and parsed only once.
+///
+/// The cache can be shared among `Compiler`s in different threads.
+/// A partial is compiled once per distinct `PartialSettings` of the
+/// compilers which include it, so compilers with different delimiters,
+/// minification, default escaping mode, filters or inline limit each
+/// get their own copy. The array check of a `Compiler` is not part of
+/// the settings: a partial compiled without one is not checked again.
+class PartialCache {
+ public:
+  /// Reads the source of a partial.
+  ///
+  /// @param name The name used in the include, e.g. `header`.
+  /// @param source Where the source of the partial is stored.
+  /// @return `false` if there is no partial with that name.
+  using Loader =
+      std::function<bool(const std::string &name, std::string &source)>;
+
+  /// @param loader The callback used to read the partials which are
+  ///        not in the cache yet.
+  PartialCache(Loader loader);
+  ~PartialCache() {}
+
+  // Not copyable nor movable.
+  PartialCache(const PartialCache &) = delete;
+  PartialCache &operator=(const PartialCache &) = delete;
+
+  /// Looks up a partial which has already been compiled.
+  ///
+  /// @param name The name of the partial.
+  /// @param settings The settings it was compiled with.
+  /// @return The compiled partial or `nullptr` if it is not cached.
+  std::shared_ptr<const Template> Find(
+      const std::string &name,
+      const PartialSettings &settings) const;
+
+  /// Reads the source of a partial through the loader.
+  ///
+  /// @param name The name of the partial.
+  /// @param source Where the source of the partial is stored.
+  /// @return `false` if the loader does not know the partial.
+  bool Load(const std::string &name, std::string &source) const;
+
+  /// Stores a compiled partial. If another thread stored the same
+  /// partial first, that one is kept, so all the templates share a
+  /// single copy.
+  ///
+  /// @param name The name of the partial.
+  /// @param settings The settings it was compiled with.
+  /// @param partial The compiled partial.
+  /// @return The partial stored in the cache.
+  std::shared_ptr<const Template> Insert(
+      const std::string &name,
+      const PartialSettings &settings,
+      Template partial);
+
+  /// Removes all the partials, e.g. after their sources changed.
+  /// Templates which already include them keep their copy.
+  void Clear();
+
+  /// @return The number of compiled partials in the cache, counting
+  ///         each settings of a partial.
+  std::size_t size() const;
+
+ private:
+  using Entry = std::pair<PartialSettings, std::shared_ptr<const Template>>;
+
+  Loader loader_;
+  mutable std::mutex mutex_;
+  /// The compiled copies of each partial, usually a single one.
+  std::unordered_map<std::string, std::vector<Entry>> partials_;
+};
+
+} // namespace yate
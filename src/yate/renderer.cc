@@ -1,134 +1,957 @@
 #include "renderer.hh"
 
+#include "compiler.hh"
+#include "filter.hh"
+#include "fragment_cache.hh"
 #include "frame.hh"
-#include "lexer.hh"
-#include "token.hh"
+#include "schema.hh"
+#include "symbol_table.hh"
 
+#include <chrono>
+#include <cstring>
+#include <limits>
+#include <memory>
 #include <string>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 
 namespace yate {
 
+namespace {
+
+/// The token reported for errors of a node, its symbol at its
+/// position.
+Token NodeToken(const Template::Node &node) {
+  auto tag = node.metadata == LoopMetadata::eNone
+      ? Token::Tag::eIdentifier
+      : Token::Tag::eLoopMetadata;
+  return Token(tag, node.text, node.line, node.column);
+}
+
+/// The output of a loop kernel is written in batches of at most this
+/// size, so long arrays do not need a buffer as large as their output.
+const std::size_t kKernelBatchSize = 64 * 1024;
+
+/// Writer for `WriteEscapedTo()` which copies the text to a buffer
+/// which is already large enough.
+struct BufferWriter {
+  char *end;
+
+  void write(const char *data, std::size_t length) {
+    std::memcpy(end, data, length);
+    end += length;
+  }
+};
+
+#ifdef YATE_COROUTINES
+/// Suspends an asynchronous render until its sink is not full.
+struct Drain {
+  AsyncSink &sink;
+
+  bool await_ready() const { return !sink.Full(); }
+  void await_suspend(std::coroutine_handle<> handle) {
+    sink.WhenDrained([handle]() { handle.resume(); });
+  }
+  void await_resume() const {}
+};
+
+/// Asks the provider of an asynchronous render for a value. If it is
+/// pending the render suspends and `ePending` is returned once it
+/// continues, meaning the value has to be asked for again.
+struct Resolve {
+  AsyncValues &values;
+  const std::string &symbol;
+  std::string &value;
+  AsyncValues::Resolution resolution;
+
+  bool await_ready() const { return false; }
+  bool await_suspend(std::coroutine_handle<> handle) {
+    // The render may continue on another thread before this returns,
+    // so the awaiter is only written when not suspending.
+    auto result =
+        values.Resolve(symbol, value, [handle]() { handle.resume(); });
+    if (result == AsyncValues::Resolution::ePending) {
+      return true;
+    }
+    resolution = result;
+    return false;
+  }
+  AsyncValues::Resolution await_resume() const { return resolution; }
+};
+
+/// A range of nodes being rendered by `Renderer::RenderAsync()`: the
+/// template, a partial or the body of a loop.
+struct AsyncLevel {
+  const Template *tmpl = nullptr;
+  /// The next node to render and the end of the range.
+  std::size_t next = 0;
+  std::size_t end = 0;
+  /// The index of the loop, if the range is its body.
+  std::size_t loop = std::numeric_limits<std::size_t>::max();
+  /// What the loop iterates, either an array or a generator.
+  const std::vector<std::string> *array = nullptr;
+  Generator *generator = nullptr;
+  /// The other arrays of a zipped loop.
+  std::vector<const std::vector<std::string> *> zipped;
+  /// The index of the next iteration.
+  std::size_t position = 0;
+  /// State of loops over generators, as in `RenderGenerator()`.
+  std::size_t size = 0;
+  bool size_known = false;
+  bool has_current = false;
+  bool has_following = false;
+  std::string *current = nullptr;
+  std::string *following = nullptr;
+};
+#endif
+
+} // namespace
+
 Renderer::Renderer(
     std::unordered_map<std::string, std::string> printable_values,
     std::unordered_map<std::string, std::vector<std::string>> iterable_values)
-    : root_(std::make_shared<Frame>(printable_values, iterable_values)),
-      top_() {
+    : root_(std::make_shared<Frame>(
+          std::move(printable_values), std::move(iterable_values))),
+      top_(),
+      loop_frames_(),
+      loop_depth_(0),
+      zipped_columns_(),
+      fragment_cache_(),
+      pinned_fragments_(),
+      filter_buffers_(),
+      generator_buffers_(),
+      generator_depth_(0),
+      limits_(),
+      iterations_(0),
+      loop_kernels_(true),
+      kernel_buffer_(),
+      bindings_(),
+      bound_id_(0),
+      slots_(nullptr),
+      error_() {
   top_ = root_;
+  loop_depth_ = 0;
 }
 
 void Renderer::Render(std::istream &input, std::ostream &output) {
-  lexer_ = std::make_unique<Lexer>(input);
-  Render(output);
-}
-
-StreamPos Renderer::Render(std::ostream &output, bool write_output) {
-  auto current = lexer_->Scan();
-  while (current.tag() != Token::Tag::eEOF) {
-    switch (current.tag()) {
-      case Token::Tag::eNoOp: {
-        // Literate mode token, just copy everything to the output
-        // stream.
-        if (write_output) {
-          output << current.value();
+  auto result = TryRender(input, output);
+  if (!result.ok()) {
+    result.Throw();
+  }
+}
+
+Result Renderer::TryRender(
+    std::istream &input,
+    std::ostream &output) noexcept {
+  try {
+    Compiler compiler(input);
+    // Arrays can only be defined at the root, so undefined ones are
+    // reported as soon as their loop is parsed.
+    compiler.set_array_check([this](const std::string &array) {
+      return root_->ContainsIterable(array) ||
+          root_->ContainsGenerator(array);
+    });
+    Template tmpl;
+    auto result = compiler.TryCompile(tmpl);
+    if (!result.ok()) {
+      return result;
+    }
+    StreamSink sink(output);
+    return TryRender(tmpl, sink);
+  } catch (...) {
+    return CurrentException();
+  }
+}
+
+void Renderer::Render(const Template &tmpl, std::ostream &output) {
+  StreamSink sink(output);
+  Render(tmpl, sink);
+}
+
+void Renderer::Render(const Template &tmpl, Sink &output) {
+  auto result = TryRender(tmpl, output);
+  if (!result.ok()) {
+    result.Throw();
+  }
+}
+
+Result Renderer::TryRender(const Template &tmpl, Sink &output) noexcept {
+  return RenderRange(tmpl, 0, tmpl.nodes().size(), output);
+}
+
+void Renderer::Render(const ValidatedTemplate &validated, Sink &output) {
+  for (const auto &value : validated.schema().values) {
+    if (!root_->ContainsValue(value)) {
+      throw std::runtime_error("Schema value '" + value + "' is not set");
+    }
+  }
+  for (const auto &array : validated.schema().arrays) {
+    if (!root_->ContainsIterable(array) && !root_->ContainsGenerator(array)) {
+      throw std::runtime_error("Schema array '" + array + "' is not set");
+    }
+  }
+  Render(validated.tmpl(), output);
+}
+
+Result Renderer::RenderRange(
+    const Template &tmpl,
+    std::size_t begin,
+    std::size_t end,
+    Sink &output) noexcept {
+  Result result;
+  try {
+    // A failed render may have left the frames of its loops behind.
+    top_ = root_;
+    loop_depth_ = 0;
+    zipped_columns_.clear();
+    generator_depth_ = 0;
+    iterations_ = 0;
+    if (CheckDeadline()) {
+      Bind(tmpl);
+      auto rendered = false;
+      if (limits_.max_output_bytes ==
+          std::numeric_limits<std::size_t>::max()) {
+        rendered = Render(tmpl, begin, end, output);
+      } else {
+        LimitedSink limited(output, limits_.max_output_bytes);
+        rendered = Render(tmpl, begin, end, limited);
+      }
+      if (rendered) {
+        output.Flush();
+      }
+    }
+    result = std::exchange(error_, Result());
+  } catch (...) {
+    // Sinks, filters and generators may still throw, as well as the
+    // output limit, which is checked by a sink.
+    result = CurrentException();
+  }
+  // Cached fragments are pinned until the sink is flushed, which a
+  // failed render never does, so they are released either way.
+  pinned_fragments_.clear();
+  return result;
+}
+
+bool Renderer::Render(
+    const Template &tmpl,
+    std::size_t begin,
+    std::size_t end,
+    Sink &output) {
+  const auto &nodes = tmpl.nodes();
+  for (auto i = begin; i < end; ++i) {
+    const auto &node = nodes[i];
+    switch (node.kind) {
+      case Template::Node::Kind::eLiteral:
+        output.WriteStable(node.text.data(), node.text.size());
+        break;
+
+      case Template::Node::Kind::eValue:
+        if (!RenderValue(node, output)) {
+          return false;
+        }
+        break;
+
+      case Template::Node::Kind::eLoopBegin: {
+        auto cached = false;
+        if (fragment_cache_ != nullptr && top_ == root_ &&
+            !RenderCachedSection(tmpl, i, output, cached)) {
+          return false;
+        }
+        if (!cached && !RenderLoop(tmpl, i, output)) {
+          return false;
+        }
+        i = node.jump;
+      } break;
+
+      case Template::Node::Kind::eIfBegin: {
+        // A false condition jumps to the `#else` branch or past the
+        // end of the section.
+        auto condition = false;
+        if (!EvaluateCondition(node, condition)) {
+          return false;
+        }
+        if (!condition) {
+          i = node.jump;
+        }
+      } break;
+
+      case Template::Node::Kind::eElse:
+        // Reached at the end of the true branch.
+        i = node.jump;
+        break;
+
+      case Template::Node::Kind::eIfEnd:
+        break;
+
+      case Template::Node::Kind::eInclude: {
+        // Partials are rendered in the current frame, so they see the
+        // symbols bound by the loops around the include.
+        const auto &partial = *node.partial;
+        auto slots = slots_;
+        slots_ = nullptr;
+        auto rendered = Render(partial, 0, partial.nodes().size(), output);
+        slots_ = slots;
+        if (!rendered) {
+          return false;
+        }
+      } break;
+
+      case Template::Node::Kind::eLoopEnd:
+        // UNREACHABLE, loop bodies are rendered up to their end.
+        throw std::runtime_error("Invalid Syntax: Unmatched 'LOOP_END'");
+    }
+  }
+  return true;
+}
+
+void Renderer::RenderNode(
+    const Template &tmpl,
+    std::size_t index,
+    Sink &output) {
+  auto end = index + 1;
+  auto kind = tmpl.nodes()[index].kind;
+  if (kind == Template::Node::Kind::eLoopBegin ||
+      kind == Template::Node::Kind::eIfBegin) {
+    end = tmpl.SectionEnd(index) + 1;
+  }
+  auto result = RenderRange(tmpl, index, end, output);
+  if (!result.ok()) {
+    result.Throw();
+  }
+}
+
+#ifdef YATE_COROUTINES
+RenderTask Renderer::RenderAsync(
+    const Template &tmpl,
+    AsyncSink &output,
+    AsyncValues *values) {
+  // Releases the cached fragments pinned by the render however it
+  // ends, including errors and tasks destroyed while suspended.
+  struct Unpin {
+    std::vector<std::shared_ptr<const std::string>> &fragments;
+    ~Unpin() { fragments.clear(); }
+  } unpin{pinned_fragments_};
+  top_ = root_;
+  loop_depth_ = 0;
+  generator_depth_ = 0;
+  iterations_ = 0;
+  if (!CheckDeadline()) {
+    error_.Throw();
+  }
+  Bind(tmpl);
+  std::unique_ptr<LimitedSink> limited;
+  Sink *sink = &output;
+  if (limits_.max_output_bytes != std::numeric_limits<std::size_t>::max()) {
+    limited = std::make_unique<LimitedSink>(output, limits_.max_output_bytes);
+    sink = limited.get();
+  }
+
+  // Binds the next element of the loop of `level`, returning `false`
+  // when the loop is over.
+  auto next_iteration = [this](AsyncLevel &level) {
+    const auto &node = level.tmpl->nodes()[level.loop];
+    if (level.generator == nullptr) {
+      if (level.position == level.array->size()) {
+        return false;
+      }
+      if (!CountIteration()) {
+        error_.Throw();
+      }
+      top_->BindValue(node.item, (*level.array)[level.position]);
+      for (std::size_t c = 0; c < level.zipped.size(); ++c) {
+        top_->BindValue(
+            node.zipped[c].item, (*level.zipped[c])[level.position]);
+      }
+      top_->SetLoopPosition(level.position, level.array->size());
+    } else {
+      if (level.position != 0) {
+        std::swap(level.current, level.following);
+        level.has_current = level.has_following;
+      }
+      if (!level.has_current) {
+        return false;
+      }
+      if (!CountIteration()) {
+        error_.Throw();
+      }
+      level.has_following = level.generator->Next(*level.following);
+      auto length = level.size_known
+          ? level.size
+          : level.position + (level.has_following ? 2 : 1);
+      top_->BindValue(node.item, *level.current);
+      top_->SetLoopPosition(level.position, length, level.size_known);
+    }
+    ++level.position;
+    return true;
+  };
+
+  std::vector<AsyncLevel> levels(1);
+  levels[0].tmpl = &tmpl;
+  levels[0].end = tmpl.nodes().size();
+  std::string resolved;
+  while (!levels.empty()) {
+    auto &level = levels.back();
+    if (level.next == level.end) {
+      if (level.loop != std::numeric_limits<std::size_t>::max()) {
+        if (next_iteration(level)) {
+          level.next = level.loop + 1;
+          continue;
+        }
+        if (level.generator != nullptr) {
+          --generator_depth_;
+        }
+        RestoreParentFrame();
+      }
+      levels.pop_back();
+      continue;
+    }
+
+    auto index = level.next++;
+    const auto &node = level.tmpl->nodes()[index];
+    slots_ = level.tmpl == &tmpl ? &bindings_ : nullptr;
+    if (values != nullptr && node.metadata == LoopMetadata::eNone &&
+        (node.kind == Template::Node::Kind::eValue ||
+         node.kind == Template::Node::Kind::eIfBegin) &&
+        !top_->ContainsValue(node.text) &&
+        (node.kind == Template::Node::Kind::eValue ||
+         (!top_->ContainsIterable(node.text) &&
+          !top_->ContainsGenerator(node.text)))) {
+      auto resolution = AsyncValues::Resolution::ePending;
+      do {
+        resolution = co_await Resolve{
+            *values, node.text, resolved, AsyncValues::Resolution::ePending};
+      } while (resolution == AsyncValues::Resolution::ePending);
+      if (resolution == AsyncValues::Resolution::eResolved) {
+        root_->PutValue(node.text, std::move(resolved));
+        bound_id_ = 0;
+      }
+    }
+
+    switch (node.kind) {
+      case Template::Node::Kind::eLiteral:
+        sink->WriteStable(node.text.data(), node.text.size());
+        break;
+
+      case Template::Node::Kind::eValue:
+        if (!RenderValue(node, *sink)) {
+          error_.Throw();
+        }
+        break;
+
+      case Template::Node::Kind::eLoopBegin: {
+        level.next = node.jump + 1;
+        auto cached = false;
+        if (fragment_cache_ != nullptr && top_ == root_ &&
+            !RenderCachedSection(*level.tmpl, index, *sink, cached)) {
+          error_.Throw();
+        }
+        if (cached) {
+          break;
+        }
+        AsyncLevel loop;
+        loop.tmpl = level.tmpl;
+        loop.next = loop.end = node.jump;
+        loop.loop = index;
+        loop.array = top_->FindIterable(node.text);
+        if (loop.array != nullptr &&
+            !ResolveZipped(node, loop.array->size(), loop.zipped)) {
+          error_.Throw();
         }
+        if (loop.array == nullptr) {
+          if (!top_->ContainsGenerator(node.text)) {
+            Fail(Status::eUndefinedArray, NodeToken(node));
+            error_.Throw();
+          }
+          if (!node.zipped.empty()) {
+            FailZippedGenerator(node.text, node);
+            error_.Throw();
+          }
+          loop.generator = &top_->GetGenerator(node.text);
+          while (generator_buffers_.size() < 2 * (generator_depth_ + 1)) {
+            generator_buffers_.emplace_back();
+          }
+          loop.current = &generator_buffers_[2 * generator_depth_];
+          loop.following = &generator_buffers_[2 * generator_depth_ + 1];
+          ++generator_depth_;
+          loop.size_known = loop.generator->Size(loop.size);
+          loop.generator->Reset();
+          loop.has_current = loop.generator->Next(*loop.current);
+        }
+        PushLoopFrame(index);
+        // Invalidates `level`, the loop binds its first element when
+        // it is back at the top.
+        levels.push_back(loop);
       } break;
 
-      case Token::Tag::eScriptBegin: {
-        current = lexer_->Scan();
-
-        switch (current.tag()) {
-          case Token::Tag::eIdentifier: {
-            std::string id = current.value();
-            if (!top_->ContainsValue(id)) {
-              throw std::runtime_error("Identifier '" + id + "' is undefined");
-            }
-
-            if (write_output) {
-              output << top_->GetValue(id);
-            }
-            current = lexer_->Scan();
-
-            if (current.tag() != Token::Tag::eScriptEnd) {
-              throw std::runtime_error(
-                  CreateError(current, Token::Tag::eScriptEnd));
-            }
-          } break;
-
-          case Token::Tag::eLoopBegin: {
-            Token array_name, item_name;
-            std::tie(array_name, item_name) = SetLoopFrame(current.value());
-            auto loop_begin = lexer_->CurrentStreamPos();
-            StreamPos loop_end;
-
-            auto &array = top_->GetIterable(array_name.value());
-
-            if (write_output && !array.empty()) {
-              for (const auto &item : array) {
-                top_->PutValue(item_name.value(), item);
-                loop_end = Render(output, write_output);
-                lexer_->SetStreamPos(loop_begin);
-              }
-            } else {
-                top_->PutValue(item_name.value(), "");
-              loop_end = Render(output, false);
-            }
-
-            RestoreParentFrame();
-            lexer_->SetStreamPos(loop_end);
-          } break;
-
-          case Token::Tag::eLoopEnd: {
-            if (top_ == root_) {
-              throw std::runtime_error("Invalid Syntax: Unmatched 'LOOP_END'");
-            }
-
-            current = lexer_->Scan();
-            if (current.tag() != Token::Tag::eScriptEnd) {
-              throw std::runtime_error(
-                  CreateError(current, Token::Tag::eScriptEnd));
-            }
-            return lexer_->CurrentStreamPos();
-          } break;
-
-          default:
-            throw std::runtime_error(CreateError(current));
-            break;
+      case Template::Node::Kind::eIfBegin: {
+        auto condition = false;
+        if (!EvaluateCondition(node, condition)) {
+          error_.Throw();
+        }
+        if (!condition) {
+          level.next = node.jump + 1;
         }
       } break;
 
-      default:
-        // UNREACHABLE
-        throw std::runtime_error(CreateError(current));
+      case Template::Node::Kind::eElse:
+        level.next = node.jump + 1;
+        break;
+
+      case Template::Node::Kind::eIfEnd:
         break;
+
+      case Template::Node::Kind::eInclude: {
+        AsyncLevel partial;
+        partial.tmpl = node.partial.get();
+        partial.end = node.partial->nodes().size();
+        levels.push_back(partial);
+      } break;
+
+      case Template::Node::Kind::eLoopEnd:
+        // UNREACHABLE, loop bodies end before their `eLoopEnd`.
+        throw std::runtime_error("Invalid Syntax: Unmatched 'LOOP_END'");
+    }
+    co_await Drain{output};
+  }
+  sink->Flush();
+}
+#endif
+
+void Renderer::SetValue(const std::string &identifier, std::string value) {
+  root_->PutValue(identifier, std::move(value));
+  bound_id_ = 0;
+}
+
+void Renderer::SetIterable(
+    const std::string &identifier,
+    std::vector<std::string> values) {
+  root_->PutIterable(identifier, std::move(values));
+  bound_id_ = 0;
+}
+
+void Renderer::SetGenerator(
+    const std::string &identifier,
+    std::shared_ptr<Generator> generator) {
+  root_->PutGenerator(identifier, std::move(generator));
+  bound_id_ = 0;
+}
+
+void Renderer::Bind(const Template &tmpl) {
+  slots_ = &bindings_;
+  if (bound_id_ == tmpl.id()) {
+    return;
+  }
+  bound_id_ = tmpl.id();
+  const auto &symbols = tmpl.symbols();
+  bindings_.assign(symbols.size(), SymbolBinding{nullptr, nullptr});
+  const auto &values = root_->printable_values();
+  const auto &arrays = root_->iterable_values();
+  if (values.size() + arrays.size() < symbols.size()) {
+    // The perfect hash of the template maps the root symbols to slots.
+    for (const auto &entry : values) {
+      auto slot = symbols.Find(entry.first);
+      if (slot != SymbolTable::kNotFound) {
+        bindings_[slot].value = &entry.second;
+      }
+    }
+    for (const auto &entry : arrays) {
+      auto slot = symbols.Find(entry.first);
+      if (slot != SymbolTable::kNotFound) {
+        bindings_[slot].array = &entry.second;
+      }
+    }
+    return;
+  }
+  for (std::uint32_t slot = 0; slot < symbols.size(); ++slot) {
+    auto value = values.find(symbols.name(slot));
+    if (value != values.end()) {
+      bindings_[slot].value = &value->second;
+    }
+    auto array = arrays.find(symbols.name(slot));
+    if (array != arrays.end()) {
+      bindings_[slot].array = &array->second;
+    }
+  }
+}
+
+bool Renderer::RenderLoop(
+    const Template &tmpl,
+    std::size_t index,
+    Sink &output) {
+  const auto &node = tmpl.nodes()[index];
+  const std::vector<std::string> *iterable = nullptr;
+  if (slots_ != nullptr) {
+    iterable = (*slots_)[node.slot].array;
+  } else {
+    iterable = top_->FindIterable(node.text);
+  }
+  if (iterable == nullptr) {
+    if (!top_->ContainsGenerator(node.text)) {
+      return Fail(Status::eUndefinedArray, NodeToken(node));
+    }
+    if (!node.zipped.empty()) {
+      return FailZippedGenerator(node.text, node);
+    }
+    return RenderGenerator(tmpl, index, top_->GetGenerator(node.text), output);
+  }
+  // Empty loops are skipped by jumping straight to their end.
+  const auto &array = *iterable;
+  // Kernels count the iterations up front, loops which would pass the
+  // limit are left to the generic path, which fails at the right
+  // element.
+  if (loop_kernels_ && node.kernel.enabled &&
+      iterations_ <= limits_.max_iterations &&
+      array.size() <= limits_.max_iterations - iterations_) {
+    return RenderKernel(node.kernel, array, output);
+  }
+  auto columns = zipped_columns_.size();
+  if (!node.zipped.empty() &&
+      !ResolveZipped(node, array.size(), zipped_columns_)) {
+    return false;
+  }
+  PushLoopFrame(index);
+  for (std::size_t i = 0; i < array.size(); ++i) {
+    if (!CountIteration()) {
+      return false;
+    }
+    top_->BindValue(node.item, array[i]);
+    // The columns of zipped loops are bound in place, the rows are
+    // never built.
+    for (std::size_t c = 0; c < node.zipped.size(); ++c) {
+      top_->BindValue(
+          node.zipped[c].item, (*zipped_columns_[columns + c])[i]);
+    }
+    top_->SetLoopPosition(i, array.size());
+    if (!Render(tmpl, index + 1, node.jump, output)) {
+      return false;
+    }
+  }
+  zipped_columns_.resize(columns);
+  RestoreParentFrame();
+  return true;
+}
+
+bool Renderer::RenderKernel(
+    const LoopKernel &kernel,
+    const std::vector<std::string> &array,
+    Sink &output) {
+  iterations_ += array.size();
+  if (array.empty()) {
+    return true;
+  }
+  if (kernel_buffer_ == nullptr) {
+    kernel_buffer_.reset(new char[kKernelBatchSize]);
+  }
+  // The output is the prefix, the elements joined by `kernel.joint`
+  // and the suffix. The size of each piece is bounded before it is
+  // copied, exactly for raw elements and by the longest replacement
+  // for escaped ones, so the buffer is then filled without checks.
+  auto expansion = kernel.escape == Escape::eNone ? 1 : kMaxReplacementSize;
+  auto *begin = kernel_buffer_.get();
+  BufferWriter writer{begin};
+  // Makes room for `size` bytes, `false` if they do not fit at all.
+  auto reserve = [&](std::size_t size) {
+    if (size > kKernelBatchSize - (writer.end - begin)) {
+      output.Write(begin, writer.end - begin);
+      writer.end = begin;
+    }
+    return size <= kKernelBatchSize;
+  };
+  for (std::size_t i = 0; i < array.size(); ++i) {
+    // The deadline is checked as often as by the generic path.
+    if ((i & 0x3f) == 0 && !CheckDeadline()) {
+      return false;
+    }
+    const auto &element = array[i];
+    const auto &before = i == 0 ? kernel.prefix : kernel.joint;
+    if (!reserve(before.size() + element.size() * expansion)) {
+      // Elements larger than a batch are written piece by piece.
+      output.WriteStable(before.data(), before.size());
+      WriteFiltered(
+          {}, kernel.escape, element.data(), element.size(), output,
+          filter_buffers_, true);
+      continue;
+    }
+    if (!before.empty()) {
+      writer.write(before.data(), before.size());
+    }
+    if (kernel.escape == Escape::eNone) {
+      writer.write(element.data(), element.size());
+    } else {
+      WriteEscapedTo(kernel.escape, element.data(), element.size(), writer);
+    }
+  }
+  if (reserve(kernel.suffix.size())) {
+    writer.write(kernel.suffix.data(), kernel.suffix.size());
+  } else {
+    output.WriteStable(kernel.suffix.data(), kernel.suffix.size());
+  }
+  output.Write(begin, writer.end - begin);
+  return true;
+}
+
+bool Renderer::ResolveZipped(
+    const Template::Node &node,
+    std::size_t length,
+    std::vector<const std::vector<std::string> *> &zipped) {
+  for (const auto &column : node.zipped) {
+    const std::vector<std::string> *array = nullptr;
+    if (slots_ != nullptr) {
+      array = (*slots_)[column.slot].array;
+    } else {
+      array = top_->FindIterable(column.array);
+    }
+    Token token(Token::Tag::eIdentifier, column.array, node.line, node.column);
+    if (array == nullptr) {
+      if (top_->ContainsGenerator(column.array)) {
+        return FailZippedGenerator(column.array, node);
+      }
+      return Fail(Status::eUndefinedArray, std::move(token));
+    }
+    if (array->size() != length) {
+      return Fail(
+          Status::eInvalidZippedLoop,
+          std::move(token),
+          "Array '" + column.array + "' has " + std::to_string(array->size()) +
+              " elements but '" + node.text + "' has " +
+              std::to_string(length));
+    }
+    zipped.push_back(array);
+  }
+  return true;
+}
+
+bool Renderer::FailZippedGenerator(
+    const std::string &generator,
+    const Template::Node &node) {
+  return Fail(
+      Status::eInvalidZippedLoop,
+      Token(Token::Tag::eIdentifier, generator, node.line, node.column),
+      "Generator '" + generator + "' cannot be zipped");
+}
+
+bool Renderer::RenderGenerator(
+    const Template &tmpl,
+    std::size_t index,
+    Generator &generator,
+    Sink &output) {
+  const auto &node = tmpl.nodes()[index];
+  // Each nesting level owns two buffers which are reused by every
+  // loop at that level, a deque keeps the outer ones in place.
+  while (generator_buffers_.size() < 2 * (generator_depth_ + 1)) {
+    generator_buffers_.emplace_back();
+  }
+  auto *current = &generator_buffers_[2 * generator_depth_];
+  auto *next = &generator_buffers_[2 * generator_depth_ + 1];
+  ++generator_depth_;
+
+  std::size_t size = 0;
+  auto size_known = generator.Size(size);
+  PushLoopFrame(index);
+  // The next element is produced before rendering the current one, so
+  // `@last` is known even if the size is not.
+  generator.Reset();
+  auto has_current = generator.Next(*current);
+  for (std::size_t i = 0; has_current; ++i) {
+    if (!CountIteration()) {
+      return false;
+    }
+    auto has_next = generator.Next(*next);
+    auto length = size_known ? size : (has_next ? i + 2 : i + 1);
+    top_->BindValue(node.item, *current);
+    top_->SetLoopPosition(i, length, size_known);
+    if (!Render(tmpl, index + 1, node.jump, output)) {
+      return false;
+    }
+    std::swap(current, next);
+    has_current = has_next;
+  }
+  --generator_depth_;
+  RestoreParentFrame();
+  return true;
+}
+
+bool Renderer::RenderCachedSection(
+    const Template &tmpl,
+    std::size_t index,
+    Sink &output,
+    bool &cached) {
+  cached = false;
+  auto dependencies = tmpl.section_dependencies(index);
+  if (dependencies == nullptr) {
+    return true;
+  }
+
+  FragmentKey key;
+  key.Add(tmpl.id());
+  key.Add(static_cast<std::uint64_t>(index));
+  for (const auto &value : dependencies->values) {
+    if (!top_->ContainsValue(value)) {
+      return true;
+    }
+    key.Add(top_->GetValue(value));
+  }
+  for (const auto &array : dependencies->arrays) {
+    if (!top_->ContainsIterable(array)) {
+      return true;
+    }
+    key.Add(top_->GetIterable(array));
+  }
+  for (const auto &condition : dependencies->conditions) {
+    key.Add(static_cast<std::uint64_t>(IsTrue(condition)));
+  }
+
+  auto fragment = fragment_cache_->Find(key);
+  if (fragment == nullptr) {
+    std::string rendered;
+    StringSink section(rendered);
+    if (!RenderLoop(tmpl, index, section)) {
+      return false;
+    }
+    fragment = std::make_shared<const std::string>(std::move(rendered));
+    fragment_cache_->Insert(std::move(key), fragment);
+  }
+  output.WriteStable(fragment->data(), fragment->size());
+  pinned_fragments_.push_back(std::move(fragment));
+  cached = true;
+  return true;
+}
+
+bool Renderer::CountIteration() {
+  if (++iterations_ > limits_.max_iterations) {
+    return Fail(
+        Status::eIterationLimitExceeded,
+        Token(),
+        std::to_string(limits_.max_iterations));
+  }
+  // Reading the clock on every iteration would dominate tight loops.
+  if ((iterations_ & 0x3f) == 0) {
+    return CheckDeadline();
+  }
+  return true;
+}
+
+bool Renderer::CheckDeadline() {
+  if (limits_.cancellation != nullptr && limits_.cancellation->cancelled()) {
+    return Fail(Status::eCancelled, Token());
+  }
+  if (limits_.deadline != std::chrono::steady_clock::time_point::max() &&
+      std::chrono::steady_clock::now() >= limits_.deadline) {
+    return Fail(Status::eDeadlineExceeded, Token());
+  }
+  return true;
+}
+
+const Frame *Renderer::LoopFrame(const Template::Node &node) {
+  if (top_ == root_) {
+    Fail(Status::eLoopMetadataOutsideLoop, NodeToken(node));
+    return nullptr;
+  }
+  return top_.get();
+}
+
+bool Renderer::RenderValue(const Template::Node &node, Sink &output) {
+  if (node.metadata != LoopMetadata::eNone) {
+    const auto *loop = LoopFrame(node);
+    if (loop == nullptr) {
+      return false;
     }
-    current = lexer_->Scan();
+    if (node.metadata == LoopMetadata::eLength && !loop->loop_length_known()) {
+      return Fail(Status::eLoopLengthUnknown, NodeToken(node));
+    }
+    char buffer[24];
+    auto size = FormatLoopMetadata(
+        node.metadata, loop->loop_index(), loop->loop_length(), buffer);
+    WriteFiltered(
+        node.filters, node.escape, buffer, size, output, filter_buffers_,
+        false);
+    return true;
+  }
+  // Templates validated against a schema never fail here, the lookup
+  // is the only cost.
+  const std::string *value = nullptr;
+  if (slots_ != nullptr && node.slot != SymbolTable::kNotFound) {
+    value = (*slots_)[node.slot].value;
+  }
+  if (value == nullptr) {
+    value = top_->FindValue(node.text);
   }
-  return lexer_->CurrentStreamPos();
+  if (value == nullptr) {
+    return Fail(Status::eUndefinedIdentifier, NodeToken(node));
+  }
+  // Elements of generators are overwritten by the following ones, so
+  // they cannot be written as stable bytes.
+  WriteFiltered(
+      node.filters,
+      node.escape,
+      value->data(),
+      value->size(),
+      output,
+      filter_buffers_,
+      generator_depth_ == 0);
+  return true;
 }
 
-std::tuple<Token, Token> Renderer::SetLoopFrame(const std::string &frame_id) {
-  auto array_id = lexer_->Scan(); // must be eIdentifier and exist
-  if (array_id.tag() != Token::Tag::eIdentifier) {
-    throw std::runtime_error(CreateError(array_id, Token::Tag::eIdentifier));
+bool Renderer::EvaluateCondition(const Template::Node &node, bool &value) {
+  if (node.metadata != LoopMetadata::eNone) {
+    const auto *loop = LoopFrame(node);
+    if (loop == nullptr) {
+      return false;
+    }
+    value = IsLoopMetadataTrue(
+        node.metadata, loop->loop_index(), loop->loop_length());
+    return true;
+  }
+  if (slots_ != nullptr && node.slot != SymbolTable::kNotFound) {
+    const auto &binding = (*slots_)[node.slot];
+    if (binding.value != nullptr) {
+      value = !binding.value->empty();
+      return true;
+    }
+    if (binding.array != nullptr) {
+      value = !binding.array->empty();
+      return true;
+    }
   }
-  if (!top_->ContainsIterable(array_id.value())) {
-    throw std::runtime_error("Array '" + array_id.value() + "' is undefined");
+  value = IsTrue(node.text);
+  return true;
+}
+
+bool Renderer::IsTrue(const std::string &symbol) const {
+  if (const auto *value = top_->FindValue(symbol)) {
+    return !value->empty();
   }
-  auto item_id = lexer_->Scan(); // must be eIdentifier does not need to exist
-  if (item_id.tag() != Token::Tag::eIdentifier) {
-    throw std::runtime_error(CreateError(item_id, Token::Tag::eIdentifier));
+  if (const auto *iterable = top_->FindIterable(symbol)) {
+    return !iterable->empty();
   }
-  auto current = lexer_->Scan(); // must be `}}`
-  if (current.tag() != Token::Tag::eScriptEnd) {
-    throw std::runtime_error(CreateError(current, Token::Tag::eScriptEnd));
+  if (top_->ContainsGenerator(symbol)) {
+    auto &generator = top_->GetGenerator(symbol);
+    std::size_t size = 0;
+    if (generator.Size(size)) {
+      return size != 0;
+    }
+    std::string first;
+    generator.Reset();
+    return generator.Next(first);
   }
+  return false;
+}
 
-  auto new_frame = std::make_shared<Frame>(top_, frame_id);
-  top_ = new_frame;
+bool Renderer::Fail(Status status, Token token, std::string detail) {
+  error_ = Result(status, std::move(token), std::move(detail));
+  return false;
+}
 
-  return {array_id, item_id};
+void Renderer::PushLoopFrame(std::size_t index) {
+  // The frame at each depth is created with the one below as its
+  // parent, which is the top frame whenever a loop at that depth
+  // begins.
+  if (loop_depth_ == loop_frames_.size()) {
+    loop_frames_.push_back(std::make_shared<Frame>(top_, "#loop"));
+  }
+  top_ = loop_frames_[loop_depth_++];
+  top_->Reset("#loop" + std::to_string(index));
 }
 
 void Renderer::RestoreParentFrame() {
@@ -137,21 +960,7 @@ void Renderer::RestoreParentFrame() {
     throw std::runtime_error("root frame has no parent.");
   }
   top_ = top_->parent();
-}
-
-std::string Renderer::CreateError(const Token &token, Token::Tag expected) {
-  return "Invalid Syntax: Expected '" + to_string(expected) + "' but got '" +
-         to_string(token.tag()) + "' " +
-         (token.value().empty() ? "" : ("('" + token.value() + "')")) +
-         " at line " + std::to_string(token.line()) + " column " +
-         std::to_string(token.column());
-}
-
-std::string Renderer::CreateError(const Token &token) {
-  return "Invalid Syntax: Unexpected token '" + to_string(token.tag()) + "' " +
-         (token.value().empty() ? "" : ("('" + token.value() + "')")) +
-         " at line " + std::to_string(token.line()) + " column " +
-         std::to_string(token.column());
+  --loop_depth_;
 }
 
 } // namespace yate
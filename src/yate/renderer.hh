@@ -1,8 +1,15 @@
 #pragma once
 
-#include "lexer.hh"
-#include "token.hh"
+#ifdef YATE_COROUTINES
+#include "async.hh"
+#endif
+#include "generator.hh"
+#include "limits.hh"
+#include "result.hh"
+#include "sink.hh"
+#include "template.hh"
 
+#include <deque>
 #include <memory>
 #include <string>
 #include <unordered_map>
@@ -10,7 +17,9 @@
 
 namespace yate {
 
+class FragmentCache;
 class Frame;
+class ValidatedTemplate;
 
 /// Interprest a template stored in an input stream and generates a
 /// rendered results which is copied in the output stream.
@@ -30,7 +39,10 @@ class Renderer {
   ~Renderer() {}
 
   /// Interprest a template stored in an input stream and generates a
-  /// rendered results which is copied in the output stream.
+  /// rendered results which is copied in the output stream. The
+  /// template is compiled first, so sections which are not rendered,
+  /// e.g. false conditionals or empty loops, are skipped without
+  /// being read again.
   /// NOTE: This function is not reentrant, so do not call it in a
   ///       multithreaded environment without protection.
   ///
@@ -39,43 +51,328 @@ class Renderer {
   ///        stored.
   void Render(std::istream &input, std::ostream &output);
 
+  /// Like `Render()`, but errors are returned instead of thrown. Syntax
+  /// errors and undefined symbols, the errors of the template itself,
+  /// are reported without raising exceptions and their message is only
+  /// formatted if the caller asks for it.
+  /// NOTE: This function is not reentrant either.
+  ///
+  /// @param input The stream from which the template will be read.
+  /// @param output The stream where the rendered output will be
+  ///        stored.
+  /// @return The outcome, `Render()` throws `Result::Throw()`.
+  Result TryRender(std::istream &input, std::ostream &output) noexcept;
+
+  /// Renders a template which has already been compiled, so the input
+  /// is not parsed again and loops do not need to seek the input.
+  /// NOTE: This function is not reentrant either.
+  ///
+  /// @param tmpl The compiled template.
+  /// @param output The stream where the rendered output will be
+  ///        stored.
+  void Render(const Template &tmpl, std::ostream &output);
+
+  /// Renders a compiled template into a sink. Literals of the template
+  /// and symbols of the renderer are written with
+  /// `Sink::WriteStable()`, so sinks can reference them without
+  /// copying. The sink is flushed before returning.
+  /// NOTE: This function is not reentrant either.
+  ///
+  /// @param tmpl The compiled template.
+  /// @param output The sink where the rendered output will be written.
+  void Render(const Template &tmpl, Sink &output);
+
+  /// Renders a compiled template into a sink, returning errors instead
+  /// of throwing them. Undefined symbols, loop metadata outside loops
+  /// and the deadline, iteration and cancellation limits unwind the
+  /// render with status codes. What may still throw, e.g. sinks,
+  /// filters, generators and the output limit, is caught and kept in
+  /// the result. The sink is flushed on success.
+  /// NOTE: This function is not reentrant either.
+  ///
+  /// @param tmpl The compiled template.
+  /// @param output The sink where the rendered output will be written.
+  /// @return The outcome, `Render()` throws `Result::Throw()`.
+  Result TryRender(const Template &tmpl, Sink &output) noexcept;
+
+  /// Renders a template validated against a schema. The renderer is
+  /// checked to define every symbol of the schema once, before
+  /// anything is written, so the render cannot fail halfway because
+  /// of an undefined symbol. Throws a `std::runtime_error` naming the
+  /// first symbol of the schema which is not set.
+  /// NOTE: This function is not reentrant either.
+  ///
+  /// @param validated The template and its schema.
+  /// @param output The sink where the rendered output will be written.
+  void Render(const ValidatedTemplate &validated, Sink &output);
+
+#ifdef YATE_COROUTINES
+  /// Renders a compiled template as a coroutine, for servers which
+  /// interleave many renders on an event loop. The render suspends
+  /// when the sink is full and while `values` resolves a symbol the
+  /// renderer does not define, and continues from the same node when
+  /// it is called back. Resolved values are stored like the ones given
+  /// to `SetValue()`, so each is resolved once. Loops are interpreted
+  /// without recursion, so suspending does not depend on the nesting
+  /// of the template. Limits and the fragment cache apply as in
+  /// `Render()`. Only available when built with `YATE_COROUTINES`.
+  /// NOTE: The renderer, template, sink and provider must outlive the
+  ///       task, and the renderer must not render anything else until
+  ///       the task finishes.
+  ///
+  /// @param tmpl The compiled template.
+  /// @param output The sink where the rendered output will be written.
+  ///        It is flushed when the render finishes.
+  /// @param values The provider of undefined symbols, may be
+  ///        `nullptr`.
+  /// @return The task, which starts rendering on `RenderTask::Start()`.
+  RenderTask RenderAsync(
+      const Template &tmpl,
+      AsyncSink &output,
+      AsyncValues *values = nullptr);
+#endif
+
+  /// Enables caching of the top-level sections of compiled templates.
+  /// When rendering a top-level loop, a key is computed from exactly
+  /// the symbols the loop reads and, if the cache already holds the
+  /// output for that key, it is copied instead of rendering the loop.
+  /// The cache can be shared among renderers.
+  ///
+  /// @param cache The cache to use or `nullptr` to disable caching.
+  void set_fragment_cache(std::shared_ptr<FragmentCache> cache) {
+    fragment_cache_ = std::move(cache);
+  }
+
+  /// Renders a single top-level node of a compiled template. Loops
+  /// and conditionals are rendered whole.
+  ///
+  /// @param tmpl The compiled template.
+  /// @param index The index of a node which is not inside a loop.
+  /// @param output The sink where the rendered output will be
+  ///        written. It is flushed before returning.
+  void RenderNode(const Template &tmpl, std::size_t index, Sink &output);
+
+  /// Sets or replaces a printable symbol for the following renders.
+  ///
+  /// @param identifier The symbol name.
+  /// @param value The value printed for the symbol.
+  void SetValue(const std::string &identifier, std::string value);
+
+  /// Sets or replaces an array for the following renders.
+  ///
+  /// @param identifier The symbol name.
+  /// @param values The elements of the array.
+  void SetIterable(
+      const std::string &identifier,
+      std::vector<std::string> values);
+
+  /// Sets or replaces a generator for the following renders. Loops
+  /// over `identifier` consume it element by element instead of
+  /// iterating an array, so the elements are never all in memory.
+  /// Arrays with the same name take precedence. Testing a generator in
+  /// an `#if` without a known size produces its first element.
+  ///
+  /// @param identifier The symbol name.
+  /// @param generator The generator, shared with the caller.
+  void SetGenerator(
+      const std::string &identifier,
+      std::shared_ptr<Generator> generator);
+
+  /// Bounds the work of the following renders. A render which passes
+  /// its deadline, writes more bytes or renders more loop iterations
+  /// than allowed, or whose cancellation token is cancelled, fails
+  /// with `RenderLimitExceeded`. Limits are checked as loops iterate,
+  /// the clock is only read every 64 iterations. Output written before
+  /// the error has already been given to the sink.
+  ///
+  /// @param limits The limits, by default nothing is limited.
+  void set_limits(RenderLimits limits) { limits_ = std::move(limits); }
+  const RenderLimits &limits() const { return limits_; }
+
+  /// Whether loops over arrays with the shape of a `LoopKernel` are
+  /// rendered by the kernel, which is the default. The output is the
+  /// same either way, disabling them is only useful to measure them.
+  /// Kernels write the output of many elements with a single
+  /// `Sink::Write()` and check the deadline once per batch of elements
+  /// rather than every 64 iterations.
+  ///
+  /// @param enabled Whether to use the kernels.
+  void set_loop_kernels(bool enabled) { loop_kernels_ = enabled; }
+  bool loop_kernels() const { return loop_kernels_; }
+
  private:
+  /// What the symbol of a slot of `Template::symbols()` is in the root
+  /// frame, `nullptr` if it is not a value or not an array.
+  struct SymbolBinding {
+    const std::string *value;
+    const std::vector<std::string> *array;
+  };
+
   std::shared_ptr<Frame> top_;
   std::shared_ptr<Frame> root_;
-  std::unique_ptr<Lexer> lexer_;
+  /// The frames of the loops, by nesting depth. They outlive their
+  /// loops and are reused by the following ones, so warm renders
+  /// allocate no frames.
+  std::vector<std::shared_ptr<Frame>> loop_frames_;
+  /// The number of loop frames above the root frame.
+  std::size_t loop_depth_;
+  /// The other arrays of the zipped loops being rendered, used as a
+  /// stack which keeps its memory between renders.
+  std::vector<const std::vector<std::string> *> zipped_columns_;
+  std::shared_ptr<FragmentCache> fragment_cache_;
+  /// Cached fragments written during the current render, kept alive
+  /// until the sink is flushed.
+  std::vector<std::shared_ptr<const std::string>> pinned_fragments_;
+  /// Intermediate results of filter chains, reused between values.
+  std::vector<std::string> filter_buffers_;
+  /// The current and next element of the loops over generators being
+  /// rendered, two per nesting level.
+  std::deque<std::string> generator_buffers_;
+  std::size_t generator_depth_;
+  RenderLimits limits_;
+  /// The loop iterations rendered by the current render.
+  std::size_t iterations_;
+  bool loop_kernels_;
+  /// Where loop kernels build the output of a batch, allocated by the
+  /// first one and kept between renders.
+  std::unique_ptr<char[]> kernel_buffer_;
+  /// The root symbols of the template with id `bound_id_`, by slot.
+  std::vector<SymbolBinding> bindings_;
+  std::uint64_t bound_id_;
+  /// `bindings_` while rendering the nodes of the bound template and
+  /// `nullptr` inside partials, whose slots refer to their own symbols
+  /// and whose symbols may be bound by the loops around the include.
+  const std::vector<SymbolBinding> *slots_;
+  /// The error of the current render, set by the functions returning
+  /// `false`.
+  Result error_;
 
-  /// This method actually performs the rendering after the lexer has
-  /// been initialized, which allows for this overload to be
-  /// recursively called.
+  /// Maps the symbols of `tmpl` to the root frame, unless they are
+  /// already mapped, walking whichever of the template symbols and the
+  /// root symbols is smaller. Values and arrays set afterwards clear
+  /// the mapping.
+  void Bind(const Template &tmpl);
+
+  /// Entry point of `TryRender()` and `RenderNode()`: renders the
+  /// nodes in the range [begin, end) from the root frame, enforcing
+  /// the limits, and flushes the sink.
   ///
-  /// @param output The stream where the rendered output will be
-  ///        stored.
-  /// @param write_output A boolean indicating whether the parsed
-  ///        elements should be written. Useful with empty loops
-  ///        and when implemented an `#if` keyword.
-  /// @return The position of the input stream at the moment this
-  ///        method returns.
-  StreamPos Render(std::ostream &output, bool write_output = true);
-
-  /// Creates a new Frame and sets it as the new top Frame. It returns
-  /// a tuple containing the identifiers to be used to iterate over
-  /// as well as the symbol which will be used for the loop variable.
-  ///
-  /// @param frame_id The frame identifier for the new  top frame.
-  /// @return A tuple where position 0 contains the identifier of the
-  ///        array the loop will iterate over and position 1 has the
-  ///        identifier where the loop value will be stored.
-  std::tuple<Token, Token> SetLoopFrame(const std::string &frame_id);
-  void RestoreParentFrame();
+  /// @return The outcome of the render.
+  Result RenderRange(
+      const Template &tmpl,
+      std::size_t begin,
+      std::size_t end,
+      Sink &output) noexcept;
+
+  /// Renders the nodes of `tmpl` in the range [begin, end), which is
+  /// either the whole template or the body of a section.
+  ///
+  /// @param tmpl The compiled template.
+  /// @param begin The index of the first node to be rendered.
+  /// @param end The index past the last node to be rendered.
+  /// @param output The sink where the rendered output will be
+  ///        written.
+  /// @return `false` on errors, which are stored in `error_`, as for
+  ///         the following functions.
+  bool Render(
+      const Template &tmpl,
+      std::size_t begin,
+      std::size_t end,
+      Sink &output);
 
-  /// Helper function to generate error strings when a token does not
-  /// match an specific expected one.
-  std::string CreateError(const Token &token, Token::Tag expected);
+  /// Renders every iteration of the loop which begins at `index`.
+  bool RenderLoop(const Template &tmpl, std::size_t index, Sink &output);
 
-  /// Helper function to generate error strings when a token does not
-  /// match an expected one, but there is no specific token which
-  /// could appear at that point.
-  std::string CreateError(const Token &token);
+  /// Renders a loop over `array` whose body has the shape of `kernel`.
+  /// The output of the elements is copied to `kernel_buffer_`, which
+  /// is written whenever the next element may not fit.
+  bool RenderKernel(
+      const LoopKernel &kernel,
+      const std::vector<std::string> &array,
+      Sink &output);
+
+  /// Finds the arrays iterated in step with the first one by a zipped
+  /// loop, which must have its length.
+  ///
+  /// @param node The `eLoopBegin` node.
+  /// @param length The length of the first array.
+  /// @param zipped Where the arrays are appended, in the order of
+  ///        `node.zipped`.
+  bool ResolveZipped(
+      const Template::Node &node,
+      std::size_t length,
+      std::vector<const std::vector<std::string> *> &zipped);
+
+  /// Fails because a zipped loop iterates a generator, whose length
+  /// is not known up front.
+  ///
+  /// @param generator The symbol of the generator.
+  /// @param node The `eLoopBegin` node.
+  bool FailZippedGenerator(
+      const std::string &generator,
+      const Template::Node &node);
+
+  /// Renders every iteration of the loop which begins at `index` over
+  /// the elements of a generator.
+  bool RenderGenerator(
+      const Template &tmpl,
+      std::size_t index,
+      Generator &generator,
+      Sink &output);
+
+  /// Renders the top-level loop which begins at `index` through the
+  /// fragment cache.
+  ///
+  /// @param cached Set to `false` if the section cannot be cached,
+  ///        e.g. because one of its symbols is undefined, in which
+  ///        case nothing was written.
+  bool RenderCachedSection(
+      const Template &tmpl,
+      std::size_t index,
+      Sink &output,
+      bool &cached);
+
+  /// Writes the value or loop metadata printed by `node`.
+  bool RenderValue(const Template::Node &node, Sink &output);
+
+  /// Evaluates the condition of the `#if` at `node`, which tests
+  /// either a symbol or loop metadata.
+  ///
+  /// @param value Where the truthiness of the condition is stored.
+  bool EvaluateCondition(const Template::Node &node, bool &value);
+
+  /// Evaluates the condition of an `#if`: values are true when they
+  /// are not empty, arrays when they have elements and undefined
+  /// symbols are false.
+  ///
+  /// @param symbol The symbol tested.
+  /// @return The truthiness of the symbol.
+  bool IsTrue(const std::string &symbol) const;
+
+  /// Counts a loop iteration against the limits, checking the
+  /// deadline and the cancellation token every 64 iterations.
+  bool CountIteration();
+
+  /// Fails if the deadline passed or the render was cancelled.
+  bool CheckDeadline();
+
+  /// Returns the frame of the innermost loop, from which the loop
+  /// metadata used by `node` is read.
+  ///
+  /// @return The frame or `nullptr` if no loop is being rendered.
+  const Frame *LoopFrame(const Template::Node &node);
+
+  /// Stores an error in `error_`.
+  ///
+  /// @return `false`, so rendering functions can return it.
+  bool Fail(Status status, Token token, std::string detail = std::string());
+
+  /// Makes a frame for the loop which begins at `index` the new top
+  /// frame, reusing the one of a previous loop at the same depth.
+  void PushLoopFrame(std::size_t index);
+
+  /// Makes the parent of the top frame the new top frame.
+  void RestoreParentFrame();
 };
 
 } // namespace yate
@@ -0,0 +1,172 @@
+#include "result.hh"
+
+#include "limits.hh"
+
+#include <stdexcept>
+#include <utility>
+
+namespace yate {
+
+namespace {
+
+std::string Position(const Token &token) {
+  return " at line " + std::to_string(token.line()) + " column " +
+      std::to_string(token.column());
+}
+
+} // namespace
+
+Result::Result()
+    : status_(Status::eOk),
+      token_(),
+      detail_(),
+      has_expected_(false),
+      expected_(Token::Tag::eEOF),
+      partials_(),
+      exception_() {}
+
+Result::Result(Status status, Token token, std::string detail)
+    : status_(status),
+      token_(std::move(token)),
+      detail_(std::move(detail)),
+      has_expected_(false),
+      expected_(Token::Tag::eEOF),
+      partials_(),
+      exception_() {}
+
+Result::Result(Status status, std::exception_ptr exception)
+    : status_(status),
+      token_(),
+      detail_(),
+      has_expected_(false),
+      expected_(Token::Tag::eEOF),
+      partials_(),
+      exception_(std::move(exception)) {}
+
+void Result::set_expected(Token::Tag expected) {
+  has_expected_ = true;
+  expected_ = expected;
+}
+
+bool Result::expected(Token::Tag &expected) const {
+  expected = expected_;
+  return has_expected_;
+}
+
+void Result::AddPartial(std::string name) {
+  partials_.insert(partials_.begin(), std::move(name));
+}
+
+std::string Result::Message() const {
+  std::string message;
+  for (const auto &partial : partials_) {
+    message += "In partial '" + partial + "': ";
+  }
+  if (exception_ != nullptr) {
+    try {
+      std::rethrow_exception(exception_);
+    } catch (const std::exception &e) {
+      return message + e.what();
+    } catch (...) {
+      return message + "Unknown error";
+    }
+  }
+
+  const auto &value = token_.value();
+  switch (status_) {
+    case Status::eOk:
+      return "";
+    case Status::eLexicalError:
+      return message + "Error found in line " + std::to_string(line()) +
+          " column " + std::to_string(column()) + ": " + detail_;
+    case Status::eUnexpectedToken:
+      return message +
+          (has_expected_ ? CreateError(token_, expected_)
+                         : CreateError(token_));
+    case Status::eUnmatchedSection:
+      return message + "Invalid Syntax: Unmatched '" +
+          to_string(token_.tag()) + "'";
+    case Status::eUnknownLoopMetadata:
+      return message + "Unknown loop metadata '" + value + "'" +
+          Position(token_);
+    case Status::eLoopMetadataOutsideLoop:
+      return message + "Loop metadata '" + value +
+          "' used outside of a loop" + Position(token_);
+    case Status::eLoopLengthUnknown:
+      return message +
+          "Loop metadata '@length' is not available for generators of "
+          "unknown size";
+    case Status::eUndefinedIdentifier:
+      return message + "Identifier '" + value + "' is undefined";
+    case Status::eUndefinedArray:
+      return message + "Array '" + value + "' is undefined";
+    case Status::ePartialNotFound:
+      return message + "Partial '" + value + "' not found" + Position(token_);
+    case Status::eRecursivePartial:
+      return message + "Partial '" + value + "' includes itself" +
+          Position(token_);
+    case Status::eInvalidFilter:
+      return message + detail_ + Position(token_);
+    case Status::eDeadlineExceeded:
+      return message + "Render deadline exceeded";
+    case Status::eCancelled:
+      return message + "Render cancelled";
+    case Status::eOutputLimitExceeded:
+      return message + "Render output exceeded " + detail_ + " bytes";
+    case Status::eIterationLimitExceeded:
+      return message + "Render exceeded " + detail_ + " loop iterations";
+    case Status::eException:
+      return message + detail_;
+    case Status::eInvalidZippedLoop:
+      return message + detail_ + Position(token_);
+  }
+  return message;
+}
+
+void Result::Throw() const {
+  if (exception_ != nullptr && partials_.empty()) {
+    std::rethrow_exception(exception_);
+  }
+  switch (status_) {
+    case Status::eDeadlineExceeded:
+      throw RenderLimitExceeded(
+          RenderLimitExceeded::Reason::eDeadline, Message());
+    case Status::eCancelled:
+      throw RenderLimitExceeded(
+          RenderLimitExceeded::Reason::eCancelled, Message());
+    case Status::eOutputLimitExceeded:
+      throw RenderLimitExceeded(
+          RenderLimitExceeded::Reason::eOutputSize, Message());
+    case Status::eIterationLimitExceeded:
+      throw RenderLimitExceeded(
+          RenderLimitExceeded::Reason::eIterations, Message());
+    default:
+      throw std::runtime_error(Message());
+  }
+}
+
+Result CurrentException() {
+  auto status = Status::eException;
+  try {
+    throw;
+  } catch (const RenderLimitExceeded &e) {
+    switch (e.reason()) {
+      case RenderLimitExceeded::Reason::eDeadline:
+        status = Status::eDeadlineExceeded;
+        break;
+      case RenderLimitExceeded::Reason::eOutputSize:
+        status = Status::eOutputLimitExceeded;
+        break;
+      case RenderLimitExceeded::Reason::eIterations:
+        status = Status::eIterationLimitExceeded;
+        break;
+      case RenderLimitExceeded::Reason::eCancelled:
+        status = Status::eCancelled;
+        break;
+    }
+  } catch (...) {
+  }
+  return Result(status, std::current_exception());
+}
+
+} // namespace yate
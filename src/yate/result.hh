@@ -0,0 +1,129 @@
+#pragma once
+
+#include "token.hh"
+
+#include <cstdint>
+#include <exception>
+#include <string>
+#include <vector>
+
+namespace yate {
+
+/// What went wrong while compiling or rendering a template.
+enum class Status {
+  eOk = 0,
+  eLexicalError = 1,             /// The input does not form a token.
+  eUnexpectedToken = 2,          /// A token is not valid at its position.
+  eUnmatchedSection = 3,         /// A `/loop`, `#else` or `/if` closes
+                                 /// no section.
+  eUnknownLoopMetadata = 4,      /// E.g. `@size`.
+  eLoopMetadataOutsideLoop = 5,  /// Loop metadata used outside a loop.
+  eLoopLengthUnknown = 6,        /// `@length` of a generator of unknown
+                                 /// size.
+  eUndefinedIdentifier = 7,      /// A value which is not defined.
+  eUndefinedArray = 8,           /// A loop over an undefined array.
+  ePartialNotFound = 9,          /// The partial cannot be loaded.
+  eRecursivePartial = 10,        /// A partial includes itself.
+  eInvalidFilter = 11,           /// An unknown filter or escaping mode,
+                                 /// or wrong arguments of a filter.
+  eDeadlineExceeded = 12,        /// See `RenderLimits`.
+  eCancelled = 13,
+  eOutputLimitExceeded = 14,
+  eIterationLimitExceeded = 15,
+  eException = 16,               /// Any other error, e.g. a sink which
+                                 /// cannot write or a failing filter.
+  eInvalidZippedLoop = 17        /// A zipped loop binding a different
+                                 /// number of symbols than arrays, or
+                                 /// over arrays of different lengths.
+};
+
+/// The outcome of `Compiler::TryCompile()` and `Renderer::TryRender()`.
+/// Failures keep what the error is made of, the status, the offending
+/// token and its position, and only format the message the throwing
+/// functions would have raised when `Message()` is called, so servers
+/// which turn errors into status codes never pay for it.
+class Result {
+ public:
+  /// A successful result.
+  Result();
+
+  /// A failure.
+  ///
+  /// @param status What went wrong.
+  /// @param token The offending token, e.g. the undefined identifier,
+  ///        positioned where the error was found. For lexical errors
+  ///        it holds the characters which could not be scanned.
+  /// @param detail For lexical and filter errors, their description.
+  ///        For limits, the limit exceeded.
+  Result(Status status, Token token, std::string detail = std::string());
+
+  /// A failure raised as an exception by code the library calls, e.g.
+  /// a sink or a filter. `Throw()` rethrows the same exception.
+  ///
+  /// @param status `eException` or, for `RenderLimitExceeded`, the
+  ///        status matching its reason.
+  /// @param exception The exception caught.
+  Result(Status status, std::exception_ptr exception);
+  ~Result() {}
+
+  // Result is copyable and movable.
+  Result(const Result &other) = default;
+  Result(Result &&other) = default;
+  Result &operator=(const Result &other) = default;
+  Result &operator=(Result &&other) = default;
+
+  bool ok() const { return status_ == Status::eOk; }
+  Status status() const { return status_; }
+  const Token &token() const { return token_; }
+  std::uint32_t line() const { return token_.line(); }
+  std::uint32_t column() const { return token_.column(); }
+
+  /// For `eUnexpectedToken`, sets the kind of token which should have
+  /// been found, if there is a single one.
+  ///
+  /// @param expected The kind of token expected.
+  void set_expected(Token::Tag expected);
+
+  /// @param expected Where the expected kind of token is stored.
+  /// @return Whether the error expects a single kind of token.
+  bool expected(Token::Tag &expected) const;
+
+  /// Records that the error happened in a partial, which is included
+  /// by the partials added before, from the innermost outwards.
+  ///
+  /// @param name The name of the partial.
+  void AddPartial(std::string name);
+
+  /// @return The partials in which the error happened, from the
+  ///         outermost to the innermost.
+  const std::vector<std::string> &partials() const { return partials_; }
+
+  /// Formats the message of the error, the same `Compile()` and
+  /// `Render()` throw.
+  ///
+  /// @return The message or an empty string if the result is `ok()`.
+  std::string Message() const;
+
+  /// Throws the error as the throwing API does: the exception caught
+  /// if there is one, `RenderLimitExceeded` for limits and a
+  /// `std::runtime_error` with `Message()` otherwise.
+  [[noreturn]] void Throw() const;
+
+ private:
+  Status status_;
+  Token token_;
+  std::string detail_;
+  bool has_expected_;
+  Token::Tag expected_;
+  std::vector<std::string> partials_;
+  std::exception_ptr exception_;
+};
+
+/// Converts the exception being handled into a failure, keeping the
+/// reason of `RenderLimitExceeded` as its status. It must be called
+/// from a `catch` block.
+///
+/// @return The failure, which rethrows the exception on `Throw()`.
+Result CurrentException();
+
+} // namespace yate
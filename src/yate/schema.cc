@@ -0,0 +1,132 @@
+#include "schema.hh"
+
+#include <algorithm>
+#include <utility>
+
+namespace yate {
+
+namespace {
+
+/// Validates the nodes of `tmpl`, where `items` holds the symbols bound
+/// by the loops around them, innermost last.
+void ValidateNodes(
+    const Template &tmpl,
+    const Schema &schema,
+    const std::string &prefix,
+    std::vector<std::string> &items,
+    std::vector<SchemaViolation> &violations) {
+  auto bound = [&items](const std::string &symbol) {
+    return std::find(items.begin(), items.end(), symbol) != items.end();
+  };
+  auto report = [&](const Template::Node &node, const std::string &message) {
+    violations.push_back({prefix + message, node.line, node.column});
+  };
+  // The number of items bound by each loop opened in this template.
+  std::vector<std::size_t> counts;
+
+  for (const auto &node : tmpl.nodes()) {
+    switch (node.kind) {
+      case Template::Node::Kind::eValue:
+      case Template::Node::Kind::eIfBegin:
+        if (node.metadata != LoopMetadata::eNone) {
+          if (items.empty()) {
+            report(
+                node,
+                "Loop metadata '" + node.text + "' used outside of a loop");
+          }
+        } else if (node.kind == Template::Node::Kind::eValue) {
+          if (!bound(node.text) && schema.values.count(node.text) == 0) {
+            report(
+                node,
+                "Identifier '" + node.text + "' is not declared in the schema");
+          }
+        } else if (
+            !bound(node.text) && schema.values.count(node.text) == 0 &&
+            schema.arrays.count(node.text) == 0) {
+          report(
+              node,
+              "Condition '" + node.text + "' is not declared in the schema");
+        }
+        break;
+
+      case Template::Node::Kind::eLoopBegin:
+        if (schema.arrays.count(node.text) == 0) {
+          report(
+              node, "Array '" + node.text + "' is not declared in the schema");
+        }
+        items.push_back(node.item);
+        for (const auto &zipped : node.zipped) {
+          if (schema.arrays.count(zipped.array) == 0) {
+            report(
+                node,
+                "Array '" + zipped.array + "' is not declared in the schema");
+          }
+          items.push_back(zipped.item);
+        }
+        counts.push_back(node.zipped.size() + 1);
+        break;
+
+      case Template::Node::Kind::eLoopEnd:
+        if (!counts.empty()) {
+          items.resize(items.size() - counts.back());
+          counts.pop_back();
+        }
+        break;
+
+      case Template::Node::Kind::eInclude:
+        // Partials see the loops around the include.
+        ValidateNodes(
+            *node.partial,
+            schema,
+            prefix + "In partial '" + node.text + "': ",
+            items,
+            violations);
+        break;
+
+      case Template::Node::Kind::eLiteral:
+      case Template::Node::Kind::eElse:
+      case Template::Node::Kind::eIfEnd:
+        break;
+    }
+  }
+}
+
+std::string Describe(const std::vector<SchemaViolation> &violations) {
+  std::string message;
+  for (const auto &violation : violations) {
+    if (!message.empty()) {
+      message += '\n';
+    }
+    message += violation.message + " at line " +
+        std::to_string(violation.line) + " column " +
+        std::to_string(violation.column);
+  }
+  return message;
+}
+
+} // namespace
+
+std::vector<SchemaViolation> Validate(
+    const Template &tmpl,
+    const Schema &schema) {
+  std::vector<SchemaViolation> violations;
+  std::vector<std::string> items;
+  ValidateNodes(tmpl, schema, "", items, violations);
+  return violations;
+}
+
+SchemaError::SchemaError(std::vector<SchemaViolation> violations)
+    : std::runtime_error(Describe(violations)),
+      violations_(std::move(violations)) {}
+
+ValidatedTemplate::ValidatedTemplate(
+    std::shared_ptr<const Template> tmpl,
+    Schema schema)
+    : tmpl_(std::move(tmpl)), schema_(std::move(schema)) {
+  auto violations = Validate(*tmpl_, schema_);
+  if (!violations.empty()) {
+    throw SchemaError(std::move(violations));
+  }
+}
+
+} // namespace yate
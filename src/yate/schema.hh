@@ -0,0 +1,81 @@
+#pragma once
+
+#include "template.hh"
+
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+namespace yate {
+
+/// The symbols a template may use: the printable values and the
+/// arrays, or generators, given to the renderer.
+struct Schema {
+  std::unordered_set<std::string> values;
+  std::unordered_set<std::string> arrays;
+};
+
+/// A use of a symbol which the schema does not declare.
+struct SchemaViolation {
+  /// The description of the problem, without its position.
+  std::string message;
+  /// The position of the offending tag in the template or, for
+  /// violations inside partials, in the partial.
+  std::uint32_t line;
+  std::uint32_t column;
+};
+
+/// Checks every value, loop and condition of a template, including
+/// its partials, against a schema. Values have to be declared or bound
+/// by a loop around them, loops have to iterate declared arrays and
+/// conditions have to test either. Loop metadata is only allowed
+/// inside loops.
+///
+/// @param tmpl The compiled template.
+/// @param schema The symbols the template may use.
+/// @return Every violation, in the order of the template.
+std::vector<SchemaViolation> Validate(
+    const Template &tmpl,
+    const Schema &schema);
+
+/// Error raised when a template does not conform to its schema. The
+/// message lists every violation, one per line.
+class SchemaError : public std::runtime_error {
+ public:
+  /// @param violations The violations found, at least one.
+  SchemaError(std::vector<SchemaViolation> violations);
+
+  const std::vector<SchemaViolation> &violations() const {
+    return violations_;
+  }
+
+ private:
+  std::vector<SchemaViolation> violations_;
+};
+
+/// A template which was checked against its schema, e.g. when it was
+/// deployed. `Renderer::Render()` checks the renderer defines every
+/// symbol of the schema before writing anything, so rendering it never
+/// fails halfway because of an undefined symbol.
+class ValidatedTemplate {
+ public:
+  /// Validates `tmpl`, throwing a `SchemaError` with every violation
+  /// if it does not conform to `schema`.
+  ///
+  /// @param tmpl The compiled template.
+  /// @param schema The symbols the template may use.
+  ValidatedTemplate(std::shared_ptr<const Template> tmpl, Schema schema);
+  ~ValidatedTemplate() {}
+
+  const Template &tmpl() const { return *tmpl_; }
+  const Schema &schema() const { return schema_; }
+
+ private:
+  std::shared_ptr<const Template> tmpl_;
+  Schema schema_;
+};
+
+} // namespace yate
@@ -0,0 +1,20 @@
+#include "sink.hh"
+
+#include <ostream>
+#include <string>
+
+namespace yate {
+
+StreamSink::StreamSink(std::ostream &stream) : stream_(stream) {}
+
+void StreamSink::Write(const char *data, std::size_t size) {
+  stream_.write(data, static_cast<std::streamsize>(size));
+}
+
+StringSink::StringSink(std::string &output) : output_(output) {}
+
+void StringSink::Write(const char *data, std::size_t size) {
+  output_.append(data, size);
+}
+
+} // namespace yate
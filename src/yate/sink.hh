@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstddef>
+#include <iosfwd>
+#include <string>
+
+namespace yate {
+
+/// Destination of the rendered output of a compiled template. Besides
+/// plain writes, the renderer tells the sink which bytes stay valid
+/// after the call, e.g. the literals of the template or the symbols
+/// given to the renderer, so sinks which can defer the copy (like
+/// `FdSink`) may keep a reference to them instead.
+class Sink {
+ public:
+  virtual ~Sink() {}
+
+  /// Writes bytes which are only valid during the call.
+  ///
+  /// @param data The bytes to be written.
+  /// @param size The number of bytes.
+  virtual void Write(const char *data, std::size_t size) = 0;
+
+  /// Writes bytes which stay valid and unchanged until the next call
+  /// to `Flush()` returns. By default they are written with `Write()`.
+  ///
+  /// @param data The bytes to be written.
+  /// @param size The number of bytes.
+  virtual void WriteStable(const char *data, std::size_t size) {
+    Write(data, size);
+  }
+
+  /// Delivers every byte written so far to its final destination.
+  /// After this call returns the sink does not reference any of the
+  /// bytes given to `WriteStable()`.
+  virtual void Flush() {}
+};
+
+/// Sink which writes to a `std::ostream`.
+class StreamSink : public Sink {
+ public:
+  /// @param stream The stream where the output is written.
+  StreamSink(std::ostream &stream);
+  ~StreamSink() {}
+
+  void Write(const char *data, std::size_t size) override;
+
+ private:
+  std::ostream &stream_;
+};
+
+/// Sink which appends to a `std::string`. Reserving the string in
+/// advance avoids any allocation while rendering.
+class StringSink : public Sink {
+ public:
+  /// @param output The string where the output is appended.
+  StringSink(std::string &output);
+  ~StringSink() {}
+
+  void Write(const char *data, std::size_t size) override;
+
+ private:
+  std::string &output_;
+};
+
+} // namespace yate
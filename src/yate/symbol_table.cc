@@ -0,0 +1,158 @@
+#include "symbol_table.hh"
+
+#include <algorithm>
+
+namespace yate {
+
+namespace {
+
+/// FNV-1a, computed once per lookup.
+std::uint64_t HashName(const std::string &name) {
+  std::uint64_t hash = 0xcbf29ce484222325ull;
+  for (auto c : name) {
+    hash ^= static_cast<unsigned char>(c);
+    hash *= 0x100000001b3ull;
+  }
+  return hash;
+}
+
+/// Derives independent hashes from the hash of a name, the finalizer
+/// of MurmurHash3 spreads the seed over every bit.
+std::uint64_t Mix(std::uint64_t hash, std::uint64_t seed) {
+  hash ^= seed * 0x9e3779b97f4a7c15ull;
+  hash ^= hash >> 33;
+  hash *= 0xff51afd7ed558ccdull;
+  hash ^= hash >> 33;
+  hash *= 0xc4ceb9fe1a85ec53ull;
+  hash ^= hash >> 33;
+  return hash;
+}
+
+} // namespace
+
+const std::uint32_t SymbolTable::kNotFound;
+
+SymbolTable::SymbolTable()
+    : names_(), index_(), built_(false), seeds_(), positions_() {}
+
+std::uint32_t SymbolTable::Find(const std::string &name) const {
+  if (!built_) {
+    auto it = index_.find(name);
+    return it == index_.end() ? kNotFound : it->second;
+  }
+  auto hash = HashName(name);
+  auto bucket = Mix(hash, 0) % seeds_.size();
+  auto position = Mix(hash, seeds_[bucket]) % positions_.size();
+  auto slot = positions_[position];
+  // Layouts with more positions than names leave some of them empty.
+  if (slot == kNotFound) {
+    return kNotFound;
+  }
+  return names_[slot] == name ? slot : kNotFound;
+}
+
+std::uint32_t SymbolTable::Add(const std::string &name) {
+  auto slot = Find(name);
+  if (slot != kNotFound) {
+    return slot;
+  }
+  if (built_) {
+    // Back to the map until the next build.
+    for (std::uint32_t i = 0; i < names_.size(); ++i) {
+      index_[names_[i]] = i;
+    }
+    built_ = false;
+    seeds_.clear();
+    positions_.clear();
+  }
+  slot = static_cast<std::uint32_t>(names_.size());
+  names_.push_back(name);
+  index_[name] = slot;
+  return slot;
+}
+
+void SymbolTable::Build(std::size_t spread) {
+  if (built_ || names_.empty()) {
+    return;
+  }
+  std::vector<std::uint64_t> hashes;
+  hashes.reserve(names_.size());
+  for (const auto &name : names_) {
+    hashes.push_back(HashName(name));
+  }
+
+  // About two names per bucket keeps the seed search short. When a
+  // bucket finds no seed, which is very unlikely, the search restarts
+  // with one name per bucket and then with more positions than names.
+  auto count = names_.size();
+  for (auto positions = spread * count; positions <= 4 * spread * count;
+       positions *= 2) {
+    for (auto buckets = (count + 1) / 2; buckets <= count; buckets *= 2) {
+      if (Place(hashes, buckets, positions)) {
+        built_ = true;
+        index_.clear();
+        return;
+      }
+    }
+  }
+  // Only names whose hashes collide get here, since no seed tells
+  // them apart. They keep using the map.
+  seeds_.clear();
+  positions_.clear();
+}
+
+bool SymbolTable::Place(
+    const std::vector<std::uint64_t> &hashes,
+    std::size_t bucket_count,
+    std::size_t position_count) {
+  std::vector<std::vector<std::uint32_t>> buckets(bucket_count);
+  for (std::uint32_t slot = 0; slot < names_.size(); ++slot) {
+    buckets[Mix(hashes[slot], 0) % bucket_count].push_back(slot);
+  }
+  // The largest buckets are placed first, while most positions are
+  // still free.
+  std::vector<std::size_t> order(bucket_count);
+  for (std::size_t i = 0; i < bucket_count; ++i) {
+    order[i] = i;
+  }
+  std::stable_sort(
+      order.begin(), order.end(), [&buckets](std::size_t a, std::size_t b) {
+        return buckets[a].size() > buckets[b].size();
+      });
+
+  seeds_.assign(bucket_count, 0);
+  positions_.assign(position_count, kNotFound);
+  std::vector<std::size_t> taken;
+  for (auto bucket : order) {
+    const auto &slots = buckets[bucket];
+    if (slots.empty()) {
+      break;
+    }
+    auto placed = false;
+    for (std::uint32_t seed = 1; seed < (1u << 16) && !placed; ++seed) {
+      taken.clear();
+      placed = true;
+      for (auto slot : slots) {
+        auto position = Mix(hashes[slot], seed) % position_count;
+        if (positions_[position] != kNotFound ||
+            std::find(taken.begin(), taken.end(), position) != taken.end()) {
+          placed = false;
+          break;
+        }
+        taken.push_back(position);
+      }
+      if (placed) {
+        seeds_[bucket] = seed;
+        for (std::size_t i = 0; i < slots.size(); ++i) {
+          positions_[taken[i]] = slots[i];
+        }
+      }
+    }
+    if (!placed) {
+      return false;
+    }
+  }
+  return true;
+}
+
+} // namespace yate
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace yate {
+
+/// The names of the symbols a template reads from the root of the
+/// renderer, each with a dense slot number. Names are found through a
+/// minimal perfect hash built with the hash and displace method: a
+/// first hash picks a bucket, whose displacement seed makes a second
+/// hash land every name of the table on a different position, so a
+/// lookup hashes the name once and compares a single candidate.
+///
+/// The hash is built once, by `Build()`, after the names are added.
+/// Until then, and for the rare sets of names which no seed separates,
+/// names are found through an ordinary hash map.
+class SymbolTable {
+ public:
+  /// Returned by `Find()` for names which are not in the table.
+  static const std::uint32_t kNotFound = 0xffffffff;
+
+  SymbolTable();
+  ~SymbolTable() {}
+
+  /// Looks a name up.
+  ///
+  /// @param name The name of the symbol.
+  /// @return Its slot or `kNotFound`.
+  std::uint32_t Find(const std::string &name) const;
+
+  /// Adds a name. A new name discards the perfect hash until the next
+  /// `Build()`, so adding N names costs O(N).
+  ///
+  /// @param name The name of the symbol.
+  /// @return Its slot, the number of names added before it.
+  std::uint32_t Add(const std::string &name);
+
+  /// Builds the perfect hash of the names added so far, unless it is
+  /// already built.
+  ///
+  /// @param spread The number of positions per name of the first
+  ///     layout tried, up to four times more are tried after it.
+  void Build(std::size_t spread = 1);
+
+  /// @return The number of names, slots go from 0 to `size() - 1`.
+  std::size_t size() const { return names_.size(); }
+
+  /// @return The number of positions of the perfect hash, 0 while it
+  ///     is not built.
+  std::size_t position_count() const { return positions_.size(); }
+
+  /// @return The name stored in `slot`.
+  const std::string &name(std::uint32_t slot) const { return names_[slot]; }
+
+ private:
+  /// Finds a seed for every bucket which places the names on distinct
+  /// positions among `position_count`.
+  ///
+  /// @param hashes The hash of each name, by slot.
+  /// @return `false` if some bucket found no seed.
+  bool Place(
+      const std::vector<std::uint64_t> &hashes,
+      std::size_t bucket_count,
+      std::size_t position_count);
+
+  /// The names, indexed by slot.
+  std::vector<std::string> names_;
+  /// The slot of each name while the perfect hash is not built.
+  std::unordered_map<std::string, std::uint32_t> index_;
+  bool built_;
+  /// The displacement seed of each bucket.
+  std::vector<std::uint32_t> seeds_;
+  /// The slot of the name hashed to each position.
+  std::vector<std::uint32_t> positions_;
+};
+
+} // namespace yate
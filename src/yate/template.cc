@@ -0,0 +1,665 @@
+#include "template.hh"
+
+#include "utils.hh"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+namespace yate {
+
+bool ParseLoopMetadata(const std::string &name, LoopMetadata &metadata) {
+  static const std::pair<const char *, LoopMetadata> kNames[] = {
+      {"@index", LoopMetadata::eIndex},
+      {"@number", LoopMetadata::eNumber},
+      {"@first", LoopMetadata::eFirst},
+      {"@last", LoopMetadata::eLast},
+      {"@length", LoopMetadata::eLength}};
+  for (const auto &entry : kNames) {
+    if (name == entry.first) {
+      metadata = entry.second;
+      return true;
+    }
+  }
+  return false;
+}
+
+std::size_t FormatLoopMetadata(
+    LoopMetadata metadata,
+    std::size_t index,
+    std::size_t length,
+    char (&buffer)[24]) {
+  std::size_t number = 0;
+  switch (metadata) {
+    case LoopMetadata::eIndex:
+      number = index;
+      break;
+    case LoopMetadata::eNumber:
+      number = index + 1;
+      break;
+    case LoopMetadata::eLength:
+      number = length;
+      break;
+    case LoopMetadata::eFirst:
+    case LoopMetadata::eLast:
+    case LoopMetadata::eNone: {
+      auto flag = IsLoopMetadataTrue(metadata, index, length);
+      std::memcpy(buffer, flag ? "true" : "false", flag ? 4 : 5);
+      return flag ? 4 : 5;
+    }
+  }
+  // Digits are written from the end of the buffer and moved to the
+  // front.
+  std::size_t begin = sizeof(buffer);
+  do {
+    buffer[--begin] = static_cast<char>('0' + number % 10);
+    number /= 10;
+  } while (number != 0);
+  auto size = sizeof(buffer) - begin;
+  std::memmove(buffer, buffer + begin, size);
+  return size;
+}
+
+bool IsLoopMetadataTrue(
+    LoopMetadata metadata,
+    std::size_t index,
+    std::size_t length) {
+  switch (metadata) {
+    case LoopMetadata::eIndex:
+      return index != 0;
+    case LoopMetadata::eFirst:
+      return index == 0;
+    case LoopMetadata::eLast:
+      return index + 1 == length;
+    case LoopMetadata::eNumber:
+    case LoopMetadata::eLength:
+      return true;
+    case LoopMetadata::eNone:
+      break;
+  }
+  return false;
+}
+
+namespace {
+
+/// Tells whether a loop binds `symbol` to its elements.
+bool LoopBinds(const Template::Node &loop, const std::string &symbol) {
+  return loop.item == symbol ||
+      std::any_of(
+             loop.zipped.begin(),
+             loop.zipped.end(),
+             [&symbol](const Template::Node::Zipped &zipped) {
+               return zipped.item == symbol;
+             });
+}
+
+} // namespace
+
+Template::Template()
+    : nodes_(), open_sections_(), sections_(), symbols_(), id_(0) {
+  Touch();
+}
+
+const Template::Dependencies *Template::section_dependencies(
+    std::size_t index) const {
+  auto it = sections_.find(index);
+  return it == sections_.end() ? nullptr : &it->second;
+}
+
+Template::Dependencies Template::CollectDependencies(
+    std::size_t begin,
+    std::size_t end) const {
+  Dependencies result;
+  // The loops open at each node.
+  std::vector<const Node *> scope;
+  auto bound = [&scope](const std::string &symbol) {
+    return std::find_if(
+               scope.begin(), scope.end(), [&symbol](const Node *loop) {
+                 return LoopBinds(*loop, symbol);
+               }) != scope.end();
+  };
+  for (auto i = begin; i < end; ++i) {
+    const auto &node = nodes_[i];
+    switch (node.kind) {
+      case Node::Kind::eValue:
+        if (node.metadata == LoopMetadata::eNone && !bound(node.text)) {
+          append_unique(result.values, node.text);
+        }
+        break;
+      case Node::Kind::eLoopBegin:
+        append_unique(result.arrays, node.text);
+        for (const auto &zipped : node.zipped) {
+          append_unique(result.arrays, zipped.array);
+        }
+        scope.push_back(&node);
+        break;
+      case Node::Kind::eLoopEnd:
+        scope.pop_back();
+        break;
+      case Node::Kind::eIfBegin:
+        if (node.metadata == LoopMetadata::eNone && !bound(node.text)) {
+          append_unique(result.conditions, node.text);
+        }
+        break;
+      case Node::Kind::eInclude: {
+        // Partials see the symbols bound by the loops around them.
+        const auto &partial = *node.partial;
+        auto inner = partial.CollectDependencies(0, partial.nodes_.size());
+        for (const auto &value : inner.values) {
+          if (!bound(value)) {
+            append_unique(result.values, value);
+          }
+        }
+        for (const auto &array : inner.arrays) {
+          append_unique(result.arrays, array);
+        }
+        for (const auto &condition : inner.conditions) {
+          if (!bound(condition)) {
+            append_unique(result.conditions, condition);
+          }
+        }
+      } break;
+      case Node::Kind::eLiteral:
+      case Node::Kind::eElse:
+      case Node::Kind::eIfEnd:
+        break;
+    }
+  }
+  return result;
+}
+
+void Template::Touch() {
+  static std::atomic<std::uint64_t> next_id(1);
+  id_ = next_id++;
+}
+
+std::uint32_t Template::SlotOf(const std::string &symbol) {
+  for (auto index : open_sections_) {
+    const auto &node = nodes_[index];
+    if (node.kind == Node::Kind::eLoopBegin && LoopBinds(node, symbol)) {
+      return SymbolTable::kNotFound;
+    }
+  }
+  return symbols_.Add(symbol);
+}
+
+void Template::AppendLiteral(
+    const std::string &text,
+    std::uint32_t line,
+    std::uint32_t column) {
+  if (text.empty()) {
+    return;
+  }
+  Touch();
+  if (!nodes_.empty() && nodes_.back().kind == Node::Kind::eLiteral) {
+    nodes_.back().text += text;
+    return;
+  }
+  nodes_.push_back({Node::Kind::eLiteral, text, "", 0, line, column});
+}
+
+void Template::AppendValue(
+    std::string identifier,
+    std::uint32_t line,
+    std::uint32_t column,
+    Escape escape,
+    std::vector<FilterCall> filters,
+    LoopMetadata metadata) {
+  Touch();
+  nodes_.push_back(
+      {Node::Kind::eValue,
+       std::move(identifier),
+       "",
+       0,
+       line,
+       column,
+       escape,
+       std::move(filters),
+       nullptr,
+       metadata});
+  auto &node = nodes_.back();
+  if (metadata == LoopMetadata::eNone) {
+    node.slot = SlotOf(node.text);
+  }
+}
+
+void Template::AppendInclude(
+    std::string name,
+    std::shared_ptr<const Template> partial,
+    std::uint32_t line,
+    std::uint32_t column) {
+  Touch();
+  nodes_.push_back(
+      {Node::Kind::eInclude,
+       std::move(name),
+       "",
+       0,
+       line,
+       column,
+       Escape::eNone,
+       {},
+       std::move(partial)});
+}
+
+void Template::AppendTemplate(const Template &other) {
+  if (other.nodes_.empty()) {
+    return;
+  }
+  Touch();
+  std::size_t first = 0;
+  if (other.nodes_.front().kind == Node::Kind::eLiteral && !nodes_.empty() &&
+      nodes_.back().kind == Node::Kind::eLiteral) {
+    nodes_.back().text += other.nodes_.front().text;
+    first = 1;
+  }
+  // The node at index `i` of `other` is copied to `i + offset`.
+  auto offset = nodes_.size() - first;
+  for (auto i = first; i < other.nodes_.size(); ++i) {
+    nodes_.push_back(other.nodes_[i]);
+    auto &node = nodes_.back();
+    // Slots refer to the symbols of `other`, symbols it reads from the
+    // root may be bound by the loops open here.
+    if (node.slot != SymbolTable::kNotFound) {
+      node.slot = node.kind == Node::Kind::eLoopBegin
+          ? symbols_.Add(node.text)
+          : SlotOf(node.text);
+    }
+    for (auto &zipped : node.zipped) {
+      zipped.slot = symbols_.Add(zipped.array);
+    }
+    if (node.kind != Node::Kind::eLiteral &&
+        node.kind != Node::Kind::eValue &&
+        node.kind != Node::Kind::eInclude) {
+      node.jump += offset;
+    }
+  }
+  if (open_sections_.empty()) {
+    for (const auto &section : other.sections_) {
+      sections_[section.first + offset] = section.second;
+    }
+  }
+}
+
+void Template::BeginLoop(
+    std::string array,
+    std::string item,
+    std::uint32_t line,
+    std::uint32_t column,
+    std::vector<Node::Zipped> zipped) {
+  Touch();
+  // Arrays are only defined at the root.
+  auto slot = symbols_.Add(array);
+  for (auto &other : zipped) {
+    other.slot = symbols_.Add(other.array);
+  }
+  open_sections_.push_back(nodes_.size());
+  nodes_.push_back(
+      {Node::Kind::eLoopBegin,
+       std::move(array),
+       std::move(item),
+       0,
+       line,
+       column});
+  nodes_.back().slot = slot;
+  nodes_.back().zipped = std::move(zipped);
+}
+
+void Template::EndLoop(std::uint32_t line, std::uint32_t column) {
+  if (!CanClose(Node::Kind::eLoopEnd)) {
+    throw std::runtime_error("Invalid Syntax: Unmatched 'LOOP_END'");
+  }
+  CloseSection(Node::Kind::eLoopEnd, line, column);
+}
+
+void Template::BeginIf(
+    std::string symbol,
+    std::uint32_t line,
+    std::uint32_t column,
+    LoopMetadata metadata) {
+  Touch();
+  auto slot = metadata == LoopMetadata::eNone ? SlotOf(symbol)
+                                              : SymbolTable::kNotFound;
+  open_sections_.push_back(nodes_.size());
+  nodes_.push_back(
+      {Node::Kind::eIfBegin,
+       std::move(symbol),
+       "",
+       0,
+       line,
+       column,
+       Escape::eNone,
+       {},
+       nullptr,
+       metadata});
+  nodes_.back().slot = slot;
+}
+
+void Template::Else(std::uint32_t line, std::uint32_t column) {
+  if (!CanClose(Node::Kind::eElse)) {
+    throw std::runtime_error("Invalid Syntax: Unmatched 'ELSE'");
+  }
+  Touch();
+  // A false condition continues right after the `eElse`.
+  nodes_[open_sections_.back()].jump = nodes_.size();
+  nodes_.push_back({Node::Kind::eElse, "", "", 0, line, column});
+}
+
+void Template::EndIf(std::uint32_t line, std::uint32_t column) {
+  if (!CanClose(Node::Kind::eIfEnd)) {
+    throw std::runtime_error("Invalid Syntax: Unmatched 'IF_END'");
+  }
+  CloseSection(Node::Kind::eIfEnd, line, column);
+}
+
+void Template::CloseSections(std::uint32_t line, std::uint32_t column) {
+  while (!open_sections_.empty()) {
+    auto kind = nodes_[open_sections_.back()].kind == Node::Kind::eLoopBegin
+        ? Node::Kind::eLoopEnd
+        : Node::Kind::eIfEnd;
+    CloseSection(kind, line, column);
+  }
+  // Every symbol is known once the template is compiled.
+  symbols_.Build();
+}
+
+bool Template::InLoop() const {
+  return std::any_of(
+      open_sections_.begin(), open_sections_.end(), [this](std::size_t index) {
+        return nodes_[index].kind == Node::Kind::eLoopBegin;
+      });
+}
+
+bool Template::CanClose(Node::Kind kind) const {
+  if (open_sections_.empty()) {
+    return false;
+  }
+  const auto &section = nodes_[open_sections_.back()];
+  switch (kind) {
+    case Node::Kind::eLoopEnd:
+      return section.kind == Node::Kind::eLoopBegin;
+    case Node::Kind::eElse:
+      // A conditional has at most one `#else`, which sets its jump.
+      return section.kind == Node::Kind::eIfBegin && section.jump == 0;
+    case Node::Kind::eIfEnd:
+      return section.kind == Node::Kind::eIfBegin;
+    default:
+      return false;
+  }
+}
+
+std::size_t Template::SectionEnd(std::size_t index) const {
+  const auto &node = nodes_[index];
+  if (node.kind == Node::Kind::eIfBegin &&
+      nodes_[node.jump].kind == Node::Kind::eElse) {
+    return nodes_[node.jump].jump;
+  }
+  return node.jump;
+}
+
+void Template::CloseSection(
+    Node::Kind kind,
+    std::uint32_t line,
+    std::uint32_t column) {
+  auto begin = open_sections_.back();
+  open_sections_.pop_back();
+  Touch();
+  auto end = nodes_.size();
+  auto &node = nodes_[begin];
+  if (node.kind == Node::Kind::eIfBegin && node.jump != 0) {
+    nodes_[node.jump].jump = end;
+  } else {
+    node.jump = end;
+  }
+  nodes_.push_back({kind, "", "", begin, line, column});
+  if (kind == Node::Kind::eLoopEnd) {
+    nodes_[begin].kernel = FindLoopKernel(begin, end);
+  }
+  if (open_sections_.empty()) {
+    sections_[begin] = CollectDependencies(begin, nodes_.size());
+  }
+}
+
+LoopKernel Template::FindLoopKernel(
+    std::size_t begin,
+    std::size_t end) const {
+  const auto &loop = nodes_[begin];
+  if (!loop.zipped.empty()) {
+    return LoopKernel();
+  }
+  auto is_literal = [this, end](std::size_t i) {
+    return i < end && nodes_[i].kind == Node::Kind::eLiteral;
+  };
+  auto tests = [this](std::size_t i, LoopMetadata metadata) {
+    return nodes_[i].kind == Node::Kind::eIfBegin &&
+        nodes_[i].metadata == metadata;
+  };
+
+  LoopKernel kernel;
+  auto i = begin + 1;
+  // `{{#if @index}}separator{{/if}}`, without `#else`.
+  if (i + 2 < end && tests(i, LoopMetadata::eIndex) &&
+      nodes_[i].jump == i + 2 && is_literal(i + 1)) {
+    kernel.separator = nodes_[i + 1].text;
+    i += 3;
+  }
+  if (is_literal(i)) {
+    kernel.prefix = nodes_[i++].text;
+  }
+  if (i == end || nodes_[i].kind != Node::Kind::eValue ||
+      nodes_[i].text != loop.item ||
+      nodes_[i].metadata != LoopMetadata::eNone ||
+      !nodes_[i].filters.empty()) {
+    return LoopKernel();
+  }
+  kernel.escape = nodes_[i++].escape;
+  if (is_literal(i)) {
+    kernel.suffix = nodes_[i++].text;
+  }
+  // `{{#if @last}}{{#else}}separator{{/if}}`, with an empty true
+  // branch.
+  if (kernel.separator.empty() && i + 3 < end &&
+      tests(i, LoopMetadata::eLast) && nodes_[i].jump == i + 1 &&
+      is_literal(i + 2) && nodes_[i + 3].kind == Node::Kind::eIfEnd) {
+    kernel.separator = nodes_[i + 2].text;
+    i += 4;
+  }
+  if (i != end) {
+    return LoopKernel();
+  }
+  kernel.enabled = true;
+  kernel.joint = kernel.suffix + kernel.separator + kernel.prefix;
+  return kernel;
+}
+
+Template Template::Specialize(
+    const std::unordered_map<std::string, std::string> &values,
+    const std::unordered_map<std::string, std::vector<std::string>> &arrays)
+    const {
+  Template result;
+  Scope scope;
+  Specialize(0, nodes_.size(), values, arrays, scope, result);
+  result.symbols_.Build();
+  return result;
+}
+
+void Template::Specialize(
+    std::size_t begin,
+    std::size_t end,
+    const std::unordered_map<std::string, std::string> &values,
+    const std::unordered_map<std::string, std::vector<std::string>> &arrays,
+    Scope &scope,
+    Template &result) const {
+  for (auto i = begin; i < end; ++i) {
+    const auto &node = nodes_[i];
+    switch (node.kind) {
+      case Node::Kind::eLiteral:
+        result.AppendLiteral(node.text, node.line, node.column);
+        break;
+
+      case Node::Kind::eValue: {
+        // Loop symbols shadow the values given, whether they are
+        // known or not.
+        auto it = scope.rbegin();
+        while (it != scope.rend() && it->symbol != node.text) {
+          ++it;
+        }
+        const char *data = nullptr;
+        std::size_t size = 0;
+        char buffer[24];
+        if (node.metadata != LoopMetadata::eNone) {
+          // Metadata is known inside unrolled loops.
+          if (!scope.empty() && scope.back().value != nullptr) {
+            data = buffer;
+            size = FormatLoopMetadata(
+                node.metadata, scope.back().index, scope.back().length, buffer);
+          }
+        } else if (it != scope.rend()) {
+          if (it->value != nullptr) {
+            data = it->value->data();
+            size = it->value->size();
+          }
+        } else if (contains(values, node.text)) {
+          data = values.at(node.text).data();
+          size = values.at(node.text).size();
+        }
+        if (data != nullptr) {
+          std::string folded;
+          StringSink output(folded);
+          std::vector<std::string> scratch;
+          WriteFiltered(
+              node.filters, node.escape, data, size, output, scratch, false);
+          result.AppendLiteral(folded, node.line, node.column);
+        } else {
+          result.AppendValue(
+              node.text,
+              node.line,
+              node.column,
+              node.escape,
+              node.filters,
+              node.metadata);
+        }
+      } break;
+
+      case Node::Kind::eLoopBegin: {
+        // Arrays are only defined at the root, loops never shadow them.
+        // Zipped loops are unrolled when every array is known and kept
+        // when none is. The residual cannot carry the known arrays of a
+        // loop which is kept, so knowing only some is an error.
+        std::vector<const std::vector<std::string> *> columns;
+        auto known = contains(arrays, node.text);
+        if (known) {
+          columns.push_back(&arrays.at(node.text));
+        }
+        for (const auto &zipped : node.zipped) {
+          auto position = " at line " + std::to_string(node.line) +
+              " column " + std::to_string(node.column);
+          if (contains(arrays, zipped.array) != known) {
+            const auto &missing = known ? zipped.array : node.text;
+            const auto &given = known ? node.text : zipped.array;
+            throw std::runtime_error(
+                "Cannot specialize the zipped loop over '" + given +
+                "' without array '" + missing + "'" + position);
+          }
+          if (!known) {
+            continue;
+          }
+          const auto &array = arrays.at(zipped.array);
+          if (array.size() != columns[0]->size()) {
+            throw std::runtime_error(
+                "Array '" + zipped.array + "' has " +
+                std::to_string(array.size()) + " elements but '" +
+                node.text + "' has " + std::to_string(columns[0]->size()) +
+                position);
+          }
+          columns.push_back(&array);
+        }
+        auto bind = [&](std::size_t index, std::size_t length) {
+          for (std::size_t c = 0; c <= node.zipped.size(); ++c) {
+            const auto &item = c == 0 ? node.item : node.zipped[c - 1].item;
+            const auto *value = known ? &(*columns[c])[index] : nullptr;
+            scope.push_back({item, value, index, length});
+          }
+        };
+        if (known) {
+          auto length = columns[0]->size();
+          for (std::size_t index = 0; index < length; ++index) {
+            bind(index, length);
+            Specialize(i + 1, node.jump, values, arrays, scope, result);
+            scope.erase(scope.end() - columns.size(), scope.end());
+          }
+        } else {
+          result.BeginLoop(
+              node.text, node.item, node.line, node.column, node.zipped);
+          bind(0, 0);
+          Specialize(i + 1, node.jump, values, arrays, scope, result);
+          scope.erase(scope.end() - node.zipped.size() - 1, scope.end());
+          const auto &loop_end = nodes_[node.jump];
+          result.EndLoop(loop_end.line, loop_end.column);
+        }
+        i = node.jump;
+      } break;
+
+      case Node::Kind::eIfBegin: {
+        auto end = SectionEnd(i);
+        auto has_else = node.jump != end;
+        auto it = scope.rbegin();
+        while (it != scope.rend() && it->symbol != node.text) {
+          ++it;
+        }
+        bool known = true;
+        bool truth = false;
+        if (node.metadata != LoopMetadata::eNone) {
+          known = !scope.empty() && scope.back().value != nullptr;
+          truth = known &&
+              IsLoopMetadataTrue(
+                      node.metadata, scope.back().index, scope.back().length);
+        } else if (it != scope.rend()) {
+          known = it->value != nullptr;
+          truth = known && !it->value->empty();
+        } else if (contains(values, node.text)) {
+          truth = !values.at(node.text).empty();
+        } else if (contains(arrays, node.text)) {
+          truth = !arrays.at(node.text).empty();
+        } else {
+          known = false;
+        }
+
+        if (known) {
+          if (truth) {
+            Specialize(i + 1, node.jump, values, arrays, scope, result);
+          } else if (has_else) {
+            Specialize(node.jump + 1, end, values, arrays, scope, result);
+          }
+        } else {
+          result.BeginIf(node.text, node.line, node.column, node.metadata);
+          Specialize(i + 1, node.jump, values, arrays, scope, result);
+          if (has_else) {
+            const auto &branch = nodes_[node.jump];
+            result.Else(branch.line, branch.column);
+            Specialize(node.jump + 1, end, values, arrays, scope, result);
+          }
+          result.EndIf(nodes_[end].line, nodes_[end].column);
+        }
+        i = end;
+      } break;
+
+      case Node::Kind::eInclude:
+        // Partials are specialized in place, so they end up inlined.
+        node.partial->Specialize(
+            0, node.partial->nodes_.size(), values, arrays, scope, result);
+        break;
+
+      case Node::Kind::eLoopEnd:
+        // UNREACHABLE, sections are specialized up to their end.
+        throw std::runtime_error("Invalid Syntax: Unmatched 'LOOP_END'");
+      case Node::Kind::eElse:
+      case Node::Kind::eIfEnd:
+        // UNREACHABLE, sections are specialized up to their end.
+        throw std::runtime_error("Invalid Syntax: Unmatched 'IF_END'");
+    }
+  }
+}
+
+} // namespace yate
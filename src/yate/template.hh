@@ -0,0 +1,392 @@
+#pragma once
+
+#include "escape.hh"
+#include "filter.hh"
+#include "symbol_table.hh"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace yate {
+
+/// Information about the innermost loop which templates can print or
+/// test without passing extra arrays, e.g. `{{@number}}` or
+/// `{{#if @last}}`. It is computed from the loop counter when used.
+enum class LoopMetadata {
+  eNone = 0,    /// Not metadata, a regular symbol.
+  eIndex = 1,   /// `@index`, the 0-based index of the element.
+  eNumber = 2,  /// `@number`, the 1-based index of the element.
+  eFirst = 3,   /// `@first`, whether it is the first element.
+  eLast = 4,    /// `@last`, whether it is the last element.
+  eLength = 5   /// `@length`, the number of elements of the array.
+};
+
+/// Maps the name used in templates, e.g. `@index`, to the metadata.
+///
+/// @param name The name including the `@`.
+/// @param metadata Where the result is stored.
+/// @return `false` if the name is not a known metadata.
+bool ParseLoopMetadata(const std::string &name, LoopMetadata &metadata);
+
+/// Formats a metadata without allocating. Numbers are printed in
+/// decimal and flags as `true` or `false`.
+///
+/// @param metadata The metadata to format.
+/// @param index The 0-based index of the current element.
+/// @param length The number of elements of the loop.
+/// @param buffer Where the text is written.
+/// @return The size of the text.
+std::size_t FormatLoopMetadata(
+    LoopMetadata metadata,
+    std::size_t index,
+    std::size_t length,
+    char (&buffer)[24]);
+
+/// Evaluates a metadata used as a condition: `@first` and `@last` are
+/// flags, `@index` is true after the first element and `@number` and
+/// `@length` are always true inside a loop.
+///
+/// @param metadata The metadata to test.
+/// @param index The 0-based index of the current element.
+/// @param length The number of elements of the loop.
+/// @return The truthiness of the metadata.
+bool IsLoopMetadataTrue(
+    LoopMetadata metadata,
+    std::size_t index,
+    std::size_t length);
+
+/// The shape of a loop whose body prints nothing but its element,
+/// between a prefix and a suffix and with a separator between the
+/// elements, e.g. `{{#loop xs x}}<li>{{x}}</li>{{/loop}}` or
+/// `{{#loop xs x}}{{#if @index}}, {{/if}}{{x}}{{/loop}}`. The renderer
+/// renders such loops with a dedicated kernel which copies the output
+/// of many elements into a buffer in a single pass and writes it at
+/// once, instead of walking the nodes of the body for every element.
+struct LoopKernel {
+  /// Whether the loop has this shape, the other members are only set
+  /// if it does.
+  bool enabled = false;
+  std::string prefix;
+  std::string suffix;
+  /// Written between two elements, after the suffix of the first one.
+  /// It comes from `{{#if @index}}separator{{/if}}` at the beginning
+  /// of the body or `{{#if @last}}{{#else}}separator{{/if}}` at its
+  /// end.
+  std::string separator;
+  /// The suffix, the separator and the prefix, which is all that is
+  /// written between two elements.
+  std::string joint;
+  /// How the elements are escaped.
+  Escape escape = Escape::eNone;
+};
+
+/// A template which has already been parsed. Instead of the stream
+/// of tokens generated by the `Lexer`, a template is stored as a flat
+/// list of nodes where loops keep the index of their matching end, so
+/// the template can be walked as many times as needed without going
+/// back to the input stream.
+class Template {
+ public:
+  /// A single construct of the template.
+  struct Node {
+    /// An array of a zipped loop after the first one, and the symbol
+    /// bound to its elements.
+    struct Zipped {
+      std::string array;
+      std::string item;
+      /// The slot of `array` in `symbols()`.
+      std::uint32_t slot = SymbolTable::kNotFound;
+    };
+
+    enum class Kind {
+      eLiteral = 0,    /// Text which is copied verbatim to the output.
+      eValue = 1,      /// A symbol whose value is printed.
+      eLoopBegin = 2,  /// The begin of a loop over an array.
+      eLoopEnd = 3,    /// The end of a loop.
+      eIfBegin = 4,    /// The begin of a conditional section.
+      eElse = 5,       /// The begin of the false branch of a conditional.
+      eIfEnd = 6,      /// The end of a conditional section.
+      eInclude = 7     /// A partial rendered in place.
+    };
+
+    Kind kind;
+    /// The literal text for `eLiteral`, the symbol for `eValue`, the
+    /// array identifier for `eLoopBegin`, the tested symbol for
+    /// `eIfBegin` and the name of the partial for `eInclude`.
+    std::string text;
+    /// The symbol bound to each element of the array in `eLoopBegin`.
+    std::string item;
+    /// For `eLoopBegin` the index of the matching `eLoopEnd` and the
+    /// other way around. For `eIfBegin` the index where rendering
+    /// continues when the condition is false, i.e. its `eElse` or
+    /// `eIfEnd`, for `eElse` the index of the `eIfEnd` and for `eIfEnd`
+    /// the index of the `eIfBegin`.
+    std::size_t jump;
+    std::uint32_t line;
+    std::uint32_t column;
+    /// How the value of an `eValue` is escaped.
+    Escape escape;
+    /// The filters applied to the value of an `eValue`, before it is
+    /// escaped.
+    std::vector<FilterCall> filters;
+    /// The partial of an `eInclude`, shared by every template which
+    /// includes it.
+    std::shared_ptr<const Template> partial;
+    /// For `eValue` and `eIfBegin`, the loop metadata printed or tested
+    /// instead of a symbol. `text` keeps its name, e.g. `@index`.
+    LoopMetadata metadata;
+    /// For `eValue`, `eLoopBegin` and `eIfBegin`, the slot of `text` in
+    /// `symbols()` when it is read from the root of the renderer, or
+    /// `SymbolTable::kNotFound` when a loop around the node binds it.
+    std::uint32_t slot = SymbolTable::kNotFound;
+    /// For `eLoopBegin` of zipped loops, e.g. `{{#loop names, prices as
+    /// name, price}}`, the arrays iterated in step with `text`, which
+    /// must have its length. Empty for loops over a single array.
+    std::vector<Zipped> zipped;
+    /// For `eLoopBegin`, the shape of the body if it can be rendered by
+    /// a loop kernel. It is computed when the loop is closed.
+    LoopKernel kernel;
+  };
+
+  /// The symbols read by a range of nodes which are not bound inside
+  /// that range, i.e. the inputs that determine its output.
+  struct Dependencies {
+    std::vector<std::string> values;
+    std::vector<std::string> arrays;
+    /// Symbols tested by conditionals, only their truthiness matters.
+    std::vector<std::string> conditions;
+  };
+
+  Template();
+  ~Template() {}
+
+  // Getters.
+  const std::vector<Node> &nodes() const { return nodes_; }
+
+  /// The symbols the nodes of the template read from the root of the
+  /// renderer, indexed by the `slot` of the nodes. Partials which are
+  /// not inlined have their own.
+  const SymbolTable &symbols() const { return symbols_; }
+
+  /// An identifier which is unique among all the templates in the
+  /// process and changes every time the template is modified, so it
+  /// can be used to key caches of rendered output.
+  std::uint64_t id() const { return id_; }
+
+  /// Returns the dependencies of a top-level section of the template,
+  /// i.e. a loop or a conditional which is not nested in any other
+  /// one. They are computed once, when the section is closed.
+  ///
+  /// @param index The index of the node where the section begins.
+  /// @return The dependencies of the section or `nullptr` if no
+  ///        top-level section begins at `index`.
+  const Dependencies *section_dependencies(std::size_t index) const;
+
+  /// Computes the symbols read by the nodes in the range [begin, end)
+  /// which are not bound by a loop inside the range, including the
+  /// ones read by the partials it includes. The range must not split
+  /// any section.
+  ///
+  /// @param begin The index of the first node of the range.
+  /// @param end The index past the last node of the range.
+  /// @return The values and arrays read, in order of appearance and
+  ///        without duplicates.
+  Dependencies CollectDependencies(std::size_t begin, std::size_t end) const;
+
+  /// Appends literal text to the template. Consecutive literals are
+  /// merged into a single node.
+  ///
+  /// @param text The text to be copied to the output.
+  /// @param line The line where the text begins.
+  /// @param column The column where the text begins.
+  void AppendLiteral(
+      const std::string &text,
+      std::uint32_t line,
+      std::uint32_t column);
+
+  /// Appends the substitution of a symbol.
+  ///
+  /// @param identifier The symbol whose value is going to be printed.
+  /// @param line The line where the symbol was found.
+  /// @param column The column where the symbol was found.
+  /// @param escape How the value is escaped when printed.
+  /// @param filters The filters applied to the value, in order.
+  /// @param metadata The loop metadata printed if `identifier` names
+  ///        one, e.g. `@index`.
+  void AppendValue(
+      std::string identifier,
+      std::uint32_t line,
+      std::uint32_t column,
+      Escape escape = Escape::eNone,
+      std::vector<FilterCall> filters = {},
+      LoopMetadata metadata = LoopMetadata::eNone);
+
+  /// Appends the include of a partial, which is rendered in place with
+  /// the symbols visible at that point.
+  ///
+  /// @param name The name of the partial.
+  /// @param partial The compiled partial.
+  /// @param line The line where the include was found.
+  /// @param column The column where the include was found.
+  void AppendInclude(
+      std::string name,
+      std::shared_ptr<const Template> partial,
+      std::uint32_t line,
+      std::uint32_t column);
+
+  /// Appends a copy of the nodes of another template, e.g. to inline a
+  /// partial. Literals at the boundaries are merged.
+  ///
+  /// @param other A template without open sections.
+  void AppendTemplate(const Template &other);
+
+  /// Opens a loop. Every node appended until the matching `EndLoop()`
+  /// is part of the loop body.
+  ///
+  /// @param array The identifier of the array to iterate over.
+  /// @param item The identifier bound to each element of the array.
+  /// @param line The line where the loop begins.
+  /// @param column The column where the loop begins.
+  /// @param zipped The other arrays of a zipped loop and their items,
+  ///        their slots are assigned here.
+  void BeginLoop(
+      std::string array,
+      std::string item,
+      std::uint32_t line,
+      std::uint32_t column,
+      std::vector<Node::Zipped> zipped = {});
+
+  /// Closes the innermost open section, which must be a loop. If it
+  /// is not a `std::runtime_error` is thrown.
+  ///
+  /// @param line The line where the loop ends.
+  /// @param column The column where the loop ends.
+  void EndLoop(std::uint32_t line, std::uint32_t column);
+
+  /// Opens a conditional section. Its nodes are rendered only if the
+  /// symbol is true: a value which is not empty or an array with
+  /// elements. Undefined symbols are false.
+  ///
+  /// @param symbol The identifier of the value or array tested.
+  /// @param line The line where the section begins.
+  /// @param column The column where the section begins.
+  /// @param metadata The loop metadata tested if `symbol` names one.
+  void BeginIf(
+      std::string symbol,
+      std::uint32_t line,
+      std::uint32_t column,
+      LoopMetadata metadata = LoopMetadata::eNone);
+
+  /// Begins the false branch of the innermost open section, which
+  /// must be a conditional without an `Else()` yet. Otherwise a
+  /// `std::runtime_error` is thrown.
+  ///
+  /// @param line The line where the branch begins.
+  /// @param column The column where the branch begins.
+  void Else(std::uint32_t line, std::uint32_t column);
+
+  /// Closes the innermost open section, which must be a conditional.
+  /// If it is not a `std::runtime_error` is thrown.
+  ///
+  /// @param line The line where the conditional ends.
+  /// @param column The column where the conditional ends.
+  void EndIf(std::uint32_t line, std::uint32_t column);
+
+  /// Closes every open section, used at the end of the input.
+  ///
+  /// @param line The line where the input ends.
+  /// @param column The column where the input ends.
+  void CloseSections(std::uint32_t line, std::uint32_t column);
+
+  /// @return The number of sections which have not been closed yet.
+  std::size_t open_sections() const { return open_sections_.size(); }
+
+  /// @return Whether any of the open sections is a loop.
+  bool InLoop() const;
+
+  /// Tells whether `EndLoop()`, `Else()` or `EndIf()` can be called,
+  /// so callers can report unmatched sections without exceptions.
+  ///
+  /// @param kind `eLoopEnd`, `eElse` or `eIfEnd`.
+  /// @return Whether the innermost open section accepts the node.
+  bool CanClose(Node::Kind kind) const;
+
+  /// Returns the index of the node which closes a section.
+  ///
+  /// @param index The index of an `eLoopBegin` or `eIfBegin` node.
+  /// @return The index of its `eLoopEnd` or `eIfEnd`.
+  std::size_t SectionEnd(std::size_t index) const;
+
+  /// Partially evaluates the template against the symbols which are
+  /// already known. Every substitution of a known value is filtered,
+  /// escaped and folded into the surrounding literals, loops over
+  /// known arrays are unrolled and conditionals over known symbols are
+  /// replaced by the branch taken, so the returned template only
+  /// contains the constructs which depend on symbols that were not
+  /// given. Rendering the result with the remaining symbols produces
+  /// the same output as rendering this template with all of them.
+  ///
+  /// @param values The printable symbols known at this point.
+  /// @param arrays The arrays known at this point.
+  /// @return The residual template.
+  /// @throw std::runtime_error if a zipped loop has some of its arrays
+  ///        known and others not, or known arrays of different
+  ///        lengths, since the residual could not honor that promise.
+  Template Specialize(
+      const std::unordered_map<std::string, std::string> &values,
+      const std::unordered_map<std::string, std::vector<std::string>> &arrays)
+      const;
+
+ private:
+  /// A symbol bound by a loop enclosing the node being specialized.
+  struct Binding {
+    std::string symbol;
+    /// `nullptr` when the loop is kept in the residual template, i.e.
+    /// the symbol is only known at render time.
+    const std::string *value;
+    /// The position of the element in an unrolled loop.
+    std::size_t index;
+    std::size_t length;
+  };
+  using Scope = std::vector<Binding>;
+
+  /// Helper of `Specialize()` which appends to `result` the residual
+  /// of the nodes in the range [begin, end).
+  void Specialize(
+      std::size_t begin,
+      std::size_t end,
+      const std::unordered_map<std::string, std::string> &values,
+      const std::unordered_map<std::string, std::vector<std::string>> &arrays,
+      Scope &scope,
+      Template &result) const;
+
+  /// Assigns a new unique identifier to the template.
+  void Touch();
+
+  /// Returns the slot of a symbol read at the end of the template,
+  /// adding it to `symbols_`, or `SymbolTable::kNotFound` if an open
+  /// loop binds it.
+  std::uint32_t SlotOf(const std::string &symbol);
+
+  /// Tells whether the body of the loop which begins at `begin` and
+  /// ends at `end` has the shape of a `LoopKernel`.
+  ///
+  /// @return The shape, disabled if the body is more complex.
+  LoopKernel FindLoopKernel(std::size_t begin, std::size_t end) const;
+
+  /// Appends the node which closes the innermost open section.
+  void CloseSection(Node::Kind kind, std::uint32_t line, std::uint32_t column);
+
+  std::vector<Node> nodes_;
+  std::vector<std::size_t> open_sections_;
+  std::unordered_map<std::size_t, Dependencies> sections_;
+  SymbolTable symbols_;
+  std::uint64_t id_;
+};
+
+} // namespace yate
@@ -0,0 +1,289 @@
+#ifndef _WIN32
+
+#include "template_registry.hh"
+
+#include "compiler.hh"
+
+#include <dirent.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#endif
+
+#include <fstream>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace yate {
+
+namespace {
+
+const char kExtension[] = ".yate";
+const std::size_t kExtensionSize = sizeof(kExtension) - 1;
+
+/// Returns the name of the template stored in `file`, or an empty
+/// string if it is not a template.
+std::string TemplateName(const std::string &file) {
+  if (file.size() <= kExtensionSize ||
+      file.compare(file.size() - kExtensionSize, kExtensionSize, kExtension) !=
+          0) {
+    return "";
+  }
+  return file.substr(0, file.size() - kExtensionSize);
+}
+
+bool ReadTemplate(
+    const std::string &directory,
+    const std::string &name,
+    std::string &source) {
+  std::ifstream input(
+      directory + "/" + name + kExtension,
+      std::ios_base::in | std::ios_base::binary);
+  if (!input) {
+    return false;
+  }
+  std::stringstream content;
+  content << input.rdbuf();
+  source = content.str();
+  return true;
+}
+
+/// Whether `tmpl` includes the partial `name`, directly or through
+/// other partials.
+bool Includes(const Template &tmpl, const std::string &name) {
+  for (const auto &node : tmpl.nodes()) {
+    if (node.kind == Template::Node::Kind::eInclude &&
+        (node.text == name || Includes(*node.partial, name))) {
+      return true;
+    }
+  }
+  return false;
+}
+
+} // namespace
+
+TemplateRegistry::TemplateRegistry(std::string directory)
+    : directory_(std::move(directory)),
+      partials_(),
+      snapshot_(nullptr),
+      epoch_(0),
+      readers_{{0}, {0}},
+      version_(0),
+      reload_mutex_(),
+      error_handler_(),
+      watcher_(),
+      stop_fd_(-1) {
+  auto directory_path = directory_;
+  partials_ = std::make_shared<PartialCache>(
+      [directory_path](const std::string &name, std::string &source) {
+        return ReadTemplate(directory_path, name, source);
+      });
+
+  auto *dir = opendir(directory_.c_str());
+  if (dir == nullptr) {
+    throw std::runtime_error(
+        "Cannot read template directory '" + directory_ + "'");
+  }
+  std::vector<std::string> names;
+  while (auto *entry = readdir(dir)) {
+    auto name = TemplateName(entry->d_name);
+    if (!name.empty()) {
+      names.push_back(std::move(name));
+    }
+  }
+  closedir(dir);
+
+  auto snapshot = std::unique_ptr<Snapshot>(new Snapshot());
+  for (const auto &name : names) {
+    std::shared_ptr<const Template> tmpl;
+    try {
+      if (Compile(name, tmpl)) {
+        (*snapshot)[name] = std::move(tmpl);
+      }
+    } catch (const std::runtime_error &e) {
+      throw std::runtime_error(
+          "In template '" + name + "': " + std::string(e.what()));
+    }
+  }
+  snapshot_.store(snapshot.release());
+}
+
+TemplateRegistry::~TemplateRegistry() {
+  Stop();
+  delete snapshot_.load();
+}
+
+std::shared_ptr<const Template> TemplateRegistry::Get(
+    const std::string &name) const {
+  // The epoch is read again after registering, so a writer which
+  // flipped it in between is not missed: it may already be waiting
+  // for the other counter.
+  std::uint64_t epoch = 0;
+  for (;;) {
+    epoch = epoch_.load();
+    readers_[epoch & 1].fetch_add(1);
+    if (epoch_.load() == epoch) {
+      break;
+    }
+    readers_[epoch & 1].fetch_sub(1);
+  }
+  std::shared_ptr<const Template> result;
+  const auto &snapshot = *snapshot_.load();
+  auto it = snapshot.find(name);
+  if (it != snapshot.end()) {
+    result = it->second;
+  }
+  readers_[epoch & 1].fetch_sub(1, std::memory_order_release);
+  return result;
+}
+
+void TemplateRegistry::Reload(const std::string &name) {
+  std::lock_guard<std::mutex> lock(reload_mutex_);
+  // Only writers replace the snapshot, so it can be read directly.
+  const auto &current = *snapshot_.load();
+  std::vector<std::string> names{name};
+  for (const auto &entry : current) {
+    if (entry.first != name && Includes(*entry.second, name)) {
+      names.push_back(entry.first);
+    }
+  }
+
+  // The partials are compiled again as well, templates which are not
+  // reloaded keep the copies they include.
+  partials_->Clear();
+  auto snapshot = std::unique_ptr<Snapshot>(new Snapshot(current));
+  for (const auto &reloaded : names) {
+    std::shared_ptr<const Template> tmpl;
+    try {
+      if (Compile(reloaded, tmpl)) {
+        (*snapshot)[reloaded] = std::move(tmpl);
+      } else {
+        snapshot->erase(reloaded);
+      }
+    } catch (const std::runtime_error &e) {
+      if (error_handler_) {
+        error_handler_(reloaded, e.what());
+      }
+    }
+  }
+  Publish(snapshot.release());
+}
+
+void TemplateRegistry::set_error_handler(ErrorHandler handler) {
+  std::lock_guard<std::mutex> lock(reload_mutex_);
+  error_handler_ = std::move(handler);
+}
+
+bool TemplateRegistry::Compile(
+    const std::string &name,
+    std::shared_ptr<const Template> &tmpl) {
+  std::string source;
+  if (!ReadTemplate(directory_, name, source)) {
+    return false;
+  }
+  std::stringstream input(source);
+  Compiler compiler(input);
+  compiler.set_partials(partials_);
+  tmpl = std::make_shared<const Template>(compiler.Compile());
+  return true;
+}
+
+void TemplateRegistry::Publish(Snapshot *snapshot) {
+  auto *previous = snapshot_.exchange(snapshot);
+  // Readers registered in the current epoch may hold the previous
+  // snapshot, the ones registering after the flip see the new one.
+  auto epoch = epoch_.load();
+  epoch_.store(epoch + 1);
+  while (readers_[epoch & 1].load(std::memory_order_acquire) != 0) {
+    std::this_thread::yield();
+  }
+  delete previous;
+  version_.fetch_add(1, std::memory_order_release);
+}
+
+void TemplateRegistry::Watch() {
+#ifdef __linux__
+  if (watcher_.joinable()) {
+    return;
+  }
+  int inotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (inotify < 0) {
+    throw std::runtime_error("Cannot initialize inotify");
+  }
+  // Editors either write the file in place or move a new one over it.
+  if (inotify_add_watch(
+          inotify,
+          directory_.c_str(),
+          IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE) < 0) {
+    close(inotify);
+    throw std::runtime_error("Cannot watch directory '" + directory_ + "'");
+  }
+  stop_fd_ = eventfd(0, EFD_CLOEXEC);
+  if (stop_fd_ < 0) {
+    close(inotify);
+    throw std::runtime_error("Cannot create the watcher stop event");
+  }
+  watcher_ = std::thread(&TemplateRegistry::WatchLoop, this, inotify);
+#else
+  throw std::runtime_error("Watching templates requires inotify");
+#endif
+}
+
+void TemplateRegistry::Stop() {
+#ifdef __linux__
+  if (!watcher_.joinable()) {
+    return;
+  }
+  std::uint64_t one = 1;
+  if (write(stop_fd_, &one, sizeof(one)) != sizeof(one)) {
+    // UNREACHABLE, an eventfd only fails to count past its maximum.
+    throw std::runtime_error("Cannot stop the template watcher");
+  }
+  watcher_.join();
+  close(stop_fd_);
+  stop_fd_ = -1;
+#endif
+}
+
+void TemplateRegistry::WatchLoop(int inotify) {
+#ifdef __linux__
+  alignas(inotify_event) char buffer[4096];
+  pollfd fds[2] = {{inotify, POLLIN, 0}, {stop_fd_, POLLIN, 0}};
+  for (;;) {
+    if (poll(fds, 2, -1) < 0 || (fds[1].revents & POLLIN) != 0) {
+      break;
+    }
+    // Events of the same batch often refer to the same file, each
+    // template is reloaded once.
+    std::set<std::string> changed;
+    ssize_t size = 0;
+    while ((size = read(inotify, buffer, sizeof(buffer))) > 0) {
+      for (ssize_t offset = 0; offset < size;) {
+        const auto *event =
+            reinterpret_cast<const inotify_event *>(buffer + offset);
+        if (event->len > 0) {
+          auto name = TemplateName(event->name);
+          if (!name.empty()) {
+            changed.insert(std::move(name));
+          }
+        }
+        offset += sizeof(inotify_event) + event->len;
+      }
+    }
+    for (const auto &name : changed) {
+      Reload(name);
+    }
+  }
+  close(inotify);
+#endif
+}
+
+} // namespace yate
+
+#endif // _WIN32
@@ -0,0 +1,121 @@
+#pragma once
+
+#ifndef _WIN32
+
+#include "partial_cache.hh"
+#include "template.hh"
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+namespace yate {
+
+/// Holds the compiled templates of a directory, one per `.yate` file
+/// named after the file without the extension, and reloads them when
+/// the files change. Templates include each other as partials.
+///
+/// The templates are published in an immutable snapshot which is
+/// replaced as a whole when a file changes, RCU style: `Get()` never
+/// takes a lock, renders in progress keep the version they got and
+/// the old snapshot is freed once no reader can be looking at it.
+/// Only the threads which reload templates are serialized.
+class TemplateRegistry {
+ public:
+  /// Called with the name of a template and the error when a changed
+  /// file cannot be compiled. The previous version is kept.
+  using ErrorHandler =
+      std::function<void(const std::string &name, const std::string &error)>;
+
+  /// Compiles every `.yate` file in `directory`. Throws a
+  /// `std::runtime_error` if the directory cannot be read or one of
+  /// the templates does not compile.
+  ///
+  /// @param directory The directory holding the templates.
+  TemplateRegistry(std::string directory);
+  ~TemplateRegistry();
+
+  // Not copyable nor movable.
+  TemplateRegistry(const TemplateRegistry &) = delete;
+  TemplateRegistry &operator=(const TemplateRegistry &) = delete;
+
+  /// Returns the current version of a template. It is safe to call
+  /// from any number of threads and never blocks.
+  ///
+  /// @param name The name of the template, e.g. `page` for `page.yate`.
+  /// @return The template or `nullptr` if there is none with the name.
+  std::shared_ptr<const Template> Get(const std::string &name) const;
+
+  /// Compiles `name` again, together with every template including it,
+  /// and publishes the new versions. If the file no longer exists the
+  /// template is removed. Compile errors are reported to the error
+  /// handler.
+  ///
+  /// @param name The name of the template which changed.
+  void Reload(const std::string &name);
+
+  /// Starts a background thread which watches the directory with
+  /// inotify and reloads the templates whose files are written, moved
+  /// in or deleted. Throws a `std::runtime_error` if inotify is not
+  /// available.
+  void Watch();
+
+  /// Stops watching the directory, waiting for the reload in progress.
+  void Stop();
+
+  /// @param handler Called with the errors of background reloads.
+  void set_error_handler(ErrorHandler handler);
+
+  /// @return The number of snapshots published so far, which grows
+  ///         every time templates are reloaded.
+  std::uint64_t version() const {
+    return version_.load(std::memory_order_acquire);
+  }
+
+ private:
+  using Snapshot =
+      std::unordered_map<std::string, std::shared_ptr<const Template>>;
+
+  /// Reads and compiles the template `name`.
+  ///
+  /// @param name The name of the template.
+  /// @param tmpl Where the template is stored.
+  /// @return `false` if the file does not exist.
+  bool Compile(
+      const std::string &name,
+      std::shared_ptr<const Template> &tmpl);
+
+  /// Replaces the current snapshot and frees the previous one after
+  /// the readers which may have loaded it are done.
+  void Publish(Snapshot *snapshot);
+
+  /// Body of the watching thread.
+  ///
+  /// @param inotify The inotify descriptor watching the directory,
+  ///        closed when the thread stops.
+  void WatchLoop(int inotify);
+
+  std::string directory_;
+  std::shared_ptr<PartialCache> partials_;
+  std::atomic<Snapshot *> snapshot_;
+  /// Readers register in the counter of the current epoch, so a writer
+  /// knows when the readers of a replaced snapshot finished.
+  std::atomic<std::uint64_t> epoch_;
+  mutable std::atomic<std::uint64_t> readers_[2];
+  std::atomic<std::uint64_t> version_;
+  /// Serializes the writers.
+  std::mutex reload_mutex_;
+  ErrorHandler error_handler_;
+  std::thread watcher_;
+  /// Descriptor which wakes the watcher up to stop it.
+  int stop_fd_;
+};
+
+} // namespace yate
+
+#endif // _WIN32
@@ -50,6 +50,24 @@ std::string to_string(Token::Tag tag) {
       return "SCRIPT_BEGIN";
     case Token::Tag::eScriptEnd:
       return "SCRIPT_END";
+    case Token::Tag::ePipe:
+      return "PIPE";
+    case Token::Tag::eNumber:
+      return "NUMBER";
+    case Token::Tag::eString:
+      return "STRING";
+    case Token::Tag::eIfBegin:
+      return "IF_BEGIN";
+    case Token::Tag::eElse:
+      return "ELSE";
+    case Token::Tag::eIfEnd:
+      return "IF_END";
+    case Token::Tag::ePartial:
+      return "PARTIAL";
+    case Token::Tag::eLoopMetadata:
+      return "LOOP_METADATA";
+    case Token::Tag::eComma:
+      return "COMMA";
   }
   return "";
 }
@@ -58,4 +76,19 @@ std::ostream &operator<<(std::ostream &stream, Token::Tag tag) {
   return stream << to_string(tag);
 }
 
+std::string CreateError(const Token &token, Token::Tag expected) {
+  return "Invalid Syntax: Expected '" + to_string(expected) + "' but got '" +
+         to_string(token.tag()) + "' " +
+         (token.value().empty() ? "" : ("('" + token.value() + "')")) +
+         " at line " + std::to_string(token.line()) + " column " +
+         std::to_string(token.column());
+}
+
+std::string CreateError(const Token &token) {
+  return "Invalid Syntax: Unexpected token '" + to_string(token.tag()) + "' " +
+         (token.value().empty() ? "" : ("('" + token.value() + "')")) +
+         " at line " + std::to_string(token.line()) + " column " +
+         std::to_string(token.column());
+}
+
 } // namespace yate
@@ -21,8 +21,21 @@ class Token {
     eIdentifier = 6,   /// Identifier follows the regex [a-zA-Z_][a-zA-Z0-9_]*
     eScriptBegin = 7,  /// The string `{{`, used to switch between literal and
                        /// script modes.
-    eScriptEnd = 8     /// The string `}}`, used to switch between literal and
+    eScriptEnd = 8,    /// The string `}}`, used to switch between literal and
                        /// script modes.
+    ePipe = 9,         /// The character `|`, which applies a modifier to
+                       /// the value before it, e.g. `{{name | html}}`.
+    eNumber = 10,      /// A number argument of a filter, e.g. `-12` or `0.5`.
+    eString = 11,      /// A quoted argument of a filter, e.g. `"%Y"`. The
+                       /// value is unquoted and unescaped.
+    eIfBegin = 12,     /// The keyword `#if`.
+    eElse = 13,        /// The keyword `#else`.
+    eIfEnd = 14,       /// The keyword `/if`.
+    ePartial = 15,     /// The character `>`, which includes the partial
+                       /// named after it, e.g. `{{>header}}`.
+    eLoopMetadata = 16, /// Metadata of the innermost loop, e.g. `@index`.
+    eComma = 17         /// The character `,`, which separates the arrays
+                        /// and symbols of zipped loops.
   };
 
   /// Default constructor, it is a shortcut for the equivalent:
@@ -69,4 +82,20 @@ std::string to_string(Token::Tag tag);
 /// `stream << to_string(tag)`.
 std::ostream &operator<<(std::ostream &stream, Token::Tag tag);
 
+/// Helper function to generate error strings when a token does not
+/// match an specific expected one.
+///
+/// @param token The token found in the input.
+/// @param expected The kind of token which should have been found.
+/// @return A message including the position of `token`.
+std::string CreateError(const Token &token, Token::Tag expected);
+
+/// Helper function to generate error strings when a token does not
+/// match an expected one, but there is no specific token which
+/// could appear at that point.
+///
+/// @param token The token found in the input.
+/// @return A message including the position of `token`.
+std::string CreateError(const Token &token);
+
 } // namespace yate
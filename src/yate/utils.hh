@@ -1,5 +1,7 @@
 #pragma once
 
+#include <algorithm>
+
 /// Small helper function template which works as syntax candy for
 /// verification of element existance within a container.
 /// The container needs to support the `.find()` method which limits
@@ -30,3 +32,17 @@ bool begins_with(const Container &reference, const Container &prefix) {
   return reference.size() >= prefix.size() &&
          equal(prefix.begin(), prefix.end(), reference.begin());
 }
+
+/// Small helper function template which appends `elem` at the end of
+/// a sequence container unless it is already there, so the container
+/// keeps the order in which elements were first added.
+///
+/// @param container The container where the element is added.
+/// @param elem The element to be added.
+template<typename Container, typename T>
+inline
+void append_unique(Container &container, const T &elem) {
+  if (std::find(container.begin(), container.end(), elem) == container.end()) {
+    container.push_back(elem);
+  }
+}
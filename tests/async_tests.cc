@@ -0,0 +1,270 @@
+#ifdef YATE_COROUTINES
+
+#include "async_tests.hh"
+
+#include "helpers.hh"
+#include "unit.hh"
+
+#include <yate/async.hh>
+#include <yate/partial_cache.hh>
+#include <yate/renderer.hh>
+
+#include <deque>
+#include <functional>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace {
+
+/// Callbacks waiting to run, standing for the event loop of a server.
+using EventLoop = std::deque<std::function<void()>>;
+
+/// Runs the callbacks of `loop`, including the ones they queue.
+void RunLoop(EventLoop &loop) {
+  while (!loop.empty()) {
+    auto callback = std::move(loop.front());
+    loop.pop_front();
+    callback();
+  }
+}
+
+/// Sink with a buffer of limited capacity, which the event loop
+/// drains into `text`.
+class BufferSink : public yate::AsyncSink {
+ public:
+  BufferSink(EventLoop &loop, std::size_t capacity)
+      : loop_(loop), capacity_(capacity) {}
+
+  void Write(const char *data, std::size_t size) override {
+    buffer_.append(data, size);
+  }
+  void Flush() override {
+    text.append(buffer_);
+    buffer_.clear();
+  }
+  bool Full() const override { return buffer_.size() >= capacity_; }
+  void WhenDrained(std::function<void()> resume) override {
+    ++suspensions;
+    loop_.push_back([this, resume]() {
+      Flush();
+      resume();
+    });
+  }
+
+  std::string text;
+  int suspensions = 0;
+
+ private:
+  EventLoop &loop_;
+  std::size_t capacity_;
+  std::string buffer_;
+};
+
+/// Resolves values from a map on the next turn of the event loop.
+class DeferredValues : public yate::AsyncValues {
+ public:
+  DeferredValues(
+      EventLoop &loop,
+      std::unordered_map<std::string, std::string> values)
+      : loop_(loop), values_(std::move(values)) {}
+
+  Resolution Resolve(
+      const std::string &symbol,
+      std::string &value,
+      std::function<void()> resume) override {
+    ++requests;
+    if (ready_.count(symbol) != 0) {
+      value = values_.at(symbol);
+      return Resolution::eResolved;
+    }
+    if (values_.count(symbol) == 0) {
+      return Resolution::eUndefined;
+    }
+    loop_.push_back([this, symbol, resume]() {
+      ready_.insert({symbol, true});
+      resume();
+    });
+    return Resolution::ePending;
+  }
+
+  int requests = 0;
+
+ private:
+  EventLoop &loop_;
+  std::unordered_map<std::string, std::string> values_;
+  std::unordered_map<std::string, bool> ready_;
+};
+
+} // namespace
+
+int AsyncTests::RunTests() {
+  int result = 0;
+  result += TestSuspendOnFullSink();
+  result += TestAsyncValues();
+  result += TestInterleavedRenders();
+  result += TestAsyncErrors();
+  return result;
+}
+
+int AsyncTests::TestSuspendOnFullSink() {
+  auto partials = std::make_shared<yate::PartialCache>(
+      [](const std::string &name, std::string &source) {
+        source = "<{{cell}}>";
+        return name == "cell";
+      });
+  auto tmpl = CompileString(
+      "{{title}}\n{{#loop rows row}}{{#loop cols cell}}{{>cell}}{{/loop}}"
+      "{{#if @last}}.{{#else}},{{/if}}{{/loop}}|{{#loop letters l}}{{l}}"
+      "{{@index}}{{/loop}}|{{#loop rows, marks as row, mark}}{{row}}{{mark}}"
+      "{{/loop}}",
+      partials);
+  yate::Renderer renderer(
+      {{"title", "table"}},
+      {{"rows", {"1", "2", "3"}},
+       {"cols", {"a", "b"}},
+       {"marks", {"p", "q", "r"}}});
+  renderer.SetGenerator(
+      "letters",
+      std::make_shared<yate::FunctionGenerator>(
+          [](std::size_t index, std::string &element) {
+            element.assign(1, static_cast<char>('x' + index));
+            return index < 3;
+          }));
+  std::stringstream expected;
+  renderer.Render(tmpl, expected);
+  TEST_EXPECT_EQ(expected.str(), "table\n<a><b>,<a><b>,<a><b>.|x0y1z2|1p2q3r");
+
+  EventLoop loop;
+  BufferSink sink(loop, 4);
+  auto task = renderer.RenderAsync(tmpl, sink);
+  TEST_EXPECT(!task.done());
+  auto finished = false;
+  task.Start([&finished]() { finished = true; });
+  // The title fills the sink before anything else is rendered.
+  TEST_EXPECT(!task.done());
+  TEST_EXPECT_EQ(sink.suspensions, 1);
+  RunLoop(loop);
+  TEST_ASSERT_EQ(task.done(), true);
+  TEST_EXPECT(finished);
+  task.Get();
+  TEST_EXPECT_EQ(sink.text, expected.str());
+  TEST_EXPECT(sink.suspensions > 5);
+
+  // The renderer can render synchronously again afterwards.
+  std::stringstream again;
+  renderer.Render(tmpl, again);
+  TEST_EXPECT_EQ(again.str(), expected.str());
+  return 0;
+}
+
+int AsyncTests::TestAsyncValues() {
+  auto tmpl = CompileString(
+      "Hello {{user | upper}}{{#if admin}} (admin){{/if}}{{#if guest}}?"
+      "{{/if}}: {{#loop items item}}{{item}}{{user}} {{/loop}}");
+  EventLoop loop;
+  DeferredValues values(loop, {{"user", "bob"}, {"admin", "yes"}});
+  yate::Renderer renderer({}, {{"items", {"1", "2"}}});
+  BufferSink sink(loop, 1024);
+  auto task = renderer.RenderAsync(tmpl, sink, &values);
+  task.Start();
+  TEST_EXPECT(!task.done());
+  RunLoop(loop);
+  TEST_ASSERT_EQ(task.done(), true);
+  task.Get();
+  TEST_EXPECT_EQ(sink.text, "Hello BOB (admin): 1bob 2bob ");
+  // Each value is asked for twice, once pending and once resolved,
+  // and the undefined one once.
+  TEST_EXPECT_EQ(values.requests, 5);
+  TEST_EXPECT_EQ(sink.suspensions, 0);
+
+  // Undefined values fail as in synchronous renders.
+  auto missing = CompileString("{{nobody}}");
+  auto failed = renderer.RenderAsync(missing, sink, &values);
+  failed.Start();
+  TEST_ASSERT_EQ(failed.done(), true);
+  TEST_EXPECT_EXCEPTION(
+      failed.Get(), std::runtime_error, "Identifier 'nobody' is undefined");
+  return 0;
+}
+
+int AsyncTests::TestInterleavedRenders() {
+  auto tmpl = CompileString(
+      "{{name}}:{{#loop rows row}}[{{row}}{{suffix}}]{{/loop}}\n");
+  const int kRenders = 200;
+  EventLoop loop;
+  std::vector<std::unique_ptr<yate::Renderer>> renderers;
+  std::vector<std::unique_ptr<BufferSink>> sinks;
+  std::vector<std::unique_ptr<DeferredValues>> values;
+  std::vector<yate::RenderTask> tasks;
+  int finished = 0;
+  for (int i = 0; i < kRenders; ++i) {
+    renderers.push_back(
+        std::make_unique<yate::Renderer>(
+            std::unordered_map<std::string, std::string>{
+                {"name", std::to_string(i)}},
+            std::unordered_map<std::string, std::vector<std::string>>{
+                {"rows", {"a", "b", "c", "d"}}}));
+    sinks.push_back(std::make_unique<BufferSink>(loop, 3));
+    values.push_back(
+        std::make_unique<DeferredValues>(
+            loop,
+            std::unordered_map<std::string, std::string>{
+                {"suffix", std::to_string(i % 7)}}));
+    tasks.push_back(
+        renderers.back()->RenderAsync(
+            tmpl, *sinks.back(), values.back().get()));
+    tasks.back().Start([&finished]() { ++finished; });
+  }
+  TEST_EXPECT_EQ(finished, 0);
+  RunLoop(loop);
+  TEST_ASSERT_EQ(finished, kRenders);
+  for (int i = 0; i < kRenders; ++i) {
+    tasks[i].Get();
+    auto suffix = std::to_string(i % 7);
+    TEST_EXPECT_EQ(
+        sinks[i]->text,
+        std::to_string(i) + ":[a" + suffix + "][b" + suffix + "][c" +
+            suffix + "][d" + suffix + "]\n");
+  }
+  return 0;
+}
+
+int AsyncTests::TestAsyncErrors() {
+  auto tmpl = CompileString("{{#loop rows row}}{{row}}{{/loop}}");
+  yate::Renderer renderer({}, {{"rows", {"a", "b", "c"}}});
+  EventLoop loop;
+  BufferSink sink(loop, 1);
+
+  yate::RenderLimits limits;
+  limits.max_iterations = 2;
+  renderer.set_limits(limits);
+  auto limited = renderer.RenderAsync(tmpl, sink);
+  limited.Start();
+  RunLoop(loop);
+  TEST_ASSERT_EQ(limited.done(), true);
+  TEST_EXPECT_EXCEPTION(
+      limited.Get(),
+      yate::RenderLimitExceeded,
+      "Render exceeded 2 loop iterations");
+  TEST_EXPECT_EQ(sink.text, "ab");
+
+  // Tasks which did not finish report it.
+  renderer.set_limits(yate::RenderLimits());
+  sink.text.clear();
+  auto task = renderer.RenderAsync(tmpl, sink);
+  TEST_EXPECT_EXCEPTION(
+      task.Get(), std::runtime_error, "Render task has not finished");
+  task.Start();
+  RunLoop(loop);
+  task.Get();
+  TEST_EXPECT_EQ(sink.text, "abc");
+  TEST_EXPECT_EXCEPTION(
+      task.Start(), std::runtime_error, "Render task already finished");
+  return 0;
+}
+
+#endif // YATE_COROUTINES
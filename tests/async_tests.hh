@@ -0,0 +1,14 @@
+#pragma once
+
+#ifdef YATE_COROUTINES
+
+struct AsyncTests {
+  int RunTests();
+
+  int TestSuspendOnFullSink();
+  int TestAsyncValues();
+  int TestInterleavedRenders();
+  int TestAsyncErrors();
+};
+
+#endif // YATE_COROUTINES
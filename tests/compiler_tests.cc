@@ -0,0 +1,299 @@
+#include "compiler_tests.hh"
+
+#include "unit.hh"
+
+#include <yate/codegen.hh>
+#include <yate/compiler.hh>
+#include <yate/renderer.hh>
+
+#include <codegen_template.hh>
+
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <string>
+
+int CompilerTests::RunTests() {
+  int result = 0;
+  result += TestCompileNodes();
+  result += TestCompileErrors();
+  result += TestCodeGeneration();
+  result += TestGeneratedRender();
+  result += TestCompileConditionals();
+  result += TestMinify();
+  result += TestDelimiters();
+  result += TestZippedLoops();
+  return result;
+}
+
+// Checks the nodes generated for a template with nested loops,
+// including the jumps between the begin and end of each loop.
+int CompilerTests::TestCompileNodes() {
+  using Kind = yate::Template::Node::Kind;
+  std::stringstream input(
+      "a{{x}}b{{#loop xs x}}c{{#loop ys y}}{{y}}{{/loop}}{{/loop}}d");
+  yate::Compiler compiler(input);
+  auto tmpl = compiler.Compile();
+  const auto &nodes = tmpl.nodes();
+
+  TEST_ASSERT_EQ(nodes.size(), 10u);
+  TEST_EXPECT(nodes[0].kind == Kind::eLiteral);
+  TEST_EXPECT_EQ(nodes[0].text, "a");
+  TEST_EXPECT(nodes[1].kind == Kind::eValue);
+  TEST_EXPECT_EQ(nodes[1].text, "x");
+  TEST_EXPECT(nodes[3].kind == Kind::eLoopBegin);
+  TEST_EXPECT_EQ(nodes[3].text, "xs");
+  TEST_EXPECT_EQ(nodes[3].item, "x");
+  TEST_EXPECT_EQ(nodes[3].jump, 8u);
+  TEST_EXPECT(nodes[5].kind == Kind::eLoopBegin);
+  TEST_EXPECT_EQ(nodes[5].jump, 7u);
+  TEST_EXPECT(nodes[7].kind == Kind::eLoopEnd);
+  TEST_EXPECT_EQ(nodes[7].jump, 5u);
+  TEST_EXPECT_EQ(nodes[8].jump, 3u);
+  TEST_EXPECT_EQ(nodes[9].text, "d");
+
+  // Loops left open at the end of the input are closed.
+  std::stringstream open("{{#loop xs x}}{{x}}");
+  yate::Compiler open_compiler(open);
+  auto open_tmpl = open_compiler.Compile();
+  TEST_ASSERT_EQ(open_tmpl.nodes().size(), 3u);
+  TEST_EXPECT(open_tmpl.nodes()[2].kind == Kind::eLoopEnd);
+  return 0;
+}
+
+// Syntax errors are reported with the same messages as the renderer.
+int CompilerTests::TestCompileErrors() {
+  {
+    std::stringstream input("{{}}");
+    yate::Compiler compiler(input);
+    TEST_EXPECT_EXCEPTION(
+        compiler.Compile(),
+        std::runtime_error,
+        "Invalid Syntax: Unexpected token 'SCRIPT_END' ('}}') "
+        "at line 1 column 3");
+  }
+  {
+    std::stringstream input("{{#loop array item}}{{/loop}}{{/loop}}");
+    yate::Compiler compiler(input);
+    TEST_EXPECT_EXCEPTION(
+        compiler.Compile(),
+        std::runtime_error,
+        "Invalid Syntax: Unmatched 'LOOP_END'");
+  }
+  {
+    // Symbols do not need to be defined to compile a template.
+    std::stringstream input("{{undefined}}{{#loop nothing item}}{{/loop}}");
+    yate::Compiler compiler(input);
+    TEST_EXPECT_EQ(compiler.Compile().nodes().size(), 3u);
+  }
+  return 0;
+}
+
+// Checks the shape of the generated code.
+int CompilerTests::TestCodeGeneration() {
+  {
+    std::stringstream input("{{title}}{{#loop rows row}}{{row}}{{/loop}}");
+    yate::Compiler compiler(input);
+    auto tmpl = compiler.Compile();
+    yate::CodeGenerator generator(tmpl, "Page", "site::pages");
+    std::stringstream code;
+    generator.Generate(code);
+
+    auto text = code.str();
+    TEST_EXPECT_NEQ(text.find("namespace site {"), std::string::npos);
+    TEST_EXPECT_NEQ(text.find("namespace pages {"), std::string::npos);
+    TEST_EXPECT_NEQ(text.find("struct PageContext {"), std::string::npos);
+    TEST_EXPECT_NEQ(text.find("  std::string title;"), std::string::npos);
+    TEST_EXPECT_NEQ(
+        text.find("  std::vector<std::string> rows;"), std::string::npos);
+    TEST_EXPECT_EQ(text.find("std::string row;"), std::string::npos);
+    TEST_EXPECT_NEQ(text.find("void RenderPage("), std::string::npos);
+  }
+  {
+    std::stringstream input("{{xs}}{{#loop xs x}}{{/loop}}");
+    yate::Compiler compiler(input);
+    auto tmpl = compiler.Compile();
+    yate::CodeGenerator generator(tmpl, "Page", "");
+    std::stringstream code;
+    TEST_EXPECT_EXCEPTION(
+        generator.Generate(code),
+        std::runtime_error,
+        "Symbol 'xs' is used both as a value and as an array");
+  }
+
+  TEST_EXPECT_EQ(yate::ToCppIdentifier("class"), "class_");
+  TEST_EXPECT_EQ(yate::ToCppIdentifier("name"), "name");
+  TEST_EXPECT_EQ(
+      yate::ToCppStringLiteral("a\"b\\c??\x01"), "\"a\\\"b\\\\c\\?\\?\\001\"");
+  return 0;
+}
+
+// Renders the template generated during the build and compares it
+// with the output of the renderer for the same template.
+int CompilerTests::TestGeneratedRender() {
+  generated::CodegenTestContext context;
+  context.name = "Ada";
+  context.class_ = "root";
+  context.items = {"first", "second"};
+  context.tags = {"x", "y"};
+  std::stringstream generated_output;
+  generated::RenderCodegenTest(context, generated_output);
+
+  std::ifstream input(YATE_TEST_TEMPLATE_DIR "/codegen.yate");
+  TEST_ASSERT_EQ(input.good(), true);
+  yate::Compiler compiler(input);
+  compiler.set_partials(std::make_shared<yate::PartialCache>(
+      [](const std::string &name, std::string &source) {
+        std::ifstream partial(YATE_TEST_TEMPLATE_DIR "/" + name + ".yate");
+        std::stringstream content;
+        content << partial.rdbuf();
+        source = content.str();
+        return partial.good();
+      }));
+  yate::Renderer renderer(
+      {{"name", "Ada"}, {"class", "root"}},
+      {{"items", {"first", "second"}}, {"tags", {"x", "y"}}});
+  std::stringstream rendered_output;
+  renderer.Render(compiler.Compile(), rendered_output);
+
+  TEST_EXPECT_EQ(generated_output.str(), rendered_output.str());
+  return 0;
+}
+
+// A false condition jumps to its `#else`, or to its end when it has
+// none, and the `#else` jumps to the end.
+int CompilerTests::TestCompileConditionals() {
+  using Kind = yate::Template::Node::Kind;
+  std::stringstream input("{{#if a}}x{{#else}}y{{/if}}{{#if b}}z{{/if}}");
+  yate::Compiler compiler(input);
+  auto tmpl = compiler.Compile();
+  const auto &nodes = tmpl.nodes();
+
+  TEST_ASSERT_EQ(nodes.size(), 8u);
+  TEST_EXPECT(nodes[0].kind == Kind::eIfBegin);
+  TEST_EXPECT_EQ(nodes[0].text, "a");
+  TEST_EXPECT_EQ(nodes[0].jump, 2u);
+  TEST_EXPECT(nodes[2].kind == Kind::eElse);
+  TEST_EXPECT_EQ(nodes[2].jump, 4u);
+  TEST_EXPECT(nodes[4].kind == Kind::eIfEnd);
+  TEST_EXPECT_EQ(nodes[4].jump, 0u);
+  TEST_EXPECT_EQ(tmpl.SectionEnd(0), 4u);
+  TEST_EXPECT_EQ(nodes[5].jump, 7u);
+  TEST_EXPECT_EQ(tmpl.SectionEnd(5), 7u);
+
+  std::stringstream keyword("{{#iffy a}}");
+  yate::Compiler keyword_compiler(keyword);
+  TEST_EXPECT_EXCEPTION(
+      keyword_compiler.Compile(),
+      std::runtime_error,
+      "Error found in line 1 column 6: Invalid keyword found");
+
+  std::stringstream missing("{{#if}}");
+  yate::Compiler missing_compiler(missing);
+  TEST_EXPECT_EXCEPTION(
+      missing_compiler.Compile(),
+      std::runtime_error,
+      "Invalid Syntax: Expected 'IDENTIFIER' but got 'SCRIPT_END' ('}}') "
+      "at line 1 column 6");
+  return 0;
+}
+
+// Minifying collapses whitespace runs in literals, keeping newlines
+// and the content of elements such as `<pre>`, even when the element
+// spans several literals. Values are not touched.
+int CompilerTests::TestMinify() {
+  std::stringstream input(
+      "<div>\n    <p>  {{text}}  </p>\t<PRE class=\"{{cls}}\">  a\n\n"
+      "  {{text}}  </pre>   <b> x </b>\n\n</div>");
+  yate::Compiler compiler(input);
+  compiler.set_minify(true);
+  yate::Renderer renderer({{"text", "  two  spaces "}, {"cls", "c"}}, {});
+  std::stringstream output;
+  renderer.Render(compiler.Compile(), output);
+  TEST_EXPECT_EQ(
+      output.str(),
+      "<div>\n<p>   two  spaces  </p> <PRE class=\"c\">  a\n\n"
+      "    two  spaces   </pre> <b> x </b>\n</div>");
+
+  std::stringstream plain("<p>  a  </p>");
+  yate::Compiler plain_compiler(plain);
+  auto tmpl = plain_compiler.Compile();
+  TEST_ASSERT_EQ(tmpl.nodes().size(), 1u);
+  TEST_EXPECT_EQ(tmpl.nodes()[0].text, "<p>  a  </p>");
+  return 0;
+}
+
+// Partials are compiled with the delimiters of the including template.
+int CompilerTests::TestDelimiters() {
+  std::stringstream input(
+      "function f() { return {{ a: '<%name%>' }}; }<%>item%>");
+  yate::Compiler compiler(input);
+  compiler.set_delimiters(yate::Delimiters("<%", "%>"));
+  compiler.set_partials(std::make_shared<yate::PartialCache>(
+      [](const std::string &name, std::string &source) {
+        source = "{{<%name | upper%>}}";
+        return true;
+      }));
+  yate::Renderer renderer({{"name", "x"}}, {});
+  std::stringstream output;
+  renderer.Render(compiler.Compile(), output);
+  TEST_EXPECT_EQ(
+      output.str(), "function f() { return {{ a: 'x' }}; }{{X}}");
+
+  std::stringstream invalid("<%name}}");
+  yate::Compiler invalid_compiler(invalid);
+  invalid_compiler.set_delimiters(yate::Delimiters("<%", "%>"));
+  TEST_EXPECT_EXCEPTION(
+      invalid_compiler.Compile(),
+      std::runtime_error,
+      "Error found in line 1 column 7: Cannot recognize character '}'.");
+  return 0;
+}
+
+// Zipped loops keep the first array and item in the node, like other
+// loops, and the rest as columns.
+int CompilerTests::TestZippedLoops() {
+  using Kind = yate::Template::Node::Kind;
+  std::stringstream input(
+      "{{#loop names,prices , units as name ,price,unit}}{{price}}{{/loop}}"
+      "{{#loop names as name}}{{/loop}}");
+  yate::Compiler compiler(input);
+  auto tmpl = compiler.Compile();
+  const auto &nodes = tmpl.nodes();
+
+  TEST_ASSERT_EQ(nodes.size(), 5u);
+  TEST_EXPECT(nodes[0].kind == Kind::eLoopBegin);
+  TEST_EXPECT_EQ(nodes[0].text, "names");
+  TEST_EXPECT_EQ(nodes[0].item, "name");
+  TEST_ASSERT_EQ(nodes[0].zipped.size(), 2u);
+  TEST_EXPECT_EQ(nodes[0].zipped[0].array, "prices");
+  TEST_EXPECT_EQ(nodes[0].zipped[0].item, "price");
+  TEST_EXPECT_EQ(nodes[0].zipped[1].array, "units");
+  TEST_EXPECT_EQ(nodes[0].zipped[1].item, "unit");
+  TEST_EXPECT_EQ(nodes[0].jump, 2u);
+  TEST_EXPECT_EQ(nodes[3].item, "name");
+  TEST_EXPECT(nodes[3].zipped.empty());
+
+  std::stringstream arity("{{#loop names, prices as name}}{{/loop}}");
+  yate::Compiler arity_compiler(arity);
+  TEST_EXPECT_EXCEPTION(
+      arity_compiler.Compile(),
+      std::runtime_error,
+      "Loop over 2 arrays binds 1 symbols at line 1 column 3");
+
+  std::stringstream twice("{{#loop names, prices as x, x}}{{/loop}}");
+  yate::Compiler twice_compiler(twice);
+  TEST_EXPECT_EXCEPTION(
+      twice_compiler.Compile(),
+      std::runtime_error,
+      "Symbol 'x' is bound twice at line 1 column 29");
+
+  std::stringstream trailing("{{#loop names, prices as name,}}{{/loop}}");
+  yate::Compiler trailing_compiler(trailing);
+  TEST_EXPECT_EXCEPTION(
+      trailing_compiler.Compile(),
+      std::runtime_error,
+      "Invalid Syntax: Expected 'IDENTIFIER' but got 'SCRIPT_END' ('}}') "
+      "at line 1 column 31");
+  return 0;
+}
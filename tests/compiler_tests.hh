@@ -0,0 +1,14 @@
+#pragma once
+
+struct CompilerTests {
+  int RunTests();
+
+  int TestCompileNodes();
+  int TestCompileErrors();
+  int TestCodeGeneration();
+  int TestGeneratedRender();
+  int TestCompileConditionals();
+  int TestMinify();
+  int TestDelimiters();
+  int TestZippedLoops();
+};
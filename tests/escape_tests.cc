@@ -0,0 +1,180 @@
+#include "escape_tests.hh"
+
+#include "helpers.hh"
+#include "unit.hh"
+
+#include <yate/codegen.hh>
+#include <yate/escape.hh>
+#include <yate/renderer.hh>
+
+#include <random>
+#include <sstream>
+#include <string>
+
+namespace {
+
+/// Escapes one character at a time, used as a reference for the
+/// vectorized kernels.
+std::string EscapeSlowly(yate::Escape mode, const std::string &text) {
+  std::string result;
+  for (auto ch : text) {
+    if (yate::FindEscapable(mode, &ch, 0, 1) == 0) {
+      std::size_t size;
+      auto replacement = yate::GetReplacement(mode, ch, size);
+      result.append(replacement, size);
+    } else {
+      result += ch;
+    }
+  }
+  return result;
+}
+
+} // namespace
+
+int EscapeTests::RunTests() {
+  int result = 0;
+  result += TestEscapeModes();
+  result += TestKernelsMatchScalar();
+  result += TestEscapedRender();
+  result += TestEscapedSpecialization();
+  result += TestGeneratedEscaping();
+  return result;
+}
+
+int EscapeTests::TestEscapeModes() {
+  using yate::Escape;
+  using yate::Escaped;
+  TEST_EXPECT_EQ(Escaped(Escape::eNone, "<a href='x'>"), "<a href='x'>");
+  TEST_EXPECT_EQ(
+      Escaped(Escape::eHtml, "<b>Tom & \"Jerry\"</b>"),
+      "&lt;b&gt;Tom &amp; \"Jerry\"&lt;/b&gt;");
+  TEST_EXPECT_EQ(
+      Escaped(Escape::eHtmlAttribute, "\"it's\" `x` <&>"),
+      "&quot;it&#39;s&quot; &#96;x&#96; &lt;&amp;&gt;");
+  TEST_EXPECT_EQ(
+      Escaped(Escape::eJson, std::string("a\"b\\c\nd\te\x01\x1f", 11)),
+      "a\\\"b\\\\c\\nd\\te\\u0001\\u001F");
+  TEST_EXPECT_EQ(
+      Escaped(Escape::eUrl, "a b/c?d=é~_.-Z9"),
+      "a%20b%2Fc%3Fd%3D%C3%A9~_.-Z9");
+
+  // Long clean runs with a character to escape at every position of
+  // a vector, including the last one.
+  std::string clean(64, 'x');
+  for (std::size_t i = 0; i < clean.size(); ++i) {
+    auto text = clean;
+    text[i] = '<';
+    auto expected = clean.substr(0, i) + "&lt;" + clean.substr(i + 1);
+    TEST_EXPECT_EQ(Escaped(Escape::eHtml, text), expected);
+  }
+
+  yate::Escape mode;
+  TEST_EXPECT(yate::ParseEscape("attr", mode));
+  TEST_EXPECT(mode == Escape::eHtmlAttribute);
+  TEST_EXPECT(yate::ParseEscape("raw", mode));
+  TEST_EXPECT(mode == Escape::eNone);
+  TEST_EXPECT(!yate::ParseEscape("xml", mode));
+  return 0;
+}
+
+// Random texts of every length up to a few vectors, biased towards
+// the characters each mode handles, give the same result through the
+// vectorized kernels and the character by character reference.
+int EscapeTests::TestKernelsMatchScalar() {
+  static const char kAlphabet[] = "abcXYZ019-._~&<>\"'`\\/ %\n\t\x01\x7f\xc3\xa9";
+  std::mt19937 generator(42);
+  std::uniform_int_distribution<std::size_t> pick(
+      0, sizeof(kAlphabet) - 2);
+  std::uniform_int_distribution<int> clean(0, 3);
+  for (auto mode :
+       {yate::Escape::eHtml, yate::Escape::eHtmlAttribute, yate::Escape::eJson,
+        yate::Escape::eUrl}) {
+    for (std::size_t length = 0; length < 100; ++length) {
+      std::string text;
+      for (std::size_t i = 0; i < length; ++i) {
+        // Mostly clean text, so the kernels skip whole vectors too.
+        text += clean(generator) != 0 ? 'q' : kAlphabet[pick(generator)];
+      }
+      TEST_EXPECT_EQ(yate::Escaped(mode, text), EscapeSlowly(mode, text));
+    }
+  }
+  return 0;
+}
+
+// The default escaping of the template applies to every substitution
+// unless it names its own mode.
+int EscapeTests::TestEscapedRender() {
+  auto tmpl = CompileString(
+      "<p title=\"{{title | attr}}\">{{body}}{{#loop items item}}"
+      "<a href=\"/q?{{item | url}}\">{{item}}</a>{{/loop}}{{body | raw}}</p>",
+      yate::Escape::eHtml);
+  yate::Renderer renderer(
+      {{"title", "\"1 < 2\""}, {"body", "<br>"}},
+      {{"items", {"a&b", "c d"}}});
+  std::stringstream output;
+  renderer.Render(tmpl, output);
+  TEST_EXPECT_EQ(
+      output.str(),
+      "<p title=\"&quot;1 &lt; 2&quot;\">&lt;br&gt;"
+      "<a href=\"/q?a%26b\">a&amp;b</a><a href=\"/q?c%20d\">c d</a><br></p>");
+
+  TEST_EXPECT_EXCEPTION(
+      CompileString("{{name | xml}}"),
+      std::runtime_error,
+      "Unknown filter or escaping mode 'xml' at line 1 column 10");
+  TEST_EXPECT_EXCEPTION(
+      CompileString("{{name |}}"),
+      std::runtime_error,
+      "Invalid Syntax: Expected 'IDENTIFIER' but got 'SCRIPT_END' ('}}') at "
+      "line 1 column 9");
+  return 0;
+}
+
+// Values folded by the partial evaluation are escaped with the mode
+// of their substitution.
+int EscapeTests::TestEscapedSpecialization() {
+  auto tmpl = CompileString(
+      "{{a | html}}{{#loop xs x}}[{{x | json}}]{{/loop}}{{b | url}}");
+  auto residual = tmpl.Specialize({{"a", "<"}}, {{"xs", {"\"", "\n"}}});
+  TEST_ASSERT_EQ(residual.nodes().size(), 2u);
+  TEST_EXPECT_EQ(residual.nodes()[0].text, "&lt;[\\\"][\\n]");
+  TEST_EXPECT(residual.nodes()[1].escape == yate::Escape::eUrl);
+
+  yate::Renderer renderer({{"b", "/"}}, {});
+  std::stringstream output;
+  renderer.Render(residual, output);
+  TEST_EXPECT_EQ(output.str(), "&lt;[\\\"][\\n]%2F");
+  return 0;
+}
+
+// Generated code calls the same kernels and only depends on them when
+// some substitution is escaped.
+int EscapeTests::TestGeneratedEscaping() {
+  {
+    auto tmpl = CompileString("{{a}}{{b | raw}}", yate::Escape::eJson);
+    yate::CodeGenerator generator(tmpl, "Escaped", "");
+    std::stringstream code;
+    generator.Generate(code);
+    auto text = code.str();
+    TEST_EXPECT_NEQ(text.find("#include <yate/escape.hh>"), std::string::npos);
+    TEST_EXPECT_NEQ(
+        text.find("yate::WriteEscapedTo(yate::Escape::eJson, context.a.data(), "
+                  "context.a.size(), output);"),
+        std::string::npos);
+    TEST_EXPECT_NEQ(
+        text.find("output.write(context.b.data(), context.b.size());"),
+        std::string::npos);
+  }
+  {
+    auto tmpl = CompileString("{{a}}");
+    yate::CodeGenerator generator(tmpl, "Plain", "");
+    std::stringstream code;
+    generator.Generate(code);
+    TEST_EXPECT_EQ(code.str().find("yate/escape.hh"), std::string::npos);
+  }
+
+  std::stringstream output;
+  yate::WriteEscapedTo(yate::Escape::eHtml, "a<b", 3, output);
+  TEST_EXPECT_EQ(output.str(), "a&lt;b");
+  return 0;
+}
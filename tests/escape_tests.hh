@@ -0,0 +1,11 @@
+#pragma once
+
+struct EscapeTests {
+  int RunTests();
+
+  int TestEscapeModes();
+  int TestKernelsMatchScalar();
+  int TestEscapedRender();
+  int TestEscapedSpecialization();
+  int TestGeneratedEscaping();
+};
@@ -0,0 +1,182 @@
+#include "filter_tests.hh"
+
+#include "helpers.hh"
+#include "unit.hh"
+
+#include <yate/compiler.hh>
+#include <yate/filter.hh>
+#include <yate/renderer.hh>
+
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+std::string RenderString(
+    const std::string &text,
+    std::unordered_map<std::string, std::string> values,
+    const yate::FilterRegistry &filters = yate::FilterRegistry::Builtin()) {
+  yate::Renderer renderer(std::move(values), {});
+  return RenderToString(renderer, CompileString(text, filters));
+}
+
+/// Filter used to test custom registries, it wraps the value with its
+/// argument.
+void Wrap(
+    const char *data,
+    std::size_t size,
+    const std::vector<yate::FilterArgument> &arguments,
+    yate::Sink &output) {
+  const auto &wrapper = arguments[0].text;
+  output.Write(wrapper.data(), wrapper.size());
+  output.Write(data, size);
+  output.Write(wrapper.data(), wrapper.size());
+}
+
+} // namespace
+
+int FilterTests::RunTests() {
+  int result = 0;
+  result += TestBuiltinFilters();
+  result += TestFilterChains();
+  result += TestCustomFilters();
+  result += TestFilterErrors();
+  result += TestSpecializeFilters();
+  return result;
+}
+
+int FilterTests::TestBuiltinFilters() {
+  TEST_EXPECT_EQ(
+      RenderString("{{a | upper}} {{a | lower}}", {{"a", "MiXeD 1"}}),
+      "MIXED 1 mixed 1");
+  TEST_EXPECT_EQ(
+      RenderString(
+          "{{a | truncate 5}}|{{a | truncate 3 \"~\"}}|{{a | truncate 20}}",
+          {{"a", "abcdefgh"}}),
+      "abcde...|abc~|abcdefgh");
+  // UTF-8 characters are not split.
+  TEST_EXPECT_EQ(
+      RenderString("{{a | truncate 2 \"\"}}", {{"a", "a\xc3\xa9z"}}), "a");
+  TEST_EXPECT_EQ(
+      RenderString(
+          "{{a | number}} {{b | number 2}} {{c | number 1}}",
+          {{"a", "1234567"}, {"b", "-1234.5"}, {"c", "999"}}),
+      "1,234,567 -1,234.50 999.0");
+  TEST_EXPECT_EQ(
+      RenderString(
+          "{{t | date}} {{t | date \"%H:%M:%S\"}}", {{"t", "1700000000"}}),
+      "2023-11-14 22:13:20");
+  TEST_EXPECT_EQ(
+      RenderString(
+          "{{a | default \"none\"}} {{b | default \"none\"}}",
+          {{"a", ""}, {"b", "some"}}),
+      "none some");
+  return 0;
+}
+
+// Filters are applied from left to right and the escaping mode, either
+// the one given or the default of the template, applies to the result.
+int FilterTests::TestFilterChains() {
+  TEST_EXPECT_EQ(
+      RenderString(
+          "{{a | truncate 6 \"\" | upper | html}}", {{"a", "<b>bold</b>"}}),
+      "&lt;B&gt;BOL");
+  TEST_EXPECT_EQ(
+      RenderString(
+          "{{a | default \"<none>\" | lower | upper}}", {{"a", ""}}),
+      "<NONE>");
+
+  std::stringstream input("{{a | upper}}{{a | upper | raw}}");
+  yate::Compiler compiler(input);
+  compiler.set_default_escape(yate::Escape::eHtml);
+  auto tmpl = compiler.Compile();
+  yate::Renderer renderer({{"a", "x&y"}}, {});
+  std::stringstream output;
+  renderer.Render(tmpl, output);
+  TEST_EXPECT_EQ(output.str(), "X&amp;YX&Y");
+  return 0;
+}
+
+// Registries extending the built-in ones resolve both their own
+// filters and the built-in filters.
+int FilterTests::TestCustomFilters() {
+  auto filters = yate::FilterRegistry::Builtin();
+  filters.Register("wrap", Wrap, 1, 1);
+  TEST_EXPECT(filters.Contains("wrap"));
+  TEST_EXPECT(!yate::FilterRegistry::Builtin().Contains("wrap"));
+  TEST_EXPECT_EQ(
+      RenderString("{{a | wrap \"*\" | upper}}", {{"a", "b"}}, filters),
+      "*B*");
+
+  auto tmpl = CompileString("{{a | wrap \"-\"}}", filters);
+  const auto &node = tmpl.nodes()[0];
+  TEST_ASSERT_EQ(node.filters.size(), 1u);
+  TEST_EXPECT(node.filters[0].function == &Wrap);
+  TEST_EXPECT_EQ(node.filters[0].arguments[0].text, "-");
+
+  // Counts are parsed once, when the template is compiled.
+  auto truncate = CompileString("{{a | truncate 12 \"~\"}}");
+  const auto &arguments = truncate.nodes()[0].filters[0].arguments;
+  TEST_ASSERT_EQ(arguments.size(), 2u);
+  TEST_EXPECT_EQ(arguments[0].count, 12u);
+  TEST_EXPECT_EQ(arguments[1].text, "~");
+  return 0;
+}
+
+// Unknown filters and wrong arguments are reported when compiling,
+// bad values when rendering.
+int FilterTests::TestFilterErrors() {
+  TEST_EXPECT_EXCEPTION(
+      CompileString("{{a | wrap \"*\"}}"),
+      std::runtime_error,
+      "Unknown filter 'wrap' at line 1 column 7");
+  TEST_EXPECT_EXCEPTION(
+      CompileString("{{a | truncate}}"),
+      std::runtime_error,
+      "Filter 'truncate' takes 1 to 2 arguments but got 0 at line 1 column 7");
+  TEST_EXPECT_EXCEPTION(
+      CompileString("{{a | upper 1}}"),
+      std::runtime_error,
+      "Filter 'upper' takes 0 arguments but got 1 at line 1 column 7");
+  TEST_EXPECT_EXCEPTION(
+      CompileString("{{a | truncate \"abc\"}}"),
+      std::runtime_error,
+      "Argument 1 of filter 'truncate' is not a non-negative integer: 'abc' "
+      "at line 1 column 7");
+  TEST_EXPECT_EXCEPTION(
+      CompileString("\n  {{a | truncate -1}}"),
+      std::runtime_error,
+      "Argument 1 of filter 'truncate' is not a non-negative integer: '-1' "
+      "at line 2 column 9");
+  TEST_EXPECT_EXCEPTION(
+      CompileString("{{a | number 99999999999999999999}}"),
+      std::runtime_error,
+      "Argument 1 of filter 'number' is not a non-negative integer: "
+      "'99999999999999999999' at line 1 column 7");
+  TEST_EXPECT_EXCEPTION(
+      CompileString("{{a | html | upper}}"),
+      std::runtime_error,
+      "Invalid Syntax: Expected 'SCRIPT_END' but got 'PIPE' ('|') at line 1 "
+      "column 12");
+  TEST_EXPECT_EXCEPTION(
+      RenderString("{{a | number}}", {{"a", "12abc"}}),
+      std::runtime_error,
+      "Value '12abc' is not a number");
+  return 0;
+}
+
+// Partial evaluation runs the filters of the values it folds.
+int FilterTests::TestSpecializeFilters() {
+  auto tmpl = CompileString("{{a | number 1}}/{{b | upper}}");
+  auto residual = tmpl.Specialize({{"a", "1000"}}, {});
+  TEST_ASSERT_EQ(residual.nodes().size(), 2u);
+  TEST_EXPECT_EQ(residual.nodes()[0].text, "1,000.0/");
+  TEST_EXPECT_EQ(residual.nodes()[1].filters.size(), 1u);
+
+  yate::Renderer renderer({{"b", "c"}}, {});
+  std::stringstream output;
+  renderer.Render(residual, output);
+  TEST_EXPECT_EQ(output.str(), "1,000.0/C");
+  return 0;
+}
@@ -0,0 +1,11 @@
+#pragma once
+
+struct FilterTests {
+  int RunTests();
+
+  int TestBuiltinFilters();
+  int TestFilterChains();
+  int TestCustomFilters();
+  int TestFilterErrors();
+  int TestSpecializeFilters();
+};
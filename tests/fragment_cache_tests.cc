@@ -0,0 +1,188 @@
+#include "fragment_cache_tests.hh"
+
+#include "helpers.hh"
+#include "unit.hh"
+
+#include <yate/fragment_cache.hh>
+#include <yate/renderer.hh>
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace {
+
+/// A key of 8 bytes.
+yate::FragmentKey Key(std::uint64_t number) {
+  yate::FragmentKey key;
+  key.Add(number);
+  return key;
+}
+
+std::shared_ptr<const std::string> Fragment(std::string text) {
+  return std::make_shared<const std::string>(std::move(text));
+}
+
+} // namespace
+
+int FragmentCacheTests::RunTests() {
+  int result = 0;
+  result += TestCachedSections();
+  result += TestInvalidation();
+  result += TestEviction();
+  result += TestConcurrentRenders();
+  return result;
+}
+
+// Top-level loops are cached and reused across renderers, while the
+// rest of the template is rendered every time.
+int FragmentCacheTests::TestCachedSections() {
+  auto tmpl = CompileString(
+      "{{user}}:{{#loop rows row}}<{{row}}|{{label}}>{{/loop}}"
+      "{{#loop rows row}}{{#loop rows inner}}{{inner}}{{/loop}}{{/loop}}");
+  auto cache = std::make_shared<yate::FragmentCache>(1024);
+
+  yate::Renderer first(
+      {{"user", "ada"}, {"label", "x"}}, {{"rows", {"1", "2"}}});
+  first.set_fragment_cache(cache);
+  TEST_EXPECT_EQ(RenderToString(first, tmpl), "ada:<1|x><2|x>1212");
+  TEST_EXPECT_EQ(cache->misses(), 2u);
+  TEST_EXPECT_EQ(cache->hits(), 0u);
+
+  // Only the user differs, which is not read by any section.
+  yate::Renderer second(
+      {{"user", "bob"}, {"label", "x"}}, {{"rows", {"1", "2"}}});
+  second.set_fragment_cache(cache);
+  TEST_EXPECT_EQ(RenderToString(second, tmpl), "bob:<1|x><2|x>1212");
+  TEST_EXPECT_EQ(cache->misses(), 2u);
+  TEST_EXPECT_EQ(cache->hits(), 2u);
+  // 14 bytes of fragments and 93 of keys: the template id, the index
+  // of the section and the length prefixed inputs.
+  TEST_EXPECT_EQ(cache->size(), 107u);
+
+  // Undefined symbols are still reported.
+  yate::Renderer undefined({{"user", "ada"}}, {{"rows", {"1"}}});
+  undefined.set_fragment_cache(cache);
+  std::stringstream output;
+  TEST_EXPECT_EXCEPTION(
+      undefined.Render(tmpl, output),
+      std::runtime_error,
+      "Identifier 'label' is undefined");
+
+  // A render which fails after writing a cached fragment does not keep
+  // it pinned: only the cache and this test hold it afterwards.
+  auto failing = CompileString("{{#loop rows row}}{{row}}{{/loop}}{{label}}");
+  yate::Renderer pinning({}, {{"rows", {"1", "2"}}});
+  pinning.set_fragment_cache(cache);
+  TEST_EXPECT_EXCEPTION(
+      pinning.Render(failing, output),
+      std::runtime_error,
+      "Identifier 'label' is undefined");
+  yate::FragmentKey key;
+  key.Add(failing.id());
+  key.Add(static_cast<std::uint64_t>(0));
+  key.Add(std::vector<std::string>{"1", "2"});
+  auto fragment = cache->Find(key);
+  TEST_ASSERT_EQ(fragment != nullptr, true);
+  TEST_EXPECT_EQ(fragment.use_count(), 2);
+  return 0;
+}
+
+// A change in any of the inputs of a section is a miss.
+int FragmentCacheTests::TestInvalidation() {
+  auto tmpl = CompileString("{{#loop rows row}}{{row}}{{label}}{{/loop}}");
+  auto other = CompileString("{{#loop rows row}}{{row}}{{label}}{{/loop}}");
+  auto cache = std::make_shared<yate::FragmentCache>(1024);
+
+  yate::Renderer renderer({{"label", "x"}}, {{"rows", {"1", "2"}}});
+  renderer.set_fragment_cache(cache);
+  RenderToString(renderer, tmpl);
+  TEST_EXPECT_EQ(RenderToString(renderer, tmpl), "1x2x");
+  TEST_EXPECT_EQ(cache->hits(), 1u);
+
+  // Same template source compiled twice does not share fragments.
+  TEST_EXPECT_EQ(RenderToString(renderer, other), "1x2x");
+  TEST_EXPECT_EQ(cache->misses(), 2u);
+
+  yate::Renderer label({{"label", "y"}}, {{"rows", {"1", "2"}}});
+  label.set_fragment_cache(cache);
+  TEST_EXPECT_EQ(RenderToString(label, tmpl), "1y2y");
+
+  // Moving a character between elements changes the key.
+  yate::Renderer rows({{"label", "x"}}, {{"rows", {"12", ""}}});
+  rows.set_fragment_cache(cache);
+  TEST_EXPECT_EQ(RenderToString(rows, tmpl), "12xx");
+  TEST_EXPECT_EQ(cache->hits(), 1u);
+  TEST_EXPECT_EQ(cache->misses(), 4u);
+  return 0;
+}
+
+// The least recently used fragments are evicted first. Keys count
+// against the capacity as well as the fragments.
+int FragmentCacheTests::TestEviction() {
+  yate::FragmentCache cache(30);
+  cache.Insert(Key(1), Fragment("aaaa"));
+  cache.Insert(Key(2), Fragment("bbbb"));
+  TEST_EXPECT(cache.Find(Key(1)) != nullptr);
+  cache.Insert(Key(3), Fragment("cccc"));
+  TEST_EXPECT(cache.Find(Key(2)) == nullptr);
+  TEST_EXPECT(cache.Find(Key(1)) != nullptr);
+  TEST_EXPECT_EQ(*cache.Find(Key(3)), "cccc");
+  TEST_EXPECT_EQ(cache.size(), 24u);
+  TEST_EXPECT_EQ(cache.evictions(), 1u);
+
+  // The fragment inserted is shared, not copied.
+  auto fragment = Fragment("dd");
+  cache.Insert(Key(4), fragment);
+  TEST_EXPECT(cache.Find(Key(4)) == fragment);
+
+  // Keys are compared whole, not only by their hash.
+  yate::FragmentKey longer = Key(4);
+  longer.Add(std::string());
+  TEST_EXPECT(cache.Find(longer) == nullptr);
+
+  // Too big to ever fit.
+  cache.Insert(Key(5), Fragment("01234567890123456789012"));
+  TEST_EXPECT(cache.Find(Key(5)) == nullptr);
+  TEST_EXPECT_EQ(cache.size(), 22u);
+
+  cache.Clear();
+  TEST_EXPECT_EQ(cache.size(), 0u);
+  return 0;
+}
+
+// Renderers in different threads share a single cache.
+int FragmentCacheTests::TestConcurrentRenders() {
+  auto tmpl = CompileString("{{#loop rows row}}[{{row}}]{{/loop}}{{id}}");
+  auto cache = std::make_shared<yate::FragmentCache>(64);
+  std::atomic<int> failures(0);
+
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; ++t) {
+    threads.emplace_back([&tmpl, &cache, &failures, t]() {
+      for (int i = 0; i < 200; ++i) {
+        auto rows = std::to_string(i % 7);
+        yate::Renderer renderer(
+            {{"id", std::to_string(t)}}, {{"rows", {rows, rows}}});
+        renderer.set_fragment_cache(cache);
+        auto expected = "[" + rows + "][" + rows + "]" + std::to_string(t);
+        if (RenderToString(renderer, tmpl) != expected) {
+          ++failures;
+        }
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+
+  TEST_EXPECT_EQ(failures.load(), 0);
+  TEST_EXPECT_EQ(cache->hits() + cache->misses(), 800u);
+  TEST_EXPECT(cache->size() <= 64u);
+  return 0;
+}
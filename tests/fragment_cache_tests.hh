@@ -0,0 +1,10 @@
+#pragma once
+
+struct FragmentCacheTests {
+  int RunTests();
+
+  int TestCachedSections();
+  int TestInvalidation();
+  int TestEviction();
+  int TestConcurrentRenders();
+};
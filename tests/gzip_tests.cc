@@ -0,0 +1,177 @@
+#ifdef YATE_ZLIB
+
+#include "gzip_tests.hh"
+
+#include "helpers.hh"
+#include "unit.hh"
+
+#include <yate/gzip_sink.hh>
+#include <yate/renderer.hh>
+#include <yate/sink.hh>
+
+#include <zlib.h>
+
+#include <cstring>
+#include <memory>
+#include <string>
+
+namespace {
+
+/// Decompresses gzip or zlib data, including several gzip members one
+/// after the other. Returns "inflate failed" on corrupt data, which
+/// includes wrong checksums and sizes.
+std::string Inflate(const std::string &compressed) {
+  z_stream stream;
+  std::memset(&stream, 0, sizeof(stream));
+  // Detects the gzip or zlib header.
+  if (inflateInit2(&stream, 15 + 32) != Z_OK) {
+    return "inflate failed";
+  }
+  stream.next_in =
+      reinterpret_cast<Bytef *>(const_cast<char *>(compressed.data()));
+  stream.avail_in = static_cast<uInt>(compressed.size());
+  std::string output;
+  char buffer[4096];
+  int status = Z_OK;
+  while (stream.avail_in > 0) {
+    stream.next_out = reinterpret_cast<Bytef *>(buffer);
+    stream.avail_out = sizeof(buffer);
+    status = inflate(&stream, Z_NO_FLUSH);
+    output.append(buffer, sizeof(buffer) - stream.avail_out);
+    if (status == Z_STREAM_END) {
+      inflateReset(&stream);
+    } else if (status != Z_OK) {
+      break;
+    }
+  }
+  inflateEnd(&stream);
+  if (status != Z_STREAM_END) {
+    return "inflate failed";
+  }
+  return output;
+}
+
+} // namespace
+
+int GzipTests::RunTests() {
+  int result = 0;
+  result += TestRoundTrip();
+  result += TestSplicedLiterals();
+  result += TestDeflateFormat();
+  result += TestChangedLiteral();
+  result += TestSeveralFlushes();
+  return result;
+}
+
+int GzipTests::TestRoundTrip() {
+  auto tmpl = CompileString(
+      "<ul>{{#loop rows row}}<li>{{row}}</li>{{/loop}}</ul>");
+  yate::Renderer renderer({}, {{"rows", {"a", "b", "c"}}});
+  std::string output;
+  yate::StringSink target(output);
+  yate::GzipSink sink(target);
+  renderer.Render(tmpl, sink);
+  TEST_ASSERT_EQ(output.substr(0, 2), std::string("\x1f\x8b"));
+  TEST_EXPECT_EQ(Inflate(output), "<ul><li>a</li><li>b</li><li>c</li></ul>");
+  TEST_EXPECT_EQ(sink.bytes_in(), 39u);
+  TEST_EXPECT_EQ(sink.bytes_out(), output.size());
+  TEST_EXPECT_EQ(sink.spliced_bytes(), 0u);
+  return 0;
+}
+
+// Long literals are compressed once and reused by every response, which
+// still decompresses to the plain output.
+int GzipTests::TestSplicedLiterals() {
+  std::string header(2000, 'h');
+  std::string footer;
+  for (int i = 0; i < 200; ++i) {
+    footer += "<p>" + std::to_string(i) + "</p>";
+  }
+  auto tmpl = CompileString(
+      header + "{{#loop rows row}}<li>{{row}} " + header.substr(0, 20) +
+      "</li>{{/loop}}" + footer);
+  yate::Renderer renderer({}, {{"rows", {"a", "b"}}});
+  std::string plain;
+  yate::StringSink plain_sink(plain);
+  renderer.Render(tmpl, plain_sink);
+
+  auto literals = std::make_shared<yate::CompressedLiterals>(100);
+  for (int i = 0; i < 2; ++i) {
+    std::string output;
+    yate::StringSink target(output);
+    yate::GzipSink sink(
+        target, Z_DEFAULT_COMPRESSION, yate::GzipSink::Format::eGzip,
+        literals);
+    renderer.Render(tmpl, sink);
+    TEST_EXPECT_EQ(Inflate(output), plain);
+    TEST_EXPECT_EQ(sink.bytes_in(), plain.size());
+    TEST_EXPECT_EQ(sink.spliced_bytes(), header.size() + footer.size());
+    TEST_EXPECT(output.size() < plain.size() / 4);
+  }
+  TEST_EXPECT_EQ(literals->size(), 2u);
+  return 0;
+}
+
+int GzipTests::TestDeflateFormat() {
+  std::string literal(500, 'x');
+  auto literals = std::make_shared<yate::CompressedLiterals>(100);
+  std::string output;
+  yate::StringSink target(output);
+  yate::GzipSink sink(
+      target, Z_BEST_SPEED, yate::GzipSink::Format::eDeflate, literals);
+  sink.Write("before ", 7);
+  sink.WriteStable(literal.data(), literal.size());
+  sink.Write(" after", 6);
+  sink.Flush();
+  TEST_ASSERT_EQ(output.substr(0, 2), std::string("\x78\x9c"));
+  TEST_EXPECT_EQ(Inflate(output), "before " + literal + " after");
+  TEST_EXPECT_EQ(sink.spliced_bytes(), literal.size());
+  return 0;
+}
+
+// A literal replaced by different bytes at the same address is
+// compressed again.
+int GzipTests::TestChangedLiteral() {
+  std::string literal(300, 'a');
+  auto literals = std::make_shared<yate::CompressedLiterals>(100);
+  auto first = literals->Get(literal.data(), literal.size());
+  TEST_ASSERT_EQ(first != nullptr, true);
+  TEST_EXPECT(literals->Get(literal.data(), literal.size()) == first);
+
+  literal.assign(literal.size(), 'b');
+  std::string output;
+  yate::StringSink target(output);
+  yate::GzipSink sink(
+      target, Z_DEFAULT_COMPRESSION, yate::GzipSink::Format::eGzip,
+      literals);
+  sink.WriteStable(literal.data(), literal.size());
+  sink.Flush();
+  TEST_EXPECT_EQ(Inflate(output), literal);
+  TEST_EXPECT_EQ(literals->size(), 1u);
+  TEST_EXPECT(first->text == std::string(300, 'a'));
+
+  // A full cache falls back to compressing the literal with the rest.
+  auto full = std::make_shared<yate::CompressedLiterals>(100, 100);
+  TEST_EXPECT(full->Get(literal.data(), literal.size()) == nullptr);
+  return 0;
+}
+
+// Every flush ends a gzip member, and the members together decompress
+// to the whole output.
+int GzipTests::TestSeveralFlushes() {
+  std::string output;
+  yate::StringSink target(output);
+  yate::GzipSink sink(target);
+  sink.Write("first ", 6);
+  sink.Flush();
+  auto first_size = output.size();
+  TEST_EXPECT_EQ(Inflate(output), "first ");
+  sink.Flush();
+  TEST_EXPECT_EQ(output.size(), first_size);
+  sink.Write("second", 6);
+  sink.Flush();
+  TEST_EXPECT_EQ(Inflate(output), "first second");
+  return 0;
+}
+
+#endif // YATE_ZLIB
@@ -0,0 +1,15 @@
+#pragma once
+
+#ifdef YATE_ZLIB
+
+struct GzipTests {
+  int RunTests();
+
+  int TestRoundTrip();
+  int TestSplicedLiterals();
+  int TestDeflateFormat();
+  int TestChangedLiteral();
+  int TestSeveralFlushes();
+};
+
+#endif // YATE_ZLIB
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <yate/compiler.hh>
+#include <yate/escape.hh>
+#include <yate/filter.hh>
+#include <yate/partial_cache.hh>
+#include <yate/renderer.hh>
+#include <yate/template.hh>
+
+#include <cstddef>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <utility>
+
+/// Compiles a template from a string, with the partials of a cache
+/// when one is given.
+inline yate::Template CompileString(
+    const std::string &text,
+    std::shared_ptr<yate::PartialCache> partials = nullptr,
+    std::size_t inline_limit = 0) {
+  std::stringstream input(text);
+  yate::Compiler compiler(input);
+  compiler.set_partials(std::move(partials));
+  compiler.set_inline_limit(inline_limit);
+  return compiler.Compile();
+}
+
+/// Compiles a template from a string with a default escaping mode.
+inline yate::Template CompileString(
+    const std::string &text,
+    yate::Escape escape) {
+  std::stringstream input(text);
+  yate::Compiler compiler(input);
+  compiler.set_default_escape(escape);
+  return compiler.Compile();
+}
+
+/// Compiles a template from a string with the filters of a registry.
+inline yate::Template CompileString(
+    const std::string &text,
+    const yate::FilterRegistry &filters) {
+  std::stringstream input(text);
+  yate::Compiler compiler(input);
+  compiler.set_filters(filters);
+  return compiler.Compile();
+}
+
+/// Renders a template into a string.
+inline std::string RenderToString(
+    yate::Renderer &renderer,
+    const yate::Template &tmpl) {
+  std::stringstream output;
+  renderer.Render(tmpl, output);
+  return output.str();
+}
@@ -0,0 +1,96 @@
+#include "incremental_tests.hh"
+
+#include "helpers.hh"
+#include "unit.hh"
+
+#include <yate/incremental_renderer.hh>
+
+#include <string>
+
+namespace {
+
+const char kDashboard[] =
+    "<h1>{{title}}</h1><p>{{load}}</p>"
+    "<ul>{{#loop hosts host}}<li>{{host}} {{unit}}</li>{{/loop}}</ul>"
+    "<footer>{{title}}</footer>";
+
+} // namespace
+
+int IncrementalTests::RunTests() {
+  int result = 0;
+  result += TestInitialRender();
+  result += TestUpdateValues();
+  result += TestUpdateArrays();
+  return result;
+}
+
+// The first render produces the whole output.
+int IncrementalTests::TestInitialRender() {
+  auto tmpl = CompileString(kDashboard);
+  yate::IncrementalRenderer renderer(
+      tmpl,
+      {{"title", "Status"}, {"load", "0.5"}, {"unit", "ms"}},
+      {{"hosts", {"a", "b"}}});
+  TEST_EXPECT_EQ(
+      renderer.output(),
+      "<h1>Status</h1><p>0.5</p><ul><li>a ms</li><li>b ms</li></ul>"
+      "<footer>Status</footer>");
+  return 0;
+}
+
+// Only the segments reading the changed values are patched.
+int IncrementalTests::TestUpdateValues() {
+  auto tmpl = CompileString(kDashboard);
+  yate::IncrementalRenderer renderer(
+      tmpl,
+      {{"title", "Status"}, {"load", "0.5"}, {"unit", "ms"}},
+      {{"hosts", {"a", "b"}}});
+  auto previous = renderer.output();
+
+  auto patches = renderer.Update({{"load", "12.25"}}, {});
+  TEST_ASSERT_EQ(patches.size(), 1u);
+  TEST_EXPECT_EQ(patches[0].offset, 18u);
+  TEST_EXPECT_EQ(patches[0].length, 3u);
+  TEST_EXPECT_EQ(patches[0].text, "12.25");
+  yate::IncrementalRenderer::Apply(patches, previous);
+  TEST_EXPECT_EQ(previous, renderer.output());
+
+  // A value read in two places and inside a loop.
+  patches = renderer.Update({{"title", "OK"}, {"unit", "s"}}, {});
+  TEST_ASSERT_EQ(patches.size(), 3u);
+  TEST_EXPECT_EQ(patches[0].offset, 4u);
+  TEST_EXPECT_EQ(patches[1].text, "<li>a s</li><li>b s</li>");
+  TEST_EXPECT_EQ(patches[2].text, "OK");
+  yate::IncrementalRenderer::Apply(patches, previous);
+  TEST_EXPECT_EQ(previous, renderer.output());
+  TEST_EXPECT_EQ(
+      previous,
+      "<h1>OK</h1><p>12.25</p><ul><li>a s</li><li>b s</li></ul>"
+      "<footer>OK</footer>");
+
+  // Values which do not change the output produce no patches.
+  TEST_EXPECT_EQ(renderer.Update({{"load", "12.25"}}, {}).size(), 0u);
+  TEST_EXPECT_EQ(renderer.Update({{"unused", "x"}}, {}).size(), 0u);
+  return 0;
+}
+
+// Arrays changes re-render the loops iterating over them.
+int IncrementalTests::TestUpdateArrays() {
+  auto tmpl = CompileString(kDashboard);
+  yate::IncrementalRenderer renderer(
+      tmpl,
+      {{"title", "Status"}, {"load", "0.5"}, {"unit", "ms"}},
+      {{"hosts", {"a", "b"}}});
+  auto previous = renderer.output();
+
+  auto patches = renderer.Update({}, {{"hosts", {"c"}}});
+  TEST_ASSERT_EQ(patches.size(), 1u);
+  TEST_EXPECT_EQ(patches[0].text, "<li>c ms</li>");
+  yate::IncrementalRenderer::Apply(patches, previous);
+  TEST_EXPECT_EQ(previous, renderer.output());
+  TEST_EXPECT_EQ(
+      previous,
+      "<h1>Status</h1><p>0.5</p><ul><li>c ms</li></ul>"
+      "<footer>Status</footer>");
+  return 0;
+}
@@ -0,0 +1,9 @@
+#pragma once
+
+struct IncrementalTests {
+  int RunTests();
+
+  int TestInitialRender();
+  int TestUpdateValues();
+  int TestUpdateArrays();
+};
@@ -0,0 +1,81 @@
+#include "json_tests.hh"
+
+#include "unit.hh"
+
+#include <yate/json_context.hh>
+
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+int JsonTests::RunTests() {
+  int result = 0;
+  result += TestParseContext();
+  result += TestParseErrors();
+  return result;
+}
+
+// Scalars become values and arrays of scalars become arrays, numbers
+// keep their text and false values are empty.
+int JsonTests::TestParseContext() {
+  auto context = yate::ParseJsonContext(
+      " {\"name\": \"A\\\"da\\n\", \"n\": -1.5e3, \"vip\": true,"
+      " \"off\": false, \"none\": null, \"tags\": [\"x\", 2, true],"
+      " \"empty\": [],"
+      " \"esc\": \"\\u00e9\\u20ac\\ud83d\\ude00\\/\", \"n\": 0} ");
+  TEST_ASSERT_EQ(context.values.size(), 6u);
+  TEST_EXPECT_EQ(context.values["name"], "A\"da\n");
+  TEST_EXPECT_EQ(context.values["n"], "0");
+  TEST_EXPECT_EQ(context.values["vip"], "true");
+  TEST_EXPECT_EQ(context.values["off"], "");
+  TEST_EXPECT_EQ(context.values["none"], "");
+  TEST_EXPECT_EQ(
+      context.values["esc"], "\xc3\xa9\xe2\x82\xac\xf0\x9f\x98\x80/");
+  TEST_ASSERT_EQ(context.arrays.size(), 2u);
+  TEST_EXPECT(
+      context.arrays["tags"] == std::vector<std::string>({"x", "2", "true"}));
+  TEST_EXPECT(context.arrays["empty"].empty());
+
+  // A repeated key replaces the previous one, whatever its kind.
+  auto replaced = yate::ParseJsonContext("{\"a\": [\"x\"], \"a\": \"y\"}");
+  TEST_EXPECT(replaced.arrays.empty());
+  TEST_EXPECT_EQ(replaced.values["a"], "y");
+  TEST_EXPECT(yate::ParseJsonContext("{}").values.empty());
+  return 0;
+}
+
+int JsonTests::TestParseErrors() {
+  TEST_EXPECT_EXCEPTION(
+      yate::ParseJsonContext("[1]"),
+      std::runtime_error,
+      "Invalid JSON at column 1: Expected '{'");
+  TEST_EXPECT_EXCEPTION(
+      yate::ParseJsonContext("{\"a\": {\"b\": 1}}"),
+      std::runtime_error,
+      "Invalid JSON at column 7: Nested objects are not supported");
+  TEST_EXPECT_EXCEPTION(
+      yate::ParseJsonContext("{\"a\": [[1]]}"),
+      std::runtime_error,
+      "Invalid JSON at column 8: Nested arrays are not supported");
+  TEST_EXPECT_EXCEPTION(
+      yate::ParseJsonContext("{\"a\": 01}"),
+      std::runtime_error,
+      "Invalid JSON at column 8: Expected '}'");
+  TEST_EXPECT_EXCEPTION(
+      yate::ParseJsonContext("{\"a\": \"\\ud800\"}"),
+      std::runtime_error,
+      "Invalid JSON at column 14: Unpaired surrogate");
+  TEST_EXPECT_EXCEPTION(
+      yate::ParseJsonContext("{\"a\": \"x"),
+      std::runtime_error,
+      "Invalid JSON at column 9: Unterminated string");
+  TEST_EXPECT_EXCEPTION(
+      yate::ParseJsonContext("{\"a\": 1} x"),
+      std::runtime_error,
+      "Invalid JSON at column 10: Unexpected text after the object");
+  TEST_EXPECT_EXCEPTION(
+      yate::ParseJsonContext("{\"a\": tru}"),
+      std::runtime_error,
+      "Invalid JSON at column 7: Expected a value");
+  return 0;
+}
@@ -0,0 +1,8 @@
+#pragma once
+
+struct JsonTests {
+  int RunTests();
+
+  int TestParseContext();
+  int TestParseErrors();
+};
@@ -8,6 +8,7 @@
 #include <regex>
 #include <sstream>
 #include <string>
+#include <vector>
 
 
 int LexerTests::RunTests() {
@@ -15,6 +16,10 @@ int LexerTests::RunTests() {
   result += TestLiterateOnly() == 0 ? 0 : 1;
   result += TestMultiTokenInput() == 0 ? 0 : 1;
   result += TestInputValidation() == 0 ? 0 : 1;
+  result += TestFilterTokens() == 0 ? 0 : 1;
+  result += TestTrimMarkers() == 0 ? 0 : 1;
+  result += TestEscapedDelimiters() == 0 ? 0 : 1;
+  result += TestDelimiters() == 0 ? 0 : 1;
   return result;
 }
 
@@ -195,3 +200,157 @@ int LexerTests::TestInputValidation() {
   }
   return 0;
 }
+
+// Numbers and quoted strings are scanned only as the arguments of the
+// filters which follow a `|`.
+int LexerTests::TestFilterTokens() {
+  std::stringstream stream(
+      "{{name | truncate -12 \"a \\\"b\\\\\" | number 2.5}}");
+  yate::Lexer lexer(stream);
+  std::vector<yate::Token::Tag> tags;
+  std::vector<std::string> values;
+  for (auto token = lexer.Scan(); token.tag() != yate::Token::Tag::eEOF;
+       token = lexer.Scan()) {
+    tags.push_back(token.tag());
+    values.push_back(token.value());
+  }
+  using Tag = yate::Token::Tag;
+  std::vector<Tag> expected_tags = {
+      Tag::eScriptBegin, Tag::eIdentifier, Tag::ePipe, Tag::eIdentifier,
+      Tag::eNumber, Tag::eString, Tag::ePipe, Tag::eIdentifier, Tag::eNumber,
+      Tag::eScriptEnd};
+  TEST_ASSERT_EQ(tags.size(), expected_tags.size());
+  for (std::size_t i = 0; i < tags.size(); ++i) {
+    TEST_EXPECT_EQ(tags[i], expected_tags[i]);
+  }
+  TEST_EXPECT_EQ(values[4], "-12");
+  TEST_EXPECT_EQ(values[5], "a \"b\\");
+  TEST_EXPECT_EQ(values[8], "2.5");
+
+  {
+    std::stringstream unterminated("{{name | default \"abc");
+    yate::Lexer lexer(unterminated);
+    lexer.Scan();
+    lexer.Scan();
+    lexer.Scan();
+    lexer.Scan();
+    TEST_EXPECT_EXCEPTION(
+        lexer.Scan(),
+        std::runtime_error,
+        "Error found in line 1 column 22: EOF found inside string.");
+  }
+  return 0;
+}
+
+// `{{-` drops the whitespace before the tag and `-}}` the whitespace
+// after it, newlines included.
+int LexerTests::TestTrimMarkers() {
+  std::stringstream stream(
+      "<ul>\n  {{- #loop rows row -}}\n  <li>{{row}}</li>\n{{-/loop}} \n"
+      "{{x | add -1 -}}  end");
+  yate::Lexer lexer(stream);
+  std::vector<std::string> values;
+  for (auto token = lexer.Scan(); token.tag() != yate::Token::Tag::eEOF;
+       token = lexer.Scan()) {
+    values.push_back(token.value());
+  }
+  std::vector<std::string> expected{
+      "<ul>", "{{", "#loop0", "rows", "row", "-}}", "<li>", "{{", "row",
+      "}}", "</li>", "{{", "/loop", "}}", " \n", "{{", "x", "|", "add", "-1",
+      "-}}", "end"};
+  TEST_ASSERT_EQ(values.size(), expected.size());
+  for (std::size_t i = 0; i < values.size(); ++i) {
+    TEST_EXPECT_EQ(values[i], expected[i]);
+  }
+
+  std::stringstream whitespace("  {{- a -}}  ");
+  yate::Lexer whitespace_lexer(whitespace);
+  TEST_EXPECT_EQ(whitespace_lexer.Scan().tag(), yate::Token::Tag::eScriptBegin);
+  TEST_EXPECT_EQ(whitespace_lexer.Scan().value(), "a");
+  TEST_EXPECT_EQ(whitespace_lexer.Scan().value(), "-}}");
+  TEST_EXPECT_EQ(whitespace_lexer.Scan().tag(), yate::Token::Tag::eEOF);
+
+  std::stringstream invalid("{{a -} }}");
+  yate::Lexer invalid_lexer(invalid);
+  invalid_lexer.Scan();
+  invalid_lexer.Scan();
+  TEST_EXPECT_EXCEPTION(
+      invalid_lexer.Scan(),
+      std::runtime_error,
+      "Error found in line 1 column 7: Invalid trim marker found.");
+  return 0;
+}
+
+// Every backslash after the first one in an escaped delimiter is kept,
+// so both `{{` and `{\{` can be written.
+int LexerTests::TestEscapedDelimiters() {
+  std::stringstream stream(
+      "a {\\{ b {\\\\{ c {\\\\\\{ d {\\x {\\\\ {\\{{{x}}");
+  yate::Lexer lexer(stream);
+  auto token = lexer.Scan();
+  TEST_EXPECT_EQ(token.tag(), yate::Token::Tag::eNoOp);
+  TEST_EXPECT_EQ(token.value(), "a {{ b {\\{ c {\\\\{ d {\\x {\\\\ {{");
+  TEST_EXPECT_EQ(lexer.Scan().tag(), yate::Token::Tag::eScriptBegin);
+  TEST_EXPECT_EQ(lexer.Scan().value(), "x");
+
+  std::stringstream end("{\\");
+  yate::Lexer end_lexer(end);
+  TEST_EXPECT_EQ(end_lexer.Scan().value(), "{\\");
+  return 0;
+}
+
+int LexerTests::TestDelimiters() {
+  std::stringstream stream(
+      "var o = {{a: 1}};\n  <%- #loop rows row %>[<%row | json-%>]\n"
+      "<%/loop%><\\%");
+  yate::Lexer lexer(stream);
+  lexer.set_delimiters(yate::Delimiters("<%", "%>"));
+  std::vector<std::string> values;
+  for (auto token = lexer.Scan(); token.tag() != yate::Token::Tag::eEOF;
+       token = lexer.Scan()) {
+    values.push_back(token.value());
+  }
+  std::vector<std::string> expected{
+      "var o = {{a: 1}};", "<%", "#loop0", "rows", "row", "%>", "[", "<%",
+      "row", "|", "json", "-%>", "]\n", "<%", "/loop", "%>", "<%"};
+  TEST_ASSERT_EQ(values.size(), expected.size());
+  for (std::size_t i = 0; i < values.size(); ++i) {
+    TEST_EXPECT_EQ(values[i], expected[i]);
+  }
+
+  // Delimiters whose prefix repeats are found after partial matches.
+  std::stringstream repeated("a<<<%b%>>");
+  yate::Lexer repeated_lexer(repeated);
+  repeated_lexer.set_delimiters(yate::Delimiters("<<%", "%>>"));
+  TEST_EXPECT_EQ(repeated_lexer.Scan().value(), "a<");
+  TEST_EXPECT_EQ(repeated_lexer.Scan().value(), "<<%");
+  TEST_EXPECT_EQ(repeated_lexer.Scan().value(), "b");
+  TEST_EXPECT_EQ(repeated_lexer.Scan().value(), "%>>");
+
+  std::stringstream unclosed("<% a %");
+  yate::Lexer unclosed_lexer(unclosed);
+  unclosed_lexer.set_delimiters(yate::Delimiters("<%", "%>"));
+  unclosed_lexer.Scan();
+  unclosed_lexer.Scan();
+  TEST_EXPECT_EXCEPTION(
+      unclosed_lexer.Scan(),
+      std::runtime_error,
+      "Error found in line 1 column 7: EOF found inside script mode.");
+
+  TEST_EXPECT_EXCEPTION(
+      yate::Delimiters("{", "}"),
+      std::runtime_error,
+      "Invalid delimiters '{' and '}': delimiters must have between 2 and 16 "
+      "characters");
+  TEST_EXPECT_EXCEPTION(
+      yate::Delimiters("<%", "% >"),
+      std::runtime_error,
+      "Invalid delimiters '<%' and '% >': delimiters cannot contain "
+      "whitespace, letters, digits or '\\'");
+  TEST_EXPECT_EXCEPTION(
+      yate::Delimiters("<!--", "-->"),
+      std::runtime_error,
+      "Invalid delimiters '<!--' and '-->': the closing delimiter cannot "
+      "begin with any of '#/@>|-\",'");
+  return 0;
+}
@@ -6,4 +6,8 @@ struct LexerTests {
   int TestLiterateOnly();
   int TestMultiTokenInput();
   int TestInputValidation();
+  int TestFilterTokens();
+  int TestTrimMarkers();
+  int TestEscapedDelimiters();
+  int TestDelimiters();
 };
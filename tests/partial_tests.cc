@@ -0,0 +1,241 @@
+#include "partial_tests.hh"
+
+#include "helpers.hh"
+#include "unit.hh"
+
+#include <yate/compiler.hh>
+#include <yate/incremental_renderer.hh>
+#include <yate/partial_cache.hh>
+#include <yate/renderer.hh>
+
+#include <memory>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+
+namespace {
+
+/// Serves partials from a map and counts how many times they are
+/// loaded.
+struct Sources {
+  std::unordered_map<std::string, std::string> partials;
+  int loads = 0;
+
+  std::shared_ptr<yate::PartialCache> Cache() {
+    return std::make_shared<yate::PartialCache>(
+        [this](const std::string &name, std::string &source) {
+          auto it = partials.find(name);
+          if (it == partials.end()) {
+            return false;
+          }
+          ++loads;
+          source = it->second;
+          return true;
+        });
+  }
+};
+
+} // namespace
+
+int PartialTests::RunTests() {
+  int result = 0;
+  result += TestIncludes();
+  result += TestSharedPartials();
+  result += TestPartialSettings();
+  result += TestInlining();
+  result += TestPartialErrors();
+  result += TestPartialDependencies();
+  return result;
+}
+
+// Partials are rendered in place and see the symbols bound by the
+// loops around them. They can include other partials.
+int PartialTests::TestIncludes() {
+  Sources sources;
+  sources.partials = {
+      {"header", "<h1>{{title}}</h1>"},
+      {"row", "<li>{{item}}{{>badge}}</li>"},
+      {"badge", "{{#if item}}*{{/if}}"}};
+  auto tmpl = CompileString(
+      "{{>header}}<ul>{{#loop items item}}{{ > row }}{{/loop}}</ul>",
+      sources.Cache());
+
+  const auto &nodes = tmpl.nodes();
+  TEST_ASSERT_EQ(nodes.size(), 6u);
+  TEST_EXPECT(nodes[0].kind == yate::Template::Node::Kind::eInclude);
+  TEST_EXPECT_EQ(nodes[0].text, "header");
+  TEST_EXPECT(nodes[3].kind == yate::Template::Node::Kind::eInclude);
+  TEST_EXPECT_EQ(nodes[3].partial->nodes().size(), 4u);
+
+  yate::Renderer renderer({{"title", "List"}}, {{"items", {"a", ""}}});
+  TEST_EXPECT_EQ(
+      RenderToString(renderer, tmpl),
+      "<h1>List</h1><ul><li>a*</li><li></li></ul>");
+  return 0;
+}
+
+// Every template which includes a partial shares the same compiled
+// copy, which is loaded only once.
+int PartialTests::TestSharedPartials() {
+  Sources sources;
+  sources.partials = {{"footer", "-- {{site}}"}};
+  auto cache = sources.Cache();
+  auto first = CompileString("a{{>footer}}", cache);
+  auto second = CompileString("b{{>footer}}{{>footer}}", cache);
+
+  TEST_EXPECT_EQ(sources.loads, 1);
+  TEST_EXPECT_EQ(cache->size(), 1u);
+  TEST_EXPECT(first.nodes()[1].partial == second.nodes()[1].partial);
+  TEST_EXPECT(second.nodes()[1].partial == second.nodes()[2].partial);
+  TEST_EXPECT(
+      cache->Find("footer", yate::PartialSettings()) ==
+      first.nodes()[1].partial);
+
+  yate::Renderer renderer({{"site", "yate"}}, {});
+  TEST_EXPECT_EQ(RenderToString(renderer, second), "b-- yate-- yate");
+
+  // Templates keep their partials after the cache is cleared.
+  cache->Clear();
+  TEST_EXPECT_EQ(cache->size(), 0u);
+  TEST_EXPECT_EQ(RenderToString(renderer, first), "a-- yate");
+  CompileString("{{>footer}}", cache);
+  TEST_EXPECT_EQ(sources.loads, 2);
+  return 0;
+}
+
+// Compilers sharing a cache but whose settings change how partials
+// are compiled get a copy each, and the same settings share one.
+int PartialTests::TestPartialSettings() {
+  Sources sources;
+  sources.partials = {{"item", "<li>  {{name}}<%name%></li>"}};
+  auto cache = sources.Cache();
+  auto compile = [&cache](const yate::Delimiters &delimiters, bool minify) {
+    std::stringstream input("<%>item%>");
+    yate::Compiler compiler(input);
+    compiler.set_partials(cache);
+    compiler.set_delimiters(delimiters);
+    compiler.set_minify(minify);
+    return compiler.Compile();
+  };
+  yate::Delimiters percent("<%", "%>");
+  auto plain = CompileString("{{>item}}", cache);
+  auto custom = compile(percent, false);
+  auto minified = compile(percent, true);
+  auto again = compile(percent, true);
+
+  TEST_EXPECT_EQ(sources.loads, 3);
+  TEST_EXPECT_EQ(cache->size(), 3u);
+  TEST_EXPECT(minified.nodes()[0].partial == again.nodes()[0].partial);
+
+  yate::Renderer renderer({{"name", "x"}}, {});
+  TEST_EXPECT_EQ(RenderToString(renderer, plain), "<li>  x<%name%></li>");
+  TEST_EXPECT_EQ(RenderToString(renderer, custom), "<li>  {{name}}x</li>");
+  TEST_EXPECT_EQ(RenderToString(renderer, minified), "<li> {{name}}x</li>");
+  return 0;
+}
+
+// Small partials are copied into the template: their literals merge
+// with the surrounding ones and their sections are relocated.
+int PartialTests::TestInlining() {
+  using Kind = yate::Template::Node::Kind;
+  Sources sources;
+  sources.partials = {
+      {"small", "({{#if x}}{{x}}{{/if}})"},
+      {"big", "{{#loop xs x}}{{x}}{{/loop}}{{#loop xs x}}{{x}}{{/loop}}"}};
+  auto tmpl = CompileString("[{{>small}}]{{>big}}", sources.Cache(), 5);
+
+  const auto &nodes = tmpl.nodes();
+  TEST_ASSERT_EQ(nodes.size(), 6u);
+  TEST_EXPECT_EQ(nodes[0].text, "[(");
+  TEST_EXPECT(nodes[1].kind == Kind::eIfBegin);
+  TEST_EXPECT_EQ(nodes[1].jump, 3u);
+  TEST_EXPECT_EQ(nodes[3].jump, 1u);
+  TEST_EXPECT_EQ(nodes[4].text, ")]");
+  TEST_EXPECT(nodes[5].kind == Kind::eInclude);
+  auto dependencies = tmpl.section_dependencies(1);
+  TEST_ASSERT_EQ(dependencies != nullptr, true);
+  TEST_EXPECT(dependencies->conditions == std::vector<std::string>({"x"}));
+
+  yate::Renderer renderer({{"x", "1"}}, {{"xs", {"a", "b"}}});
+  TEST_EXPECT_EQ(RenderToString(renderer, tmpl), "[(1)]abab");
+  return 0;
+}
+
+int PartialTests::TestPartialErrors() {
+  Sources sources;
+  sources.partials = {
+      {"self", "{{>self}}"},
+      {"outer", "x{{>inner}}"},
+      {"inner", "\n  {{>outer}}"},
+      {"broken", "{{#loop}}"}};
+  auto cache = sources.Cache();
+
+  TEST_EXPECT_EXCEPTION(
+      CompileString("ab{{>missing}}", cache),
+      std::runtime_error,
+      "Partial 'missing' not found at line 1 column 6");
+  TEST_EXPECT_EXCEPTION(
+      CompileString("{{>header}}", nullptr),
+      std::runtime_error,
+      "Partial 'header' not found at line 1 column 4");
+  TEST_EXPECT_EXCEPTION(
+      CompileString("{{>self}}", cache),
+      std::runtime_error,
+      "In partial 'self': Partial 'self' includes itself at line 1 column 4");
+  TEST_EXPECT_EXCEPTION(
+      CompileString("{{>outer}}", cache),
+      std::runtime_error,
+      "In partial 'outer': In partial 'inner': Partial 'outer' includes "
+      "itself at line 2 column 6");
+  TEST_EXPECT_EXCEPTION(
+      CompileString("{{>broken}}", cache),
+      std::runtime_error,
+      "In partial 'broken': Invalid Syntax: Expected 'IDENTIFIER' but got "
+      "'SCRIPT_END' ('}}') at line 1 column 8");
+  TEST_EXPECT_EXCEPTION(
+      CompileString("{{>}}", cache),
+      std::runtime_error,
+      "Invalid Syntax: Expected 'IDENTIFIER' but got 'SCRIPT_END' ('}}') "
+      "at line 1 column 4");
+  // Failed partials are not cached.
+  TEST_EXPECT_EQ(cache->size(), 0u);
+  return 0;
+}
+
+// The symbols read by partials are dependencies of the sections which
+// include them, and specialization inlines partials.
+int PartialTests::TestPartialDependencies() {
+  Sources sources;
+  sources.partials = {{"cell", "{{cell}}{{label}}{{#loop extra e}}{{/loop}}"}};
+  auto cache = sources.Cache();
+  auto tmpl = CompileString(
+      "{{>cell}}|{{#loop cells cell}}{{>cell}}{{/loop}}", cache);
+
+  auto dependencies = tmpl.section_dependencies(2);
+  TEST_ASSERT_EQ(dependencies != nullptr, true);
+  TEST_EXPECT(dependencies->values == std::vector<std::string>({"label"}));
+  TEST_EXPECT(
+      dependencies->arrays == std::vector<std::string>({"cells", "extra"}));
+
+  auto residual = tmpl.Specialize({{"label", "!"}}, {{"extra", {}}});
+  for (const auto &node : residual.nodes()) {
+    TEST_EXPECT(node.kind != yate::Template::Node::Kind::eInclude);
+  }
+  yate::Renderer renderer(
+      {{"cell", "c"}, {"label", "!"}}, {{"cells", {"1", "2"}}, {"extra", {}}});
+  TEST_EXPECT_EQ(RenderToString(renderer, residual), "c!|1!2!");
+  TEST_EXPECT_EQ(RenderToString(renderer, tmpl), "c!|1!2!");
+
+  yate::IncrementalRenderer incremental(
+      tmpl,
+      {{"cell", "c"}, {"label", "!"}},
+      {{"cells", {"1"}}, {"extra", {}}});
+  TEST_EXPECT_EQ(incremental.output(), "c!|1!");
+  auto patches = incremental.Update({{"label", "?"}}, {});
+  TEST_EXPECT_EQ(patches.size(), 2u);
+  TEST_EXPECT_EQ(incremental.output(), "c?|1?");
+  patches = incremental.Update({{"cell", "d"}}, {});
+  TEST_EXPECT_EQ(patches.size(), 1u);
+  TEST_EXPECT_EQ(incremental.output(), "d?|1?");
+  return 0;
+}
@@ -0,0 +1,12 @@
+#pragma once
+
+struct PartialTests {
+  int RunTests();
+
+  int TestIncludes();
+  int TestSharedPartials();
+  int TestPartialSettings();
+  int TestInlining();
+  int TestPartialErrors();
+  int TestPartialDependencies();
+};
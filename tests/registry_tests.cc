@@ -0,0 +1,228 @@
+#include "registry_tests.hh"
+
+#include "helpers.hh"
+#include "unit.hh"
+
+#ifndef _WIN32
+#include <yate/renderer.hh>
+#include <yate/template_registry.hh>
+
+#include <stdlib.h>
+#include <unistd.h>
+#endif
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+#ifndef _WIN32
+/// A temporary directory which is removed with its templates.
+class TemporaryDirectory {
+ public:
+  TemporaryDirectory() {
+    char path[] = "/tmp/yate-registry-XXXXXX";
+    if (mkdtemp(path) != nullptr) {
+      path_ = path;
+    }
+  }
+  ~TemporaryDirectory() {
+    for (const auto &file : files_) {
+      std::remove(file.c_str());
+    }
+    rmdir(path_.c_str());
+  }
+
+  const std::string &path() const { return path_; }
+
+  /// Writes a file in place.
+  void Write(const std::string &name, const std::string &content) {
+    auto file = path_ + "/" + name;
+    std::ofstream output(file, std::ios_base::binary | std::ios_base::trunc);
+    output << content;
+    files_.push_back(file);
+  }
+
+  /// Writes a file next to `name` and moves it over, as most editors
+  /// do, so readers never see it half written.
+  void Replace(const std::string &name, const std::string &content) {
+    Write(name + ".tmp", content);
+    std::rename((path_ + "/" + name + ".tmp").c_str(),
+                (path_ + "/" + name).c_str());
+    files_.push_back(path_ + "/" + name);
+  }
+
+  void Remove(const std::string &name) {
+    std::remove((path_ + "/" + name).c_str());
+  }
+
+ private:
+  std::string path_;
+  std::vector<std::string> files_;
+};
+
+std::string RenderToString(
+    yate::Renderer &renderer,
+    const std::shared_ptr<const yate::Template> &tmpl) {
+  // The overload for plain templates is hidden by this one.
+  return tmpl == nullptr ? "<missing>" : ::RenderToString(renderer, *tmpl);
+}
+#endif
+
+} // namespace
+
+int RegistryTests::RunTests() {
+  int result = 0;
+#ifndef _WIN32
+  result += TestLoadTemplates();
+  result += TestReload();
+  result += TestReloadErrors();
+#ifdef __linux__
+  result += TestHotReload();
+#endif
+#endif
+  return result;
+}
+
+#ifndef _WIN32
+int RegistryTests::TestLoadTemplates() {
+  TemporaryDirectory directory;
+  directory.Write("page.yate", "<{{>header}}|{{name}}>");
+  directory.Write("header.yate", "Header");
+  directory.Write("notes.txt", "{{ignored");
+
+  yate::TemplateRegistry registry(directory.path());
+  yate::Renderer renderer({{"name", "yate"}}, {});
+  TEST_EXPECT_EQ(
+      RenderToString(renderer, registry.Get("page")), "<Header|yate>");
+  TEST_EXPECT_EQ(RenderToString(renderer, registry.Get("header")), "Header");
+  TEST_EXPECT(registry.Get("notes") == nullptr);
+  TEST_EXPECT_EQ(registry.version(), 0u);
+
+  TEST_EXPECT_EXCEPTION(
+      yate::TemplateRegistry(directory.path() + "/none"),
+      std::runtime_error,
+      "Cannot read template directory '" + directory.path() + "/none'");
+  directory.Write("broken.yate", "{{#loop}}");
+  TEST_EXPECT_EXCEPTION(
+      yate::TemplateRegistry(directory.path()),
+      std::runtime_error,
+      "In template 'broken': Invalid Syntax: Expected 'IDENTIFIER' but got "
+      "'SCRIPT_END' ('}}') at line 1 column 8");
+  return 0;
+}
+
+// Reloading a partial reloads the templates which include it, while
+// the versions already handed out stay unchanged.
+int RegistryTests::TestReload() {
+  TemporaryDirectory directory;
+  directory.Write("page.yate", "[{{>header}}]");
+  directory.Write("header.yate", "v1");
+  directory.Write("other.yate", "other");
+  yate::TemplateRegistry registry(directory.path());
+  yate::Renderer renderer({}, {});
+
+  auto old_page = registry.Get("page");
+  auto other = registry.Get("other");
+  directory.Replace("header.yate", "v2");
+  registry.Reload("header");
+  TEST_EXPECT_EQ(registry.version(), 1u);
+  TEST_EXPECT_EQ(RenderToString(renderer, registry.Get("page")), "[v2]");
+  TEST_EXPECT_EQ(RenderToString(renderer, registry.Get("header")), "v2");
+  TEST_EXPECT_EQ(RenderToString(renderer, old_page), "[v1]");
+  TEST_EXPECT(registry.Get("other") == other);
+
+  directory.Write("new.yate", "new");
+  registry.Reload("new");
+  TEST_EXPECT_EQ(RenderToString(renderer, registry.Get("new")), "new");
+  directory.Remove("new.yate");
+  registry.Reload("new");
+  TEST_EXPECT(registry.Get("new") == nullptr);
+  return 0;
+}
+
+int RegistryTests::TestReloadErrors() {
+  TemporaryDirectory directory;
+  directory.Write("page.yate", "page");
+  yate::TemplateRegistry registry(directory.path());
+  std::vector<std::string> errors;
+  registry.set_error_handler(
+      [&errors](const std::string &name, const std::string &error) {
+        errors.push_back(name + ": " + error);
+      });
+
+  directory.Replace("page.yate", "{{>missing}}");
+  registry.Reload("page");
+  TEST_ASSERT_EQ(errors.size(), 1u);
+  TEST_EXPECT_EQ(
+      errors[0], "page: Partial 'missing' not found at line 1 column 4");
+  yate::Renderer renderer({}, {});
+  TEST_EXPECT_EQ(RenderToString(renderer, registry.Get("page")), "page");
+  return 0;
+}
+
+#ifdef __linux__
+// Renders from many threads while the watcher reloads the templates,
+// every render must see a complete version.
+int RegistryTests::TestHotReload() {
+  TemporaryDirectory directory;
+  directory.Write("page.yate", "{{>body}}{{>body}}");
+  directory.Write("body.yate", "0");
+  yate::TemplateRegistry registry(directory.path());
+  registry.Watch();
+
+  std::atomic<bool> stop(false);
+  std::atomic<int> torn(0);
+  std::atomic<std::uint64_t> renders(0);
+  std::vector<std::thread> readers;
+  for (int i = 0; i < 8; ++i) {
+    readers.emplace_back([&]() {
+      yate::Renderer renderer({}, {});
+      while (!stop.load()) {
+        auto output = RenderToString(renderer, registry.Get("page"));
+        if (output.size() % 2 != 0 ||
+            output.substr(0, output.size() / 2) !=
+                output.substr(output.size() / 2)) {
+          ++torn;
+        }
+        ++renders;
+      }
+    });
+  }
+
+  const int kVersions = 20;
+  auto reloaded = true;
+  for (int i = 1; i <= kVersions && reloaded; ++i) {
+    auto body = std::to_string(i);
+    directory.Replace("body.yate", body);
+    // The watcher reloads in the background, wait until it is done.
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    yate::Renderer renderer({}, {});
+    while (RenderToString(renderer, registry.Get("page")) != body + body) {
+      if (std::chrono::steady_clock::now() > deadline) {
+        reloaded = false;
+        break;
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+  }
+  stop.store(true);
+  for (auto &reader : readers) {
+    reader.join();
+  }
+  registry.Stop();
+
+  TEST_EXPECT(reloaded);
+  TEST_EXPECT_EQ(torn.load(), 0);
+  TEST_EXPECT(renders.load() > 0u);
+  TEST_EXPECT(registry.version() >= static_cast<std::uint64_t>(kVersions));
+  return 0;
+}
+#endif
+#endif
@@ -0,0 +1,10 @@
+#pragma once
+
+struct RegistryTests {
+  int RunTests();
+
+  int TestLoadTemplates();
+  int TestReload();
+  int TestReloadErrors();
+  int TestHotReload();
+};
@@ -2,9 +2,20 @@
 
 #include "unit.hh"
 
+#include <yate/allocation_counter.hh>
+#include <yate/compiler.hh>
+#include <yate/partial_cache.hh>
 #include <yate/renderer.hh>
 
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <set>
 #include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
 
 int RenderTests::RunTests() {
   int result = 0;
@@ -15,6 +26,15 @@ int RenderTests::RunTests() {
   result += TestTemplateVariableShadowing();
   result += TestRenderErrors();
   result += TestLoopWithEmptyArray();
+  result += TestCompiledTemplate();
+  result += TestConditionals();
+  result += TestLoopMetadata();
+  result += TestGenerators();
+  result += TestRenderLimits();
+  result += TestBoundSymbols();
+  result += TestZippedLoops();
+  result += TestLoopKernels();
+  result += TestWarmRenderAllocations();
   return result;
 }
 
@@ -268,3 +288,605 @@ int RenderTests::TestRenderErrors() {
 
   return 0;
 }
+
+// Tests that a compiled template renders the same as the stream and
+// can be rendered several times.
+int RenderTests::TestCompiledTemplate() {
+  yate::Renderer renderer(
+      {
+        {"test", "something"},
+        {"foo", "bar"}
+      },
+      {
+        {"level0", {"first", "second"}},
+        {"level1", {"erste", "zweite"}},
+        {"empty", {}}
+      });
+  std::stringstream input(
+      "{{#loop level0 item0}}{{test}}{{#loop level1 item1}}"
+      "\n{{item0}}.{{item1}} {{foo}}{{/loop}}{{/loop}}"
+      "{{#loop empty foo}}{{foo}}{{/loop}}{{foo}}");
+  yate::Compiler compiler(input);
+  auto tmpl = compiler.Compile();
+
+  for (int i = 0; i < 2; ++i) {
+    std::stringstream output;
+    renderer.Render(tmpl, output);
+    TEST_EXPECT_EQ(
+        output.str(),
+        "something\n"
+        "first.erste bar\n"
+        "first.zweite barsomething\n"
+        "second.erste bar\n"
+        "second.zweite barbar");
+  }
+
+  std::stringstream undefined_input("{{#loop level0 item}}{{name}}{{/loop}}");
+  yate::Compiler undefined_compiler(undefined_input);
+  auto undefined = undefined_compiler.Compile();
+  std::stringstream output;
+  TEST_EXPECT_EXCEPTION(
+      renderer.Render(undefined, output),
+      std::runtime_error,
+      "Identifier 'name' is undefined");
+  return 0;
+}
+
+// Values are true when they are not empty, arrays when they have
+// elements and undefined symbols are false. Skipped branches are not
+// evaluated at all.
+int RenderTests::TestConditionals() {
+  yate::Renderer renderer(
+      {{"name", "Ada"}, {"empty", ""}},
+      {{"items", {"a", "", "b"}}, {"none", {}}});
+  std::stringstream input(
+      "{{#if name}}Hi {{name}}{{#else}}{{undefined}}{{/if}}|"
+      "{{#if empty}}{{undefined}}{{#else}}no value{{/if}}|"
+      "{{#if missing}}{{undefined}}{{/if}}|"
+      "{{#if none}}{{#loop none x}}{{x}}{{/loop}}{{#else}}no items{{/if}}|"
+      "{{#loop items item}}{{#if item}}[{{item}}]{{#else}}[-]{{/if}}{{/loop}}|"
+      "{{#if items}}{{#if name}}nested{{/if}}{{/if}}");
+  std::stringstream output;
+  renderer.Render(input, output);
+  TEST_EXPECT_EQ(
+      output.str(), "Hi Ada|no value||no items|[a][-][b]|nested");
+
+  // Sections left open at the end of the input are closed.
+  std::stringstream open("{{#if name}}{{name}}{{#else}}x");
+  std::stringstream open_output;
+  renderer.Render(open, open_output);
+  TEST_EXPECT_EQ(open_output.str(), "Ada");
+
+  std::stringstream unmatched("{{#loop items item}}{{/if}}");
+  std::stringstream unmatched_output;
+  TEST_EXPECT_EXCEPTION(
+      renderer.Render(unmatched, unmatched_output),
+      std::runtime_error,
+      "Invalid Syntax: Unmatched 'IF_END'");
+
+  std::stringstream twice("{{#if name}}{{#else}}{{#else}}{{/if}}");
+  std::stringstream twice_output;
+  TEST_EXPECT_EXCEPTION(
+      renderer.Render(twice, twice_output),
+      std::runtime_error,
+      "Invalid Syntax: Unmatched 'ELSE'");
+
+  std::stringstream crossed("{{#if name}}{{#loop items i}}{{/if}}{{/loop}}");
+  std::stringstream crossed_output;
+  TEST_EXPECT_EXCEPTION(
+      renderer.Render(crossed, crossed_output),
+      std::runtime_error,
+      "Invalid Syntax: Unmatched 'IF_END'");
+  return 0;
+}
+
+// Metadata refers to the innermost loop and is computed from its
+// counter, no array has to be given for it.
+int RenderTests::TestLoopMetadata() {
+  yate::Renderer renderer(
+      {{"index", "shadowed"}}, {{"rows", {"a", "b", "c"}}, {"cols", {"x"}}});
+  std::stringstream input(
+      "{{#loop rows row}}{{@number}}/{{@length}}:{{row}}"
+      "{{#if @last}}.{{#else}}, {{/if}}{{/loop}}|"
+      "{{#loop rows row}}{{#if @first}}[{{/if}}{{@index}}{{#loop cols col}}"
+      "({{@index}}{{@first}}{{@last}}){{/loop}}{{#if @index}}+{{/if}}"
+      "{{/loop}}|{{#loop rows row}}{{@number | number 1}}{{/loop}}|{{index}}");
+  std::stringstream output;
+  renderer.Render(input, output);
+  TEST_EXPECT_EQ(
+      output.str(),
+      "1/3:a, 2/3:b, 3/3:c.|"
+      "[0(0truetrue)1(0truetrue)+2(0truetrue)+|1.02.03.0|shadowed");
+
+  std::stringstream outside("{{@index}}");
+  std::stringstream outside_output;
+  TEST_EXPECT_EXCEPTION(
+      renderer.Render(outside, outside_output),
+      std::runtime_error,
+      "Loop metadata '@index' used outside of a loop at line 1 column 3");
+
+  std::stringstream unknown("{{#loop rows row}}{{#if @size}}{{/if}}{{/loop}}");
+  std::stringstream unknown_output;
+  TEST_EXPECT_EXCEPTION(
+      renderer.Render(unknown, unknown_output),
+      std::runtime_error,
+      "Unknown loop metadata '@size' at line 1 column 25");
+
+  std::stringstream empty("{{#loop rows row}}{{@}}{{/loop}}");
+  std::stringstream empty_output;
+  TEST_EXPECT_EXCEPTION(
+      renderer.Render(empty, empty_output),
+      std::runtime_error,
+      "Error found in line 1 column 22: Invalid loop metadata found.");
+  return 0;
+}
+
+// Loops over generators render the same output as loops over arrays
+// while only two elements are kept at a time.
+int RenderTests::TestGenerators() {
+  const std::size_t kRows = 10000;
+  std::set<const std::string *> buffers;
+  auto rows = std::make_shared<yate::FunctionGenerator>(
+      [&buffers, kRows](std::size_t index, std::string &element) {
+        buffers.insert(&element);
+        element = "row" + std::to_string(index);
+        return index < kRows;
+      });
+  auto letters = std::make_shared<yate::FunctionGenerator>(
+      [](std::size_t index, std::string &element) {
+        element.assign(1, static_cast<char>('a' + index));
+        return index < 2;
+      });
+
+  yate::Renderer renderer({}, {{"empty", {}}});
+  renderer.SetGenerator("rows", rows);
+  renderer.SetGenerator("letters", letters);
+  std::stringstream input(
+      "{{#loop rows row}}{{#if @last}}{{@number}}:{{row}}{{/if}}"
+      "{{/loop}}|{{#loop letters a}}{{#loop letters b}}{{a}}{{b}}"
+      "{{#if @last}};{{#else}},{{/if}}{{/loop}}{{/loop}}");
+  std::stringstream output;
+  renderer.Render(input, output);
+  TEST_EXPECT_EQ(output.str(), "10000:row9999|aa,ab;ba,bb;");
+  TEST_EXPECT_EQ(buffers.size(), 2u);
+
+  // Conditions produce the first element of the generator.
+  std::stringstream condition("{{#if rows}}rows{{/if}}{{#if none}}none{{/if}}");
+  std::stringstream condition_output;
+  renderer.SetGenerator(
+      "none",
+      std::make_shared<yate::FunctionGenerator>(
+          [](std::size_t, std::string &) { return false; }));
+  renderer.Render(condition, condition_output);
+  TEST_EXPECT_EQ(condition_output.str(), "rows");
+
+  // Elements are not written as stable bytes, since their buffers are
+  // reused before the sink is flushed.
+  struct DeferredSink : yate::Sink {
+    std::vector<std::pair<const char *, std::size_t>> pending;
+    std::deque<std::string> copies;
+    std::string text;
+    void Write(const char *data, std::size_t size) override {
+      copies.emplace_back(data, size);
+      pending.emplace_back(copies.back().data(), size);
+    }
+    void WriteStable(const char *data, std::size_t size) override {
+      pending.emplace_back(data, size);
+    }
+    void Flush() override {
+      for (const auto &chunk : pending) {
+        text.append(chunk.first, chunk.second);
+      }
+      pending.clear();
+    }
+  };
+  std::stringstream letters_input("{{#loop letters l}}{{l}}{{/loop}}");
+  yate::Compiler compiler(letters_input);
+  DeferredSink deferred;
+  renderer.Render(compiler.Compile(), deferred);
+  TEST_EXPECT_EQ(deferred.text, "ab");
+
+  // `@length` needs the size of the generator.
+  std::stringstream length("{{#loop letters a}}{{@length}}{{/loop}}");
+  std::stringstream length_output;
+  TEST_EXPECT_EXCEPTION(
+      renderer.Render(length, length_output),
+      std::runtime_error,
+      "Loop metadata '@length' is not available for generators of unknown "
+      "size");
+
+  struct SizedGenerator : yate::Generator {
+    std::size_t next = 0;
+    void Reset() override { next = 0; }
+    bool Next(std::string &element) override {
+      element = std::to_string(next);
+      return next++ < 3;
+    }
+    bool Size(std::size_t &size) const override {
+      size = 3;
+      return true;
+    }
+  };
+  renderer.SetGenerator("sized", std::make_shared<SizedGenerator>());
+  std::stringstream sized(
+      "{{#loop sized n}}{{n}}/{{@length}}{{#if @last}}.{{/if}} {{/loop}}");
+  std::stringstream sized_output;
+  renderer.Render(sized, sized_output);
+  TEST_EXPECT_EQ(sized_output.str(), "0/3 1/3 2/3. ");
+
+  // Arrays take precedence over generators with the same name.
+  renderer.SetIterable("letters", {"z"});
+  std::stringstream shadowed("{{#loop letters a}}{{a}}{{/loop}}");
+  std::stringstream shadowed_output;
+  renderer.Render(shadowed, shadowed_output);
+  TEST_EXPECT_EQ(shadowed_output.str(), "z");
+  return 0;
+}
+
+int RenderTests::TestRenderLimits() {
+  yate::Renderer renderer(
+      {{"name", "yate"}}, {{"rows", {"a", "b", "c", "d"}}});
+  std::stringstream input("{{#loop rows row}}{{name}}:{{row}} {{/loop}}");
+  yate::Compiler compiler(input);
+  auto tmpl = compiler.Compile();
+  std::string output;
+  yate::StringSink sink(output);
+
+  // Renders the template, returning the reason it failed for.
+  auto reason = [&]() {
+    output.clear();
+    try {
+      renderer.Render(tmpl, sink);
+    } catch (const yate::RenderLimitExceeded &e) {
+      return static_cast<int>(e.reason());
+    }
+    return -1;
+  };
+
+  yate::RenderLimits limits;
+  limits.max_output_bytes = 10;
+  renderer.set_limits(limits);
+  TEST_EXPECT_EQ(
+      reason(),
+      static_cast<int>(yate::RenderLimitExceeded::Reason::eOutputSize));
+  TEST_EXPECT_EQ(output, "yate:a ");
+  TEST_EXPECT_EXCEPTION(
+      renderer.Render(tmpl, sink),
+      std::runtime_error,
+      "Render output exceeded 10 bytes");
+
+  limits = yate::RenderLimits();
+  limits.max_iterations = 3;
+  renderer.set_limits(limits);
+  TEST_EXPECT_EQ(
+      reason(),
+      static_cast<int>(yate::RenderLimitExceeded::Reason::eIterations));
+  TEST_EXPECT_EQ(output, "yate:a yate:b yate:c ");
+  TEST_EXPECT_EXCEPTION(
+      renderer.Render(tmpl, sink),
+      std::runtime_error,
+      "Render exceeded 3 loop iterations");
+
+  // Iterations add up across nested loops, and generators count too.
+  renderer.SetGenerator(
+      "numbers",
+      std::make_shared<yate::FunctionGenerator>(
+          [](std::size_t index, std::string &element) {
+            element = std::to_string(index);
+            return true;
+          }));
+  limits.max_iterations = 1000;
+  renderer.set_limits(limits);
+  std::stringstream endless("{{#loop numbers n}}{{n}}{{/loop}}");
+  std::stringstream endless_output;
+  TEST_EXPECT_EXCEPTION(
+      renderer.Render(endless, endless_output),
+      yate::RenderLimitExceeded,
+      "Render exceeded 1000 loop iterations");
+
+  limits = yate::RenderLimits();
+  limits.deadline = std::chrono::steady_clock::now() - std::chrono::seconds(1);
+  renderer.set_limits(limits);
+  TEST_EXPECT_EQ(
+      reason(), static_cast<int>(yate::RenderLimitExceeded::Reason::eDeadline));
+  TEST_EXPECT_EQ(output, "");
+
+  // A deadline stops renders which would never finish otherwise.
+  limits.deadline =
+      std::chrono::steady_clock::now() + std::chrono::milliseconds(20);
+  renderer.set_limits(limits);
+  std::stringstream late("{{#loop numbers n}}{{n}}{{/loop}}");
+  std::stringstream late_output;
+  TEST_EXPECT_EXCEPTION(
+      renderer.Render(late, late_output),
+      yate::RenderLimitExceeded,
+      "Render deadline exceeded");
+
+  auto token = std::make_shared<yate::CancellationToken>();
+  limits = yate::RenderLimits();
+  limits.cancellation = token;
+  renderer.set_limits(limits);
+  TEST_EXPECT_EQ(reason(), -1);
+  token->Cancel();
+  TEST_EXPECT_EQ(
+      reason(),
+      static_cast<int>(yate::RenderLimitExceeded::Reason::eCancelled));
+
+  // Cancelling from inside a loop stops it within 64 iterations.
+  auto stopping = std::make_shared<yate::CancellationToken>();
+  limits.cancellation = stopping;
+  renderer.set_limits(limits);
+  std::size_t produced = 0;
+  renderer.SetGenerator(
+      "numbers",
+      std::make_shared<yate::FunctionGenerator>(
+          [&](std::size_t index, std::string &element) {
+            if (index == 10) {
+              stopping->Cancel();
+            }
+            produced = index + 1;
+            element = std::to_string(index);
+            return true;
+          }));
+  std::stringstream cancelled("{{#loop numbers n}}{{n}}{{/loop}}");
+  std::stringstream cancelled_output;
+  TEST_EXPECT_EXCEPTION(
+      renderer.Render(cancelled, cancelled_output),
+      yate::RenderLimitExceeded,
+      "Render cancelled");
+  TEST_EXPECT(produced <= 66);
+
+  // The renderer is usable again once the limits are lifted.
+  renderer.set_limits(yate::RenderLimits());
+  TEST_EXPECT_EQ(reason(), -1);
+  TEST_EXPECT_EQ(output, "yate:a yate:b yate:c yate:d ");
+  return 0;
+}
+
+// Root symbols are looked up through the slots of the template, which
+// must follow the changes of the renderer and leave partials alone.
+int RenderTests::TestBoundSymbols() {
+  auto partials = std::make_shared<yate::PartialCache>(
+      [](const std::string &name, std::string &source) {
+        source = "<{{title}}>";
+        return true;
+      });
+  std::stringstream input(
+      "{{title}}{{#loop rows title}}{{>p}}{{/loop}}{{#if extra}}{{extra}}"
+      "{{/if}}{{#if a}}{{/if}}{{#if b}}{{/if}}{{#if c}}{{/if}}");
+  yate::Compiler compiler(input);
+  compiler.set_partials(partials);
+  auto tmpl = compiler.Compile();
+
+  // The context is smaller than the symbols of the template.
+  yate::Renderer renderer({{"title", "T"}}, {});
+  renderer.SetIterable("rows", {"x", "y"});
+  std::string output;
+  yate::StringSink sink(output);
+  renderer.Render(tmpl, sink);
+  TEST_EXPECT_EQ(output, "T<x><y>");
+
+  output.clear();
+  renderer.SetValue("title", "U");
+  renderer.SetValue("extra", "!");
+  renderer.Render(tmpl, sink);
+  TEST_EXPECT_EQ(output, "U<x><y>!");
+
+  // The context is larger than the symbols of the template.
+  for (int i = 0; i < 20; ++i) {
+    renderer.SetValue("unused" + std::to_string(i), "");
+  }
+  output.clear();
+  renderer.Render(tmpl, sink);
+  TEST_EXPECT_EQ(output, "U<x><y>!");
+
+  // Partials included at the root read the root.
+  std::stringstream root_input("{{>p}}");
+  yate::Compiler root_compiler(root_input);
+  root_compiler.set_partials(partials);
+  output.clear();
+  renderer.Render(root_compiler.Compile(), sink);
+  TEST_EXPECT_EQ(output, "<U>");
+  return 0;
+}
+
+// Zipped loops bind the elements with the same index of each array,
+// which must have the same length.
+int RenderTests::TestZippedLoops() {
+  auto partials = std::make_shared<yate::PartialCache>(
+      [](const std::string &name, std::string &source) {
+        source = "({{price}})";
+        return true;
+      });
+  yate::Renderer renderer(
+      {{"price", "none"}},
+      {{"names", {"tea", "cake", "jam"}},
+       {"prices", {"2", "4", "3"}},
+       {"units", {"cup", "slice", "jar"}},
+       {"short", {"1"}}});
+  std::stringstream input(
+      "{{#loop names, prices, units as name, price, unit}}{{@number}}."
+      "{{name}}={{price}}/{{unit}}{{>p}}{{#if @last}};{{#else}}, {{/if}}"
+      "{{/loop}}{{price}}");
+  yate::Compiler compiler(input);
+  compiler.set_partials(partials);
+  auto tmpl = compiler.Compile();
+  std::string output;
+  yate::StringSink sink(output);
+  renderer.Render(tmpl, sink);
+  TEST_EXPECT_EQ(
+      output, "1.tea=2/cup(2), 2.cake=4/slice(4), 3.jam=3/jar(3);none");
+
+  // Nested loops shadow the symbols of zipped ones.
+  std::stringstream nested(
+      "{{#loop names, prices as name, price}}{{#loop short price}}"
+      "{{name}}{{price}}{{/loop}}{{price}} {{/loop}}");
+  std::stringstream nested_output;
+  renderer.Render(nested, nested_output);
+  TEST_EXPECT_EQ(nested_output.str(), "tea12 cake14 jam13 ");
+
+  std::stringstream mismatch(
+      "\n{{#loop names, short as name, n}}{{name}}{{/loop}}");
+  std::stringstream mismatch_output;
+  TEST_EXPECT_EXCEPTION(
+      renderer.Render(mismatch, mismatch_output),
+      std::runtime_error,
+      "Array 'short' has 1 elements but 'names' has 3 at line 2 column 3");
+
+  std::stringstream undefined(
+      "{{#loop names, missing as name, m}}{{name}}{{/loop}}");
+  std::stringstream undefined_output;
+  TEST_EXPECT_EXCEPTION(
+      renderer.Render(undefined, undefined_output),
+      std::runtime_error,
+      "Array 'missing' is undefined");
+
+  renderer.SetGenerator(
+      "letters",
+      std::make_shared<yate::FunctionGenerator>(
+          [](std::size_t index, std::string &element) {
+            element.assign(1, static_cast<char>('a' + index));
+            return index < 3;
+          }));
+  std::stringstream generator(
+      "{{#loop names, letters as name, letter}}{{name}}{{/loop}}");
+  std::stringstream generator_output;
+  TEST_EXPECT_EXCEPTION(
+      renderer.Render(generator, generator_output),
+      std::runtime_error,
+      "Generator 'letters' cannot be zipped at line 1 column 3");
+  return 0;
+}
+
+// Loops which only print their element are rendered by kernels, whose
+// output must not differ from the generic path.
+int RenderTests::TestLoopKernels() {
+  struct Case {
+    std::string source;
+    bool kernel;
+    std::string expected;
+  };
+  std::vector<Case> cases = {
+      {"{{#loop xs x}}{{x}}{{/loop}}", true, "a<b&c"},
+      {"{{#loop xs x}}<li>{{x | html}}</li>\n{{/loop}}",
+       true,
+       "<li>a</li>\n<li>&lt;b</li>\n<li>&amp;c</li>\n"},
+      {"[{{#loop xs x}}{{#if @index}}, {{/if}}\"{{x | json}}\"{{/loop}}]",
+       true,
+       "[\"a\", \"<b\", \"&c\"]"},
+      {"{{#loop xs x}}({{x}}){{#if @last}}{{#else}}|{{/if}}{{/loop}}",
+       true,
+       "(a)|(<b)|(&c)"},
+      {"{{#loop empty x}}<{{x}}>{{/loop}}", true, ""},
+      // Shapes which are rendered by the generic path.
+      {"{{#loop xs x}}{{x | upper}}{{/loop}}", false, "A<B&C"},
+      {"{{#loop xs x}}{{x}}{{x}}{{/loop}}", false, "aa<b<b&c&c"},
+      {"{{#loop xs x}}{{y}}{{/loop}}", false, "yyy"},
+      {"{{#loop xs x}}{{x}}{{#if @last}}.{{/if}}{{/loop}}", false, "a<b&c."},
+      {"{{#loop xs x}}{{#if @index}},{{#else}}:{{/if}}{{x}}{{/loop}}",
+       false,
+       ":a,<b,&c"},
+      {"{{#loop xs, ys as x, y}}{{x}}{{/loop}}", false, "a<b&c"}};
+  yate::Renderer renderer(
+      {{"y", "y"}},
+      {{"xs", {"a", "<b", "&c"}}, {"ys", {"1", "2", "3"}}, {"empty", {}}});
+  for (const auto &test : cases) {
+    std::stringstream input(test.source);
+    auto tmpl = yate::Compiler(input).Compile();
+    const auto &nodes = tmpl.nodes();
+    auto loop = std::find_if(nodes.begin(), nodes.end(), [](const auto &n) {
+      return n.kind == yate::Template::Node::Kind::eLoopBegin;
+    });
+    TEST_EXPECT_EQ(loop->kernel.enabled, test.kernel);
+    for (auto kernels : {true, false}) {
+      renderer.set_loop_kernels(kernels);
+      std::string output;
+      yate::StringSink sink(output);
+      renderer.Render(tmpl, sink);
+      TEST_EXPECT_EQ(output, test.expected);
+    }
+  }
+
+  // Long arrays are written in batches and elements larger than a
+  // batch on their own.
+  std::vector<std::string> rows;
+  for (int i = 0; i < 20000; ++i) {
+    rows.push_back(std::to_string(i) + "&");
+  }
+  rows[5000] = std::string(100000, '<');
+  renderer.SetIterable("rows", rows);
+  std::stringstream input(
+      "{{#loop rows row}}{{#if @index}},{{/if}}<{{row | html}}>{{/loop}}");
+  auto tmpl = yate::Compiler(input).Compile();
+  std::string expected;
+  yate::StringSink expected_sink(expected);
+  renderer.set_loop_kernels(false);
+  renderer.Render(tmpl, expected_sink);
+  renderer.set_loop_kernels(true);
+  std::string output;
+  yate::StringSink sink(output);
+  renderer.Render(tmpl, sink);
+  TEST_EXPECT_EQ(output.size(), expected.size());
+  TEST_EXPECT(output == expected);
+
+  // Loops which would pass the iteration limit fail after the same
+  // elements as the generic path.
+  yate::RenderLimits limits;
+  limits.max_iterations = 4;
+  renderer.set_limits(limits);
+  std::stringstream limited_input(
+      "{{#loop xs x}}{{x}}{{/loop}}{{#loop xs x}}{{x}}{{/loop}}");
+  auto limited = yate::Compiler(limited_input).Compile();
+  output.clear();
+  TEST_EXPECT_EXCEPTION(
+      renderer.Render(limited, sink),
+      yate::RenderLimitExceeded,
+      "Render exceeded 4 loop iterations");
+  TEST_EXPECT_EQ(output, "a<b&ca");
+  return 0;
+}
+
+// Once a renderer has rendered a compiled template, rendering it again
+// into a buffer with enough room makes no heap allocation at all.
+int RenderTests::TestWarmRenderAllocations() {
+  TEST_ASSERT_EQ(yate::AllocationCounter::enabled(), true);
+  auto partials = std::make_shared<yate::PartialCache>(
+      [](const std::string &name, std::string &source) {
+        source = "<li>{{row | html}}</li>";
+        return true;
+      });
+  std::stringstream input(
+      "<h1>{{title | upper | html}}</h1>{{#if rows}}<ul>{{#loop rows row}}"
+      "{{>item}}{{#loop cols col}}{{@index}}{{col}}{{#if @last}}.{{/if}}"
+      "{{/loop}}{{/loop}}</ul>{{#else}}none{{/if}}"
+      "{{#loop rows, cols as r, c}}{{r}}={{c | truncate 2}}{{/loop}}"
+      "{{#if missing}}!{{/if}}"
+      "{{#loop cols col}}{{#if @index}}, {{/if}}{{col | html}}{{/loop}}");
+  yate::Compiler compiler(input);
+  compiler.set_partials(partials);
+  auto tmpl = compiler.Compile();
+  yate::Renderer renderer(
+      {{"title", "a <long> title which does not fit in a small string"}},
+      {{"rows", {"first & row with a long text", "second", "third"}},
+       {"cols", {"x", "yy", "a column which is long enough"}}});
+
+  std::string output;
+  yate::StringSink sink(output);
+  renderer.Render(tmpl, sink);
+  auto size = output.size();
+  output.clear();
+  output.reserve(2 * size);
+  yate::AllocationCounter counter;
+  auto result = renderer.TryRender(tmpl, sink);
+  TEST_EXPECT_EQ(counter.allocations(), 0u);
+  TEST_EXPECT_EQ(counter.bytes(), 0u);
+  TEST_EXPECT(result.ok());
+  TEST_EXPECT_EQ(output.size(), size);
+
+  // The counter sees the allocations of its thread.
+  counter.Reset();
+  std::string copy(output);
+  TEST_EXPECT_EQ(counter.allocations(), 1u);
+  TEST_EXPECT_EQ(counter.bytes(), copy.capacity() + 1);
+  return 0;
+}
@@ -10,4 +10,13 @@ struct RenderTests {
   int TestTemplateVariableShadowing();
   int TestRenderErrors();
   int TestLoopWithEmptyArray();
+  int TestCompiledTemplate();
+  int TestConditionals();
+  int TestLoopMetadata();
+  int TestGenerators();
+  int TestRenderLimits();
+  int TestBoundSymbols();
+  int TestZippedLoops();
+  int TestLoopKernels();
+  int TestWarmRenderAllocations();
 };
@@ -0,0 +1,250 @@
+#include "result_tests.hh"
+
+#include "helpers.hh"
+#include "unit.hh"
+
+#include <yate/compiler.hh>
+#include <yate/limits.hh>
+#include <yate/partial_cache.hh>
+#include <yate/renderer.hh>
+#include <yate/result.hh>
+
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+
+namespace {
+
+yate::Result TryCompileString(
+    const std::string &text,
+    yate::Template &tmpl,
+    std::shared_ptr<yate::PartialCache> partials = nullptr) {
+  std::stringstream input(text);
+  yate::Compiler compiler(input);
+  compiler.set_partials(std::move(partials));
+  return compiler.TryCompile(tmpl);
+}
+
+/// Returns the message of the exception thrown by `Throw()`.
+std::string ThrownMessage(const yate::Result &result) {
+  try {
+    result.Throw();
+  } catch (const std::exception &e) {
+    return e.what();
+  }
+  return "";
+}
+
+struct FailingSink : yate::Sink {
+  void Write(const char *data, std::size_t size) override {
+    throw std::runtime_error("Disk full");
+  }
+};
+
+} // namespace
+
+int ResultTests::RunTests() {
+  int result = 0;
+  result += TestCompileResults();
+  result += TestPartialResults();
+  result += TestRenderResults();
+  result += TestLimitResults();
+  result += TestCaughtExceptions();
+  return result;
+}
+
+// Syntax errors keep the offending token, and the message is the one
+// `Compile()` throws.
+int ResultTests::TestCompileResults() {
+  yate::Template tmpl;
+  auto result = TryCompileString("{{name}}{{#if}}", tmpl);
+  TEST_ASSERT_EQ(result.ok(), false);
+  TEST_EXPECT(result.status() == yate::Status::eUnexpectedToken);
+  TEST_EXPECT(result.token().tag() == yate::Token::Tag::eScriptEnd);
+  TEST_EXPECT_EQ(result.line(), 1u);
+  TEST_EXPECT_EQ(result.column(), 14u);
+  yate::Token::Tag expected;
+  TEST_EXPECT(result.expected(expected));
+  TEST_EXPECT(expected == yate::Token::Tag::eIdentifier);
+  TEST_EXPECT_EQ(
+      result.Message(),
+      "Invalid Syntax: Expected 'IDENTIFIER' but got 'SCRIPT_END' ('}}') "
+      "at line 1 column 14");
+  TEST_EXPECT_EQ(ThrownMessage(result), result.Message());
+
+  yate::Template keyword;
+  result = TryCompileString("ab\n{{#iffy}}", keyword);
+  TEST_EXPECT(result.status() == yate::Status::eLexicalError);
+  TEST_EXPECT_EQ(result.token().value(), "f");
+  TEST_EXPECT_EQ(
+      result.Message(),
+      "Error found in line 2 column 6: Invalid keyword found");
+
+  yate::Template unmatched;
+  result = TryCompileString("{{#loop a b}}{{/if}}", unmatched);
+  TEST_EXPECT(result.status() == yate::Status::eUnmatchedSection);
+  TEST_EXPECT_EQ(result.column(), 16u);
+  TEST_EXPECT_EQ(result.Message(), "Invalid Syntax: Unmatched 'IF_END'");
+
+  yate::Template metadata;
+  result = TryCompileString("{{@index}}", metadata);
+  TEST_EXPECT(result.status() == yate::Status::eLoopMetadataOutsideLoop);
+  TEST_EXPECT_EQ(result.token().value(), "@index");
+
+  yate::Template filter;
+  result = TryCompileString("{{name | shout}}", filter);
+  TEST_EXPECT(result.status() == yate::Status::eInvalidFilter);
+  TEST_EXPECT_EQ(
+      result.Message(),
+      "Unknown filter or escaping mode 'shout' at line 1 column 10");
+
+  yate::Template valid;
+  result = TryCompileString("{{#loop a b}}{{b}}{{/loop}}", valid);
+  TEST_EXPECT(result.ok());
+  TEST_EXPECT(result.status() == yate::Status::eOk);
+  TEST_EXPECT_EQ(result.Message(), "");
+  TEST_EXPECT_EQ(valid.nodes().size(), 3u);
+  return 0;
+}
+
+// Errors in partials name the partials which include each other.
+int ResultTests::TestPartialResults() {
+  auto partials = std::make_shared<yate::PartialCache>(
+      [](const std::string &name, std::string &source) {
+        if (name == "outer") {
+          source = "x{{>inner}}";
+        } else if (name == "inner") {
+          source = "\n{{/loop}}";
+        } else if (name == "self") {
+          source = "{{>self}}";
+        } else {
+          return false;
+        }
+        return true;
+      });
+
+  yate::Template tmpl;
+  auto result = TryCompileString("{{>outer}}", tmpl, partials);
+  TEST_EXPECT(result.status() == yate::Status::eUnmatchedSection);
+  TEST_ASSERT_EQ(result.partials().size(), 2u);
+  TEST_EXPECT_EQ(result.partials()[0], "outer");
+  TEST_EXPECT_EQ(result.partials()[1], "inner");
+  TEST_EXPECT_EQ(result.line(), 2u);
+  TEST_EXPECT_EQ(
+      result.Message(),
+      "In partial 'outer': In partial 'inner': Invalid Syntax: Unmatched "
+      "'LOOP_END'");
+
+  yate::Template recursive;
+  result = TryCompileString("{{>self}}", recursive, partials);
+  TEST_EXPECT(result.status() == yate::Status::eRecursivePartial);
+  TEST_EXPECT_EQ(
+      result.Message(),
+      "In partial 'self': Partial 'self' includes itself at line 1 column 4");
+
+  yate::Template missing;
+  result = TryCompileString("{{>missing}}", missing, partials);
+  TEST_EXPECT(result.status() == yate::Status::ePartialNotFound);
+  TEST_EXPECT(result.partials().empty());
+  return 0;
+}
+
+// Undefined symbols unwind the render with status codes, the renderer
+// can render again afterwards.
+int ResultTests::TestRenderResults() {
+  yate::Renderer renderer({{"name", "Ada"}}, {{"items", {"a", "b"}}});
+  std::string output;
+  yate::StringSink sink(output);
+
+  auto values = CompileString(
+      "{{#loop items item}}{{item}}{{#if item}}{{name}}{{/if}}{{/loop}}"
+      "\n{{nobody}}");
+  auto result = renderer.TryRender(values, sink);
+  TEST_EXPECT(result.status() == yate::Status::eUndefinedIdentifier);
+  TEST_EXPECT_EQ(result.token().value(), "nobody");
+  TEST_EXPECT_EQ(result.line(), 2u);
+  TEST_EXPECT_EQ(result.column(), 3u);
+  TEST_EXPECT_EQ(result.Message(), "Identifier 'nobody' is undefined");
+  TEST_EXPECT_EQ(output, "aAdabAda\n");
+
+  auto arrays = CompileString("{{#loop rows row}}{{row}}{{/loop}}");
+  result = renderer.TryRender(arrays, sink);
+  TEST_EXPECT(result.status() == yate::Status::eUndefinedArray);
+  TEST_EXPECT_EQ(result.Message(), "Array 'rows' is undefined");
+  TEST_EXPECT_EXCEPTION(
+      renderer.Render(arrays, sink),
+      std::runtime_error,
+      "Array 'rows' is undefined");
+
+  output.clear();
+  auto valid = CompileString("{{#loop items item}}{{item}}{{/loop}}");
+  TEST_EXPECT(renderer.TryRender(valid, sink).ok());
+  TEST_EXPECT_EQ(output, "ab");
+
+  std::stringstream input("{{name}}{{#loop rows row}}{{/loop}}");
+  std::stringstream stream_output;
+  result = renderer.TryRender(input, stream_output);
+  TEST_EXPECT(result.status() == yate::Status::eUndefinedArray);
+  TEST_EXPECT_EQ(stream_output.str(), "");
+  return 0;
+}
+
+// Limits checked by the renderer are status codes, `Throw()` raises
+// the same `RenderLimitExceeded` as `Render()`.
+int ResultTests::TestLimitResults() {
+  yate::Renderer renderer({}, {{"items", {"a", "b", "c"}}});
+  auto tmpl = CompileString("{{#loop items item}}{{item}}{{/loop}}");
+  yate::RenderLimits limits;
+  limits.max_iterations = 2;
+  renderer.set_limits(limits);
+  std::string output;
+  yate::StringSink sink(output);
+
+  auto result = renderer.TryRender(tmpl, sink);
+  TEST_EXPECT(result.status() == yate::Status::eIterationLimitExceeded);
+  TEST_EXPECT_EQ(result.Message(), "Render exceeded 2 loop iterations");
+  try {
+    result.Throw();
+    TEST_EXPECT(false);
+  } catch (const yate::RenderLimitExceeded &e) {
+    TEST_EXPECT(e.reason() == yate::RenderLimitExceeded::Reason::eIterations);
+    TEST_EXPECT_EQ(std::string(e.what()), result.Message());
+  }
+
+  auto token = std::make_shared<yate::CancellationToken>();
+  token->Cancel();
+  limits = yate::RenderLimits();
+  limits.cancellation = token;
+  renderer.set_limits(limits);
+  TEST_EXPECT(
+      renderer.TryRender(tmpl, sink).status() == yate::Status::eCancelled);
+
+  limits = yate::RenderLimits();
+  limits.max_output_bytes = 1;
+  renderer.set_limits(limits);
+  result = renderer.TryRender(tmpl, sink);
+  TEST_EXPECT(result.status() == yate::Status::eOutputLimitExceeded);
+  TEST_EXPECT_EQ(result.Message(), "Render output exceeded 1 bytes");
+  TEST_EXPECT_EXCEPTION(
+      result.Throw(),
+      yate::RenderLimitExceeded,
+      "Render output exceeded 1 bytes");
+  return 0;
+}
+
+// Exceptions of the code the renderer calls do not escape, they are
+// kept to be rethrown as they were.
+int ResultTests::TestCaughtExceptions() {
+  yate::Renderer renderer({{"name", "Ada"}}, {});
+  auto tmpl = CompileString("{{name}}");
+  FailingSink sink;
+  auto result = renderer.TryRender(tmpl, sink);
+  TEST_EXPECT(result.status() == yate::Status::eException);
+  TEST_EXPECT_EQ(result.Message(), "Disk full");
+  TEST_EXPECT_EXCEPTION(result.Throw(), std::runtime_error, "Disk full");
+  TEST_EXPECT_EXCEPTION(
+      renderer.Render(tmpl, sink), std::runtime_error, "Disk full");
+  return 0;
+}
@@ -0,0 +1,11 @@
+#pragma once
+
+struct ResultTests {
+  int RunTests();
+
+  int TestCompileResults();
+  int TestPartialResults();
+  int TestRenderResults();
+  int TestLimitResults();
+  int TestCaughtExceptions();
+};
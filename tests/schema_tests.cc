@@ -0,0 +1,128 @@
+#include "schema_tests.hh"
+
+#include "helpers.hh"
+#include "unit.hh"
+
+#include <yate/partial_cache.hh>
+#include <yate/renderer.hh>
+#include <yate/schema.hh>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+int SchemaTests::RunTests() {
+  int result = 0;
+  result += TestValidTemplate();
+  result += TestViolations();
+  result += TestPartialViolations();
+  result += TestValidatedRender();
+  return result;
+}
+
+int SchemaTests::TestValidTemplate() {
+  auto tmpl = CompileString(
+      "{{title}}{{#loop rows row}}{{row}}{{@index}}{{#loop rows title}}"
+      "{{title}}{{/loop}}{{/loop}}{{#if rows}}{{#else}}{{#if title}}{{/if}}"
+      "{{/if}}");
+  yate::Schema schema{{"title"}, {"rows"}};
+  TEST_EXPECT(yate::Validate(tmpl, schema).empty());
+  return 0;
+}
+
+// Every violation is reported, not only the first one.
+int SchemaTests::TestViolations() {
+  auto tmpl = CompileString(
+      "{{title}}\n{{#loop items item}}{{item}}{{name}}{{/loop}}\n"
+      "{{item}}{{#if flag}}{{/if}}{{rows}}");
+  yate::Schema schema{{"title"}, {"rows"}};
+  auto violations = yate::Validate(tmpl, schema);
+  TEST_ASSERT_EQ(violations.size(), 5u);
+  TEST_EXPECT_EQ(
+      violations[0].message, "Array 'items' is not declared in the schema");
+  TEST_EXPECT_EQ(violations[0].line, 2u);
+  TEST_EXPECT_EQ(violations[0].column, 3u);
+  TEST_EXPECT_EQ(
+      violations[1].message, "Identifier 'name' is not declared in the schema");
+  TEST_EXPECT_EQ(violations[1].column, 31u);
+  TEST_EXPECT_EQ(
+      violations[2].message, "Identifier 'item' is not declared in the schema");
+  TEST_EXPECT_EQ(violations[2].line, 3u);
+  TEST_EXPECT_EQ(
+      violations[3].message, "Condition 'flag' is not declared in the schema");
+  TEST_EXPECT_EQ(
+      violations[4].message, "Identifier 'rows' is not declared in the schema");
+
+  std::string expected;
+  for (const auto &violation : violations) {
+    expected += (expected.empty() ? "" : "\n") + violation.message +
+        " at line " + std::to_string(violation.line) + " column " +
+        std::to_string(violation.column);
+  }
+  TEST_EXPECT_EXCEPTION(
+      yate::ValidatedTemplate(
+          std::make_shared<const yate::Template>(tmpl), schema),
+      yate::SchemaError,
+      expected);
+  return 0;
+}
+
+// Partials are validated in the scope of their include.
+int SchemaTests::TestPartialViolations() {
+  auto partials = std::make_shared<yate::PartialCache>(
+      [](const std::string &name, std::string &source) {
+        source = "{{row}}{{@number}}{{missing}}";
+        return name == "row";
+      });
+  auto tmpl = CompileString(
+      "{{#loop rows row}}{{>row}}{{/loop}}{{>row}}", partials);
+  auto violations = yate::Validate(tmpl, yate::Schema{{}, {"rows"}});
+  TEST_ASSERT_EQ(violations.size(), 4u);
+  TEST_EXPECT_EQ(
+      violations[0].message,
+      "In partial 'row': Identifier 'missing' is not declared in the schema");
+  TEST_EXPECT_EQ(violations[0].column, 21u);
+  TEST_EXPECT_EQ(
+      violations[1].message,
+      "In partial 'row': Identifier 'row' is not declared in the schema");
+  TEST_EXPECT_EQ(
+      violations[2].message,
+      "In partial 'row': Loop metadata '@number' used outside of a loop");
+  TEST_EXPECT_EQ(violations[2].column, 10u);
+  return 0;
+}
+
+// Missing symbols are reported before anything is written.
+int SchemaTests::TestValidatedRender() {
+  yate::ValidatedTemplate validated(
+      std::make_shared<const yate::Template>(
+          CompileString("{{title}}:{{#loop rows row}} {{row}}{{/loop}}")),
+      yate::Schema{{"title"}, {"rows"}});
+
+  yate::Renderer renderer({{"title", "list"}}, {});
+  std::string output;
+  yate::StringSink sink(output);
+  TEST_EXPECT_EXCEPTION(
+      renderer.Render(validated, sink),
+      std::runtime_error,
+      "Schema array 'rows' is not set");
+  TEST_EXPECT_EQ(output, "");
+
+  renderer.SetIterable("rows", {"a", "b"});
+  renderer.Render(validated, sink);
+  TEST_EXPECT_EQ(output, "list: a b");
+
+  // Generators satisfy arrays of the schema.
+  yate::Renderer generated({{"title", "gen"}}, {});
+  generated.SetGenerator(
+      "rows",
+      std::make_shared<yate::FunctionGenerator>(
+          [](std::size_t index, std::string &element) {
+            element = std::to_string(index);
+            return index < 2;
+          }));
+  output.clear();
+  generated.Render(validated, sink);
+  TEST_EXPECT_EQ(output, "gen: 0 1");
+  return 0;
+}
@@ -0,0 +1,10 @@
+#pragma once
+
+struct SchemaTests {
+  int RunTests();
+
+  int TestValidTemplate();
+  int TestViolations();
+  int TestPartialViolations();
+  int TestValidatedRender();
+};
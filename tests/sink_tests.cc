@@ -0,0 +1,257 @@
+#include "sink_tests.hh"
+
+#include "unit.hh"
+
+#include <yate/allocation_counter.hh>
+#include <yate/compiler.hh>
+#include <yate/fd_sink.hh>
+#include <yate/hashing_sink.hh>
+#include <yate/renderer.hh>
+#include <yate/sink.hh>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+#ifndef _WIN32
+/// Runs `writer` with the write end of a pipe while the read end is
+/// drained in another thread, and returns everything read.
+template <typename Writer>
+std::string CaptureFd(Writer writer, bool non_blocking = false) {
+  int fds[2];
+  if (pipe(fds) != 0) {
+    return "pipe failed";
+  }
+  if (non_blocking) {
+    fcntl(fds[1], F_SETFL, fcntl(fds[1], F_GETFL) | O_NONBLOCK);
+  }
+  std::string result;
+  std::thread reader([&result, &fds]() {
+    char buffer[4096];
+    ssize_t size;
+    while ((size = read(fds[0], buffer, sizeof(buffer))) > 0) {
+      result.append(buffer, static_cast<std::size_t>(size));
+    }
+  });
+  writer(fds[1]);
+  close(fds[1]);
+  reader.join();
+  close(fds[0]);
+  return result;
+}
+#endif
+
+} // namespace
+
+int SinkTests::RunTests() {
+  int result = 0;
+  result += TestStringSink();
+  result += TestHashingSink();
+  result += TestHashOnlyRender();
+#ifndef _WIN32
+  result += TestFdSinkWrites();
+  result += TestFdSinkBatches();
+  result += TestFdSinkNonBlocking();
+  result += TestRenderToFdSink();
+#endif
+  return result;
+}
+
+// The string sink appends both kinds of writes.
+int SinkTests::TestStringSink() {
+  std::string output = "> ";
+  yate::StringSink sink(output);
+  sink.Write("abc", 3);
+  sink.WriteStable("def", 2);
+  sink.Flush();
+  TEST_EXPECT_EQ(output, "> abcde");
+  return 0;
+}
+
+// The hashes match the reference values and do not depend on how the
+// bytes are split among the writes.
+int SinkTests::TestHashingSink() {
+  {
+    yate::HashingSink sink(true);
+    TEST_EXPECT_EQ(sink.hash(), 0xef46db3751d8e999ull);
+    TEST_EXPECT_EQ(
+        sink.sha256(),
+        "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855");
+    sink.Write("abc", 3);
+    TEST_EXPECT_EQ(sink.hash(), 0x44bc2cf5ad770999ull);
+    TEST_EXPECT_EQ(
+        sink.sha256(),
+        "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad");
+    TEST_EXPECT_EQ(sink.ETag(), '"' + sink.sha256() + '"');
+    TEST_EXPECT_EQ(sink.size(), 3u);
+  }
+
+  std::string text;
+  for (int i = 0; i < 1000; ++i) {
+    text += static_cast<char>(i % 251);
+  }
+  yate::HashingSink whole(true);
+  whole.Write(text.data(), text.size());
+  TEST_EXPECT_EQ(
+      whole.sha256(),
+      "4e4c294b331f7a2099a379bec34b9f9fc03dc46ab465d998f4d683da53487e6d");
+  for (std::size_t chunk : {1, 3, 31, 32, 33, 63, 64, 65, 500}) {
+    std::string output;
+    yate::StringSink target(output);
+    yate::HashingSink split(target, true);
+    for (std::size_t i = 0; i < text.size(); i += chunk) {
+      auto size = std::min(chunk, text.size() - i);
+      if (i % 2 == 0) {
+        split.Write(text.data() + i, size);
+      } else {
+        split.WriteStable(text.data() + i, size);
+      }
+    }
+    split.Flush();
+    TEST_EXPECT_EQ(output, text);
+    TEST_EXPECT_EQ(split.hash(), whole.hash());
+    TEST_EXPECT_EQ(split.sha256(), whole.sha256());
+  }
+
+  // Without SHA-256 the entity tag is the fast hash.
+  yate::HashingSink fast;
+  fast.Write("abc", 3);
+  TEST_EXPECT_EQ(fast.sha256(), "");
+  TEST_EXPECT_EQ(fast.ETag(), "\"44bc2cf5ad770999\"");
+  fast.Reset();
+  TEST_EXPECT_EQ(fast.hash(), 0xef46db3751d8e999ull);
+  TEST_EXPECT_EQ(fast.size(), 0u);
+  return 0;
+}
+
+// Hashing a render without keeping its output gives the hash of the
+// output and, once warm, allocates nothing.
+int SinkTests::TestHashOnlyRender() {
+  std::stringstream input(
+      "<html>{{#loop rows row}}<p>{{row | html}}</p>{{/loop}}</html>");
+  yate::Compiler compiler(input);
+  auto tmpl = compiler.Compile();
+  yate::Renderer renderer({}, {{"rows", {"a & b", std::string(100, 'c')}}});
+  std::string output;
+  yate::StringSink sink(output);
+  renderer.Render(tmpl, sink);
+  yate::HashingSink expected(true);
+  expected.Write(output.data(), output.size());
+
+  yate::HashingSink hashing(true);
+  renderer.Render(tmpl, hashing);
+  TEST_EXPECT_EQ(hashing.ETag(), expected.ETag());
+  hashing.Reset();
+  yate::AllocationCounter counter;
+  renderer.Render(tmpl, hashing);
+  auto hash = hashing.hash();
+  TEST_EXPECT_EQ(counter.allocations(), 0u);
+  TEST_EXPECT_EQ(hash, expected.hash());
+  TEST_EXPECT_EQ(hashing.size(), output.size());
+  return 0;
+}
+
+#ifndef _WIN32
+// Mixes small, stable and big writes, which take different paths in
+// the sink, and checks the order is preserved.
+int SinkTests::TestFdSinkWrites() {
+  std::string stable(300, 's');
+  std::string big(20000, 'b');
+  std::string expected;
+  auto output = CaptureFd([&](int fd) {
+    yate::FdSink sink(fd);
+    for (int i = 0; i < 3; ++i) {
+      std::string small = "<" + std::to_string(i) + ">";
+      sink.Write(small.data(), small.size());
+      expected += small;
+      sink.WriteStable(stable.data(), stable.size());
+      expected += stable;
+      sink.WriteStable("x", 1);
+      expected += "x";
+      sink.Write(big.data(), big.size());
+      expected += big;
+    }
+    sink.Flush();
+    TEST_EXPECT_EQ(sink.bytes_written(), expected.size());
+  });
+  TEST_EXPECT_EQ(output.size(), expected.size());
+  TEST_EXPECT(output == expected);
+  return 0;
+}
+
+// More vectors than `IOV_MAX` and more bytes than the pending limit
+// are split in several calls.
+int SinkTests::TestFdSinkBatches() {
+  std::vector<std::string> pieces;
+  for (int i = 0; i < 3000; ++i) {
+    pieces.push_back(std::string(200, static_cast<char>('a' + i % 26)));
+  }
+  std::string expected;
+  std::uint64_t calls = 0;
+  auto output = CaptureFd([&](int fd) {
+    yate::FdSink sink(fd, 256 * 1024);
+    for (const auto &piece : pieces) {
+      sink.WriteStable(piece.data(), piece.size());
+      expected += piece;
+    }
+    sink.Flush();
+    calls = sink.system_calls();
+  });
+  TEST_EXPECT(output == expected);
+  TEST_EXPECT(calls >= 3u);
+  return 0;
+}
+
+// Non-blocking descriptors produce partial writes which are resumed.
+int SinkTests::TestFdSinkNonBlocking() {
+  std::vector<std::string> pieces;
+  for (int i = 0; i < 2000; ++i) {
+    pieces.push_back(std::string(1000, static_cast<char>('A' + i % 26)));
+  }
+  std::string expected;
+  auto output = CaptureFd(
+      [&](int fd) {
+        yate::FdSink sink(fd);
+        for (const auto &piece : pieces) {
+          sink.WriteStable(piece.data(), piece.size());
+          expected += piece;
+        }
+        sink.Flush();
+      },
+      true);
+  TEST_EXPECT_EQ(output.size(), expected.size());
+  TEST_EXPECT(output == expected);
+  return 0;
+}
+
+// Rendering into a descriptor gives the same output as a stream.
+int SinkTests::TestRenderToFdSink() {
+  std::stringstream input(
+      "{{title}}\n{{#loop rows row}}<li>{{row}} {{title}}</li>\n{{/loop}}");
+  yate::Compiler compiler(input);
+  auto tmpl = compiler.Compile();
+  std::vector<std::string> rows;
+  for (int i = 0; i < 500; ++i) {
+    rows.push_back(std::string(static_cast<std::size_t>(i), 'r'));
+  }
+  yate::Renderer renderer({{"title", std::string(150, 't')}}, {{"rows", rows}});
+
+  std::stringstream expected;
+  renderer.Render(tmpl, expected);
+  auto output = CaptureFd([&](int fd) {
+    yate::FdSink sink(fd);
+    renderer.Render(tmpl, sink);
+  });
+  TEST_EXPECT(output == expected.str());
+  return 0;
+}
+#endif
@@ -0,0 +1,13 @@
+#pragma once
+
+struct SinkTests {
+  int RunTests();
+
+  int TestStringSink();
+  int TestHashingSink();
+  int TestHashOnlyRender();
+  int TestFdSinkWrites();
+  int TestFdSinkBatches();
+  int TestFdSinkNonBlocking();
+  int TestRenderToFdSink();
+};
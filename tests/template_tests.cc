@@ -0,0 +1,319 @@
+#include "template_tests.hh"
+
+#include "helpers.hh"
+#include "unit.hh"
+
+#include <yate/compiler.hh>
+#include <yate/partial_cache.hh>
+#include <yate/renderer.hh>
+#include <yate/symbol_table.hh>
+#include <yate/template.hh>
+
+#include <memory>
+#include <sstream>
+#include <string>
+
+int TemplateTests::RunTests() {
+  int result = 0;
+  result += TestSpecializeValues();
+  result += TestSpecializeLoops();
+  result += TestSpecializeShadowing();
+  result += TestSectionDependencies();
+  result += TestSpecializeConditionals();
+  result += TestSpecializeLoopMetadata();
+  result += TestSymbolTable();
+  result += TestSymbolTableSpread();
+  result += TestSymbolSlots();
+  return result;
+}
+
+// Known values are folded into a single literal while the unknown
+// ones are left for render time.
+int TemplateTests::TestSpecializeValues() {
+  using Kind = yate::Template::Node::Kind;
+  auto tmpl = CompileString("<a href=\"{{cdn}}/{{path}}\">{{site}}</a>");
+  auto residual = tmpl.Specialize({{"cdn", "//cdn"}, {"site", "Yate"}}, {});
+  const auto &nodes = residual.nodes();
+
+  TEST_ASSERT_EQ(nodes.size(), 3u);
+  TEST_EXPECT(nodes[0].kind == Kind::eLiteral);
+  TEST_EXPECT_EQ(nodes[0].text, "<a href=\"//cdn/");
+  TEST_EXPECT(nodes[1].kind == Kind::eValue);
+  TEST_EXPECT_EQ(nodes[1].text, "path");
+  TEST_EXPECT_EQ(nodes[2].text, "\">Yate</a>");
+
+  yate::Renderer renderer({{"path", "index.html"}}, {});
+  std::stringstream output;
+  renderer.Render(residual, output);
+  TEST_EXPECT_EQ(output.str(), "<a href=\"//cdn/index.html\">Yate</a>");
+  return 0;
+}
+
+// Loops over known arrays are unrolled, loops over unknown ones are
+// kept with their bodies specialized.
+int TemplateTests::TestSpecializeLoops() {
+  using Kind = yate::Template::Node::Kind;
+  auto tmpl = CompileString(
+      "{{#loop labels label}}[{{label}}]{{/loop}}"
+      "{{#loop rows row}}{{prefix}}{{row}}{{#loop labels l}}{{l}}{{/loop}}"
+      "{{/loop}}");
+  auto residual = tmpl.Specialize(
+      {{"prefix", "> "}}, {{"labels", {"a", "b"}}});
+  const auto &nodes = residual.nodes();
+
+  TEST_ASSERT_EQ(nodes.size(), 6u);
+  TEST_EXPECT_EQ(nodes[0].text, "[a][b]");
+  TEST_EXPECT(nodes[1].kind == Kind::eLoopBegin);
+  TEST_EXPECT_EQ(nodes[1].text, "rows");
+  TEST_EXPECT_EQ(nodes[1].jump, 5u);
+  TEST_EXPECT_EQ(nodes[2].text, "> ");
+  TEST_EXPECT(nodes[3].kind == Kind::eValue);
+  // The inner loop over a known array becomes a single literal.
+  TEST_EXPECT_EQ(nodes[4].text, "ab");
+  TEST_EXPECT(nodes[5].kind == Kind::eLoopEnd);
+
+  yate::Renderer full(
+      {{"prefix", "> "}}, {{"labels", {"a", "b"}}, {"rows", {"1", "2"}}});
+  std::stringstream expected;
+  full.Render(tmpl, expected);
+
+  yate::Renderer partial({}, {{"rows", {"1", "2"}}});
+  std::stringstream output;
+  partial.Render(residual, output);
+  TEST_EXPECT_EQ(output.str(), expected.str());
+  TEST_EXPECT_EQ(output.str(), "[a][b]> 1ab> 2ab");
+
+  // Zipped loops are unrolled when all their arrays are known and
+  // kept when none is, so the residual does not read the known ones.
+  auto zipped = CompileString(
+      "{{#loop labels, codes as label, code}}{{label}}{{code}}{{/loop}}"
+      "{{#loop rows, units as row, unit}}{{row}}{{unit}}{{/loop}}");
+  auto zipped_residual =
+      zipped.Specialize({}, {{"labels", {"a", "b"}}, {"codes", {"1", "2"}}});
+  const auto &zipped_nodes = zipped_residual.nodes();
+  TEST_ASSERT_EQ(zipped_nodes.size(), 5u);
+  TEST_EXPECT_EQ(zipped_nodes[0].text, "a1b2");
+  TEST_EXPECT(zipped_nodes[1].kind == Kind::eLoopBegin);
+  TEST_ASSERT_EQ(zipped_nodes[1].zipped.size(), 1u);
+  TEST_EXPECT_EQ(zipped_nodes[1].zipped[0].array, "units");
+
+  yate::Renderer zipped_renderer(
+      {}, {{"rows", {"3", "4"}}, {"units", {"x", "y"}}});
+  std::stringstream zipped_output;
+  zipped_renderer.Render(zipped_residual, zipped_output);
+  TEST_EXPECT_EQ(zipped_output.str(), "a1b23x4y");
+
+  // Knowing only some of the arrays, or arrays of different lengths,
+  // cannot be specialized.
+  TEST_EXPECT_EXCEPTION(
+      zipped.Specialize({}, {{"labels", {"a", "b"}}, {"rows", {"1", "2"}}}),
+      std::runtime_error,
+      "Cannot specialize the zipped loop over 'labels' without array "
+      "'codes' at line 1 column 3");
+  TEST_EXPECT_EXCEPTION(
+      zipped.Specialize({}, {{"units", {"x"}}}),
+      std::runtime_error,
+      "Cannot specialize the zipped loop over 'units' without array "
+      "'rows' at line 1 column 67");
+  TEST_EXPECT_EXCEPTION(
+      zipped.Specialize({}, {{"labels", {"a", "b"}}, {"codes", {"1"}}}),
+      std::runtime_error,
+      "Array 'codes' has 1 elements but 'labels' has 2 at line 1 column 3");
+  return 0;
+}
+
+// Symbols bound by loops shadow the known values.
+int TemplateTests::TestSpecializeShadowing() {
+  auto tmpl = CompileString(
+      "{{foo}}{{#loop array foo}}{{foo}}{{/loop}}"
+      "{{#loop known foo}}{{foo}}{{/loop}}{{foo}}");
+  auto residual = tmpl.Specialize({{"foo", "bar"}}, {{"known", {"k"}}});
+
+  yate::Renderer renderer({}, {{"array", {"first", "second"}}});
+  std::stringstream output;
+  renderer.Render(residual, output);
+  TEST_EXPECT_EQ(output.str(), "barfirstsecondkbar");
+  return 0;
+}
+
+// Top-level loops know the symbols they read, excluding the ones
+// bound by the loops themselves.
+int TemplateTests::TestSectionDependencies() {
+  auto tmpl = CompileString(
+      "{{title}}{{#loop rows row}}{{row}}{{label}}"
+      "{{#loop cols col}}{{col}}{{row}}{{title}}{{/loop}}{{/loop}}");
+  TEST_EXPECT(tmpl.section_dependencies(0) == nullptr);
+  TEST_EXPECT(tmpl.section_dependencies(4) == nullptr);
+
+  auto dependencies = tmpl.section_dependencies(1);
+  TEST_ASSERT_EQ(dependencies != nullptr, true);
+  TEST_EXPECT(
+      dependencies->values == std::vector<std::string>({"label", "title"}));
+  TEST_EXPECT(
+      dependencies->arrays == std::vector<std::string>({"rows", "cols"}));
+
+  auto copy = tmpl;
+  TEST_EXPECT_EQ(copy.id(), tmpl.id());
+  copy.AppendLiteral("more", 1, 1);
+  TEST_EXPECT_NEQ(copy.id(), tmpl.id());
+  return 0;
+}
+
+// Conditionals over known symbols are replaced by the branch taken,
+// the others are kept with both branches specialized.
+int TemplateTests::TestSpecializeConditionals() {
+  using Kind = yate::Template::Node::Kind;
+  auto tmpl = CompileString(
+      "{{#if a}}A{{#else}}!A{{/if}}{{#if xs}}{{#loop xs x}}{{#if x}}{{x}}"
+      "{{/if}}{{/loop}}{{/if}}{{#if u}}{{v}}{{#else}}{{a}}{{/if}}");
+  auto residual = tmpl.Specialize({{"a", ""}}, {{"xs", {"1", ""}}});
+  const auto &nodes = residual.nodes();
+  // The value of `a` is folded into an empty literal, which is dropped.
+  TEST_ASSERT_EQ(nodes.size(), 5u);
+  TEST_EXPECT(nodes[0].kind == Kind::eLiteral);
+  TEST_EXPECT_EQ(nodes[0].text, "!A1");
+  TEST_EXPECT(nodes[1].kind == Kind::eIfBegin);
+  TEST_EXPECT_EQ(nodes[1].text, "u");
+  TEST_EXPECT_EQ(nodes[1].jump, 3u);
+  TEST_EXPECT(nodes[2].kind == Kind::eValue);
+  TEST_EXPECT(nodes[3].kind == Kind::eElse);
+  TEST_EXPECT(nodes[4].kind == Kind::eIfEnd);
+
+  // Conditions on symbols bound by loops are not dependencies.
+  auto dependencies = tmpl.section_dependencies(0);
+  TEST_ASSERT_EQ(dependencies != nullptr, true);
+  TEST_EXPECT(dependencies->conditions == std::vector<std::string>({"a"}));
+  dependencies = tmpl.section_dependencies(5);
+  TEST_ASSERT_EQ(dependencies != nullptr, true);
+  TEST_EXPECT(dependencies->arrays == std::vector<std::string>({"xs"}));
+  TEST_EXPECT(dependencies->conditions == std::vector<std::string>({"xs"}));
+  dependencies = tmpl.section_dependencies(12);
+  TEST_ASSERT_EQ(dependencies != nullptr, true);
+  TEST_EXPECT(dependencies->values == std::vector<std::string>({"v", "a"}));
+  TEST_EXPECT(dependencies->conditions == std::vector<std::string>({"u"}));
+
+  yate::Renderer renderer({{"v", "V"}}, {});
+  std::stringstream output;
+  renderer.Render(residual, output);
+  TEST_EXPECT_EQ(output.str(), "!A1");
+  renderer.SetValue("u", "yes");
+  std::stringstream true_output;
+  renderer.Render(residual, true_output);
+  TEST_EXPECT_EQ(true_output.str(), "!A1V");
+  return 0;
+}
+
+// Metadata is folded inside unrolled loops and kept inside the loops
+// left for render time.
+int TemplateTests::TestSpecializeLoopMetadata() {
+  using Kind = yate::Template::Node::Kind;
+  auto tmpl = CompileString(
+      "{{#loop known k}}{{@number}}{{#if @last}}.{{#else}},{{/if}}{{/loop}}"
+      "{{#loop rows row}}{{@index}}{{#if @first}}!{{/if}}{{/loop}}");
+  auto residual = tmpl.Specialize({}, {{"known", {"a", "b"}}});
+  const auto &nodes = residual.nodes();
+
+  TEST_ASSERT_EQ(nodes.size(), 7u);
+  TEST_EXPECT_EQ(nodes[0].text, "1,2.");
+  TEST_EXPECT(nodes[2].kind == Kind::eValue);
+  TEST_EXPECT(nodes[2].metadata == yate::LoopMetadata::eIndex);
+  TEST_EXPECT(nodes[3].kind == Kind::eIfBegin);
+  TEST_EXPECT(nodes[3].metadata == yate::LoopMetadata::eFirst);
+  auto dependencies = residual.section_dependencies(1);
+  TEST_ASSERT_EQ(dependencies != nullptr, true);
+  TEST_EXPECT(dependencies->values.empty());
+  TEST_EXPECT(dependencies->conditions.empty());
+
+  yate::Renderer renderer({}, {{"rows", {"x", "y"}}});
+  std::stringstream output;
+  renderer.Render(residual, output);
+  TEST_EXPECT_EQ(output.str(), "1,2.0!1");
+  return 0;
+}
+
+// Every name is found in its slot and no other name is, before the
+// hash is built, after it and after adding a name to a built table.
+int TemplateTests::TestSymbolTable() {
+  yate::SymbolTable table;
+  TEST_EXPECT_EQ(table.Find("a"), yate::SymbolTable::kNotFound);
+  table.Build();
+  TEST_EXPECT_EQ(table.Find("a"), yate::SymbolTable::kNotFound);
+  for (std::uint32_t i = 0; i < 1000; ++i) {
+    TEST_ASSERT_EQ(table.Add("symbol" + std::to_string(i)), i);
+  }
+  TEST_EXPECT_EQ(table.Add("symbol7"), 7u);
+  TEST_EXPECT_EQ(table.size(), 1000u);
+  for (auto round = 0; round < 3; ++round) {
+    if (round == 1) {
+      table.Build();
+    } else if (round == 2) {
+      TEST_EXPECT_EQ(table.Add("symbol7"), 7u);
+      TEST_EXPECT_EQ(table.Add("symbol1000"), 1000u);
+      TEST_EXPECT_EQ(table.Find("symbol1000"), 1000u);
+      table.Build();
+      TEST_EXPECT_EQ(table.Find("symbol1000"), 1000u);
+    }
+    for (std::uint32_t i = 0; i < 1000; ++i) {
+      TEST_EXPECT_EQ(table.Find("symbol" + std::to_string(i)), i);
+      TEST_EXPECT_EQ(table.name(i), "symbol" + std::to_string(i));
+    }
+    TEST_EXPECT_EQ(table.Find("symbol1001"), yate::SymbolTable::kNotFound);
+    TEST_EXPECT_EQ(table.Find(""), yate::SymbolTable::kNotFound);
+  }
+  return 0;
+}
+
+// With more positions than names some positions are empty, unknown
+// names which hash to them are not found.
+int TemplateTests::TestSymbolTableSpread() {
+  yate::SymbolTable table;
+  for (std::uint32_t i = 0; i < 100; ++i) {
+    TEST_ASSERT_EQ(table.Add("symbol" + std::to_string(i)), i);
+  }
+  table.Build(4);
+  TEST_ASSERT_EQ(table.position_count(), 400u);
+  for (std::uint32_t i = 0; i < 100; ++i) {
+    TEST_EXPECT_EQ(table.Find("symbol" + std::to_string(i)), i);
+  }
+  for (std::uint32_t i = 100; i < 1000; ++i) {
+    TEST_EXPECT_EQ(
+        table.Find("symbol" + std::to_string(i)), yate::SymbolTable::kNotFound);
+  }
+  return 0;
+}
+
+// Symbols read from the root get a slot, the ones bound by loops do
+// not, also when partials are inlined inside loops.
+int TemplateTests::TestSymbolSlots() {
+  const auto kNone = yate::SymbolTable::kNotFound;
+  auto tmpl = CompileString(
+      "{{a}}{{#loop rows a}}{{a}}{{b}}{{@index}}{{/loop}}{{#if c}}{{a}}"
+      "{{/if}}");
+  const auto &nodes = tmpl.nodes();
+  TEST_ASSERT_EQ(tmpl.symbols().size(), 4u);
+  TEST_EXPECT_EQ(nodes[0].slot, 0u);
+  TEST_EXPECT_EQ(nodes[1].slot, tmpl.symbols().Find("rows"));
+  TEST_EXPECT_EQ(nodes[2].slot, kNone);
+  TEST_EXPECT_EQ(nodes[3].slot, tmpl.symbols().Find("b"));
+  TEST_EXPECT_EQ(nodes[4].slot, kNone);
+  TEST_EXPECT_EQ(nodes[6].slot, tmpl.symbols().Find("c"));
+  TEST_EXPECT_EQ(nodes[7].slot, 0u);
+
+  auto partials = std::make_shared<yate::PartialCache>(
+      [](const std::string &name, std::string &source) {
+        source = "{{item}}{{other}}";
+        return true;
+      });
+  std::stringstream input("{{#loop rows item}}{{>p}}{{/loop}}{{>p}}");
+  yate::Compiler compiler(input);
+  compiler.set_partials(partials);
+  compiler.set_inline_limit(8);
+  auto inlined = compiler.Compile();
+  const auto &symbols = inlined.symbols();
+  TEST_ASSERT_EQ(symbols.size(), 3u);
+  TEST_EXPECT_EQ(inlined.nodes()[1].slot, kNone);
+  TEST_EXPECT_EQ(inlined.nodes()[2].slot, symbols.Find("other"));
+  TEST_EXPECT_EQ(inlined.nodes()[4].slot, symbols.Find("item"));
+  TEST_EXPECT_EQ(inlined.nodes()[5].slot, symbols.Find("other"));
+  return 0;
+}
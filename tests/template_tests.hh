@@ -0,0 +1,15 @@
+#pragma once
+
+struct TemplateTests {
+  int RunTests();
+
+  int TestSpecializeValues();
+  int TestSpecializeLoops();
+  int TestSpecializeShadowing();
+  int TestSectionDependencies();
+  int TestSpecializeConditionals();
+  int TestSpecializeLoopMetadata();
+  int TestSymbolTable();
+  int TestSymbolTableSpread();
+  int TestSymbolSlots();
+};
@@ -1,7 +1,21 @@
 #include <iostream>
 
+#include "async_tests.hh"
+#include "compiler_tests.hh"
+#include "escape_tests.hh"
+#include "filter_tests.hh"
+#include "fragment_cache_tests.hh"
+#include "gzip_tests.hh"
+#include "incremental_tests.hh"
+#include "json_tests.hh"
 #include "lexer_tests.hh"
+#include "partial_tests.hh"
+#include "registry_tests.hh"
 #include "render_tests.hh"
+#include "result_tests.hh"
+#include "schema_tests.hh"
+#include "sink_tests.hh"
+#include "template_tests.hh"
 
 #include <yate/yate.hh>
 
@@ -13,5 +27,52 @@ int main(int argc, char **argv) {
   RenderTests render_tests;
   return_code += render_tests.RunTests();
 
+  CompilerTests compiler_tests;
+  return_code += compiler_tests.RunTests();
+
+  TemplateTests template_tests;
+  return_code += template_tests.RunTests();
+
+  FragmentCacheTests fragment_cache_tests;
+  return_code += fragment_cache_tests.RunTests();
+
+  IncrementalTests incremental_tests;
+  return_code += incremental_tests.RunTests();
+
+  SinkTests sink_tests;
+  return_code += sink_tests.RunTests();
+
+  EscapeTests escape_tests;
+  return_code += escape_tests.RunTests();
+
+  FilterTests filter_tests;
+  return_code += filter_tests.RunTests();
+
+  PartialTests partial_tests;
+  return_code += partial_tests.RunTests();
+
+  RegistryTests registry_tests;
+  return_code += registry_tests.RunTests();
+
+  SchemaTests schema_tests;
+  return_code += schema_tests.RunTests();
+
+  ResultTests result_tests;
+  return_code += result_tests.RunTests();
+
+  JsonTests json_tests;
+  return_code += json_tests.RunTests();
+
+#ifdef YATE_ZLIB
+  GzipTests gzip_tests;
+  return_code += gzip_tests.RunTests();
+#endif
+
+#ifdef YATE_COROUTINES
+  AsyncTests async_tests;
+  return_code += async_tests.RunTests();
+#endif
+
+
   return return_code;
 }